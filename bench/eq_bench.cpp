@@ -0,0 +1,98 @@
+/**
+ * @brief Host benchmark of the equalizer kernels
+ *
+ * Runs the scalar reference and the block kernel over the same noise, checks
+ * that they agree bit for bit and reports the cost per sample. Built by
+ * env:bench (pio run -e bench -t exec). Host cycles only rank the kernels;
+ * the on-device numbers for the 5% budget come from the AUDIO_BENCHMARK
+ * firmware (env:esp32-s3-bench), which also times the ESP-DSP kernel.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "EqualizerKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles() { return __rdtsc(); }
+#else
+static uint64_t cycles() { return 0; }
+#endif
+
+static const uint32_t RATE = 44100;
+static const size_t BLOCK_FRAMES = 32;  // Same as AudioOutputEqualizer
+static const size_t SECONDS = 20;
+
+struct Result {
+    double nsPerSample;
+    double cyclesPerSample;
+};
+
+typedef void (*Kernel)(const EqCoeffs*, EqState*, size_t, int16_t*, size_t, int32_t*);
+
+static void reference(const EqCoeffs* coeffs, EqState* state, size_t bands,
+                      int16_t* pcm, size_t frames, int32_t*) {
+    eqProcessReference(coeffs, state, bands, pcm, frames);
+}
+
+static Result run(Kernel kernel, const EqCoeffs* coeffs, size_t bands, std::vector<int16_t>& pcm) {
+    EqState state[EQ_MAX_BANDS * 2];
+    memset(state, 0, sizeof(state));
+    int32_t work[BLOCK_FRAMES * 2];
+
+    size_t frames = pcm.size() / 2;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t startCycles = cycles();
+    for (size_t frame = 0; frame + BLOCK_FRAMES <= frames; frame += BLOCK_FRAMES) {
+        kernel(coeffs, state, bands, &pcm[frame * 2], BLOCK_FRAMES, work);
+    }
+    uint64_t elapsedCycles = cycles() - startCycles;
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    double samples = (double)pcm.size();
+    Result result;
+    result.nsPerSample = std::chrono::duration<double, std::nano>(elapsed).count() / samples;
+    result.cyclesPerSample = elapsedCycles / samples;
+    return result;
+}
+
+int main() {
+    // Octave spaced peaking bands, the worst case of a full cascade
+    EqBand bands[EQ_MAX_BANDS];
+    EqCoeffs coeffs[EQ_MAX_BANDS];
+    for (size_t i = 0; i < EQ_MAX_BANDS; i++) {
+        bands[i] = {EqFilterType::Peaking, 31.25f * (1 << i), 3.0f, 1.0f};
+        eqDesign(bands[i], RATE, i == 0 ? 0.7f : 1.0f, coeffs[i]);
+    }
+
+    std::vector<int16_t> input(RATE * SECONDS * 2);
+    uint32_t seed = 12345;
+    for (auto& sample : input) {
+        seed = seed * 1664525 + 1013904223;
+        sample = (int16_t)(seed >> 16);
+    }
+
+    const size_t bandCounts[] = {5, EQ_MAX_BANDS};
+    bool exact = true;
+    for (size_t count : bandCounts) {
+        std::vector<int16_t> scalar = input;
+        std::vector<int16_t> block = input;
+        Result ref = run(reference, coeffs, count, scalar);
+        Result blk = run(eqProcessBlock, coeffs, count, block);
+
+        bool same = scalar == block;
+        exact = exact && same;
+        printf("%2u bands  reference: %6.2f ns/sample %7.1f cycles/sample\n",
+               (unsigned)count, ref.nsPerSample, ref.cyclesPerSample);
+        printf("%2u bands  block:     %6.2f ns/sample %7.1f cycles/sample  (%s)\n",
+               (unsigned)count, blk.nsPerSample, blk.cyclesPerSample,
+               same ? "bit-exact" : "MISMATCH");
+        // 44.1 kHz stereo is 88200 samples per second
+        printf("%2u bands  block load: %.3f%% of one host core\n",
+               (unsigned)count, blk.nsPerSample * RATE * 2 / 1e7);
+    }
+
+    return exact ? 0 : 1;
+}
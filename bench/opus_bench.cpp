@@ -0,0 +1,108 @@
+/**
+ * @brief Host benchmark of Ogg Opus decoding
+ *
+ * Demuxes each file given on the command line with the firmware's
+ * OggDemuxer and decodes it with the system libopus, the same code base
+ * ESP8266Audio bundles. Reports the cost per packet, the share of a core
+ * needed in real time and the bitrate of the file. Built by env:opus-bench
+ * (needs libopus-dev), run as
+ *     .pio/build/opus-bench/program file.opus [...]
+ * The on-device numbers, next to both MP3 decoders, come from the
+ * AUDIO_BENCHMARK firmware (env:esp32-s3-bench) with the files in /bench.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <opus/opus.h>
+#include "OggDemuxer.h"
+
+static const int RATE = 48000;
+static const int MAX_FRAMES = 5760;  // 120 ms, the longest Opus packet
+
+struct Source {
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+};
+
+static size_t readSource(void* context, uint8_t* data, size_t len) {
+    Source* source = static_cast<Source*>(context);
+    size_t count = std::min(len, source->data.size() - source->pos);
+    memcpy(data, source->data.data() + source->pos, count);
+    source->pos += count;
+    return count;
+}
+
+static bool load(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t len;
+    while ((len = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + len);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool run(const char* path) {
+    Source source;
+    if (!load(path, source.data)) {
+        printf("%s: cannot read\n", path);
+        return false;
+    }
+
+    OggDemuxer demuxer;
+    int error = OPUS_OK;
+    OpusDecoder* decoder = opus_decoder_create(RATE, 2, &error);
+    if (!demuxer.allocate() || error != OPUS_OK) {
+        printf("%s: out of memory\n", path);
+        return false;
+    }
+    std::vector<int16_t> pcm(MAX_FRAMES * 2);
+
+    uint32_t packets = 0;
+    uint64_t samples = 0;
+    std::chrono::steady_clock::duration elapsed{};
+    const uint8_t* packet;
+    size_t len;
+    while (demuxer.next(readSource, &source, &packet, &len) == OggDemuxer::Result::Packet) {
+        if (len == 0 || (len >= 8 && (memcmp(packet, "OpusHead", 8) == 0 || memcmp(packet, "OpusTags", 8) == 0))) {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        int frames = opus_decode(decoder, packet, (opus_int32)len, pcm.data(), MAX_FRAMES, 0);
+        elapsed += std::chrono::steady_clock::now() - start;
+        if (frames > 0) {
+            packets++;
+            samples += frames;
+        }
+    }
+    opus_decoder_destroy(decoder);
+
+    if (packets == 0) {
+        printf("%s: no Opus packets\n", path);
+        return false;
+    }
+    double us = std::chrono::duration<double, std::micro>(elapsed).count();
+    double audioUs = samples * 1e6 / RATE;
+    printf("%s: %u packets, %.1f us/packet (%.2f%% of a core), %.0f kbps, %u bad pages\n",
+           path, packets, us / packets, 100.0 * us / audioUs,
+           source.data.size() * 8000.0 / audioUs, demuxer.getBadPages());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s file.opus [...]\n", argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        ok = run(argv[i]) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -12,10 +12,14 @@ struct Alarm {
     bool enabled;
     bool repeat[7];  // 0=Sunday, 1=Monday, ..., 6=Saturday
     uint8_t volume;  // 0-100
-    uint8_t source;  // 0=Radio, 1=MP3
+    uint8_t source;  // 0=Radio, 1=MP3, 2=Podcast, 3=Tone
+    uint8_t fadeIn;     // Fade-in time in seconds, 0=off
+    uint8_t fadeCurve;  // 0=Linear, 1=Perceptual
     union {
         uint8_t stationIndex;  // For radio
         char filepath[64];     // For MP3 files
+        uint8_t feedIndex;     // For podcasts, latest downloaded episode
+        uint8_t tonePattern;   // For tones, see AudioGeneratorTone
     } sourceData;
     
     bool shouldTrigger(const struct tm& timeInfo) const;
@@ -39,6 +43,9 @@ public:
     // Alarm trigger callback type
     using AlarmTriggerCallback = std::function<void(const Alarm& alarm)>;
     
+    // Called once, preflightLead seconds before an alarm triggers
+    using AlarmPreflightCallback = std::function<void(const Alarm& alarm)>;
+    
     static AlarmManager& getInstance() {
         if (!instance) {
             instance = new AlarmManager();
@@ -62,6 +69,17 @@ public:
     
     // Callbacks
     void setAlarmTriggerCallback(AlarmTriggerCallback cb) { triggerCallback = cb; }
+    void setAlarmPreflightCallback(AlarmPreflightCallback cb) { preflightCallback = cb; }
+    
+    // Pre-flight lead time in seconds, 0 disables the pre-flight phase
+    void setPreflightLead(uint16_t seconds) { preflightLead = seconds; }
+    
+    // True between a pre-flight and its alarm
+    bool isPreflightActive() const { return preflightTime != 0; }
+    
+    // Time until the clock reaches its next second, update() has a new
+    // second to check from then on; the scheduler sleeps this long
+    uint32_t msToNextSecond() const;
     
     // Time management
     void setTimeZone(const char* tz);
@@ -87,12 +105,16 @@ private:
     time_t lastCheckTime = 0;
     time_t snoozeEndTime = 0;
     uint8_t lastTriggeredAlarmId = 0;
+    uint16_t preflightLead = 30;
+    time_t preflightTime = 0;  // Trigger time of the alarm that had its pre-flight
     
     // Callbacks
     AlarmTriggerCallback triggerCallback = nullptr;
+    AlarmPreflightCallback preflightCallback = nullptr;
     
     // Private helpers
     bool isAlarmActive(const Alarm& alarm) const;
+    void checkPreflight(time_t now);
     void loadAlarms();
     void saveAlarms();
 };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Picks the stream variant of a station the network can sustain
+ *
+ * Fed once a second with the state of the jitter buffer on air. It steps
+ * down one or more variants as soon as the buffer drains while the link
+ * delivers less than the stream needs, so the switch happens before the
+ * decoder underruns, and at once after an underrun. It steps up one variant
+ * after the buffer has stayed full for a while; a step up that fails (the
+ * next variant does not buffer in time) doubles that wait.
+ *
+ * Pure policy, the caller does the switching.
+ */
+class AudioBitrateSelector {
+public:
+    static const size_t MAX_VARIANTS = 4;
+
+    // Jitter buffer state of the stream on air
+    struct Health {
+        uint32_t throughput;  // Unthrottled arrival rate in bytes per second
+        size_t fill;          // Bytes buffered
+        size_t target;        // Adaptive depth the producer fills to
+        uint32_t underruns;   // Cumulative decoder underruns of the stream
+    };
+
+    /**
+     * @brief Start over for a station
+     * @param kbps Bitrates of the variants in ascending order
+     * @param count Number of variants (at most MAX_VARIANTS)
+     * @param current Variant on air
+     */
+    void reset(const uint16_t* kbps, size_t count, size_t current);
+
+    /**
+     * @brief Evaluate the buffer state
+     * @return Variant to switch to, or -1 to stay
+     */
+    int update(const Health& health, uint32_t now);
+
+    // The variant returned by update() is on air now
+    void onSwitched(size_t variant, uint32_t now);
+
+    // The variant returned by update() could not be switched to
+    void onSwitchFailed();
+
+    size_t getCurrent() const { return current; }
+
+private:
+    uint16_t kbps[MAX_VARIANTS] = {};
+    size_t count = 0;
+    size_t current = 0;
+
+    uint32_t lastUnderruns = 0;
+    bool underrunsKnown = false;
+    bool draining = false;       // Buffer low while the link falls short
+    uint32_t drainingSince = 0;
+    bool healthy = false;        // Buffer full
+    uint32_t healthySince = 0;
+    uint32_t upHoldMs = 0;       // Time the buffer must stay full before a step up
+    bool steppedUp = false;      // The last switch went up
+    uint32_t lastUpMs = 0;
+
+    static uint32_t bytesPerSecond(uint16_t kbps) { return (uint32_t)kbps * 125; }
+    int fastestSustainable(uint32_t throughput) const;
+};
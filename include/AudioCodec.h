@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Compressed formats the stream pipeline can decode
+ */
+enum class StreamCodec : uint8_t {
+    Unknown = 0,
+    MP3,
+    AAC,  // AAC-LC and HE-AAC in ADTS framing
+    Opus  // Ogg Opus
+};
+
+namespace AudioCodec {
+
+// Bytes parseFrameHeader() looks at
+static const size_t FRAME_HEADER_BYTES = 7;
+
+struct FrameHeader {
+    size_t length;        // Frame size in bytes, header included
+    uint32_t samples;     // PCM samples per channel the frame decodes to
+    uint32_t sampleRate;  // Hz (the AAC core rate for HE-AAC)
+};
+
+// Short name as stored in the station list ("mp3", "aac", "opus", "" for unknown)
+const char* name(StreamCodec codec);
+StreamCodec fromName(const char* name);
+
+// PCM samples per channel of a typical frame: 1152 for MP3, 1024 for AAC
+// (an HE-AAC frame decodes to twice that), 960 (20 ms) for Opus
+uint32_t frameSamples(StreamCodec codec);
+
+/**
+ * @brief Map an HTTP Content-Type to a codec
+ * @return StreamCodec::Unknown for generic types such as application/octet-stream
+ */
+StreamCodec fromContentType(const char* contentType);
+
+/**
+ * @brief Detect the codec from the first frame headers of a stream
+ * Looks for an Ogg page (Opus), two consecutive ADTS headers (AAC) or an
+ * ID3 tag / MPEG audio frame header (MP3).
+ * @param data Start of the stream
+ * @param len Number of bytes available
+ */
+StreamCodec fromFrameSync(const uint8_t* data, size_t len);
+
+/**
+ * @brief Parse an MPEG audio Layer III or ADTS frame header
+ * @param p FRAME_HEADER_BYTES bytes at the candidate frame start
+ * @param header Receives length and duration of the frame
+ * @return false if p does not hold a valid header
+ */
+bool parseFrameHeader(const uint8_t* p, FrameHeader& header);
+
+}  // namespace AudioCodec
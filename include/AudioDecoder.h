@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioGenerator.h"
+#include "AudioCodec.h"
+
+/**
+ * @brief MP3 decoder implementations shipped with ESP8266Audio
+ */
+enum class Mp3Backend : uint8_t {
+    Libmad = 0,  // AudioGeneratorMP3
+    Helix = 1    // AudioGeneratorMP3a
+};
+
+// Backend used when the config names none, build with -DAUDIO_MP3_HELIX to
+// default to Helix
+#ifdef AUDIO_MP3_HELIX
+#define AUDIO_MP3_DEFAULT_BACKEND Mp3Backend::Helix
+#else
+#define AUDIO_MP3_DEFAULT_BACKEND Mp3Backend::Libmad
+#endif
+
+/**
+ * @brief Short sound decoded ahead of time for the clip mixer
+ * Mono (the channels are averaged) to halve the PSRAM it takes.
+ */
+struct PcmClip {
+    int16_t* samples = nullptr;  // In PSRAM
+    uint32_t frames = 0;
+    uint32_t rate = 0;
+};
+
+namespace AudioDecoder {
+
+// Stack of a task that runs a decoder: what benchmark() measures for the
+// hungriest one (libmad) plus OUTPUT_STACK for the output stages behind it.
+// The audio task and the clip task both use it.
+static const uint32_t TASK_STACK = 16384;
+static const uint32_t OUTPUT_STACK = 4096;
+
+/**
+ * @brief Create the decoder for a codec
+ * @param codec Stream codec, Unknown is decoded as MP3, Opus expects Ogg framing
+ * @param mp3 Implementation used for MP3
+ */
+AudioGenerator* create(StreamCodec codec, Mp3Backend mp3);
+
+// Short name as stored in the config ("libmad", "helix")
+const char* name(Mp3Backend backend);
+
+/**
+ * @brief Map a config name to a backend
+ * @return The build default for an empty or unknown name
+ */
+Mp3Backend fromName(const char* name);
+
+/**
+ * @brief Decode every MP3 and Ogg Opus file in a directory and log the cost
+ *
+ * MP3 files run on each backend, .opus/.ogg files on the Opus decoder.
+ * Each file is loaded into PSRAM first so SD latency stays out of the
+ * numbers, then decoded into a null sink by a dedicated task. Logs the
+ * decode time per MPEG frame or Opus packet, the share of a core that
+ * takes, the bitrate of the file, the heap each decoder holds and the
+ * stack its task needed, with a warning if that does not fit TASK_STACK.
+ * Blocks until all runs are done.
+ * @param dir Directory on the SD card with reference files
+ */
+void benchmark(const char* dir);
+
+// Longest clip decodeClip() keeps
+static const uint32_t MAX_CLIP_SECONDS = 20;
+
+/**
+ * @brief Decode a short MP3 or WAV file on the SD card into PSRAM
+ * Runs the decoder in a dedicated task and blocks until it is done. Clips
+ * longer than MAX_CLIP_SECONDS are cut.
+ * @param path File on the SD card, WAV if it ends in ".wav"
+ * @param mp3 Implementation used for MP3
+ * @param clip Receives the samples, release with freeClip()
+ */
+bool decodeClip(const char* path, Mp3Backend mp3, PcmClip& clip);
+
+void freeClip(PcmClip& clip);
+
+}  // namespace AudioDecoder
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "AudioFileSource.h"
+#include "AudioRingBuffer.h"
+
+/**
+ * @brief AudioFileSource that feeds a decoder from an AudioRingBuffer
+ *
+ * This is the consumer end of the network pipeline: the decoder running in
+ * the audio task reads from here while the network task fills the ring.
+ * Reads never wait, they return what the ring holds. ESP8266Audio decoders
+ * take a zero-length read for the end of the stream, so the audio task asks
+ * ready() before every decoder pass and skips the pass while the ring is
+ * starved; the stall watchdog keeps running meanwhile.
+ */
+class AudioFileSourceRing : public AudioFileSource {
+public:
+    explicit AudioFileSourceRing(AudioRingBuffer& ring) : ring(ring) {}
+    virtual ~AudioFileSourceRing() override {}
+
+    virtual uint32_t read(void* data, uint32_t len) override;
+    virtual uint32_t readNonBlock(void* data, uint32_t len) override;
+    virtual bool seek(int32_t pos, int dir) override { (void)pos; (void)dir; return false; }
+    virtual bool close() override { closed = true; return true; }
+    virtual bool isOpen() override { return !closed.load() && !(endOfStream.load() && ring.available() == 0); }
+    virtual uint32_t getSize() override { return 0; }
+    virtual uint32_t getPos() override { return ring.totalRead(); }
+
+    /**
+     * @brief Make the source readable again for a new stream
+     * Only call this while the decoder is not running.
+     */
+    void reopen() { closed = false; endOfStream = false; starved = false; }
+
+    bool isClosed() const { return closed.load(); }
+
+    /**
+     * @brief Mark that the producer will not write any more data
+     * The decoder drains what is left in the ring and then sees end of stream.
+     */
+    void setEndOfStream() { endOfStream = true; }
+
+    /**
+     * @brief Check whether a decoder pass can run without draining the ring
+     * Below minBytes the ring counts as starved (an underrun) until it has
+     * refilled to the refill level. A closed or ended stream is always ready,
+     * so the decoder can drain it and see the end. Audio task only.
+     * @param minBytes Stream data one decoder pass may read
+     */
+    bool ready(size_t minBytes);
+
+    /**
+     * @brief Set how much data must be buffered again after an underrun
+     * Refilling to a watermark avoids stuttering on every partial packet.
+     * @param bytes Fill level at which reading resumes
+     */
+    void setRefillLevel(size_t bytes) { refillLevel = max(bytes, (size_t)1); }
+
+    // Underrun statistics
+    uint32_t getUnderrunCount() const { return underrunCount.load(); }
+    uint32_t getUnderrunMs() const { return underrunMs.load(); }
+
+private:
+    AudioRingBuffer& ring;
+    std::atomic<bool> closed{false};
+    std::atomic<bool> endOfStream{false};
+    std::atomic<size_t> refillLevel{1};
+
+    // Audio task only
+    bool starved = false;
+    uint32_t starvedSince = 0;
+
+    std::atomic<uint32_t> underrunCount{0};
+    std::atomic<uint32_t> underrunMs{0};
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <SD.h>
+#include "AudioFileSource.h"
+#include "AudioRingBuffer.h"
+
+/**
+ * @brief AudioFileSource that reads an SD file in large, sector-aligned blocks
+ *
+ * A reader task fills a PSRAM double buffer (a ring of two blocks) with
+ * whole-block reads at sector-aligned file offsets, so the card sees a few
+ * long sequential transfers instead of the many small ones an
+ * AudioFileSourceBuffer in front of AudioFileSourceSD produces. Config and
+ * log writes on the same SPI bus then only have to fit between blocks, and
+ * the decoder has a full block of audio to ride out the wait.
+ *
+ * Reads never wait for the reader task: they hand out what is buffered,
+ * and the audio task checks ready() before a decoder pass instead of
+ * polling under pipelineMutex. open() and a seek outside the buffer read
+ * the first block themselves.
+ *
+ * The decoder side (read, ready, seek, getPos) belongs to the audio task;
+ * the file is only touched by the reader task while it runs.
+ */
+class AudioFileSourceSDBlock : public AudioFileSource {
+public:
+    /**
+     * @param blockSize Bytes per SD read, rounded up to a power of two (4-64 KB)
+     */
+    explicit AudioFileSourceSDBlock(size_t blockSize = 32 * 1024);
+    AudioFileSourceSDBlock(const char* filename, size_t blockSize = 32 * 1024, uint32_t startPos = 0);
+    virtual ~AudioFileSourceSDBlock() override;
+
+    // Prevent copying and assignment
+    AudioFileSourceSDBlock(const AudioFileSourceSDBlock&) = delete;
+    AudioFileSourceSDBlock& operator=(const AudioFileSourceSDBlock&) = delete;
+
+    virtual bool open(const char* filename) override { return open(filename, 0); }
+
+    /**
+     * @brief Open a file for reading from startPos on
+     * The first block read already starts at the sector holding startPos.
+     */
+    bool open(const char* filename, uint32_t startPos);
+    virtual uint32_t read(void* data, uint32_t len) override;
+    virtual uint32_t readNonBlock(void* data, uint32_t len) override;
+    virtual bool seek(int32_t pos, int dir) override;
+    virtual bool close() override;
+    virtual bool isOpen() override { return opened; }
+
+    /**
+     * @brief Check that a decoder pass will not run out of data
+     * @param minBytes Bytes the pass needs; the end of the file is always ready
+     * @return false while the reader task is behind, counted as one underrun;
+     *         true after a long stall, so the short read ends the decoder
+     */
+    bool ready(size_t minBytes);
+    virtual uint32_t getSize() override { return fileSize; }
+    virtual uint32_t getPos() override { return basePos + ring.totalRead() + pendingSkip; }
+
+    // SD read statistics
+    struct ReadStats {
+        uint32_t blocks;          // Block reads issued
+        uint32_t bytesPerSecond;  // Card throughput while reading
+        uint32_t p50Us;           // Block read latency percentiles over the last reads
+        uint32_t p95Us;
+        uint32_t p99Us;
+        uint32_t maxUs;
+        uint32_t underruns;       // Decoder found the buffer empty before end of file
+    };
+
+    ReadStats getReadStats() const;
+
+private:
+    static constexpr size_t LATENCY_SAMPLES = 64;
+
+    File file;
+    AudioRingBuffer ring;
+    size_t blockSize;
+    uint32_t fileSize = 0;
+    bool opened = false;
+
+    // File offset of the first byte in the ring, and bytes still to drop
+    // before the requested position (a seek is aligned down to a sector)
+    uint32_t basePos = 0;
+    uint32_t pendingSkip = 0;
+
+    // Reader task
+    TaskHandle_t readerTask = nullptr;
+    SemaphoreHandle_t readerDone = nullptr;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> endOfFile{false};
+    bool starved = false;  // Audio task only, the current underrun is counted
+    uint32_t starvedSince = 0;
+
+    // Statistics, written by the reader task
+    std::atomic<uint32_t> blockCount{0};
+    std::atomic<uint32_t> bytesPerSecond{0};  // Over the last complete rate window
+    uint32_t windowBytes = 0;
+    uint32_t windowBusyUs = 0;
+    std::atomic<uint32_t> underrunCount{0};
+    uint32_t latencyUs[LATENCY_SAMPLES] = {};
+    std::atomic<uint32_t> latencyIndex{0};
+
+    bool startReader();
+    void stopReader();
+    void fill();
+    static void readerTaskEntry(void* parameter);
+};
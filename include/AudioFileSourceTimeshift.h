@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioFileSource.h"
+#include "AudioFileSourceRing.h"
+#include "AudioTimeshift.h"
+
+/**
+ * @brief AudioFileSource that plays a stream through its timeshift history
+ *
+ * At the live edge reads pass straight through to the ring source of the
+ * stream and are recorded on the way. Behind the live edge the decoder is
+ * fed from the history instead, while the audio task keeps draining the
+ * stream ring into it.
+ */
+class AudioFileSourceTimeshift : public AudioFileSource {
+public:
+    explicit AudioFileSourceTimeshift(AudioTimeshift& store) : store(store) {}
+    virtual ~AudioFileSourceTimeshift() override {}
+
+    /**
+     * @brief Set the stream the history records
+     * Only call this while the decoder is not running.
+     */
+    void setLive(AudioFileSourceRing* source) { live = source; }
+
+    virtual uint32_t read(void* data, uint32_t len) override;
+    virtual uint32_t readNonBlock(void* data, uint32_t len) override;
+    virtual bool seek(int32_t pos, int dir) override { (void)pos; (void)dir; return false; }
+    // The manager ends a stream through its ring source; a decoder stopped
+    // for a seek must not close it
+    virtual bool close() override { return true; }
+    virtual bool isOpen() override { return store.available() > 0 || (live && live->isOpen()); }
+    virtual uint32_t getSize() override { return 0; }
+    virtual uint32_t getPos() override { return live ? live->getPos() : 0; }
+
+private:
+    AudioTimeshift& store;
+    AudioFileSourceRing* live = nullptr;
+
+    uint32_t record(void* data, uint32_t len);
+};
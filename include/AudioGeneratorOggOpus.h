@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioGenerator.h"
+#include "OggDemuxer.h"
+
+struct OpusDecoder;
+
+/**
+ * @brief Ogg Opus decoder for streams, built on the libopus in ESP8266Audio
+ *
+ * ESP8266Audio's own AudioGeneratorOpus goes through opusfile, which takes
+ * a zero-length read as the end of the stream and stops. This one pulls
+ * packets through OggDemuxer, so a source running dry only pauses it, a
+ * corrupt page costs one packet, and a stream joined mid-way or chained at
+ * the next track plays on.
+ *
+ * Output is always 48 kHz stereo, mono streams are upmixed by libopus.
+ * The OpusHead pre-skip and output gain are applied. Ogg Vorbis is
+ * recognized but not decoded, the stream stops with a log line.
+ */
+class AudioGeneratorOggOpus : public AudioGenerator {
+public:
+    AudioGeneratorOggOpus() = default;
+    virtual ~AudioGeneratorOggOpus() override;
+
+    virtual bool begin(AudioFileSource* source, AudioOutput* output) override;
+    virtual bool loop() override;
+    virtual bool stop() override;
+    virtual bool isRunning() override { return running; }
+    virtual void desync() override;
+
+    // Audio packets decoded, and the time libopus took for them
+    uint32_t getPackets() const { return packets; }
+    uint32_t getDecodeUs() const { return decodeUs; }
+
+    // Pages the demuxer dropped for a bad CRC
+    uint32_t getBadPages() const { return demuxer.getBadPages(); }
+
+private:
+    static const uint32_t RATE = 48000;
+    static const int MAX_FRAMES = 5760;  // 120 ms, the longest Opus packet
+
+    OggDemuxer demuxer;
+    OpusDecoder* decoder = nullptr;
+    int16_t* pcm = nullptr;  // Interleaved stereo, MAX_FRAMES frames
+    int pcmFrames = 0;
+    int pcmPos = 0;
+    int lastFrames = 0;       // Duration of the last good packet, for concealment
+    bool pending = false;     // lastSample was refused by the output
+    uint32_t skipFrames = 0;  // Pre-skip still to drop
+    uint32_t packets = 0;
+    uint32_t decodeUs = 0;
+
+    static size_t readSource(void* context, uint8_t* data, size_t len);
+    bool nextPacket();
+    bool startStream(const uint8_t* head, size_t len);
+    void freeBuffers();
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioGenerator.h"
+
+/**
+ * @brief Alarm tone synthesizer, the source of last resort
+ *
+ * Renders alarm patterns from single-cycle wavetables in flash with 32 bit
+ * fixed-point phase accumulators. A pattern is a list of steps (a tone, a
+ * glide between two pitches, or a pause) that repeats until stopped; each
+ * step fades in and out over a few milliseconds so the steps don't click.
+ * The level rises from a quiet start to full over a ramp time.
+ *
+ * Needs neither Wi-Fi nor the SD card and allocates nothing: all state is
+ * in the object and begin() only resets it, so the first samples can reach
+ * the output within the same call that starts it. Takes no source, pass
+ * nullptr to begin().
+ */
+class AudioGeneratorTone : public AudioGenerator {
+public:
+    static const uint32_t RATE = 44100;
+
+    AudioGeneratorTone() = default;
+    virtual ~AudioGeneratorTone() override {}
+
+    /**
+     * @brief Choose what begin() plays
+     * @param pattern Index below patternCount(), others play pattern 0
+     * @param rampMs Time from the start level to full level, 0 plays at full level
+     */
+    void setPattern(uint8_t pattern, uint32_t rampMs);
+
+    virtual bool begin(AudioFileSource* source, AudioOutput* output) override;
+    virtual bool loop() override;
+    virtual bool stop() override;
+    virtual bool isRunning() override { return running; }
+
+    static uint8_t patternCount();
+
+    // Short name for the API and the config ("beeps", "chime", ...)
+    static const char* patternName(uint8_t pattern);
+
+    // Pattern index of a name, -1 if unknown
+    static int fromName(const char* name);
+
+private:
+    uint8_t pattern = 0;
+    uint8_t step = 0;
+    uint32_t stepPos = 0;      // Samples into the current step
+    uint32_t stepLen = 0;
+    uint32_t phase = 0;        // Position in the wavetable, a cycle is 2^32
+    uint32_t increment = 0;    // Phase advance per sample, Q32 of a cycle
+    int32_t glide = 0;         // Change of the increment per sample
+    const int16_t* table = nullptr;
+
+    uint32_t rampSamples = 0;
+    uint32_t elapsed = 0;      // Samples since begin(), for the ramp
+    int32_t level = 0;         // Q15 gain of the ramp
+    bool pending = false;      // lastSample was refused by the output
+
+    void startStep();
+    int16_t render();
+};
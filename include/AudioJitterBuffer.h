@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "AudioRingBuffer.h"
+
+/**
+ * @brief Adaptive jitter buffer for radio streams
+ *
+ * Wraps the PSRAM stream ring (allocated once at the maximum depth) and
+ * derives a target depth from the measured network behaviour: the gap
+ * between data arrivals and its deviation, scaled by the sustained
+ * throughput. Throughput only counts time the producer was free to read,
+ * so a full buffer does not cap it at the decoder's rate. The depth grows immediately when the network gets worse and
+ * shrinks slowly when it recovers, always within the configured limits.
+ *
+ * onArrival() and markThrottled() belong to the producer (network task);
+ * the getters may be called from any task.
+ */
+class AudioJitterBuffer {
+public:
+    AudioJitterBuffer() = default;
+
+    // Prevent copying and assignment
+    AudioJitterBuffer(const AudioJitterBuffer&) = delete;
+    AudioJitterBuffer& operator=(const AudioJitterBuffer&) = delete;
+
+    /**
+     * @brief Set the bounds for the adaptive depth
+     * @param minBytes Smallest depth (also the depth used for a new stream)
+     * @param maxBytes Largest depth, this much PSRAM is allocated
+     */
+    void setLimits(size_t minBytes, size_t maxBytes);
+
+    /**
+     * @brief Set how full the buffer must be before playback starts
+     * @param percent Watermark in percent of the current target depth (10-90)
+     */
+    void setPreBufferPercent(uint8_t percent) { preBufferPercent = constrain(percent, 10, 90); }
+
+    /**
+     * @brief Allocate the ring at the maximum depth
+     * @return true if the storage is available
+     */
+    bool allocate();
+
+    // Largest depth in bytes, the ring size allocate() asks for
+    size_t getMaxDepth() const { return maxDepth; }
+
+    /**
+     * @brief Drop buffered data and estimates for a new stream
+     * Only call this while neither producer nor consumer is active.
+     */
+    void reset();
+
+    AudioRingBuffer& getRing() { return ring; }
+    const AudioRingBuffer& getRing() const { return ring; }
+
+    /**
+     * @brief Record that the producer received data
+     * @param bytes Number of bytes written into the ring
+     */
+    void onArrival(size_t bytes);
+
+    /**
+     * @brief Record that the producer paused because the buffer was full
+     * The next arrival gap is not a network gap and is not measured, neither
+     * for the jitter nor for the throughput.
+     */
+    void markThrottled() { lastArrivalMs = 0; }
+
+    // Current adaptive depth in bytes; the producer does not fill beyond it
+    size_t getTargetDepth() const { return targetDepth.load(); }
+
+    // Fill level needed to start (or resume after an underrun)
+    size_t getStartWatermark() const { return (getTargetDepth() * preBufferPercent) / 100; }
+
+    bool isPrimed() const { return ring.available() >= getStartWatermark(); }
+
+    // Network estimates
+    uint32_t getJitterMs() const { return jitterMs.load(); }
+    uint32_t getThroughput() const { return throughput.load(); }  // bytes per second
+    uint32_t getDrainRate() const { return drainRate.load(); }    // decoder bytes per second
+
+private:
+    AudioRingBuffer ring;
+    size_t minDepth = 16 * 1024;
+    size_t maxDepth = 128 * 1024;
+    uint8_t preBufferPercent = 50;
+
+    // Producer-side estimator state
+    uint32_t lastArrivalMs = 0;
+    uint32_t windowStartMs = 0;
+    uint32_t windowReadStart = 0;
+    uint32_t activeMs = 0;      // Unthrottled time and the bytes it brought
+    uint32_t activeBytes = 0;
+    float gapMeanMs = 0.0f;
+    float gapDevMs = 0.0f;
+    float peakGapMs = 0.0f;
+
+    // Published results
+    std::atomic<uint32_t> targetDepth{16 * 1024};
+    std::atomic<uint32_t> jitterMs{0};
+    std::atomic<uint32_t> throughput{0};
+    std::atomic<uint32_t> drainRate{0};
+
+    void updateTarget();
+};
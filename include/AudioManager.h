@@ -1,32 +1,47 @@
 #pragma once
 
 #include <Arduino.h>
+#include <atomic>
 #include "AudioGenerator.h"
 #include "AudioOutputI2S.h"
-#include "AudioFileSourceSD.h"
-#include "AudioFileSourceBuffer.h"
+#include "AudioFileSourceSDBlock.h"
 #include "AudioGeneratorMP3.h"
+#include "AudioGeneratorAAC.h"
+#include "AudioGeneratorTone.h"
+#include "AudioCodec.h"
+#include "AudioDecoder.h"
 #include "AudioFileSourceHTTPStream.h"
+#include "AudioStreamSlot.h"
+#include "StreamResolver.h"
+#include "AudioOutputCrossfade.h"
+#include "AudioOutputEqualizer.h"
+#include "AudioOutputLoudness.h"
+#include "AudioOutputFade.h"
+#include "AudioOutputSpectrum.h"
+#include "AudioOutputClipMixer.h"
+#include "AudioTimeshift.h"
+#include "AudioFileSourceTimeshift.h"
+#include "AudioBitrateSelector.h"
+#include "AudioTelemetry.h"
 #include <SD.h> // Changed from SD_MMC.h to fix initialization errors
 
 // Forward declarations
 class AudioGenerator;
 class AudioFileSource;
 class AudioOutputI2S;
-class AudioFileSourceBuffer;
 
 class AudioManager {
 private:
     static AudioManager* instance;
-    
+
     // Private constructor and destructor
     AudioManager() = default;
     ~AudioManager();
-    
+
     // Prevent copying and assignment
     AudioManager(const AudioManager&) = delete;
     AudioManager& operator=(const AudioManager&) = delete;
-    
+
 public:
     static AudioManager& getInstance() {
         if (!instance) {
@@ -35,50 +50,608 @@ public:
         return *instance;
     }
 
+    /**
+     * @brief Initialize audio output and start the audio and network tasks
+     */
     void begin();
+
+    /**
+     * @brief Run one decoder iteration (called from the audio task)
+     */
     void loop();
-    
-    bool playStream(const char* url);
-    bool playFile(const char* filename);
+
+    /**
+     * @brief Start a radio stream
+     * While something is playing, the new stream connects and pre-buffers in
+     * the second pipeline slot and replaces it with a short crossfade once it
+     * is ready, so switching stations leaves no silence.
+     * @param url HTTP URL of the stream, anything else is played from SD
+     * @param codec Codec known from the station record, Unknown to detect it
+     *        from the Content-Type or the first frames
+     */
+    bool playStream(const char* url, StreamCodec codec = StreamCodec::Unknown);
+
+    /**
+     * @brief Play an MP3 file from the SD card
+     * A start position is looked up in the file's frame index sidecar, so
+     * decoding begins with the first block read; without an up-to-date
+     * sidecar the offset is estimated from the bitrate.
+     * @param filename Path on the SD card
+     * @param startMs Position to start at, e.g. to resume an audiobook
+     */
+    bool playFile(const char* filename, uint32_t startMs = 0);
+
+    /**
+     * @brief Get the local file playing, or the last one, and the position in it
+     * Once the file stopped the position is where it stopped, for resuming.
+     * @param path Receives the path, empty if no file was played
+     * @return Position from the start of the file in ms
+     */
+    uint32_t getFilePosition(String& path) const;
+
+    /**
+     * @brief Connect to a stream and fill the jitter buffer without playing it
+     * Used ahead of an alarm; the buffer is kept live until
+     * commitPreparedStream() or any other playback call.
+     * @return true if the connection is open
+     */
+    bool prepareStream(const char* url, StreamCodec codec = StreamCodec::Unknown);
+
+    /**
+     * @brief Start playing a stream opened by prepareStream()
+     * @param url Must match the prepared URL
+     * @return false if no matching stream is prepared
+     */
+    bool commitPreparedStream(const char* url);
+
+    bool isStreamPrepared() const { return holdForTrigger; }
+
+    /**
+     * @brief Play a synthesized alarm tone, needs neither network nor SD
+     * Starts within a few milliseconds: the tone goes straight to the I2S
+     * output, past the processing stages, and does not wait for the network
+     * task to let go of a connection. A fade set with setFadeIn() is dropped,
+     * the tone ramps up on its own.
+     * @param pattern Index below AudioGeneratorTone::patternCount()
+     * @param rampMs Time to rise from a quiet start to full level, 0 for full level
+     */
+    bool playTone(uint8_t pattern, uint32_t rampMs);
+
+    /**
+     * @brief Copy a station's stream to a ring as it arrives, e.g. to record it
+     * Shares the connection of the slot playing or preparing the station.
+     * The copy ends when that slot disconnects or tunes to another station.
+     * @param url Station URL as configured
+     * @param ring Ring the caller drains; written by the network task
+     * @return false if no slot is connected to the station
+     */
+    bool tapStream(const char* url, AudioRingBuffer* ring);
+    void untapStream(AudioRingBuffer* ring);
+
+    /**
+     * @brief Check whether a tap still receives its stream
+     * @param dropped Receives the bytes the ring had no room for
+     */
+    bool isTapped(const AudioRingBuffer* ring, uint32_t& dropped);
+
+    /**
+     * @brief Start measuring the latency from an alarm trigger to the first
+     * decoded sample reaching the output
+     */
+    void markTrigger();
+
+    // Trigger-to-first-sample latency of the last alarm in ms
+    uint32_t getTriggerLatency() const { return lastTriggerLatency.load(); }
+    bool wasWarmStart() const { return lastWarmStart; }
+
+    /**
+     * @brief Check that the fallback track can be read from SD
+     */
+    bool checkFallbackReadable();
     void stop();
-    
+
     void setVolume(uint8_t volume);
     uint8_t getVolume() const { return currentVolume; }
-    
-    bool isPlaying() const { return (audioGenerator && audioGenerator->isRunning()); }
-    
+
+    bool isPlaying() const { return playing.load(); }
+
+    // Codec of the current stream, Unknown until it has been detected
+    StreamCodec getStreamCodec() const { return stream->codec.load(); }
+
+    /**
+     * @brief Fetch a codec that was detected for a stream without a hint
+     * Returns each detection once, so the caller can cache it in the station list.
+     * @param url Receives the stream URL
+     * @param codec Receives the detected codec
+     * @return true if a new detection was available
+     */
+    bool takeDetectedCodec(String& url, StreamCodec& codec);
+
+    /**
+     * @brief Level streams to a common loudness
+     * A slow gain on top of the volume steers the measured short-term
+     * loudness of a stream towards the target. Local files play unchanged.
+     * @param enabled false plays every station at its own level
+     * @param targetLufs Target short-term loudness
+     */
+    void setLoudnessNormalization(bool enabled, float targetLufs);
+
+    // Gain the normalization applies on top of the volume, in dB
+    float getLoudnessGain() const { return loudnessGainDb.load(); }
+
+    // Short-term loudness of the stream on air in LUFS, NAN while settling
+    float getShortTermLoudness() const { return shortTermLufs.load(); }
+
+    // Remembered normalization gain of a station in dB, 0 if unknown
+    typedef float (*StationGainLookup)(const char* url);
+    void setStationGainLookup(StationGainLookup cb) { stationGainLookup = cb; }
+
+    /**
+     * @brief Fetch a normalization gain learned for a station
+     * Returns each result once, so the caller can keep it in the station list
+     * and the next tune starts at the right level.
+     * @param url Receives the station URL
+     * @param gainDb Receives the gain in dB
+     * @return true if a new gain was available
+     */
+    bool takeLearnedGain(String& url, float& gainDb);
+
+    // Encoding of a station at one bitrate
+    struct StreamVariant {
+        char url[256];
+        uint16_t kbps;
+        StreamCodec codec;
+    };
+
+    // Variants of a station, returns how many were written to the array
+    typedef size_t (*StreamVariantLookup)(const char* url, StreamVariant* variants, size_t max);
+    void setStreamVariantLookup(StreamVariantLookup cb) { streamVariantLookup = cb; }
+
+    /**
+     * @brief Follow the network with the bitrate of stations that have variants
+     * The variant on air steps down before the jitter buffer runs dry and
+     * back up once the link has recovered; the next variant pre-buffers in
+     * the second pipeline slot and takes over with a crossfade, like a
+     * station switch.
+     */
+    void setAdaptiveBitrate(bool enabled) { adaptiveBitrate = enabled; }
+
+    /**
+     * @brief Check the stream on air and switch variants if needed
+     * Called from the main loop, checks once per second. A switch is
+     * connected by the dial task, the loop does not wait for it.
+     */
+    void adaptBitrate();
+
+    // Variant selection of the stream on air
+    struct BitrateStats {
+        bool enabled;
+        uint16_t kbps;          // Bitrate of the variant on air, 0 without variants
+        int8_t variant;         // Index by ascending bitrate, -1 without variants
+        uint8_t variantCount;
+        bool pending;           // A variant is pre-buffering
+        uint32_t switches;      // Variant switches since boot
+    };
+
+    BitrateStats getBitrateStats() const;
+
+    /**
+     * @brief Collect decoded audio for the spectrum visualizer
+     * Disabled, the tap costs one branch per sample.
+     */
+    void setSpectrumEnabled(bool enabled);
+    bool isSpectrumEnabled() const { return spectrumStage && spectrumStage->isEnabled(); }
+
+    /**
+     * @brief Compute the spectrum of the audio playing now
+     * Runs the FFT in the calling task, normally the UI at its frame rate.
+     * @param bars Receives levels from 0 (-60 dB) to 255 (full scale)
+     * @param count Number of bars, log spaced
+     * @return false if disabled or no new audio arrived since the last call
+     */
+    bool getSpectrum(uint8_t* bars, size_t count);
+
+    // Average FFT and bar time per spectrum frame, in microseconds
+    uint32_t getSpectrumFrameMicros() const { return spectrumStage ? spectrumStage->getFrameMicros() : 0; }
+
+    /**
+     * @brief Whether the stream on air is short of data
+     * Set by the audio task while the jitter buffer is below its start
+     * watermark or the fallback track covers for the stream; optional work
+     * such as the visualizer should back off then.
+     */
+    bool isBufferLow() const { return bufferLow.load(); }
+
+    /**
+     * @brief Decode a chime or announcement into PSRAM for playClip()
+     * Blocks while the file decodes; call from the main loop, e.g. at
+     * startup, so the clip is ready when needed. Loading a path again is free.
+     * @param path MP3 or WAV file on the SD card
+     * @return false if the file cannot be decoded or MAX_CLIPS are loaded
+     */
+    bool loadClip(const char* path);
+
+    /**
+     * @brief Play a clip over whatever plays now
+     * The stream keeps running underneath, lowered by the duck level while
+     * the clip plays. Without playback the clip plays on its own. Loads the
+     * clip first if needed. Call from the main loop.
+     * @param path MP3 or WAV file on the SD card
+     * @param gainDb Clip level, at most 0 dB
+     * @return false if the clip cannot be loaded or all voices are busy
+     */
+    bool playClip(const char* path, float gainDb = 0.0f);
+
+    void stopClips();
+    bool isClipPlaying() const { return clipPlaying.load(); }
+
+    // Attenuation of the main audio under a clip in dB, e.g. -12
+    void setDuckLevel(float db);
+
+    /**
+     * @brief Set the size of the timeshift history of the stream on air
+     * Call before begin(); the history is allocated in PSRAM there.
+     * @param bytes History size, 0 to disable pause and rewind
+     */
+    void setTimeshift(size_t bytes) { timeshiftBytes = bytes; }
+
+    /**
+     * @brief Pause the stream on air, the timeshift keeps recording
+     * @return false if no stream plays or the timeshift is disabled
+     */
+    bool pause();
+
+    /**
+     * @brief Continue a paused stream where it was paused
+     */
+    bool resume();
+
+    /**
+     * @brief Play the stream on air from a point behind the live edge
+     * Also resumes a paused stream.
+     * @param ms Time behind live, clamped to the recorded history; 0 is live
+     * @return false if no stream plays or nothing has been recorded yet
+     */
+    bool seekBehindLive(uint32_t ms);
+    bool goLive() { return seekBehindLive(0); }
+
+    bool isPaused() const { return paused.load(); }
+
+    // Timeshift state of the stream on air
+    struct TimeshiftStatus {
+        bool enabled;     // History allocated
+        bool paused;
+        uint32_t delayMs;   // Playback lags the live edge by this much
+        uint32_t windowMs;  // Time covered by the history
+        size_t capacity;    // History size in bytes
+    };
+
+    TimeshiftStatus getTimeshiftStatus() const;
+
+    /**
+     * @brief Fetch the latest stream title change without blocking
+     * Meant for the UI task; an empty title means nothing is playing.
+     * @return true if the title changed since the last call
+     */
+    bool receiveNowPlaying(NowPlaying& nowPlaying);
+
+    /**
+     * @brief Fade in the next playback from silence to the current volume
+     * Applies to the next playStream()/playFile() call only.
+     * @param durationMs Ramp length in milliseconds, 0 for no fade
+     * @param curve Gain curve of the ramp
+     */
+    void setFadeIn(uint32_t durationMs, AudioOutputFade::Curve curve);
+
     // Callback types
     typedef void (*PlaybackStateCallback)(bool isPlaying);
     void setPlaybackStateCallback(PlaybackStateCallback cb) { playbackStateCallback = cb; }
-    
-    // Buffer settings
-    void setBufferSize(size_t size) { bufferSize = size; }
-    void setPreBufferPercent(uint8_t percent) { preBufferPercent = constrain(percent, 10, 90); }
+
+    // Buffer settings, applied to the next stream
+    void setBufferLimits(size_t minBytes, size_t maxBytes);
+    void setPreBufferPercent(uint8_t percent);
+
+    /**
+     * @brief Set the crossfade of a station switch
+     * @param ms Crossfade length (0-500), 0 stops the old station before
+     *        connecting to the new one
+     */
+    void setCrossfade(uint32_t ms) { crossfadeMs = min(ms, (uint32_t)500); }
+
+    /**
+     * @brief Limit the PSRAM taken by stream rings and the crossfade buffer
+     * A switch that would need more stops the old station first.
+     * @param bytes Budget in bytes
+     */
+    void setPsramBudget(size_t bytes) { psramBudget = bytes; }
+
+    /**
+     * @brief Replace the equalizer bands, takes effect within one block
+     * @param bands Band parameters, nullptr or 0 bands for a flat response
+     * @param count Number of bands (at most EQ_MAX_BANDS)
+     */
+    void setEqualizer(const EqBand* bands, size_t count);
+
+    /**
+     * @brief Select the equalizer filter kernel
+     * @return false if the kernel is not available on this build
+     */
+    bool setEqualizerKernel(AudioOutputEqualizer::Kernel kernel);
+
+    /**
+     * @brief Select the MP3 decoder implementation
+     * Applies from the next decoder start (station, file or fallback track).
+     */
+    void setMp3Decoder(Mp3Backend backend) { mp3Backend = backend; }
+    Mp3Backend getMp3Decoder() const { return mp3Backend.load(); }
+
+    /**
+     * @brief Set how long a stream may stall before the fallback track plays
+     * @param ms Stall deadline in milliseconds (500-10000)
+     */
+    void setStallTimeout(uint32_t ms);
+
+    /**
+     * @brief Set the SD file that covers for a stalled stream
+     * @param path MP3 file on the SD card, empty to disable the fallback
+     */
+    void setFallbackFile(const char* path);
+
+    // Stream pipeline statistics
+    struct PumpStats {
+        size_t bufferCapacity;   // Ring size in bytes
+        size_t bufferFill;       // Bytes currently buffered
+        uint8_t fillPercent;     // Fill level (0-100)
+        size_t targetDepth;      // Adaptive jitter buffer depth in bytes
+        uint32_t jitterMs;       // Measured network jitter
+        uint32_t throughput;     // Network throughput in bytes per second
+        uint32_t underruns;      // Times the decoder found the ring empty
+        uint32_t underrunMs;     // Total time spent waiting on an empty ring
+        uint32_t bytesReceived;  // Stream bytes received since playStream()
+    };
+
+    /**
+     * @brief Get fill level and underrun counters of the stream pipeline
+     */
+    PumpStats getPumpStats() const;
+
+    // Stall watchdog statistics
+    struct StallStats {
+        uint32_t stalls;               // Stalls that switched to the fallback track
+        uint32_t recoveries;           // Switches back to the stream
+        uint32_t reconnects;           // Successful stream reconnects
+        uint32_t lastTimeToFallback;   // Stall onset to fallback audio, in ms
+        uint32_t maxTimeToFallback;
+        uint32_t lastTimeToRecover;    // Stream data back to stream audio, in ms
+        uint32_t maxTimeToRecover;
+        bool inFallback;               // Fallback track is covering for the stream
+    };
+
+    /**
+     * @brief Get stall, fallback and recovery counters and latencies
+     */
+    StallStats getStallStats() const;
+
+    // Station switch statistics
+    struct SwitchStats {
+        uint32_t switches;      // playStream() calls that reached the output
+        uint32_t gapless;       // Switches that overlapped with the old station
+        uint32_t lastSwitchMs;  // playStream() to the first sample of the new station
+        uint32_t maxSwitchMs;
+        bool pending;           // Next station is connecting or pre-buffering
+        size_t psramBytes;      // Stream rings and crossfade buffer allocated
+        size_t psramBudget;
+    };
+
+    /**
+     * @brief Get switch latency and memory use of the stream pipelines
+     */
+    SwitchStats getSwitchStats() const;
+
+    /**
+     * @brief Get the fill histogram, pipeline times and instrumentation cost
+     * Counted since the station on air was tuned; underruns, network rate
+     * and reconnects are in getPumpStats() and getStallStats().
+     */
+    AudioTelemetry::Snapshot getTelemetry() const { return telemetry.getSnapshot(); }
+
+    /**
+     * @brief Get SD throughput and block read latency of local playback
+     * Covers the file playing now, or the last one if none is.
+     */
+    AudioFileSourceSDBlock::ReadStats getSdReadStats() const;
 
 private:
+    // Stream playback phases, only used while isStreaming is set
+    enum class StreamState {
+        PreBuffering,  // Waiting for the jitter buffer watermark
+        Playing,       // Decoder fed from the ring
+        Fallback       // SD fallback track plays while the stream reconnects
+    };
 
-    
     // Audio components
     AudioGenerator *audioGenerator = nullptr;
+    AudioGeneratorTone toneGenerator;  // audioGenerator while a tone plays, never deleted
     AudioFileSource *fileSource = nullptr;
-    AudioFileSourceBuffer *bufferedSource = nullptr;
+    AudioFileSourceSDBlock *sdSource = nullptr;  // fileSource while a local file plays
+    AudioFileSourceSDBlock::ReadStats lastSdStats = {};
+    char filePath[128] = "";          // Last file from playFile(), not the fallback track
+    bool filePlaying = false;         // sdSource plays filePath
+    uint32_t fileStartMs = 0;         // Position the file started at, or stopped at
+    uint32_t fileStartSamples = 0;    // fadeStage sample count at fileStartMs
     AudioOutputI2S *audioOutput = nullptr;
-    
+    AudioOutputCrossfade *crossfadeStage = nullptr;  // Decoders write here
+    AudioOutputLoudness *loudnessStage = nullptr;    // Fed by crossfadeStage, measures only
+    AudioOutputEqualizer *eqStage = nullptr;         // Fed by loudnessStage
+    AudioOutputSpectrum *spectrumStage = nullptr;    // Fed by eqStage, taps the visualizer
+    AudioOutputFade *fadeStage = nullptr;            // Fed by spectrumStage
+    AudioOutputClipMixer *mixerStage = nullptr;      // Fed by fadeStage, feeds audioOutput
+
+    // Stream pipelines: network task -> jitter buffer -> decoder in the audio task.
+    // stream is on air, incoming pre-buffers the next station during a switch.
+    AudioStreamSlot slots[2];
+    AudioStreamSlot* stream = &slots[0];
+    AudioStreamSlot* incoming = nullptr;
+
     // Playback state
     uint8_t currentVolume = 50;
+    uint32_t pendingFadeMs = 0;
+    AudioOutputFade::Curve pendingFadeCurve = AudioOutputFade::Curve::Linear;
     bool isStreaming = false;
+    StreamState streamState = StreamState::PreBuffering;
+    uint32_t preBufferStart = 0;
+    bool holdForTrigger = false;  // Prepared stream waits for commitPreparedStream()
+    uint32_t stallTimeoutMs = 1500;
+    char fallbackPath[64] = "";
+    std::atomic<bool> playing{false};
+    std::atomic<Mp3Backend> mp3Backend{AUDIO_MP3_DEFAULT_BACKEND};
+
+    // Timeshift history of the stream on air (audio task)
+    AudioTimeshift timeshift;
+    AudioFileSourceTimeshift timeshiftSource{timeshift};
+    size_t timeshiftBytes = 4 * 1024 * 1024;
+    std::atomic<bool> paused{false};
+    std::atomic<bool> bufferLow{false};  // Stream on air below its start watermark
+
+    // Clips decoded for the mixer (main loop), voices play them in the audio task
+    static const size_t MAX_CLIPS = 8;
+    struct LoadedClip {
+        char path[64];
+        PcmClip pcm;
+    };
+    LoadedClip clips[MAX_CLIPS] = {};
+    size_t clipCount = 0;
+    float duckDb = -12.0f;
+    std::atomic<bool> clipPlaying{false};
+    const PcmClip* findClip(const char* path) const;
+
+    // Loudness normalization (gain written by the audio task)
+    bool normalizeLoudness = true;
+    float loudnessTargetLufs = -18.0f;
+    std::atomic<float> loudnessGainDb{0.0f};
+    std::atomic<float> shortTermLufs{NAN};
+    StationGainLookup stationGainLookup = nullptr;
+    uint32_t lastLoudnessUpdate = 0;
+    uint32_t lastGainPublish = 0;
+    bool gainAdapted = false;  // The gain moved since the station went on air
     unsigned long lastStateChange = 0;
-    
-    // Buffer settings
-    size_t bufferSize = 16 * 1024;  // 16KB buffer
-    uint8_t preBufferPercent = 50;  // 50% pre-buffer before starting playback
-    
+
+    // Stall watchdog (audio task)
+    uint32_t lastReadTotal = 0;     // Ring read position at the last progress check
+    uint32_t lastProgressMs = 0;    // Last time the decoder consumed stream data
+    uint32_t fallbackStartMs = 0;
+
+    // Station switch
+    uint32_t crossfadeMs = 150;
+    size_t psramBudget = 384 * 1024;
+    uint32_t switchRequestMs = 0;
+    uint32_t switchSampleCount = 0;
+    bool awaitingSwitchSample = false;
+    bool switchGapless = false;
+    std::atomic<uint32_t> switchCount{0};
+    std::atomic<uint32_t> gaplessCount{0};
+    std::atomic<uint32_t> lastSwitchMs{0};
+    std::atomic<uint32_t> maxSwitchMs{0};
+
+    // Adaptive bitrate (main loop; incomingIsVariant and bitrateSelector under
+    // pipelineMutex, the dial task connects the switches)
+    bool adaptiveBitrate = true;
+    StreamVariantLookup streamVariantLookup = nullptr;
+    StreamVariant variants[AudioBitrateSelector::MAX_VARIANTS];
+    size_t variantCount = 0;
+    char variantsUrl[256] = "";  // Station the variants belong to
+    int currentVariant = -1;     // Variant on air, -1 if the station plays a URL outside the list
+    int requestedVariant = -1;   // Variant being switched to
+    std::atomic<int> dialVariant{-1};  // Variant the dial task is connecting, -1 if none
+    AudioBitrateSelector bitrateSelector;
+    uint32_t lastBitrateCheck = 0;
+    bool incomingIsVariant = false;
+    std::atomic<uint32_t> variantSwitches{0};
+
+    // Alarm start latency
+    uint32_t triggerMs = 0;
+    uint32_t triggerSampleCount = 0;
+    bool awaitingFirstSample = false;
+    bool lastWarmStart = false;
+    std::atomic<uint32_t> lastTriggerLatency{0};
+    std::atomic<bool> alarmPending{false};   // markTrigger() was called, the next playback is an alarm
+    std::atomic<bool> alarmPlayback{false};  // A tone covers for a missing fallback track
+
+    // Fill and pipeline time histograms of the stream on air
+    AudioTelemetry telemetry;
+
+    // Stall statistics
+    std::atomic<uint32_t> stallCount{0};
+    std::atomic<uint32_t> recoveryCount{0};
+    std::atomic<uint32_t> reconnectCount{0};
+    std::atomic<uint32_t> lastTimeToFallback{0};
+    std::atomic<uint32_t> maxTimeToFallback{0};
+    std::atomic<uint32_t> lastTimeToRecover{0};
+    std::atomic<uint32_t> maxTimeToRecover{0};
+
     // Callbacks
     PlaybackStateCallback playbackStateCallback = nullptr;
-    
+
+    // Tasks and locks. Lock order is networkMutex before pipelineMutex.
+    TaskHandle_t audioTaskHandle = nullptr;
+    TaskHandle_t networkTaskHandle = nullptr;
+    TaskHandle_t dialTaskHandle = nullptr;
+    SemaphoreHandle_t pipelineMutex = nullptr;  // Guards generator and sources
+    SemaphoreHandle_t networkMutex = nullptr;   // Guards the slot readers
+    QueueHandle_t nowPlayingQueue = nullptr;    // Latest NowPlaying for the UI task
+    QueueHandle_t learnedGainQueue = nullptr;   // LearnedGain results for the main loop
+
+    struct LearnedGain {
+        char url[256];
+        float gainDb;
+    };
+
     // Internal methods
     void cleanup();
     void notifyPlaybackState(bool isPlaying);
-};
+    void postNowPlaying(const char* streamTitle);
+    bool pump();
+    bool openStream(const char* url, StreamCodec codec, bool hold);
+    bool connectSlot(AudioStreamSlot& slot, const char* url, String& streamUrl);
+    void attachStream(AudioStreamSlot& slot, const char* url, const char* streamUrl, StreamCodec codec,
+                      const char* resolveUrl = nullptr);
+    bool beginSwitch(const char* url, StreamCodec codec);
+    bool connectNextSlot(AudioStreamSlot& slot, const char* url, const char* resolveUrl, StreamCodec codec);
+    void claimSlot(AudioStreamSlot& slot);
+    void redialSlot(AudioStreamSlot& slot);
+    bool beginVariantSwitch(int variant);
+    void loadVariants(const char* url);
+    int variantOnAir() const;
+    bool fitsPsramBudget(const AudioStreamSlot& slot) const;
+    bool checkPendingSwitch(uint32_t now);
+    bool commitSwitch(bool overlap);
+    void dropIncoming();
+    void recordFirstSample();
+    bool decoderFed();
+    bool startStreamDecoder();
+    void keepPreparedBufferFresh();
+    void detectStreamCodec();
+    void releaseDecoder();
+    uint32_t filePositionMs() const;
+    AudioFileSource* streamSource(bool newStation);
+    void feedTimeshift();
 
+    // Loudness normalization, caller holds pipelineMutex
+    void startLoudness(float gainDb);
+    void updateLoudness(uint32_t now);
+    void publishLearnedGain();
+    void applyGain();
+    void applyPendingFade();
+    bool checkStreamStall(uint32_t now, uint32_t& onset);
+    bool enterFallback(uint32_t onset);
+    bool startFallbackTrack();
+    bool startTone(uint8_t pattern, uint32_t rampMs);
+    void checkStreamRecovery(uint32_t now);
+
+    // Task entry points
+    static void audioTask(void* parameter);
+    static void networkTask(void* parameter);
+    static void dialTask(void* parameter);
+    int pumpSlot(AudioStreamSlot& slot, uint32_t now);
+};
 
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioOutputStage.h"
+#include "AudioDecoder.h"
+
+/**
+ * @brief Mixes short pre-decoded clips over the main audio
+ *
+ * Chimes and announcements play on up to MAX_VOICES voices on top of
+ * whatever the decoder delivers, without touching the decoder or the
+ * stream. Each voice steps through its PCM clip at its own rate (linear
+ * interpolation to the output rate), the sum is saturated to 16 bit. While
+ * a ducking voice plays, the main audio is ramped down to the duck level
+ * and back up after the last one ends.
+ *
+ * Without a decoder feeding the stage, fillIdle() renders the clips over
+ * silence and keeps the sink running until they are done; a decoder stop()
+ * during a clip is held back the same way.
+ *
+ * All in Q15 fixed point. Runs in the audio task, under the pipeline mutex.
+ */
+class AudioOutputClipMixer : public AudioOutputStage {
+public:
+    static const size_t MAX_VOICES = 4;
+
+    explicit AudioOutputClipMixer(AudioOutput* sink) : AudioOutputStage(sink) {}
+
+    /**
+     * @brief Start a clip on a free voice
+     * The clip must stay allocated until it has played or stopAll().
+     * @param gainDb Clip level, at most 0 dB
+     * @param duck Lower the main audio while the clip plays
+     * @return false if every voice is busy
+     */
+    bool play(const PcmClip* clip, float gainDb, bool duck);
+
+    void stopAll();
+
+    // Clips playing, or the main audio still returning from a duck
+    bool isActive() const { return activeVoices > 0 || duckGain != DUCK_ONE; }
+
+    /**
+     * @brief Set how far the main audio is lowered under a clip
+     * @param db Attenuation, e.g. -12
+     */
+    void setDuckLevel(float db);
+
+    /**
+     * @brief Play the clips over silence while no decoder delivers samples
+     * Starts the sink if needed and fills it until it refuses a sample.
+     * Stops the sink again after the last clip, unless a decoder began.
+     * @return true if clips are still playing
+     */
+    bool fillIdle();
+
+    virtual bool SetRate(int hz) override;
+    virtual bool begin() override;
+    virtual bool stop() override;
+    virtual bool ConsumeSample(int16_t sample[2]) override;
+
+private:
+    static const uint32_t DUCK_ONE = (1u << 15) << 16;  // Unity gain, Q15 in the upper half
+
+    struct Voice {
+        const PcmClip* clip;
+        uint32_t pos;    // Frame of the clip
+        uint32_t frac;   // Position between pos and pos + 1, Q16
+        uint32_t step;   // Clip frames per output frame, Q16
+        int32_t gain;    // Q15
+        bool duck;
+    };
+
+    Voice voices[MAX_VOICES] = {};
+    size_t activeVoices = 0;
+    size_t duckingVoices = 0;
+
+    uint32_t duckGain = DUCK_ONE;   // Gain of the main audio, Q15 in the upper half
+    uint32_t duckLevel = DUCK_ONE;  // Target while a ducking clip plays
+    uint32_t attackStep = 0;        // Gain change per sample towards duckLevel
+    uint32_t releaseStep = 0;       // Gain change per sample back to unity
+
+    bool sinkRunning = false;  // The stage began the sink and did not stop it
+    bool upstreamBegun = false;  // A decoder began and has not stopped
+
+    void updateSteps();
+    void mix(const int16_t in[2], int16_t out[2]) const;
+    void advance();
+};
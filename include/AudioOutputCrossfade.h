@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioOutputStage.h"
+
+/**
+ * @brief Crossfade between two decoders that never run at the same time
+ *
+ * Only one decoder fits next to the UI, so a station switch captures a short
+ * tail of the outgoing decoder into a PSRAM buffer instead of playing it,
+ * replaces the decoder and mixes the tail out against the first samples of
+ * the new one. While a switch is in progress the stage keeps the sink
+ * running across the decoder change: the stop() of the old decoder and the
+ * begin() of the new one are not passed on, so I2S never drops to silence.
+ */
+class AudioOutputCrossfade : public AudioOutputStage {
+public:
+    explicit AudioOutputCrossfade(AudioOutput* sink) : AudioOutputStage(sink) {}
+    virtual ~AudioOutputCrossfade() override;
+
+    /**
+     * @brief Allocate the tail buffer in PSRAM
+     * @param durationMs Crossfade length, sized for 48 kHz stereo
+     * @return true if the buffer is available
+     */
+    bool allocate(uint32_t durationMs);
+
+    void release();
+
+    // Bytes allocated for the tail buffer
+    size_t getBufferBytes() const { return capacity * sizeof(Frame); }
+
+    // Bytes allocate() needs for a crossfade of this length
+    static size_t bufferBytesFor(uint32_t durationMs);
+
+    /**
+     * @brief Hold back the following samples as the outgoing tail
+     * The decoder is refused further samples once the tail is complete.
+     */
+    void beginCapture();
+
+    bool isCaptureFull() const { return mode == Mode::Capture && frames >= captureFrames; }
+
+    /**
+     * @brief Mix the captured tail out against the samples that follow
+     * With an empty tail the next samples pass through unchanged.
+     */
+    void startCrossfade();
+
+    /**
+     * @brief Drop a capture or mix in progress
+     * Stops the sink if the stage kept it running for a decoder that never came.
+     */
+    void cancel();
+
+    bool isActive() const { return mode != Mode::PassThrough; }
+
+    virtual bool begin() override;
+    virtual bool stop() override;
+    virtual bool ConsumeSample(int16_t sample[2]) override;
+
+private:
+    enum class Mode : uint8_t {
+        PassThrough,
+        Capture,  // Samples go to the tail buffer
+        Mix       // Tail fades out while the new decoder fades in
+    };
+
+    typedef int16_t Frame[2];
+
+    Frame* tail = nullptr;
+    size_t capacity = 0;       // Tail buffer size in frames
+    uint32_t durationMs = 0;
+    Mode mode = Mode::PassThrough;
+    size_t captureFrames = 0;  // Frames to capture at the current rate
+    size_t frames = 0;         // Frames captured
+    size_t mixPos = 0;         // Next tail frame to mix
+    uint32_t phase = 0;        // Gain of the new decoder, Q15 in the upper half
+    uint32_t step = 0;         // Phase increment per frame
+
+    bool sinkRunning = false;
+    bool stopDeferred = false;  // A decoder stop() was held back during a switch
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioOutputStage.h"
+#include "EqualizerKernels.h"
+
+// ESP-DSP ships with the S3 core and has PIE-optimized (float) biquads
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && __has_include(<dsps_biquad.h>)
+#define EQ_HAVE_ESP_DSP 1
+#else
+#define EQ_HAVE_ESP_DSP 0
+#endif
+
+/**
+ * @brief Cascaded biquad equalizer in the output path
+ *
+ * Collects decoded samples into short blocks and runs a cascade of up to
+ * EQ_MAX_BANDS peaking and shelf filters over each block before passing it
+ * on. Blocks keep the per-sample call overhead out of the filter loop and
+ * let the kernels keep a band's state in registers; they add
+ * BLOCK_FRAMES samples (under 1 ms) of latency; stop() passes a partial
+ * block on so the end of a stream is not cut. Headroom for boosts is taken
+ * off the first band so a boosted preset does not clip.
+ */
+class AudioOutputEqualizer : public AudioOutputStage {
+public:
+    enum class Kernel : uint8_t {
+        Reference = 0,  // Scalar fixed point, one sample at a time
+        Block = 1,      // Fixed point, band-major over the block
+        EspDsp = 2      // ESP-DSP float biquads (S3 only)
+    };
+
+    explicit AudioOutputEqualizer(AudioOutput* sink) : AudioOutputStage(sink) {}
+
+    /**
+     * @brief Replace the filter bands
+     * @param bands Band parameters, nullptr or 0 bands bypasses the stage
+     * @param count Number of bands (at most EQ_MAX_BANDS)
+     */
+    void setBands(const EqBand* bands, size_t count);
+
+    size_t getBandCount() const { return bandCount; }
+
+    /**
+     * @brief Select the filter kernel
+     * @return false if the kernel is not available on this build
+     */
+    bool setKernel(Kernel kernel);
+    Kernel getKernel() const { return kernel; }
+
+    // Average cycles per stereo frame spent filtering (AUDIO_BENCHMARK builds)
+    uint32_t getCyclesPerFrame() const;
+
+    /**
+     * @brief Time every available kernel on a synthetic block and log it
+     * @param bands Band parameters to benchmark
+     * @param count Number of bands
+     */
+    static void benchmark(const EqBand* bands, size_t count);
+
+    virtual bool SetRate(int hz) override;
+    virtual bool ConsumeSample(int16_t sample[2]) override;
+    virtual bool stop() override;
+
+    static const char* kernelName(Kernel kernel);
+
+private:
+    static constexpr size_t BLOCK_FRAMES = 32;
+
+    EqBand bands[EQ_MAX_BANDS];
+    size_t bandCount = 0;
+    Kernel kernel = Kernel::Block;
+
+    EqCoeffs coeffs[EQ_MAX_BANDS];
+    EqState state[EQ_MAX_BANDS * 2];
+#if EQ_HAVE_ESP_DSP
+    float floatCoeffs[EQ_MAX_BANDS][5];
+    float floatState[EQ_MAX_BANDS * 2][2];
+#endif
+
+    // Block being collected, then drained into the sink
+    int16_t block[BLOCK_FRAMES * 2];
+    int32_t work[BLOCK_FRAMES * 2];
+    size_t collected = 0;
+    size_t drained = 0;
+    size_t pending = 0;  // Processed frames waiting for the sink
+
+    uint64_t filterCycles = 0;
+    uint32_t filterFrames = 0;
+
+    void design();
+    void resetState();
+    void process(int16_t* pcm, size_t frames);
+    bool drain();
+    void flushBlock();
+};
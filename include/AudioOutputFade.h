@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioOutputStage.h"
+
+/**
+ * @brief Gain ramp applied per sample in the output path
+ *
+ * Fades from silence to full scale over a fixed number of output samples.
+ * The gain is advanced per sample in Q15 fixed point, so the ramp is free of
+ * the zipper noise that stepping AudioOutputI2S::SetGain() would cause and
+ * needs no timer or task wakeups. The volume itself stays on the I2S output;
+ * this stage only scales towards it.
+ */
+class AudioOutputFade : public AudioOutputStage {
+public:
+    enum class Curve : uint8_t {
+        Linear = 0,      // Gain rises linearly
+        Perceptual = 1   // Cubic gain, rises evenly in perceived loudness
+    };
+
+    explicit AudioOutputFade(AudioOutput* sink) : AudioOutputStage(sink) {}
+
+    /**
+     * @brief Start a fade-in from silence
+     * The ramp length is derived from the sample rate reported by the decoder.
+     * @param durationMs Ramp length, 0 plays at full gain immediately
+     * @param curve Gain curve of the ramp
+     */
+    void startFadeIn(uint32_t durationMs, Curve curve);
+
+    /**
+     * @brief Drop a running ramp and play at full gain
+     */
+    void cancel();
+
+    bool isFading() const { return fading; }
+
+    // Samples passed on to the sink since construction (wraps)
+    uint32_t getSamplesConsumed() const { return samplesConsumed; }
+
+    virtual bool SetRate(int hz) override;
+    virtual bool ConsumeSample(int16_t sample[2]) override;
+
+    static const char* curveName(Curve curve);
+    static Curve curveFromName(const char* name);
+
+private:
+    bool fading = false;
+    bool pendingStart = false;  // Length is set once the sample rate is known
+    Curve curve = Curve::Linear;
+    uint32_t durationMs = 0;
+    uint32_t samplesConsumed = 0;
+
+    uint32_t phase = 0;  // Ramp position, Q15 in the upper half
+    uint32_t step = 0;   // Phase increment per sample
+
+    void armRamp();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioOutputStage.h"
+
+/**
+ * @brief Short-term loudness meter in the output path
+ *
+ * Passes samples through unchanged and measures their loudness after
+ * ITU-R BS.1770 K-weighting (the filter EBU R128 builds on). Instead of the
+ * 3 s sliding window of R128 short-term loudness, the mean square of each
+ * 100 ms block feeds an exponential average with a 3 s time constant, so the
+ * meter needs no sample history. Blocks below the -70 LUFS absolute gate are
+ * skipped, so pauses and silence do not drag the reading down.
+ */
+class AudioOutputLoudness : public AudioOutputStage {
+public:
+    explicit AudioOutputLoudness(AudioOutput* sink) : AudioOutputStage(sink) {}
+
+    /**
+     * @brief Forget the measurement, e.g. when another station goes on air
+     */
+    void reset();
+
+    // True once the average covers a full time constant of gated audio
+    bool isSettled() const { return gatedBlocks >= SETTLE_BLOCKS; }
+
+    // Short-term loudness in LUFS, only meaningful once isSettled()
+    float getShortTermLufs() const;
+
+    virtual bool SetRate(int hz) override;
+    virtual bool ConsumeSample(int16_t sample[2]) override;
+
+private:
+    static constexpr float BLOCK_SECONDS = 0.1f;
+    static constexpr float TIME_CONSTANT_SECONDS = 3.0f;
+    static constexpr uint32_t SETTLE_BLOCKS = 30;  // One time constant
+
+    struct Biquad {
+        float b0, b1, b2, a1, a2;
+    };
+
+    // K-weighting: high shelf (head model) then high pass (RLB weighting)
+    Biquad shelf = {1, 0, 0, 0, 0};
+    Biquad highpass = {1, 0, 0, 0, 0};
+    float history[2][4] = {};  // Per channel: shelf z1, z2, high pass z1, z2
+
+    float blockSum = 0.0f;     // Sum of squares of the current block, both channels
+    uint32_t blockFill = 0;
+    uint32_t blockLength = 4410;
+    float average = 0.0f;      // Averaged block mean square
+    float alpha = 0.0f;        // Averaging weight of a new block
+    uint32_t gatedBlocks = 0;  // Blocks above the gate since reset()
+
+    void design();
+    float weight(float x, float* z);
+};
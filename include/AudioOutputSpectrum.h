@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "AudioOutputStage.h"
+
+// ESP-DSP ships with the S3 core and has a PIE-optimized complex FFT
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && __has_include(<dsps_fft2r.h>)
+#define SPECTRUM_HAVE_ESP_DSP 1
+#else
+#define SPECTRUM_HAVE_ESP_DSP 0
+#endif
+
+/**
+ * @brief Spectrum analyzer tap in the output path
+ *
+ * The audio task only mixes what the sink took to mono, decimates it to
+ * about 22 kHz (averaging, which doubles as the anti-alias filter) and keeps
+ * the last FFT_SIZE samples. The analysis runs in the caller of analyze(),
+ * normally the UI task: a Hann-windowed real FFT (one half-size complex FFT,
+ * ESP-DSP on the S3) whose bins are summed into log-spaced bars. Disabled,
+ * the stage costs one branch per sample.
+ */
+class AudioOutputSpectrum : public AudioOutputStage {
+public:
+    static const size_t FFT_SIZE = 512;
+    static const size_t MAX_BARS = 32;
+
+    explicit AudioOutputSpectrum(AudioOutput* sink);
+
+    /**
+     * @brief Start or stop collecting samples
+     * Enabling starts from an empty history.
+     */
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled.load(); }
+
+    /**
+     * @brief Compute the bars of the latest FFT_SIZE samples
+     * Call from the UI task at the frame rate of the display (20-30 Hz).
+     * @param bars Receives levels from 0 (silence, -60 dB) to 255 (full scale)
+     * @param count Number of bars (at most MAX_BARS), log spaced from 50 Hz
+     *        to the top of the decimated band
+     * @return false if no new samples arrived since the last call
+     */
+    bool analyze(uint8_t* bars, size_t count);
+
+    // Average time analyze() spent per frame, in microseconds
+    uint32_t getFrameMicros() const { return frameMicros.load(); }
+
+    virtual bool SetRate(int hz) override;
+    virtual bool ConsumeSample(int16_t sample[2]) override;
+
+private:
+    std::atomic<bool> enabled{false};
+
+    // Audio task: decimation and the sample history. The history is read
+    // without a lock; a sample replaced during the copy is invisible in bars.
+    uint32_t decimation = 2;
+    int32_t decimationSum = 0;
+    uint32_t decimationFill = 0;
+    int16_t history[FFT_SIZE] = {};
+    std::atomic<uint32_t> written{0};  // Decimated samples since enabled, newest at written - 1
+    std::atomic<uint32_t> analysisRate{22050};  // Decimated sample rate
+
+    // Analysis (caller of analyze())
+    uint32_t analyzedAt = 0;          // written at the last analysis
+    float window[FFT_SIZE];           // Hann
+    float twiddleCos[FFT_SIZE / 2];   // e^(-2 pi i k / FFT_SIZE)
+    float twiddleSin[FFT_SIZE / 2];
+    float fft[FFT_SIZE];              // FFT_SIZE / 2 complex values, interleaved
+    float smoothed[MAX_BARS] = {};
+    std::atomic<uint32_t> frameMicros{0};
+
+    void transform();
+};
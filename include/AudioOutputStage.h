@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioOutput.h"
+
+/**
+ * @brief Pass-through AudioOutput that forwards everything to a sink
+ *
+ * Base class for processing stages between the decoder and the I2S output,
+ * in the style of ESP8266Audio's AudioOutputFilterBiquad. A stage overrides
+ * ConsumeSample() to process PCM and hands the result to the next stage.
+ * Stages run in the audio task, under the pipeline mutex.
+ */
+class AudioOutputStage : public AudioOutput {
+public:
+    explicit AudioOutputStage(AudioOutput* sink) : sink(sink) {}
+    virtual ~AudioOutputStage() override {}
+
+    virtual bool SetRate(int hz) override { hertz = hz; return sink->SetRate(hz); }
+    virtual bool SetBitsPerSample(int bits) override { bps = bits; return sink->SetBitsPerSample(bits); }
+    virtual bool SetChannels(int chan) override { channels = chan; return sink->SetChannels(chan); }
+    virtual bool SetGain(float f) override { return sink->SetGain(f); }
+    virtual bool begin() override { return sink->begin(); }
+    virtual bool ConsumeSample(int16_t sample[2]) override { return sink->ConsumeSample(sample); }
+    virtual bool stop() override { return sink->stop(); }
+    virtual void flush() override { sink->flush(); }
+    virtual bool loop() override { return sink->loop(); }
+
+    AudioOutput* getSink() const { return sink; }
+
+    // Sample rate set by the decoder, 0 before the first SetRate()
+    int getRate() const { return hertz; }
+
+protected:
+    AudioOutput* sink;
+};
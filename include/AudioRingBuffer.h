@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @brief Lock-free single-producer/single-consumer byte ring
+ *
+ * Exactly one task may write (the network reader) and exactly one task may
+ * read (the audio pump). Head and tail are free-running counters, so the
+ * whole capacity is usable and no lock is needed between the two sides.
+ * Storage is allocated in PSRAM; the capacity is rounded up to a power of two.
+ */
+class AudioRingBuffer {
+public:
+    AudioRingBuffer() = default;
+    ~AudioRingBuffer();
+
+    // Prevent copying and assignment
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    /**
+     * @brief Allocate the ring storage in PSRAM
+     * @param capacity Requested size in bytes (rounded up to a power of two)
+     * @return true if the storage is available
+     */
+    bool allocate(size_t capacity);
+
+    /**
+     * @brief Free the ring storage
+     */
+    void release();
+
+    /**
+     * @brief Drop all buffered data
+     * Only call this while neither the producer nor the consumer is active.
+     */
+    void reset();
+
+    bool isAllocated() const { return buffer != nullptr; }
+    size_t capacity() const { return size; }
+
+    // Bytes ready to be read
+    size_t available() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    // Bytes that can be written without overwriting unread data
+    size_t freeSpace() const { return size - available(); }
+
+    // Fill level in percent (0-100)
+    uint8_t fillPercent() const { return size ? (uint8_t)((available() * 100) / size) : 0; }
+
+    // Producer side
+    size_t write(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Get the largest contiguous free region for zero-copy writes
+     * @param region Receives a pointer into the ring storage
+     * @return Number of bytes that may be written at region
+     */
+    size_t writeRegion(uint8_t** region);
+
+    /**
+     * @brief Publish bytes written into a region from writeRegion()
+     * @param len Number of bytes actually written
+     */
+    void commitWrite(size_t len);
+
+    // Consumer side
+    size_t read(uint8_t* data, size_t len);
+
+    /**
+     * @brief Get the largest contiguous unread region for zero-copy reads
+     * @param region Receives a pointer into the ring storage
+     * @return Number of bytes readable at region, release them with discard()
+     */
+    size_t readRegion(const uint8_t** region) const;
+
+    /**
+     * @brief Drop unread bytes without copying them (consumer side)
+     * @param len Maximum number of bytes to drop
+     * @return Number of bytes dropped
+     */
+    size_t discard(size_t len);
+
+    /**
+     * @brief Copy unread bytes without consuming them (consumer side)
+     * @return Number of bytes copied
+     */
+    size_t peek(uint8_t* data, size_t len) const;
+
+    // Running totals since the last reset()
+    uint32_t totalWritten() const { return head.load(std::memory_order_acquire); }
+    uint32_t totalRead() const { return tail.load(std::memory_order_acquire); }
+
+private:
+    uint8_t* buffer = nullptr;
+    size_t size = 0;
+    size_t mask = 0;
+
+    // Free-running positions: head is only written by the producer,
+    // tail only by the consumer
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include "TlsClient.h"
+#include "AudioRingBuffer.h"
+#include "IcyMetadataParser.h"
+
+/**
+ * @brief Producer end of the stream pipeline
+ *
+ * Owns the HTTP connection of a radio stream and moves whatever the socket
+ * has buffered into an AudioRingBuffer. pump() never blocks on the network,
+ * so it can be called from a dedicated reader task in a tight loop.
+ * ICY metadata is requested and stripped out of the audio data here.
+ */
+class AudioStreamReader {
+public:
+    AudioStreamReader() = default;
+    ~AudioStreamReader();
+
+    // Prevent copying and assignment
+    AudioStreamReader(const AudioStreamReader&) = delete;
+    AudioStreamReader& operator=(const AudioStreamReader&) = delete;
+
+    /**
+     * @brief Connect to a stream URL and send the GET request
+     * @param url HTTP or HTTPS URL of the stream
+     * @return true if the server answered with 200 OK
+     */
+    bool open(const char* url);
+
+    /**
+     * @brief Close the connection
+     */
+    void close();
+
+    bool isOpen() const { return stream != nullptr; }
+
+    /**
+     * @brief Move buffered socket data into the ring without blocking
+     * @param ring Destination ring
+     * @param maxFill Stop once the ring holds this many bytes
+     * @return Number of bytes moved, or -1 once the connection is gone
+     */
+    int pump(AudioRingBuffer& ring, size_t maxFill);
+
+    // Total payload bytes received since open()
+    uint32_t getBytesReceived() const { return bytesReceived; }
+
+    // Content-Type announced by the server, empty if none
+    const char* getContentType() const { return contentType; }
+
+    // Current ICY StreamTitle, empty if the station sends none; safe from any task
+    void copyStreamTitle(char* dest, size_t size) const { metadata.copyTitle(dest, size); }
+
+    /**
+     * @brief Check whether the stream title changed since the last call
+     * Call from the task that calls pump().
+     */
+    bool takeTitleChange() { bool changed = titleChanged; titleChanged = false; return changed; }
+
+    /**
+     * @brief Copy the audio data to a second ring as it arrives
+     * The stream never waits for the tap: bytes it has no room for are
+     * dropped and counted. close() removes the tap.
+     * @param ring Ring of another consumer, nullptr to remove the tap
+     */
+    void setTap(AudioRingBuffer* ring) { tap = ring; tapDropped = 0; }
+    AudioRingBuffer* getTap() const { return tap; }
+    uint32_t getTapDropped() const { return tapDropped; }
+
+private:
+    HTTPClient http;
+    WiFiClient client;
+    TlsClient secureClient;  // For https:// streams, resumes the session on reconnect
+    WiFiClient* stream = nullptr;
+    uint32_t bytesReceived = 0;
+    char contentType[48] = "";
+
+    // ICY metadata: a block of (length byte * 16) bytes follows every
+    // metaInterval audio bytes
+    IcyMetadataParser metadata;
+    size_t metaInterval = 0;
+    size_t audioUntilMeta = 0;
+    int metaRemaining = -1;  // -1 while waiting for the length byte
+    bool titleChanged = false;
+
+    AudioRingBuffer* tap = nullptr;
+    uint32_t tapDropped = 0;
+
+    bool pumpMetadata();
+
+    // Upper bound for a single socket read so one pump() call stays short
+    static constexpr size_t MAX_READ_CHUNK = 4096;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "AudioCodec.h"
+#include "AudioJitterBuffer.h"
+#include "AudioFileSourceRing.h"
+#include "AudioStreamReader.h"
+
+/**
+ * @brief One connect/buffer pipeline of a radio stream
+ *
+ * AudioManager keeps two of these so the next station can connect and
+ * pre-buffer while the current one is still on air. The network task pumps
+ * every slot that is wanted; the decoder in the audio task only ever reads
+ * from the slot that is on air.
+ */
+struct AudioStreamSlot {
+    AudioJitterBuffer jitterBuffer;
+    AudioFileSourceRing ringSource{jitterBuffer.getRing()};
+    AudioStreamReader reader;  // Guarded by AudioManager's networkMutex
+
+    // Stream identity, written before the slot is handed to the network task
+    char url[256] = "";        // Station URL as configured
+    char streamUrl[256] = "";  // Stream it resolved to (playlist and redirects followed)
+    char resolveUrl[256] = ""; // URL streamUrl is resolved from: url, or a bitrate variant of it
+    std::atomic<StreamCodec> codec{StreamCodec::Unknown};
+    std::atomic<bool> codecDetected{false};  // Detection not yet taken by takeDetectedCodec()
+    float startGainDb = 0.0f;                // Loudness gain remembered for the station
+
+    // Shared between the tasks
+    std::atomic<bool> wanted{false};              // Network task keeps the stream connected
+    std::atomic<bool> connecting{false};          // Reader is opened outside the network task
+    std::atomic<bool> redial{false};              // The dial task reconnects the reader
+    std::atomic<bool> onAir{false};               // Decoder plays this slot, its titles are shown
+    std::atomic<bool> reconnectRequested{false};  // Drop the connection and dial again
+    std::atomic<uint32_t> connectedMs{0};         // Time of the last (re)connect
+    std::atomic<uint32_t> lastDataMs{0};          // Time the producer last got data or was throttled
+    std::atomic<uint32_t> dataResumedMs{0};       // First data after the last (re)connect
+
+    // Reconnect state, touched by the network task, and by the dial task
+    // while it reconnects the slot
+    uint32_t backoff = 0;
+    uint32_t nextConnectMs = 0;
+    bool awaitingData = false;
+
+    // PSRAM held by the ring, or needed once it is allocated
+    size_t ringBytes() const {
+        const AudioRingBuffer& ring = jitterBuffer.getRing();
+        return ring.isAllocated() ? ring.capacity() : jitterBuffer.getMaxDepth();
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @brief Stream pipeline counters that explain why a station stutters
+ *
+ * Keeps a histogram of the jitter buffer fill and one of the pipeline time
+ * per frame: a decoder pass including the output stages it feeds (loudness,
+ * EQ, spectrum, fade, mixer, I2S hand-off), in fixed arrays of relaxed atomics: the audio task records
+ * without a lock or an allocation, and any task can take a snapshot (which
+ * may mix counts from two consecutive passes).
+ *
+ * The record calls time themselves in CPU cycles, so the snapshot carries
+ * the share of a core the instrumentation costs, over the last second and
+ * the worst second since reset().
+ *
+ * sampleFill() and the pipeline calls belong to the audio task; reset() to
+ * whoever holds pipelineMutex while the audio task does not record.
+ */
+class AudioTelemetry {
+public:
+    static const size_t FILL_BUCKETS = 10;      // Deciles of the target depth
+    static const size_t PIPELINE_BUCKETS = 64;  // See pipelineBucket()
+
+    struct Snapshot {
+        uint32_t fill[FILL_BUCKETS];  // Samples per decile, one every FILL_SAMPLE_MS
+        uint32_t fillSamples;
+        uint32_t pipelineFrames;      // Decoder passes measured
+        uint32_t pipelineP50Us;       // Pipeline time per frame, bucket upper bounds
+        uint32_t pipelineP95Us;
+        uint32_t pipelineP99Us;
+        uint32_t pipelineMaxUs;
+        uint32_t overheadPpm;         // Share of a core spent recording, last second
+        uint32_t maxOverheadPpm;
+        uint32_t sinceMs;             // Time since reset()
+    };
+
+    AudioTelemetry() = default;
+
+    // Prevent copying and assignment
+    AudioTelemetry(const AudioTelemetry&) = delete;
+    AudioTelemetry& operator=(const AudioTelemetry&) = delete;
+
+    // Clear all counters, e.g. for a new station
+    void reset();
+
+    /**
+     * @brief Count the jitter buffer fill, at most every FILL_SAMPLE_MS
+     * @param available Bytes in the ring
+     * @param target Adaptive target depth, a fill above it counts as full
+     */
+    void sampleFill(size_t available, size_t target, uint32_t now);
+
+    // Start of a decoder pass, pass the result to endPipeline()
+    uint32_t beginPipeline() const { return ESP.getCycleCount(); }
+
+    /**
+     * @brief Record a decoder pass and the output stages it ran
+     * @param start Value of beginPipeline() before the pass
+     * @param samples Samples the pass delivered, passes without any are not counted
+     * @param frameSamples Samples per frame of the codec, to scale the pass to one frame
+     */
+    void endPipeline(uint32_t start, uint32_t samples, uint32_t frameSamples);
+
+    Snapshot getSnapshot() const;
+
+private:
+    static const uint32_t FILL_SAMPLE_MS = 100;
+    static const uint32_t OVERHEAD_WINDOW_MS = 1000;
+
+    std::atomic<uint32_t> fillCounts[FILL_BUCKETS] = {};
+    std::atomic<uint32_t> pipelineCounts[PIPELINE_BUCKETS] = {};
+    std::atomic<uint32_t> overheadPpm{0};
+    std::atomic<uint32_t> maxOverheadPpm{0};
+    std::atomic<uint32_t> resetMs{0};
+
+    // Audio task only
+    uint32_t lastFillSample = 0;
+    uint32_t windowStart = 0;
+    uint32_t windowCycles = 0;    // Cycles spent recording in the current window
+    uint32_t cpuMHz = 240;
+
+    void closeWindow(uint32_t now);
+    static size_t pipelineBucket(uint32_t us);
+    static uint32_t bucketLimit(size_t bucket);
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioCodec.h"
+
+/**
+ * @brief Compressed-domain history of the stream on air
+ *
+ * Keeps the last few minutes of a station as received (MP3 or AAC frames,
+ * not PCM) in a PSRAM ring and indexes the start of every frame as it is
+ * written, so live radio can be paused and rewound. Frame numbers run on
+ * from reset(); the byte position of any frame still in the window is one
+ * index lookup away, and a time offset maps to a frame number through the
+ * constant frame duration of the stream.
+ *
+ * Written and read from the audio task only, under the pipeline mutex.
+ */
+class AudioTimeshift {
+public:
+    AudioTimeshift() = default;
+    ~AudioTimeshift();
+
+    // Prevent copying and assignment
+    AudioTimeshift(const AudioTimeshift&) = delete;
+    AudioTimeshift& operator=(const AudioTimeshift&) = delete;
+
+    /**
+     * @brief Allocate the history and its frame index in PSRAM
+     * @param bytes History size (rounded down to a power of two)
+     * @return true if the storage is available
+     */
+    bool allocate(size_t bytes);
+    void release();
+    bool isAllocated() const { return buffer != nullptr; }
+    size_t capacity() const { return size; }
+
+    /**
+     * @brief Forget the history, e.g. for another station
+     */
+    void reset();
+
+    /**
+     * @brief Append stream bytes, dropping the oldest ones when full
+     * A read position that falls out of the window moves to the oldest
+     * frame still indexed.
+     */
+    void write(const uint8_t* data, size_t len);
+
+    // Reader side
+    size_t read(uint8_t* data, size_t len);
+    void skip(size_t len) { readPos += min(len, available()); }
+    size_t available() const { return writePos - readPos; }
+    bool isLive() const { return readPos == writePos; }
+
+    /**
+     * @brief Move the read position behind the live edge
+     * @param ms Time behind live, rounded to a frame; clamped to the window
+     * @return false if no frame has been indexed yet
+     */
+    bool seekBehindLive(uint32_t ms);
+
+    // Time the read position lags the live edge
+    uint32_t getDelayMs() const;
+
+    // Time covered by the history
+    uint32_t getWindowMs() const;
+
+    uint32_t getFrameCount() const { return frameHead - frameTail; }
+    uint32_t getFrameUs() const { return frameUs; }
+
+private:
+    uint8_t* buffer = nullptr;
+    size_t size = 0;
+    size_t mask = 0;
+
+    // Free-running stream positions
+    uint32_t writePos = 0;
+    uint32_t readPos = 0;
+    uint32_t oldest = 0;  // Oldest byte still in the ring
+
+    // Frame index: start position of frame n at index[n & indexMask]
+    uint32_t* index = nullptr;
+    size_t indexMask = 0;
+    uint32_t frameHead = 0;  // Next frame number to be indexed
+    uint32_t frameTail = 0;  // Oldest frame still in the window
+    uint32_t frameUs = 0;    // Duration of a frame, from the first header
+
+    // Frame parser
+    uint32_t scanPos = 0;    // Next expected frame header, or the resync point
+    bool inSync = false;
+
+    uint8_t byteAt(uint32_t pos) const { return buffer[pos & mask]; }
+    bool headerAt(uint32_t pos, AudioCodec::FrameHeader& header) const;
+    void indexFrames();
+    void addFrame(uint32_t pos);
+    uint32_t frameAt(uint32_t pos) const;
+};
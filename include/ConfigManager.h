@@ -26,6 +26,7 @@ struct DisplayConfig {
     uint8_t timeout;
     bool auto_brightness;
     String theme;
+    bool spectrum;  // Spectrum visualizer on the radio screen
 };
 
 struct AlarmConfig {
@@ -38,14 +39,24 @@ struct AlarmConfig {
     uint8_t station_id;
     uint8_t volume;
     uint8_t fade_in;  // seconds
+    String fade_curve; // "linear" or "perceptual"
     uint16_t duration; // minutes
 };
 
+struct StreamVariantConfig {
+    String url;
+    uint16_t bitrate;  // kbps
+    String codec;      // "mp3", "aac" or "opus", empty to detect
+};
+
 struct RadioStation {
     uint8_t id;
     String name;
     String url;
     String genre;
+    String codec;   // "mp3", "aac" or "opus", empty until detected
+    float gain_db = 0.0f;  // Learned loudness normalization gain
+    std::vector<StreamVariantConfig> variants;  // Same program at other bitrates, url among them
 };
 
 struct WeatherConfig {
@@ -57,6 +68,55 @@ struct WeatherConfig {
     uint16_t update_interval; // Update interval in minutes
 };
 
+struct AudioConfig {
+    uint16_t buffer_min_kb;     // Smallest adaptive stream buffer depth
+    uint16_t buffer_max_kb;     // Largest adaptive stream buffer depth (PSRAM)
+    uint8_t prebuffer_percent;  // Fill level of the buffer before playback starts
+    uint16_t stall_timeout_ms;  // Stream stall deadline before the fallback track plays
+    uint16_t warm_start_s;      // Pre-connect the alarm station this long before the alarm
+    uint16_t crossfade_ms;      // Station switch crossfade, 0 stops the old station first
+    uint16_t psram_budget_kb;   // PSRAM for stream rings and the crossfade buffer
+    uint16_t resolve_ttl_h;     // Keep resolved playlist/redirect URLs this long
+    String mp3_decoder;         // "libmad" or "helix", empty for the build default
+    bool normalize_loudness;    // Level stations to loudness_target_lufs
+    int8_t loudness_target_lufs;
+    uint16_t timeshift_kb;      // Pause/rewind history of the stream on air (PSRAM), 0 disables
+    bool adaptive_bitrate;      // Follow the network with the bitrate of stations that have variants
+    int8_t duck_db;             // Level of the station under a chime or announcement
+    String hourly_chime;        // Clip on the SD card played on the hour, empty for none
+    uint16_t record_buffer_kb;  // Write-behind ring of stream recordings (PSRAM)
+    String tls_trust_store;     // Directory on SD with the CA certificates for HTTPS
+    bool tls_verify;            // Check HTTPS servers (trust store, else the built-in CA bundle)
+};
+
+struct EqBandConfig {
+    String type;    // "peaking", "lowshelf" or "highshelf"
+    float freq;     // Hz
+    float gain_db;
+    float q;
+};
+
+struct EqPresetConfig {
+    String name;
+    std::vector<EqBandConfig> bands;
+};
+
+struct EqualizerConfig {
+    String preset;  // Name of the active preset
+    std::vector<EqPresetConfig> presets;
+};
+
+struct PodcastFeedConfig {
+    String name;
+    String url;  // RSS feed
+};
+
+struct PodcastConfig {
+    std::vector<PodcastFeedConfig> feeds;  // An alarm refers to a feed by its index
+    uint16_t quota_mb;   // SD space for downloaded episodes
+    uint8_t fetch_hour;  // Local hour the nightly download starts at
+};
+
 struct SystemConfig {
     String hostname;
     String ota_password;
@@ -80,6 +140,9 @@ private:
     std::vector<RadioStation> radioStations;
     WeatherConfig weatherConfig;
     SystemConfig systemConfig;
+    AudioConfig audioConfig;
+    EqualizerConfig equalizerConfig;
+    PodcastConfig podcastConfig;
     String fallbackAudio;
     
     // Sensor states and configuration
@@ -123,6 +186,9 @@ public:
     std::vector<RadioStation> getRadioStations() { return radioStations; }
     WeatherConfig getWeatherConfig() { return weatherConfig; }
     SystemConfig getSystemConfig() { return systemConfig; }
+    AudioConfig getAudioConfig() { return audioConfig; }
+    EqualizerConfig getEqualizerConfig() { return equalizerConfig; }
+    PodcastConfig getPodcastConfig() { return podcastConfig; }
     String getFallbackAudio() { return fallbackAudio; }
     
     // OTA settings
@@ -148,7 +214,35 @@ public:
     void setRadioStations(const std::vector<RadioStation>& stations) { radioStations = stations; }
     void setWeatherConfig(const WeatherConfig& config) { weatherConfig = config; }
     void setSystemConfig(const SystemConfig& config) { systemConfig = config; }
+    void setAudioConfig(const AudioConfig& config) { audioConfig = config; }
+    void setEqualizerConfig(const EqualizerConfig& config) { equalizerConfig = config; }
+    void setPodcastConfig(const PodcastConfig& config) { podcastConfig = config; }
     void setFallbackAudio(const String& path) { fallbackAudio = path; }
+
+    /**
+     * @brief Remember the codec of the station with the given stream URL
+     * @return true if a station record changed and the config should be saved
+     */
+    bool setStationCodec(const String& url, const String& codec);
+
+    /**
+     * @brief Remember the loudness gain of the station with the given stream URL
+     * Changes under 0.5 dB are ignored to spare the SD card.
+     * @return true if a station record changed and the config should be saved
+     */
+    bool setStationGain(const String& url, float gainDb);
+
+    // Loudness gain of the station with the given stream URL, 0 if unknown
+    float getStationGain(const String& url) const;
+
+    // Station with the given stream URL, nullptr if there is none
+    const RadioStation* findStation(const String& url) const;
+
+    /**
+     * @brief Find an equalizer preset by name
+     * @return nullptr if there is no preset with that name
+     */
+    const EqPresetConfig* findEqualizerPreset(const String& name) const;
     
     // Sensor configuration setters
     void setI2CPins(int sda, int scl) { i2cSDAPin = sda; i2cSCLPin = scl; }
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Fixed-point biquad kernels of the equalizer
+ *
+ * PCM is interleaved stereo Q15. Coefficients are Q28 (range +-8, enough for
+ * +-15 dB shelves and peaks), the filter state carries 8 extra fraction bits
+ * (Q23) and every multiply-accumulate runs in 64 bits, so the cascade only
+ * rounds and saturates once, at the output.
+ *
+ * Deliberately free of Arduino headers: the host benchmark (env:bench)
+ * builds this file on its own.
+ */
+
+// Bands in a cascade
+static const size_t EQ_MAX_BANDS = 10;
+
+enum class EqFilterType : uint8_t {
+    Peaking = 0,
+    LowShelf = 1,
+    HighShelf = 2
+};
+
+struct EqBand {
+    EqFilterType type;
+    float freq;    // Center or corner frequency in Hz
+    float gainDb;  // Boost or cut
+    float q;       // Quality factor (shelf slope for shelves)
+};
+
+// Normalized biquad, y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2
+struct EqCoeffs {
+    int32_t b0, b1, b2, a1, a2;  // Q28
+};
+
+// Direct form I history of one band and channel, Q23
+struct EqState {
+    int32_t x1, x2, y1, y2;
+};
+
+/**
+ * @brief Design a band with the RBJ audio EQ cookbook formulas
+ * @param band Filter parameters
+ * @param sampleRate Sample rate in Hz
+ * @param gain Linear gain folded into the band (headroom for boosts)
+ * @param coeffs Receives the Q28 coefficients
+ */
+void eqDesign(const EqBand& band, uint32_t sampleRate, float gain, EqCoeffs& coeffs);
+
+/**
+ * @brief Scalar reference: one sample, one channel, one band at a time
+ * @param state bands * 2 states, channel-major per band
+ */
+void eqProcessReference(const EqCoeffs* coeffs, EqState* state, size_t bands,
+                        int16_t* pcm, size_t frames);
+
+/**
+ * @brief Block kernel: band-major over the block, both channels per pass
+ * Keeps the coefficients and history of a band in registers for the whole
+ * block. Bit-exact with eqProcessReference().
+ * @param work Scratch of frames * 2 values
+ */
+void eqProcessBlock(const EqCoeffs* coeffs, EqState* state, size_t bands,
+                    int16_t* pcm, size_t frames, int32_t* work);
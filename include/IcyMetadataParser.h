@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @brief Artist and title of the current stream, fixed size for queues
+ */
+struct NowPlaying {
+    char artist[64];
+    char title[96];
+
+    /**
+     * @brief Split an ICY StreamTitle ("Artist - Title") into its parts
+     * A title without separator is kept whole in title.
+     */
+    void fromStreamTitle(const char* streamTitle);
+};
+
+/**
+ * @brief Incremental parser for SHOUTcast/Icecast (ICY) metadata blocks
+ *
+ * Metadata blocks arrive interleaved with the audio data and may be split
+ * across socket reads, so the parser is fed byte ranges as they come in and
+ * extracts StreamTitle='...'; without buffering the whole block. Titles are
+ * written into two fixed slots: the back slot is filled while the front slot
+ * stays readable, and they swap when a complete, changed title is in. Each
+ * swap bumps a generation counter; copyTitle() retries when one happened
+ * while it copied (a seqlock), as two quick title changes would overwrite
+ * the slot being read. No heap allocation happens after construction.
+ *
+ * reset() and the block calls belong to the task that reads the stream,
+ * copyTitle() may be called from any task.
+ */
+class IcyMetadataParser {
+public:
+    static constexpr size_t TITLE_SIZE = 160;
+
+    /**
+     * @brief Forget the current title (new stream)
+     */
+    void reset();
+
+    /**
+     * @brief Start a metadata block
+     */
+    void beginBlock();
+
+    /**
+     * @brief Feed the next bytes of the current block
+     */
+    void feed(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Finish the current block
+     * @return true if the block carried a title different from the current one
+     */
+    bool endBlock();
+
+    /**
+     * @brief Copy the last complete title, empty until the first one arrived
+     * @param dest Buffer, TITLE_SIZE bytes hold any title
+     * @param size Size of dest
+     */
+    void copyTitle(char* dest, size_t size) const;
+
+private:
+    char slots[2][TITLE_SIZE] = {{0}, {0}};
+    std::atomic<uint32_t> generation{0};  // Swaps so far, the front slot is generation & 1
+
+    // Parser state for the current block
+    uint8_t keyMatched = 0;     // Characters of "StreamTitle='" matched so far
+    bool inValue = false;       // Copying the title into the back slot
+    bool quotePending = false;  // Saw ' inside the value, might be the terminator
+    bool valueComplete = false;
+    size_t valueLength = 0;
+
+    void append(char c);
+};
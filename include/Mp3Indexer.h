@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+
+/**
+ * @brief Frame index sidecars for seeking in MP3 files on the SD card
+ *
+ * A background task walks the card and writes a compact sidecar next to
+ * every MP3 ("<file>.idx"): the byte offset of the first frame starting at
+ * or after every INDEX_INTERVAL_MS of audio. Seeking then costs one small
+ * read of the sidecar instead of decoding or scanning from the start. A
+ * sidecar records the size and modification time of its MP3 and is
+ * rebuilt when either changes.
+ *
+ * lookup() and request() may be called from any task.
+ */
+class Mp3Indexer {
+private:
+    static Mp3Indexer* instance;
+
+    Mp3Indexer() = default;
+
+    // Prevent copying and assignment
+    Mp3Indexer(const Mp3Indexer&) = delete;
+    Mp3Indexer& operator=(const Mp3Indexer&) = delete;
+
+public:
+    static Mp3Indexer& getInstance() {
+        if (!instance) {
+            instance = new Mp3Indexer();
+        }
+        return *instance;
+    }
+
+    // Audio between two index entries
+    static const uint32_t INDEX_INTERVAL_MS = 1000;
+
+    /**
+     * @brief Start the indexer task
+     * @param root Directory whose MP3 files are indexed, subdirectories included
+     */
+    void begin(const char* root);
+
+    /**
+     * @brief Index a file ahead of the walk, e.g. one that is playing now
+     */
+    void request(const char* path);
+
+    /**
+     * @brief Find where to start decoding a file at a position
+     * @param path MP3 file
+     * @param positionMs Position from the start of the audio
+     * @param offset Receives the byte offset of a frame at or just after
+     *        the position
+     * @param startMs Receives the position that frame starts at
+     * @return false if the file has no up-to-date sidecar
+     */
+    bool lookup(const char* path, uint32_t positionMs, uint32_t& offset, uint32_t& startMs);
+
+    /**
+     * @brief Estimate the offset of a position from the first frame's bitrate
+     * Exact for constant bitrate files; the decoder resyncs on the frame
+     * following the offset.
+     * @return false if no MP3 frame is found at the start of the file
+     */
+    bool estimate(const char* path, uint32_t positionMs, uint32_t& offset);
+
+    // Files indexed since boot
+    uint32_t getIndexedCount() const { return indexedCount; }
+
+private:
+    // Sidecar layout: this header, then entryCount little endian uint32 offsets
+    struct SidecarHeader {
+        char magic[4];
+        uint16_t version;
+        uint16_t intervalMs;
+        uint32_t fileSize;    // Size of the MP3 when it was indexed
+        uint32_t fileMtime;   // Modification time of the MP3 when it was indexed
+        uint32_t durationMs;
+        uint32_t entryCount;
+    } __attribute__((packed));
+
+    static const size_t MAX_PATH = 128;
+
+    char rootPath[MAX_PATH] = "/";
+    TaskHandle_t taskHandle = nullptr;
+    QueueHandle_t requests = nullptr;  // char[MAX_PATH] paths to index first
+    volatile uint32_t indexedCount = 0;
+
+    static void indexerTask(void* parameter);
+    void walk(const char* dir, uint8_t depth);
+    void serveRequests();
+    bool isCurrent(const char* path, File& mp3);
+    bool indexFile(const char* path);
+    static String sidecarPath(const char* path);
+    static bool isMp3(const char* name);
+    static uint32_t audioStart(File& file);
+};
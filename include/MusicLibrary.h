@@ -0,0 +1,121 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+#include <atomic>
+
+/**
+ * @brief Browsable index of the MP3 collection on the SD card
+ *
+ * A background task reads only the tags of each MP3 (ID3v2 frames, the
+ * ID3v1 trailer for what v2 lacks, and the first MPEG frame for the
+ * duration) and writes a sorted binary index to /library on the card:
+ *
+ *   header | tracks (by artist, album, track number, title) |
+ *   artists (first track and track count each) | string pool
+ *
+ * Records are fixed size with offsets into the pool, so a page of tracks or
+ * artists is read with a few seeks and the index is never loaded whole;
+ * findArtist() is a binary search on the card.
+ *
+ * A scan cache remembers the modification time of every directory with
+ * the tags of its files. A rescan only reads the tags of files in
+ * directories whose time changed (a file was added, removed or renamed)
+ * and of files whose size or time changed there; the rest comes from the
+ * cache.
+ *
+ * Queries may be called from any task; the index is replaced atomically
+ * when a scan completes.
+ */
+class MusicLibrary {
+private:
+    static MusicLibrary* instance;
+
+    MusicLibrary() = default;
+
+    // Prevent copying and assignment
+    MusicLibrary(const MusicLibrary&) = delete;
+    MusicLibrary& operator=(const MusicLibrary&) = delete;
+
+public:
+    static MusicLibrary& getInstance() {
+        if (!instance) {
+            instance = new MusicLibrary();
+        }
+        return *instance;
+    }
+
+    struct Track {
+        String artist;
+        String album;
+        String title;
+        String path;
+        uint32_t durationMs;  // 0 if unknown
+        uint16_t trackNo;     // 0 if untagged
+    };
+
+    struct Artist {
+        String name;
+        uint32_t firstTrack;  // Index of the artist's first track
+        uint32_t trackCount;
+    };
+
+    struct Status {
+        bool scanning;
+        uint32_t tracks;      // Tracks in the index
+        uint32_t artists;
+        uint32_t scanned;     // Files whose tags were read by the running or last scan
+        uint32_t reused;      // Files taken from the scan cache
+        uint32_t lastScanMs;  // Duration of the last scan
+    };
+
+    /**
+     * @brief Start the scanner task, it scans once right away
+     * @param root Directory whose MP3 files are indexed, subdirectories included
+     */
+    void begin(const char* root);
+
+    /**
+     * @brief Scan again, e.g. after files were copied to the card
+     * @param full Read the directory of every file even where the directory
+     *        time is unchanged; for files replaced in place, which FAT does
+     *        not record in the directory time
+     */
+    void rescan(bool full = false);
+
+    /**
+     * @brief Read a page of tracks in index order
+     * @param first Index of the first track
+     * @param count Tracks to read at most
+     * @return Number of tracks appended to tracks
+     */
+    size_t getTracks(uint32_t first, size_t count, std::vector<Track>& tracks);
+
+    /**
+     * @brief Read a page of artists in alphabetical order
+     * @return Number of artists appended to artists
+     */
+    size_t getArtists(uint32_t first, size_t count, std::vector<Artist>& artists);
+
+    /**
+     * @brief Find the first artist at or after a name, case-insensitive
+     * @return Index of the artist, getStatus().artists if none follows
+     */
+    uint32_t findArtist(const char* prefix);
+
+    Status getStatus();
+
+private:
+    static const size_t MAX_PATH = 128;
+
+    char rootPath[MAX_PATH] = "/";
+    TaskHandle_t taskHandle = nullptr;
+    SemaphoreHandle_t mutex = nullptr;  // Guards the index file and status
+    Status status = {};
+
+    std::atomic<bool> fullRescan{false};
+
+    static void scannerTask(void* parameter);
+    void scan(bool full);
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Ogg container parser that hands out the packets of one stream
+ *
+ * Pulls bytes through a read callback that may return short (a network
+ * ring that is running low), keeps its place and picks up on the next
+ * call. Every page is CRC checked before its packets are released; after
+ * a bad page or a gap it resyncs on the next "OggS" capture pattern and
+ * drops the packet that was cut.
+ *
+ * Locks onto the first logical stream it sees. A page that begins a new
+ * stream (a chained stream, e.g. Icecast at the next track) switches to
+ * it; isStreamStart() then flags its first packet, which carries the codec
+ * header again.
+ *
+ * Packets that lie within one page are returned in place, packets that
+ * span pages are joined in a separate buffer. Both buffers are allocated
+ * in PSRAM on the device.
+ *
+ * Deliberately free of Arduino headers: the host benchmark
+ * (env:opus-bench) builds this file on its own.
+ */
+class OggDemuxer {
+public:
+    // Largest page: header, 255 lacing values, 255 segments of 255 bytes
+    static const size_t MAX_PAGE = 27 + 255 + 255 * 255;
+
+    // Largest packet joined across pages; longer ones are dropped
+    static const size_t MAX_PACKET = 16 * 1024;
+
+    // Reads up to len bytes, returns how many; 0 if nothing is available now
+    typedef size_t (*ReadFn)(void* context, uint8_t* data, size_t len);
+
+    enum class Result : uint8_t {
+        Packet,    // A packet is ready
+        NeedData,  // The read callback ran dry, call again later
+    };
+
+    OggDemuxer() = default;
+    ~OggDemuxer();
+
+    // Prevent copying and assignment
+    OggDemuxer(const OggDemuxer&) = delete;
+    OggDemuxer& operator=(const OggDemuxer&) = delete;
+
+    bool allocate();
+    void release();
+
+    /**
+     * @brief Forget the position, e.g. after the source jumped
+     * Resyncs at the next page and waits for the start of a stream again.
+     */
+    void reset();
+
+    /**
+     * @brief Get the next packet of the stream
+     * @param packet Receives the packet, valid until the next call
+     * @param len Receives its size in bytes
+     */
+    Result next(ReadFn read, void* context, const uint8_t** packet, size_t* len);
+
+    // The packet returned last is the first of a logical stream
+    bool isStreamStart() const { return streamStart; }
+
+    // Granule position of the page the last packet came from (48 kHz samples for Opus)
+    int64_t getGranule() const { return granule; }
+
+    // Pages dropped for a bad CRC or header, and bytes skipped to resync
+    uint32_t getBadPages() const { return badPages; }
+    uint32_t getSkippedBytes() const { return skippedBytes; }
+
+private:
+    static const size_t HEADER_BYTES = 27;
+
+    enum class Phase : uint8_t {
+        Header,    // Filling the fixed page header
+        Segments,  // Filling the lacing values
+        Body,      // Filling the segments
+        Packets    // Handing out the packets of a checked page
+    };
+
+    uint8_t* page = nullptr;
+    uint8_t* joined = nullptr;  // Packet spanning pages
+    size_t joinedLen = 0;
+    bool joining = false;       // joined holds the start of a packet
+    bool joinOverflow = false;  // The packet being joined was too long, drop it
+
+    Phase phase = Phase::Header;
+    size_t have = 0;            // Bytes of the page in the buffer
+    size_t pageLen = 0;         // Size of the page once the lacing values are in
+    size_t segment = 0;         // Next lacing value to hand out
+    size_t bodyPos = 0;         // Offset of that segment in the page
+
+    bool locked = false;        // serial is the stream followed
+    uint32_t serial = 0;
+    bool streamStart = false;
+    bool pageStartsStream = false;
+    int64_t granule = -1;
+
+    uint32_t badPages = 0;
+    uint32_t skippedBytes = 0;
+
+    bool fill(ReadFn read, void* context, size_t target);
+    void resync(size_t from);
+    bool checkPage();
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+
+/**
+ * @brief Downloads the newest episode of podcast feeds to the SD card overnight
+ *
+ * Once a night a background task reads each feed up to its newest item with
+ * a streaming parser (the rest of the feed is never downloaded) and fetches
+ * the enclosure to /podcasts/<feed>/ on the SD card. Downloads are written
+ * to a ".part" file and continue with a ranged request after a dropped
+ * connection or a reboot. Older episodes are pruned to stay within the
+ * storage quota; the newest episode of every feed is always kept.
+ *
+ * An alarm with a podcast source then plays a local file: no connect
+ * latency and no dependency on the network at wake-up. Downloads hold off
+ * while the busy check reports playback or an alarm about to start.
+ *
+ * getEpisode() and getStatus() may be called from any task.
+ */
+class PodcastPrefetcher {
+private:
+    static PodcastPrefetcher* instance;
+
+    PodcastPrefetcher() = default;
+
+    // Prevent copying and assignment
+    PodcastPrefetcher(const PodcastPrefetcher&) = delete;
+    PodcastPrefetcher& operator=(const PodcastPrefetcher&) = delete;
+
+public:
+    static PodcastPrefetcher& getInstance() {
+        if (!instance) {
+            instance = new PodcastPrefetcher();
+        }
+        return *instance;
+    }
+
+    // The newest downloaded episode of a feed
+    struct Episode {
+        String title;
+        String path;   // MP3 file on the SD card
+        uint32_t bytes;
+    };
+
+    // Download progress and storage use
+    struct Status {
+        bool fetching;
+        int8_t feed;           // Feed being fetched, -1 if none
+        uint32_t downloaded;   // Bytes of the episode on SD so far
+        int32_t total;         // Episode size, -1 if the server did not say
+        uint64_t usedBytes;    // Episodes on SD, partial downloads included
+        uint64_t quotaBytes;
+        uint32_t lastFetch;    // Epoch seconds of the last complete run, 0 if none
+    };
+
+    // True while downloads must wait, e.g. during playback
+    typedef bool (*BusyCheck)();
+
+    /**
+     * @brief Set the feeds to fetch; call before begin()
+     * @param urls RSS feed URLs, an alarm refers to a feed by its index
+     */
+    void setFeeds(const std::vector<String>& urls);
+
+    /**
+     * @brief Limit the SD space taken by episodes
+     * @param bytes Quota, the newest episode of each feed is kept regardless
+     */
+    void setQuota(uint64_t bytes) { quotaBytes = bytes; }
+
+    // Local hour the nightly fetch starts at
+    void setFetchHour(uint8_t hour) { fetchHour = hour % 24; }
+
+    void setBusyCheck(BusyCheck cb) { busyCheck = cb; }
+
+    /**
+     * @brief Load the episodes on SD and start the background task
+     */
+    void begin();
+
+    /**
+     * @brief Fetch all feeds now instead of waiting for the night
+     */
+    void fetchNow();
+
+    /**
+     * @brief Get the newest downloaded episode of a feed
+     * @param feed Index into the feed list
+     * @return false if nothing has been downloaded for the feed yet
+     */
+    bool getEpisode(size_t feed, Episode& episode);
+
+    Status getStatus();
+
+    size_t getFeedCount() const { return feeds.size(); }
+
+private:
+    struct Feed {
+        String url;
+        String dir;       // Directory of the feed's episodes
+        Episode episode;  // Newest complete download, empty path if none
+    };
+
+    // Newest item of a feed
+    struct Enclosure {
+        String url;
+        String title;
+        String type;
+        uint32_t length;  // Declared size, 0 if unknown
+    };
+
+    std::vector<Feed> feeds;
+    uint64_t quotaBytes = 512ULL * 1024 * 1024;
+    uint8_t fetchHour = 3;
+    BusyCheck busyCheck = nullptr;
+
+    TaskHandle_t taskHandle = nullptr;
+    SemaphoreHandle_t mutex = nullptr;  // Guards feeds[].episode and status
+    Status status = {};
+    int lastFetchDay = -1;  // Day of the year of the last complete run
+
+    static void prefetchTask(void* parameter);
+    bool isBusy() const { return busyCheck && busyCheck(); }
+    bool isFetchDue();
+    bool fetchAll();
+    bool fetchFeed(size_t index);
+    bool readNewestItem(const String& url, Enclosure& enclosure);
+    bool download(const String& url, const String& partPath);
+    void prune(const String& downloading, uint32_t room);
+    void loadEpisode(Feed& feed);
+    void saveEpisode(const Feed& feed);
+    static String hashName(const String& text);
+};
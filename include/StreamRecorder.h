@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+#include <atomic>
+#include "AlarmManager.h"
+#include "AudioRingBuffer.h"
+#include "AudioStreamReader.h"
+
+/**
+ * @brief Records radio shows to the SD card on a schedule
+ *
+ * A recording is scheduled like an alarm (time, weekdays and a station
+ * index, kept in an Alarm) plus a length in minutes. While it runs, the
+ * stream is copied as received, still compressed, into a PSRAM
+ * write-behind ring; a writer task drains the ring to /recordings in
+ * cluster-sized writes. The ring absorbs SD write latency spikes (FAT
+ * updates, wear levelling in the card), so they never hold up the
+ * network side.
+ *
+ * If the station is on air or being prepared for an alarm, the recording
+ * taps that connection instead of opening a second one. It dials its own
+ * connection when there is none, or when the player tunes elsewhere.
+ *
+ * Schedules are kept in /recordings.json. All methods may be called from
+ * any task.
+ */
+class StreamRecorder {
+private:
+    static StreamRecorder* instance;
+
+    StreamRecorder() = default;
+
+    // Prevent copying and assignment
+    StreamRecorder(const StreamRecorder&) = delete;
+    StreamRecorder& operator=(const StreamRecorder&) = delete;
+
+public:
+    static constexpr uint8_t MAX_SCHEDULES = 10;
+
+    static StreamRecorder& getInstance() {
+        if (!instance) {
+            instance = new StreamRecorder();
+        }
+        return *instance;
+    }
+
+    struct Schedule {
+        Alarm when;        // id, hour, minute, enabled, repeat and sourceData.stationIndex
+        uint16_t minutes;  // Length of the recording
+    };
+
+    struct Status {
+        bool recording;
+        bool shared;          // Taps the player's connection
+        uint8_t scheduleId;   // 0 for a recording started by hand
+        String path;          // File being written, or the last one
+        uint32_t bytes;       // Written to SD so far
+        uint32_t dropped;     // Lost because the ring was full
+        uint32_t remainingS;  // Until the recording stops
+        uint8_t bufferPercent;
+        uint32_t maxWriteMs;  // Slowest cluster write of the recording
+    };
+
+    // Station URL of a station index, false if there is none
+    typedef bool (*StationLookup)(uint8_t index, String& url);
+
+    void setStationLookup(StationLookup cb) { stationLookup = cb; }
+
+    /**
+     * @brief Size of the write-behind ring; call before begin()
+     * @param bytes Rounded up to a power of two, at least a few clusters
+     */
+    void setBufferSize(size_t bytes) { bufferBytes = bytes; }
+
+    /**
+     * @brief Load the schedules and start the recorder tasks
+     */
+    void begin();
+
+    /**
+     * @brief Record a station now
+     * @param url Station URL as configured
+     * @param minutes Length of the recording
+     * @return false if a recording is running already
+     */
+    bool start(const char* url, uint16_t minutes);
+
+    /**
+     * @brief End the running recording early, the buffered rest is written
+     */
+    void stop();
+
+    Status getStatus();
+
+    // Schedule management, same rules as for alarms
+    bool addSchedule(const Schedule& schedule);
+    bool updateSchedule(const Schedule& schedule);
+    bool removeSchedule(uint8_t id);
+    std::vector<Schedule> getSchedules();
+
+private:
+    // Work order from start() or a schedule to the recorder task
+    struct Request {
+        char url[256];
+        uint16_t minutes;
+        uint8_t scheduleId;
+    };
+
+    std::vector<Schedule> schedules;
+    StationLookup stationLookup = nullptr;
+    size_t bufferBytes = 512 * 1024;
+
+    TaskHandle_t recorderTaskHandle = nullptr;
+    TaskHandle_t writerTaskHandle = nullptr;
+    SemaphoreHandle_t mutex = nullptr;  // Guards schedules, request and status
+    Status status = {};
+    Request request = {};
+    bool requestPending = false;
+    std::atomic<bool> stopRequested{false};
+    int lastScheduleMinute = -1;  // Minute of the day the schedules were last checked
+
+    // Shared between the recorder task (producer) and the writer task (consumer)
+    AudioRingBuffer ring;
+    AudioStreamReader reader;  // Own connection, only touched by the recorder task
+    std::atomic<bool> writing{false};    // Writer owns the file of the recording
+    std::atomic<bool> finishing{false};  // Producer done, writer drains and closes
+    std::atomic<uint32_t> bytesWritten{0};
+    std::atomic<uint32_t> maxWriteMs{0};
+    char filePath[64] = "";
+
+    static void recorderTask(void* parameter);
+    static void writerTask(void* parameter);
+    void checkSchedules();
+    void record(const Request& job);
+    bool openOwnConnection(const char* url);
+    void drain(File& file, bool final);
+    void loadSchedules();
+    void saveSchedules();
+};
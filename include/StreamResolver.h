@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+/**
+ * @brief Resolves station URLs to the stream URL the decoder can play
+ *
+ * Station lists often point at a playlist (.m3u, .pls) or at a URL that
+ * answers with a redirect. HLS playlists are refused, the decoders only play
+ * continuous streams, not segments. The resolver follows
+ * redirects and playlists up to the actual audio stream and keeps the result
+ * per station URL in /stream_cache.json on the SD card, so tuning in costs no
+ * extra round trips. A cached URL is used until its TTL expires or a connect
+ * to it fails.
+ *
+ * All methods may be called from any task; they block while resolving, but
+ * the cache lock is not held across the network requests.
+ */
+class StreamResolver {
+private:
+    static StreamResolver* instance;
+
+    StreamResolver() = default;
+
+    // Prevent copying and assignment
+    StreamResolver(const StreamResolver&) = delete;
+    StreamResolver& operator=(const StreamResolver&) = delete;
+
+public:
+    static StreamResolver& getInstance() {
+        if (!instance) {
+            instance = new StreamResolver();
+        }
+        return *instance;
+    }
+
+    /**
+     * @brief Load the resolved-URL cache from SD
+     */
+    void begin();
+
+    /**
+     * @brief Set how long a resolved URL is trusted without a failure
+     * @param seconds Time to live, 0 to resolve on every tune
+     */
+    void setTtl(uint32_t seconds) { ttlSeconds = seconds; }
+
+    /**
+     * @brief Get the playable stream URL of a station URL
+     * @param url Station URL as configured
+     * @param resolved Receives the stream URL (the station URL itself if it
+     *        is a plain stream)
+     * @return false if the URL could not be resolved to a stream
+     */
+    bool resolve(const char* url, String& resolved);
+
+    /**
+     * @brief Report that the stream URL of a station failed to connect
+     * The next resolve() goes to the network again.
+     * @param url Station URL as configured
+     */
+    void reportFailure(const char* url);
+
+private:
+    struct Entry {
+        String url;
+        String resolved;
+        uint32_t resolvedAt;  // Epoch seconds, 0 if the clock was not set
+    };
+
+    std::vector<Entry> entries;
+    uint32_t ttlSeconds = 24 * 3600;
+    SemaphoreHandle_t mutex = nullptr;
+
+    bool isFresh(const Entry& entry, uint32_t now) const;
+    bool resolveNetwork(const String& url, String& resolved);
+    bool parsePlaylist(const String& body, const String& baseUrl, String& next);
+    static bool isPlaylist(const String& contentType, const String& url);
+    static String absoluteUrl(const String& base, const String& ref);
+    void loadCache();
+    void saveCache();
+};
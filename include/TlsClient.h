@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/**
+ * @brief HTTPS client that resumes TLS sessions, for use with HTTPClient
+ *
+ * Runs mbedTLS over a plain WiFiClient. Certificates are checked against
+ * the SD trust store of TlsManager, and the session of every completed
+ * handshake goes into its cache, so the next connection to the same server
+ * (a re-tune, a reconnect after a stall, the stream after its playlist)
+ * resumes the session instead of repeating the full handshake.
+ *
+ * Reads never block: available() and read() only hand out what has
+ * arrived, like WiFiClient, which AudioStreamReader::pump() relies on.
+ */
+class TlsClient : public WiFiClient {
+public:
+    TlsClient() = default;
+    virtual ~TlsClient() override;
+
+    // Prevent copying and assignment
+    TlsClient(const TlsClient&) = delete;
+    TlsClient& operator=(const TlsClient&) = delete;
+
+    virtual int connect(IPAddress ip, uint16_t port) override;
+    virtual int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+    virtual int connect(const char* host, uint16_t port) override;
+    virtual int connect(const char* host, uint16_t port, int32_t timeout) override;
+
+    virtual size_t write(uint8_t data) override { return write(&data, 1); }
+    virtual size_t write(const uint8_t* buf, size_t size) override;
+    virtual int available() override;
+    virtual int read() override;
+    virtual int read(uint8_t* buf, size_t size) override;
+    virtual int peek() override;
+    virtual void flush() override {}
+    virtual void stop() override;
+    virtual uint8_t connected() override;
+    virtual operator bool() override { return connected(); }
+
+    // The last handshake resumed a cached session
+    bool wasResumed() const { return resumed; }
+
+private:
+    static const int32_t DEFAULT_TIMEOUT_MS = 5000;
+
+    struct Context;  // mbedTLS state, only allocated while connected
+
+    WiFiClient tcp;
+    Context* tls = nullptr;
+    int peeked = -1;  // Byte taken by peek(), -1 if none
+    bool closed = false;  // The server sent close_notify
+    bool resumed = false;
+
+    bool handshake(const char* host, uint16_t port, int32_t timeout);
+    int pull();
+    static int sendCallback(void* context, const unsigned char* buf, size_t len);
+    static int recvCallback(void* context, unsigned char* buf, size_t len);
+};
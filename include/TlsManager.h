@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Arduino.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+// The CA bundle compiled into the core covers an empty SD trust store
+#if defined(CONFIG_MBEDTLS_CERTIFICATE_BUNDLE) && __has_include(<esp_crt_bundle.h>)
+#define TLS_HAVE_CRT_BUNDLE 1
+#else
+#define TLS_HAVE_CRT_BUNDLE 0
+#endif
+
+/**
+ * @brief Trust store and TLS session cache shared by all TlsClient connections
+ *
+ * The trust store is every certificate (PEM or DER, bundles allowed) in a
+ * directory on the SD card, loaded once at boot. Without any, servers are
+ * checked against the CA bundle built into the core; a build without that
+ * bundle connects unchecked, as podcast downloads always did. Sessions are cached per
+ * host and port in PSRAM, serialized, so a reconnect or a re-tune to the
+ * same server resumes with a session ticket or ID: one round trip instead
+ * of a full handshake with its certificate chain and key exchange.
+ *
+ * Sessions and statistics may be used from any task; begin() runs before
+ * the first connection.
+ */
+class TlsManager {
+private:
+    static TlsManager* instance;
+
+    TlsManager() = default;
+
+    // Prevent copying and assignment
+    TlsManager(const TlsManager&) = delete;
+    TlsManager& operator=(const TlsManager&) = delete;
+
+public:
+    static constexpr uint8_t MAX_SESSIONS = 8;
+
+    static TlsManager& getInstance() {
+        if (!instance) {
+            instance = new TlsManager();
+        }
+        return *instance;
+    }
+
+    struct Status {
+        bool verify;
+        uint16_t certificates;  // In the trust store
+        bool builtinBundle;     // Checked against the core's CA bundle instead
+        uint8_t sessions;       // Cached
+        uint32_t fullHandshakes;
+        uint32_t resumedHandshakes;
+        uint32_t fullAvgMs;
+        uint32_t resumedAvgMs;
+        uint32_t failures;
+    };
+
+    /**
+     * @brief Load the trust store
+     * @param dir Directory on the SD card with .pem, .crt or .cer files
+     * @param verify Check server certificates against the store; without
+     *        it connections are encrypted but not authenticated
+     */
+    void begin(const char* dir, bool verify);
+
+    /**
+     * @brief Set up the certificate checks of a new connection
+     * @return false if the certificate checks could not be set up
+     */
+    bool configure(mbedtls_ssl_config* conf);
+
+    /**
+     * @brief Offer the cached session of a server for resumption
+     * Call between mbedtls_ssl_setup() and the handshake.
+     * @return true if a session was offered
+     */
+    bool restoreSession(const char* host, uint16_t port, mbedtls_ssl_context* ssl);
+
+    // Keep the session of a completed handshake
+    void saveSession(const char* host, uint16_t port, const mbedtls_ssl_context* ssl);
+
+    // Drop the session of a server, e.g. after a failed resumption
+    void forgetSession(const char* host, uint16_t port);
+
+    // Handshake statistics
+    void recordHandshake(bool resumed, uint32_t ms);
+    void recordFailure();
+
+    Status getStatus();
+
+private:
+    struct Session {
+        char host[64];
+        uint16_t port;
+        uint8_t* data;  // mbedtls_ssl_session_save() output, in PSRAM
+        size_t len;
+        uint32_t savedMs;
+        uint32_t usedMs;
+    };
+
+    mbedtls_x509_crt trustStore;
+    bool storeReady = false;
+    uint16_t certificates = 0;
+    bool verify = true;
+
+    SemaphoreHandle_t mutex = nullptr;  // Guards sessions and statistics
+    Session sessions[MAX_SESSIONS] = {};
+    uint32_t fullHandshakes = 0;
+    uint32_t resumedHandshakes = 0;
+    uint64_t fullMs = 0;
+    uint64_t resumedMs = 0;
+    uint32_t failures = 0;
+
+    Session* findSession(const char* host, uint16_t port);
+    void loadFile(const char* path);
+};
@@ -164,6 +164,20 @@ public:
      */
     void updateWifiQuality(int quality);
     
+    /**
+     * @brief Update the "now playing" labels on the home and radio screens
+     * @param artist Artist of the current stream title (may be empty)
+     * @param title Title, empty hides the labels
+     */
+    void updateNowPlaying(const char* artist, const char* title);
+    
+    /**
+     * @brief Show or hide the spectrum visualizer on the radio screen
+     * It runs only while the radio screen is visible and audio plays, and
+     * pauses itself while the stream buffer is low.
+     */
+    void setSpectrumEnabled(bool enabled);
+    
     // Callback types
     typedef void (*AlarmCallback)(bool enabled, uint8_t hour, uint8_t minute, bool days[7]);
     typedef void (*VolumeCallback)(uint8_t volume);
@@ -180,12 +194,14 @@ public:
     void showAlarmSettingsScreen();
     void showRadioScreen();
     void showSettingsScreen();
+    void showDiagnosticsScreen();
     
     // LVGL screen objects - made public for direct access from lambda functions
     lv_obj_t* homeScreen = nullptr;
     lv_obj_t* alarmSettingsScreen = nullptr;
     lv_obj_t* radioScreen = nullptr;
     lv_obj_t* settingsScreen = nullptr;
+    lv_obj_t* diagnosticsScreen = nullptr;
     lv_obj_t* settingsBackArea = nullptr; // Transparent back area at the top of settings screen
     lv_obj_t* alarmScreen = nullptr;
     lv_obj_t* currentScreen = nullptr; // Currently active screen
@@ -199,6 +215,7 @@ private:
     void createAlarmSettingsScreen();
     void createRadioScreen();
     void createSettingsScreen();
+    void createDiagnosticsScreen();
     
     // Home screen elements
     lv_obj_t* timeLabel = nullptr;
@@ -213,6 +230,31 @@ private:
     lv_obj_t* eco2Label = nullptr;
     lv_obj_t* ipAddressLabel = nullptr;
     lv_obj_t* currentAlarmScreen = nullptr;
+    lv_obj_t* nowPlayingLabel = nullptr;
+    
+    // Radio screen elements
+    lv_obj_t* radioArtistLabel = nullptr;
+    lv_obj_t* radioTitleLabel = nullptr;
+    lv_obj_t* timeshiftPauseLabel = nullptr;  // Pause/play symbol
+    lv_obj_t* timeshiftDelayLabel = nullptr;  // "LIVE" or the time behind live
+    lv_timer_t* timeshiftTimer = nullptr;
+    
+    // Spectrum visualizer: bars drawn straight into the canvas buffer
+    static const size_t SPECTRUM_BARS = 16;
+    lv_obj_t* spectrumCanvas = nullptr;
+    lv_color_t* spectrumBuffer = nullptr;      // In PSRAM
+    lv_timer_t* spectrumTimer = nullptr;
+    uint8_t spectrumDrawn[SPECTRUM_BARS] = {};  // Bar heights on screen, in pixels
+    bool spectrumEnabled = true;
+    bool spectrumSuspended = false;            // Backed off for a low stream buffer
+    uint32_t spectrumHealthySince = 0;         // Buffer fine again since, 0 while low
+    void drawSpectrum(const uint8_t* bars);
+    
+    // Audio diagnostics screen elements
+    lv_obj_t* diagnosticsLabel = nullptr;
+    lv_obj_t* diagnosticsChart = nullptr;       // Jitter buffer fill histogram
+    lv_chart_series_t* diagnosticsSeries = nullptr;
+    lv_timer_t* diagnosticsTimer = nullptr;
     
     // Weather panel elements
     lv_obj_t* weatherPanel = nullptr;
@@ -295,6 +337,12 @@ public:
     static void alarm_toggle_cb(lv_event_t* e);
     static void volume_changed_cb(lv_event_t* e);
     static void radio_volume_changed_cb(lv_event_t* e);
+    static void timeshift_back_cb(lv_event_t* e);
+    static void timeshift_pause_cb(lv_event_t* e);
+    static void timeshift_live_cb(lv_event_t* e);
+    static void timeshift_timer_cb(lv_timer_t* timer);
+    static void spectrum_timer_cb(lv_timer_t* timer);
+    static void diagnostics_timer_cb(lv_timer_t* timer);
     static void brightness_changed_cb(lv_event_t* e);
     static void back_btn_clicked_cb(lv_event_t* e);
     static void theme_switch_cb(lv_event_t* e);
@@ -307,6 +355,7 @@ public:
     static void alarm_btn_clicked_cb(lv_event_t* e);
     static void radio_btn_clicked_cb(lv_event_t* e);
     static void weather_btn_clicked_cb(lv_event_t* e);
+    static void diagnostics_btn_clicked_cb(lv_event_t* e);
 };
 
 // Static member will be defined in the cpp file
@@ -6,6 +6,7 @@
 #include <TimeLib.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include <sys/time.h>
 
 // SD Card CS pin - defined in platformio.ini
 
@@ -86,7 +87,8 @@ void Alarm::getNextTriggerTime(struct tm& timeInfo) const {
 // AlarmManager implementation
 void AlarmManager::begin() {
     loadAlarms();
-    configTzTime("CET-1CEST,M3.5.0,M10.5.0/3", "pool.ntp.org", "time.nist.gov");
+    
+    // NTP server and time zone are configured by time_init() from the config
     
     // Wait for time sync (non-blocking, will check in update())
     timeSet = false;
@@ -131,6 +133,14 @@ void AlarmManager::update() {
     }
 }
 
+uint32_t AlarmManager::msToNextSecond() const {
+    // A few ms past the boundary, so time() has surely moved on by then
+    static const uint32_t BOUNDARY_MARGIN_MS = 5;
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return 1000 - tv.tv_usec / 1000 + BOUNDARY_MARGIN_MS;
+}
+
 bool AlarmManager::addAlarm(const Alarm& alarm) {
     if (alarms.size() >= MAX_ALARMS) {
         return false;
@@ -231,6 +241,10 @@ void AlarmManager::checkAlarms() {
         return;
     }
     
+    time_t now;
+    time(&now);
+    checkPreflight(now);
+    
     // Check each alarm
     for (const auto& alarm : alarms) {
         if (alarm.shouldTrigger(timeinfo)) {
@@ -241,6 +255,7 @@ void AlarmManager::checkAlarms() {
             if (currentMinute != lastTriggerMinute) {
                 lastTriggerMinute = currentMinute;
                 lastTriggeredAlarmId = alarm.id;
+                preflightTime = 0;
                 
                 if (triggerCallback) {
                     triggerCallback(alarm);
@@ -251,6 +266,43 @@ void AlarmManager::checkAlarms() {
     }
 }
 
+void AlarmManager::checkPreflight(time_t now) {
+    if (!preflightCallback || preflightLead == 0) {
+        return;
+    }
+    
+    // Forget a pre-flight whose alarm was disabled or removed meanwhile
+    if (preflightTime != 0 && now > preflightTime + 60) {
+        preflightTime = 0;
+    }
+    
+    // Find the alarm that triggers next
+    const Alarm* nextAlarm = nullptr;
+    time_t nextTime = 0;
+    for (const auto& alarm : alarms) {
+        if (!alarm.enabled) {
+            continue;
+        }
+        struct tm next;
+        alarm.getNextTriggerTime(next);
+        time_t triggerTime = mktime(&next);
+        if (!nextAlarm || triggerTime < nextTime) {
+            nextAlarm = &alarm;
+            nextTime = triggerTime;
+        }
+    }
+    
+    if (!nextAlarm || nextTime == preflightTime) {
+        return;
+    }
+    
+    if (nextTime > now && nextTime - now <= preflightLead) {
+        preflightTime = nextTime;
+        Serial.printf("Alarm %d pre-flight, triggers in %ld s\n", nextAlarm->id, (long)(nextTime - now));
+        preflightCallback(*nextAlarm);
+    }
+}
+
 void AlarmManager::loadAlarms() {
     // Initialize SD card if not already done
     if (!SD.begin(SD_CS)) {
@@ -298,9 +350,15 @@ void AlarmManager::loadAlarms() {
         
         alarm.volume = alarmObj["volume"];
         alarm.source = alarmObj["source"];
+        alarm.fadeIn = alarmObj["fade_in"] | 0;
+        alarm.fadeCurve = alarmObj["fade_curve"] | 0;
         
         if (alarm.source == 0) { // Radio
             alarm.sourceData.stationIndex = alarmObj["stationIndex"];
+        } else if (alarm.source == 2) { // Podcast
+            alarm.sourceData.feedIndex = alarmObj["feedIndex"];
+        } else if (alarm.source == 3) { // Tone
+            alarm.sourceData.tonePattern = alarmObj["tonePattern"];
         } else { // MP3
             strncpy(alarm.sourceData.filepath, alarmObj["filepath"], sizeof(alarm.sourceData.filepath) - 1);
         }
@@ -352,10 +410,16 @@ void AlarmManager::saveAlarms() {
         
         alarmObj["volume"] = alarm.volume;
         alarmObj["source"] = alarm.source;
+        alarmObj["fade_in"] = alarm.fadeIn;
+        alarmObj["fade_curve"] = alarm.fadeCurve;
         
         // Add source-specific data
         if (alarm.source == 0) {
             alarmObj["stationIndex"] = alarm.sourceData.stationIndex;
+        } else if (alarm.source == 2) {
+            alarmObj["feedIndex"] = alarm.sourceData.feedIndex;
+        } else if (alarm.source == 3) {
+            alarmObj["tonePattern"] = alarm.sourceData.tonePattern;
         } else {
             alarmObj["filepath"] = alarm.sourceData.filepath;
         }
@@ -0,0 +1,109 @@
+#include "AudioBitrateSelector.h"
+
+// Step down when the buffer is below this share of its depth while the
+// link delivers less than the stream rate plus a margin (in percent)
+static const uint32_t DOWN_FILL_PERCENT = 50;
+static const uint32_t DOWN_RATE_PERCENT = 110;
+static const uint32_t DOWN_HOLD_MS = 3000;
+
+// A lower variant is picked only if the link carries it with this margin
+static const uint32_t SUSTAIN_PERCENT = 125;
+
+// Step up once the buffer stayed this full for the hold time; the hold
+// doubles after a step up that failed or did not last. The arrival rate says
+// nothing here: a live server paces delivery at the variant on air.
+static const uint32_t UP_FILL_PERCENT = 90;
+static const uint32_t UP_HOLD_MIN_MS = 20000;
+static const uint32_t UP_HOLD_MAX_MS = 300000;
+
+void AudioBitrateSelector::reset(const uint16_t* kbps, size_t count, size_t current) {
+    this->count = min(count, MAX_VARIANTS);
+    memcpy(this->kbps, kbps, this->count * sizeof(uint16_t));
+    this->current = min(current, this->count ? this->count - 1 : 0);
+    underrunsKnown = false;
+    draining = false;
+    healthy = false;
+    upHoldMs = UP_HOLD_MIN_MS;
+    lastUpMs = 0;
+    steppedUp = false;
+}
+
+int AudioBitrateSelector::update(const Health& health, uint32_t now) {
+    if (count < 2 || health.target == 0) {
+        return -1;
+    }
+
+    bool underrun = underrunsKnown && health.underruns != lastUnderruns;
+    lastUnderruns = health.underruns;
+    underrunsKnown = true;
+
+    // Draining: low buffer and a link that falls short of the stream rate
+    uint64_t rate = bytesPerSecond(kbps[current]);
+    bool low = (uint64_t)health.fill * 100 < (uint64_t)health.target * DOWN_FILL_PERCENT;
+    bool slow = health.throughput > 0 && (uint64_t)health.throughput * 100 < rate * DOWN_RATE_PERCENT;
+    if (low && slow) {
+        if (!draining) {
+            draining = true;
+            drainingSince = now;
+        }
+    } else {
+        draining = false;
+    }
+
+    if (current > 0 && (underrun || (draining && now - drainingSince >= DOWN_HOLD_MS))) {
+        // A step up that did not last makes the next one wait longer
+        if (steppedUp && now - lastUpMs < upHoldMs) {
+            upHoldMs = min(upHoldMs * 2, UP_HOLD_MAX_MS);
+        }
+        steppedUp = false;
+        draining = false;
+        healthy = false;
+
+        int next = fastestSustainable(health.throughput);
+        if (next < 0 || (size_t)next >= current) {
+            next = current - 1;
+        }
+        return next;
+    }
+
+    bool full = (uint64_t)health.fill * 100 >= (uint64_t)health.target * UP_FILL_PERCENT;
+    if (!full || underrun) {
+        healthy = false;
+        return -1;
+    }
+    if (!healthy) {
+        healthy = true;
+        healthySince = now;
+    }
+    if (current + 1 < count && now - healthySince >= upHoldMs) {
+        healthy = false;
+        return current + 1;
+    }
+    return -1;
+}
+
+void AudioBitrateSelector::onSwitched(size_t variant, uint32_t now) {
+    steppedUp = variant > current;
+    if (steppedUp) {
+        lastUpMs = now;
+    }
+    current = min(variant, count ? count - 1 : 0);
+    underrunsKnown = false;  // The counter belongs to the new connection
+    draining = false;
+    healthy = false;
+}
+
+void AudioBitrateSelector::onSwitchFailed() {
+    upHoldMs = min(upHoldMs * 2, UP_HOLD_MAX_MS);
+    draining = false;
+    healthy = false;
+}
+
+int AudioBitrateSelector::fastestSustainable(uint32_t throughput) const {
+    for (int i = (int)count - 1; i >= 0; i--) {
+        if ((uint64_t)bytesPerSecond(kbps[i]) * SUSTAIN_PERCENT <= (uint64_t)throughput * 100) {
+            return i;
+        }
+    }
+    return -1;
+}
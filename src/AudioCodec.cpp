@@ -0,0 +1,156 @@
+#include "AudioCodec.h"
+
+namespace AudioCodec {
+
+const char* name(StreamCodec codec) {
+    switch (codec) {
+        case StreamCodec::MP3: return "mp3";
+        case StreamCodec::AAC: return "aac";
+        case StreamCodec::Opus: return "opus";
+        default: return "";
+    }
+}
+
+StreamCodec fromName(const char* name) {
+    if (!name) {
+        return StreamCodec::Unknown;
+    }
+    if (strcasecmp(name, "mp3") == 0) {
+        return StreamCodec::MP3;
+    }
+    if (strcasecmp(name, "aac") == 0) {
+        return StreamCodec::AAC;
+    }
+    if (strcasecmp(name, "opus") == 0) {
+        return StreamCodec::Opus;
+    }
+    return StreamCodec::Unknown;
+}
+
+uint32_t frameSamples(StreamCodec codec) {
+    switch (codec) {
+        case StreamCodec::AAC: return 1024;
+        case StreamCodec::Opus: return 960;
+        case StreamCodec::MP3:
+        default: return 1152;
+    }
+}
+
+// The media type is exactly type: audio/mpeg must not match audio/mpegurl,
+// a playlist. Parameters such as charset are ignored.
+static bool isMediaType(const char* contentType, const char* type) {
+    size_t len = strlen(type);
+    if (strncasecmp(contentType, type, len) != 0) {
+        return false;
+    }
+    char next = contentType[len];
+    return next == '\0' || next == ';' || next == ' ' || next == '\t';
+}
+
+StreamCodec fromContentType(const char* contentType) {
+    if (!contentType) {
+        return StreamCodec::Unknown;
+    }
+
+    if (isMediaType(contentType, "audio/mpeg") ||
+        isMediaType(contentType, "audio/mp3")) {
+        return StreamCodec::MP3;
+    }
+    if (isMediaType(contentType, "audio/aac") ||
+        isMediaType(contentType, "audio/aacp") ||
+        isMediaType(contentType, "audio/x-aac")) {
+        return StreamCodec::AAC;
+    }
+    // Opus is the only Ogg codec decoded, the decoder reports Vorbis
+    if (isMediaType(contentType, "audio/ogg") ||
+        isMediaType(contentType, "audio/opus") ||
+        isMediaType(contentType, "application/ogg")) {
+        return StreamCodec::Opus;
+    }
+    return StreamCodec::Unknown;
+}
+
+// ADTS header: 12 bit sync, layer 00, 13 bit frame length
+static bool isAdtsHeader(const uint8_t* p) {
+    return p[0] == 0xFF && (p[1] & 0xF6) == 0xF0;
+}
+
+static size_t adtsFrameLength(const uint8_t* p) {
+    return ((size_t)(p[3] & 0x03) << 11) | ((size_t)p[4] << 3) | (p[5] >> 5);
+}
+
+// MPEG audio header: 11 bit sync, layer not reserved, valid bitrate and rate
+static bool isMpegHeader(const uint8_t* p) {
+    return p[0] == 0xFF && (p[1] & 0xE0) == 0xE0 &&
+           (p[1] & 0x06) != 0 &&          // Layer
+           (p[2] & 0xF0) != 0xF0 &&       // Bitrate index
+           (p[2] & 0x0C) != 0x0C;         // Sample rate index
+}
+
+bool parseFrameHeader(const uint8_t* p, FrameHeader& header) {
+    if (isAdtsHeader(p)) {
+        static const uint32_t ADTS_RATES[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                              22050, 16000, 12000, 11025, 8000, 7350};
+        uint8_t rateIndex = (p[2] >> 2) & 0x0F;
+        header.length = adtsFrameLength(p);
+        if (rateIndex >= sizeof(ADTS_RATES) / sizeof(ADTS_RATES[0]) || header.length < 7) {
+            return false;
+        }
+        header.sampleRate = ADTS_RATES[rateIndex];
+        header.samples = 1024 * ((p[6] & 0x03) + 1);  // Raw data blocks in the frame
+        return true;
+    }
+
+    // Layer III only, version 01 is reserved
+    uint8_t version = (p[1] >> 3) & 0x03;  // 3: MPEG-1, 2: MPEG-2, 0: MPEG-2.5
+    uint8_t layer = (p[1] >> 1) & 0x03;
+    if (!isMpegHeader(p) || version == 1 || layer != 1 || (p[2] & 0xF0) == 0) {
+        return false;
+    }
+    static const uint16_t KBPS_V1[] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+    static const uint16_t KBPS_V2[] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+    static const uint32_t RATES[] = {44100, 48000, 32000};
+    bool mpeg1 = version == 3;
+    uint32_t kbps = mpeg1 ? KBPS_V1[p[2] >> 4] : KBPS_V2[p[2] >> 4];
+    header.sampleRate = RATES[(p[2] >> 2) & 0x03] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+    header.samples = mpeg1 ? 1152 : 576;
+    header.length = (mpeg1 ? 144000 : 72000) * kbps / header.sampleRate + ((p[2] >> 1) & 0x01);
+    return true;
+}
+
+StreamCodec fromFrameSync(const uint8_t* data, size_t len) {
+    if (!data || len < 10) {
+        return StreamCodec::Unknown;
+    }
+
+    if (memcmp(data, "ID3", 3) == 0) {
+        return StreamCodec::MP3;
+    }
+
+    // Ogg capture pattern, version 0. Servers start a stream on a page
+    // boundary, so it sits right at the start.
+    if (memcmp(data, "OggS", 4) == 0 && data[4] == 0) {
+        return StreamCodec::Opus;
+    }
+
+    for (size_t i = 0; i + 7 <= len; i++) {
+        if (data[i] != 0xFF) {
+            continue;
+        }
+
+        // ADTS and MPEG share the first sync bits: require a second ADTS
+        // header right behind the first to tell them apart
+        if (isAdtsHeader(data + i)) {
+            size_t frame = adtsFrameLength(data + i);
+            if (frame >= 7 && i + frame + 2 <= len && isAdtsHeader(data + i + frame)) {
+                return StreamCodec::AAC;
+            }
+        }
+        if (isMpegHeader(data + i)) {
+            return StreamCodec::MP3;
+        }
+    }
+    return StreamCodec::Unknown;
+}
+
+}  // namespace AudioCodec
@@ -0,0 +1,422 @@
+#include "AudioDecoder.h"
+#include "AudioGeneratorMP3.h"
+#include "AudioGeneratorMP3a.h"
+#include "AudioGeneratorAAC.h"
+#include "AudioGeneratorWAV.h"
+#include "AudioGeneratorOggOpus.h"
+#include "AudioFileSourcePROGMEM.h"
+#include "AudioFileSourceSD.h"
+#include "AudioOutput.h"
+#include <SD.h>
+
+// Benchmark task, roomy enough that the high water mark shows the real need
+// even where it exceeds AudioDecoder::TASK_STACK
+static const uint32_t BENCH_TASK_STACK = 24576;
+static const UBaseType_t BENCH_TASK_PRIORITY = 1;
+static const BaseType_t BENCH_TASK_CORE = 1;
+
+// Reference files are loaded into PSRAM whole
+static const size_t BENCH_MAX_FILE = 4 * 1024 * 1024;
+
+// Clip decode task, libmad needs more stack than the loop task has
+static const uint32_t CLIP_TASK_STACK = AudioDecoder::TASK_STACK;
+static const UBaseType_t CLIP_TASK_PRIORITY = 1;
+
+// First allocation of a clip buffer, doubled as the clip grows
+static const uint32_t CLIP_INITIAL_FRAMES = 16384;
+
+namespace {
+
+/**
+ * @brief Output that drops every sample
+ * Refuses one sample per 1152 (an MPEG-1 frame) so loop() returns after each frame and
+ * the heap can be sampled; the decoder retries the refused sample.
+ */
+class BenchSink : public AudioOutput {
+public:
+    virtual bool begin() override { return true; }
+    virtual bool stop() override { return true; }
+
+    virtual bool ConsumeSample(int16_t sample[2]) override {
+        if (paused) {
+            paused = false;
+        } else if (sinceYield >= 1152) {
+            sinceYield = 0;
+            paused = true;
+            return false;
+        }
+        sinceYield++;
+        samples++;
+        return true;
+    }
+
+    uint32_t getSamples() const { return samples; }
+    int getRate() const { return hertz; }
+
+private:
+    uint32_t samples = 0;
+    uint32_t sinceYield = 0;
+    bool paused = false;
+};
+
+struct BenchRun {
+    // Input
+    const uint8_t* data;
+    size_t len;
+    StreamCodec codec;
+    Mp3Backend backend;
+    TaskHandle_t caller;
+
+    // Results
+    bool ok;
+    uint32_t decodeUs;
+    uint32_t frames;   // MPEG frames or Opus packets
+    uint32_t samples;  // Per channel
+    uint32_t rate;
+    size_t heapBytes;   // Internal RAM held by the decoder at its peak
+    size_t psramBytes;  // PSRAM held by the decoder at its peak
+    size_t stackBytes;  // Stack the decode task needed
+};
+
+struct BenchTotals {
+    uint64_t decodeUs = 0;
+    uint64_t audioUs = 0;
+    uint32_t frames = 0;
+    size_t heapBytes = 0;
+    size_t psramBytes = 0;
+    size_t stackBytes = 0;
+};
+
+void benchTask(void* parameter) {
+    BenchRun* run = static_cast<BenchRun*>(parameter);
+    BenchSink sink;
+    AudioFileSourcePROGMEM source(run->data, run->len);
+
+    size_t heapBefore = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psramBefore = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t heapLow = heapBefore;
+    size_t psramLow = psramBefore;
+
+    AudioGenerator* decoder = AudioDecoder::create(run->codec, run->backend);
+    run->ok = decoder->begin(&source, &sink);
+    run->decodeUs = 0;
+    while (run->ok) {
+        heapLow = min(heapLow, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+        psramLow = min(psramLow, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        uint32_t start = micros();
+        bool running = decoder->loop();
+        run->decodeUs += micros() - start;
+        if (!running) {
+            break;
+        }
+    }
+    decoder->stop();
+
+    // MPEG-1 frames carry 1152 samples, MPEG-2/2.5 (below 32 kHz) 576;
+    // Opus packets vary, the decoder counts them
+    run->rate = sink.getRate();
+    run->samples = sink.getSamples();
+    if (run->codec == StreamCodec::Opus) {
+        run->frames = static_cast<AudioGeneratorOggOpus*>(decoder)->getPackets();
+    } else {
+        run->frames = run->samples / (run->rate >= 32000 ? 1152 : 576);
+    }
+    delete decoder;
+    run->heapBytes = heapBefore - heapLow;
+    run->psramBytes = psramBefore - psramLow;
+    run->stackBytes = BENCH_TASK_STACK - uxTaskGetStackHighWaterMark(nullptr);
+
+    xTaskNotifyGive(run->caller);
+    vTaskDelete(nullptr);
+}
+
+bool runBench(BenchRun& run) {
+    run.caller = xTaskGetCurrentTaskHandle();
+    run.ok = false;
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        benchTask,            // Task function
+        "AudioDecoderBench",  // Task name for debugging
+        BENCH_TASK_STACK,     // Stack size
+        &run,                 // Task parameters
+        BENCH_TASK_PRIORITY,  // Task priority
+        nullptr,              // Task handle
+        BENCH_TASK_CORE       // Core to run the task on
+    );
+    if (created != pdPASS) {
+        Serial.println("[ERROR] Failed to create decoder benchmark task");
+        return false;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return run.ok;
+}
+
+/**
+ * @brief Output that collects the decoded samples of a clip in PSRAM
+ */
+class ClipSink : public AudioOutput {
+public:
+    virtual bool begin() override { return true; }
+    virtual bool stop() override { return true; }
+
+    virtual bool ConsumeSample(int16_t sample[2]) override {
+        if (frames == capacity && !grow()) {
+            return true;  // Too long or out of PSRAM: the rest is dropped
+        }
+        samples[frames++] = (int16_t)(((int32_t)sample[0] + sample[1]) / 2);
+        return true;
+    }
+
+    // Hands the buffer over, shrunk to the decoded length
+    bool take(PcmClip& clip) {
+        if (frames == 0 || hertz <= 0) {
+            return false;
+        }
+        int16_t* fitted = (int16_t*)heap_caps_realloc(samples, frames * sizeof(int16_t),
+                                                       MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        clip.samples = fitted ? fitted : samples;
+        clip.frames = frames;
+        clip.rate = hertz;
+        samples = nullptr;
+        frames = capacity = 0;
+        return true;
+    }
+
+    bool isTruncated() const { return truncated; }
+
+    ~ClipSink() { heap_caps_free(samples); }
+
+private:
+    int16_t* samples = nullptr;
+    uint32_t frames = 0;
+    uint32_t capacity = 0;
+    bool truncated = false;
+
+    bool grow() {
+        // The rate is known from the first sample on
+        uint32_t limit = (hertz > 0 ? hertz : 48000) * AudioDecoder::MAX_CLIP_SECONDS;
+        uint32_t next = min(limit, capacity ? capacity * 2 : CLIP_INITIAL_FRAMES);
+        if (next <= capacity) {
+            truncated = true;
+            return false;
+        }
+        int16_t* grown = (int16_t*)heap_caps_realloc(samples, next * sizeof(int16_t),
+                                                      MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!grown) {
+            truncated = true;
+            return false;
+        }
+        samples = grown;
+        capacity = next;
+        return true;
+    }
+};
+
+struct ClipRun {
+    const char* path;
+    Mp3Backend backend;
+    PcmClip* clip;
+    TaskHandle_t caller;
+    bool ok;
+};
+
+void clipTask(void* parameter) {
+    ClipRun* run = static_cast<ClipRun*>(parameter);
+    String name = run->path;
+    name.toLowerCase();
+
+    {
+        ClipSink sink;
+        AudioFileSourceSD source(run->path);
+        AudioGenerator* decoder = name.endsWith(".wav")
+            ? static_cast<AudioGenerator*>(new AudioGeneratorWAV())
+            : AudioDecoder::create(StreamCodec::MP3, run->backend);
+        if (source.isOpen() && decoder->begin(&source, &sink)) {
+            while (decoder->loop()) {
+            }
+            decoder->stop();
+            run->ok = sink.take(*run->clip);
+            if (sink.isTruncated()) {
+                Serial.printf("[AUDIO] Clip %s cut to %u s\n", run->path, AudioDecoder::MAX_CLIP_SECONDS);
+            }
+        }
+        delete decoder;
+    }
+
+    xTaskNotifyGive(run->caller);
+    vTaskDelete(nullptr);
+}
+
+}  // namespace
+
+namespace AudioDecoder {
+
+AudioGenerator* create(StreamCodec codec, Mp3Backend mp3) {
+    if (codec == StreamCodec::AAC) {
+        return new AudioGeneratorAAC();
+    }
+    if (codec == StreamCodec::Opus) {
+        return new AudioGeneratorOggOpus();
+    }
+    if (mp3 == Mp3Backend::Helix) {
+        return new AudioGeneratorMP3a();
+    }
+    return new AudioGeneratorMP3();
+}
+
+const char* name(Mp3Backend backend) {
+    switch (backend) {
+        case Mp3Backend::Helix: return "helix";
+        case Mp3Backend::Libmad:
+        default: return "libmad";
+    }
+}
+
+Mp3Backend fromName(const char* name) {
+    if (name && strcasecmp(name, "helix") == 0) {
+        return Mp3Backend::Helix;
+    }
+    if (name && strcasecmp(name, "libmad") == 0) {
+        return Mp3Backend::Libmad;
+    }
+    return AUDIO_MP3_DEFAULT_BACKEND;
+}
+
+void benchmark(const char* dir) {
+    File root = SD.open(dir);
+    if (!root || !root.isDirectory()) {
+        Serial.printf("[ERROR] Decoder benchmark: no directory %s\n", dir);
+        return;
+    }
+
+    // MP3 files run on both backends, Ogg files on the Opus decoder
+    struct Candidate {
+        const char* label;
+        StreamCodec codec;
+        Mp3Backend backend;
+    };
+    const Candidate candidates[] = {
+        {"libmad", StreamCodec::MP3, Mp3Backend::Libmad},
+        {"helix", StreamCodec::MP3, Mp3Backend::Helix},
+        {"opus", StreamCodec::Opus, AUDIO_MP3_DEFAULT_BACKEND},
+    };
+    const size_t count = sizeof(candidates) / sizeof(candidates[0]);
+    BenchTotals totals[count];
+
+    for (File file = root.openNextFile(); file; file = root.openNextFile()) {
+        String fileName = file.name();
+        fileName.toLowerCase();
+        StreamCodec codec = fileName.endsWith(".mp3") ? StreamCodec::MP3
+                          : fileName.endsWith(".opus") || fileName.endsWith(".ogg") ? StreamCodec::Opus
+                          : StreamCodec::Unknown;
+        if (file.isDirectory() || codec == StreamCodec::Unknown) {
+            file.close();
+            continue;
+        }
+        size_t len = file.size();
+        if (len == 0 || len > BENCH_MAX_FILE) {
+            Serial.printf("[AUDIO] Decoder benchmark: skipping %s (%u bytes)\n", file.name(), (unsigned)len);
+            file.close();
+            continue;
+        }
+
+        uint8_t* data = (uint8_t*)ps_malloc(len);
+        if (!data) {
+            Serial.printf("[ERROR] Decoder benchmark: no PSRAM for %s\n", file.name());
+            file.close();
+            continue;
+        }
+        bool loaded = file.read(data, len) == len;
+        file.close();
+        if (!loaded) {
+            Serial.printf("[ERROR] Decoder benchmark: failed to read %s\n", file.name());
+            free(data);
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (candidates[i].codec != codec) {
+                continue;
+            }
+            BenchRun run = {};
+            run.data = data;
+            run.len = len;
+            run.codec = candidates[i].codec;
+            run.backend = candidates[i].backend;
+            if (!runBench(run) || run.frames == 0 || run.rate == 0) {
+                Serial.printf("[AUDIO] Decoder benchmark: %s failed on %s\n", candidates[i].label, fileName.c_str());
+                continue;
+            }
+
+            // Share of a core needed for real-time playback, and the
+            // bitrate the network has to carry for it
+            float frameUs = (float)run.decodeUs / run.frames;
+            float audioUs = (float)run.samples * 1e6f / run.rate;
+            Serial.printf("[AUDIO] %-7s %s: %u frames, %.0f us/frame (%.1f%% of a core), %.0f kbps, heap %u B, psram %u B, stack %u B\n",
+                          candidates[i].label, fileName.c_str(), run.frames, frameUs,
+                          100.0f * run.decodeUs / audioUs, len * 8000.0f / audioUs,
+                          (unsigned)run.heapBytes, (unsigned)run.psramBytes, (unsigned)run.stackBytes);
+
+            totals[i].decodeUs += run.decodeUs;
+            totals[i].audioUs += (uint64_t)audioUs;
+            totals[i].frames += run.frames;
+            totals[i].heapBytes = max(totals[i].heapBytes, run.heapBytes);
+            totals[i].psramBytes = max(totals[i].psramBytes, run.psramBytes);
+            totals[i].stackBytes = max(totals[i].stackBytes, run.stackBytes);
+        }
+        free(data);
+    }
+    root.close();
+
+    for (size_t i = 0; i < count; i++) {
+        if (totals[i].frames == 0) {
+            continue;
+        }
+        Serial.printf("[AUDIO] %-7s overall: %u frames, %.0f us/frame (%.1f%% of a core), peak heap %u B, psram %u B, stack %u B\n",
+                      candidates[i].label, totals[i].frames,
+                      (float)totals[i].decodeUs / totals[i].frames,
+                      100.0f * totals[i].decodeUs / totals[i].audioUs, (unsigned)totals[i].heapBytes,
+                      (unsigned)totals[i].psramBytes, (unsigned)totals[i].stackBytes);
+        if (totals[i].stackBytes + AudioDecoder::OUTPUT_STACK > AudioDecoder::TASK_STACK) {
+            Serial.printf("[ERROR] %s needs %u B of stack, the audio task has %u B for it\n",
+                          candidates[i].label, (unsigned)totals[i].stackBytes,
+                          (unsigned)(AudioDecoder::TASK_STACK - AudioDecoder::OUTPUT_STACK));
+        }
+    }
+}
+
+bool decodeClip(const char* path, Mp3Backend mp3, PcmClip& clip) {
+    ClipRun run = {};
+    run.path = path;
+    run.backend = mp3;
+    run.clip = &clip;
+    run.caller = xTaskGetCurrentTaskHandle();
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        clipTask,             // Task function
+        "AudioClipDecode",    // Task name for debugging
+        CLIP_TASK_STACK,      // Stack size
+        &run,                 // Task parameters
+        CLIP_TASK_PRIORITY,   // Task priority
+        nullptr,              // Task handle
+        tskNO_AFFINITY        // Core to run the task on
+    );
+    if (created != pdPASS) {
+        Serial.println("[ERROR] Failed to create clip decode task");
+        return false;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!run.ok) {
+        Serial.printf("[ERROR] Failed to decode clip %s\n", path);
+        return false;
+    }
+    Serial.printf("[AUDIO] Clip %s: %u frames at %u Hz\n", path, clip.frames, clip.rate);
+    return true;
+}
+
+void freeClip(PcmClip& clip) {
+    heap_caps_free(clip.samples);
+    clip = PcmClip();
+}
+
+}  // namespace AudioDecoder
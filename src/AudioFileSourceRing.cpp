@@ -0,0 +1,42 @@
+#include "AudioFileSourceRing.h"
+
+uint32_t AudioFileSourceRing::read(void* data, uint32_t len) {
+    // Never waits: the audio task holds pipelineMutex here, and the stall
+    // watchdog must keep running while the ring is empty
+    return readNonBlock(data, len);
+}
+
+uint32_t AudioFileSourceRing::readNonBlock(void* data, uint32_t len) {
+    if (closed) {
+        return 0;
+    }
+    return ring.read(static_cast<uint8_t*>(data), len);
+}
+
+bool AudioFileSourceRing::ready(size_t minBytes) {
+    if (closed || endOfStream) {
+        return true;
+    }
+    size_t available = ring.available();
+    size_t refill = refillLevel;
+    if (starved) {
+        // Refill to the watermark, resuming on every partial packet stutters
+        if (available < refill) {
+            return false;
+        }
+        starved = false;
+        underrunMs += millis() - starvedSince;
+        return true;
+    }
+    if (available >= min(minBytes, refill)) {
+        return true;
+    }
+    // Waiting for the very first bytes of a stream is connection latency,
+    // not an underrun
+    if (ring.totalRead() > 0) {
+        starved = true;
+        starvedSince = millis();
+        underrunCount++;
+    }
+    return false;
+}
@@ -0,0 +1,275 @@
+#include "AudioFileSourceSDBlock.h"
+#include <algorithm>
+
+// SD cards transfer whole 512 byte sectors
+static const size_t SECTOR_SIZE = 512;
+
+// Reader task: runs on the audio core just below the decoder, so it refills
+// the buffer as soon as the decoder has made room but never preempts it
+static const uint32_t READER_TASK_STACK = 3072;
+static const UBaseType_t READER_TASK_PRIORITY = 4;
+static const BaseType_t READER_TASK_CORE = 1;
+
+// How long ready() lets a pass wait for the reader task before the file
+// is given up: the short read then ends the decoder
+static const uint32_t READ_TIMEOUT_MS = 2000;
+
+// Throughput is published per this much time spent reading, so the sums
+// never come near wrapping
+static const uint32_t RATE_WINDOW_US = 250000;
+
+AudioFileSourceSDBlock::AudioFileSourceSDBlock(size_t blockSize) {
+    // A power of two keeps every block contiguous in the ring and every
+    // file offset on a sector boundary
+    this->blockSize = 4096;
+    while (this->blockSize < blockSize && this->blockSize < 65536) {
+        this->blockSize <<= 1;
+    }
+}
+
+AudioFileSourceSDBlock::AudioFileSourceSDBlock(const char* filename, size_t blockSize, uint32_t startPos)
+    : AudioFileSourceSDBlock(blockSize) {
+    open(filename, startPos);
+}
+
+AudioFileSourceSDBlock::~AudioFileSourceSDBlock() {
+    close();
+    if (readerDone) {
+        vSemaphoreDelete(readerDone);
+    }
+}
+
+bool AudioFileSourceSDBlock::open(const char* filename, uint32_t startPos) {
+    close();
+
+    // Two blocks: the reader fills one while the decoder drains the other
+    if (!ring.allocate(blockSize * 2)) {
+        return false;
+    }
+    if (!readerDone) {
+        readerDone = xSemaphoreCreateBinary();
+        if (!readerDone) {
+            return false;
+        }
+    }
+
+    file = SD.open(filename, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    fileSize = file.size();
+    startPos = min(startPos, fileSize);
+    basePos = startPos & ~(uint32_t)(SECTOR_SIZE - 1);
+    pendingSkip = startPos - basePos;
+    if (basePos > 0 && !file.seek(basePos)) {
+        file.close();
+        return false;
+    }
+    endOfFile = false;
+    starved = false;
+    ring.reset();
+
+    // The first block comes with the open, so the decoder starts on data
+    fill();
+    opened = startReader();
+    if (!opened) {
+        file.close();
+    }
+    return opened;
+}
+
+bool AudioFileSourceSDBlock::close() {
+    stopReader();
+    if (file) {
+        file.close();
+    }
+    opened = false;
+    return true;
+}
+
+uint32_t AudioFileSourceSDBlock::read(void* data, uint32_t len) {
+    // Never waits for the reader task, the caller checks ready() first
+    return readNonBlock(data, len);
+}
+
+bool AudioFileSourceSDBlock::ready(size_t minBytes) {
+    if (!opened || endOfFile || ring.available() >= pendingSkip + minBytes) {
+        starved = false;
+        return true;
+    }
+    uint32_t now = millis();
+    if (!starved) {
+        starved = true;
+        starvedSince = now;
+        underrunCount++;
+    } else if (now - starvedSince >= READ_TIMEOUT_MS) {
+        Serial.println("[ERROR] SD audio read timed out");
+        return true;
+    }
+    return false;
+}
+
+uint32_t AudioFileSourceSDBlock::readNonBlock(void* data, uint32_t len) {
+    if (!opened) {
+        return 0;
+    }
+
+    // Drop the bytes between the aligned seek offset and the requested one
+    if (pendingSkip > 0) {
+        pendingSkip -= ring.discard(pendingSkip);
+        if (pendingSkip > 0) {
+            return 0;
+        }
+    }
+
+    uint32_t count = ring.read(static_cast<uint8_t*>(data), len);
+
+    // Wake the reader as soon as a whole block is free again
+    if (count > 0 && readerTask && ring.freeSpace() >= blockSize) {
+        xTaskNotifyGive(readerTask);
+    }
+    return count;
+}
+
+bool AudioFileSourceSDBlock::seek(int32_t pos, int dir) {
+    if (!opened) {
+        return false;
+    }
+
+    int64_t target = pos;
+    if (dir == SEEK_CUR) {
+        target += getPos();
+    } else if (dir == SEEK_END) {
+        target += fileSize;
+    }
+    if (target < 0 || target > (int64_t)fileSize) {
+        return false;
+    }
+
+    // Serve a short forward seek from the buffer
+    uint32_t current = getPos();
+    size_t buffered = ring.available() > pendingSkip ? ring.available() - pendingSkip : 0;
+    if (target >= current && (uint64_t)(target - current) <= buffered) {
+        pendingSkip += (uint32_t)(target - current);
+        return true;
+    }
+
+    // Otherwise restart the reader at the sector holding the target
+    stopReader();
+    uint32_t aligned = (uint32_t)target & ~(uint32_t)(SECTOR_SIZE - 1);
+    if (!file.seek(aligned)) {
+        opened = false;
+        return false;
+    }
+    ring.reset();
+    basePos = aligned;
+    pendingSkip = (uint32_t)target - aligned;
+    endOfFile = false;
+    starved = false;
+    fill();
+    opened = startReader();
+    return opened;
+}
+
+AudioFileSourceSDBlock::ReadStats AudioFileSourceSDBlock::getReadStats() const {
+    ReadStats stats = {};
+    stats.blocks = blockCount;
+    stats.underruns = underrunCount;
+
+    stats.bytesPerSecond = bytesPerSecond;
+
+    // Percentiles over the most recent block reads
+    uint32_t samples[LATENCY_SAMPLES];
+    size_t count = min((size_t)latencyIndex.load(), LATENCY_SAMPLES);
+    if (count == 0) {
+        return stats;
+    }
+    memcpy(samples, latencyUs, count * sizeof(uint32_t));
+    std::sort(samples, samples + count);
+    stats.p50Us = samples[(count * 50) / 100];
+    stats.p95Us = samples[min((count * 95) / 100, count - 1)];
+    stats.p99Us = samples[min((count * 99) / 100, count - 1)];
+    stats.maxUs = samples[count - 1];
+    return stats;
+}
+
+bool AudioFileSourceSDBlock::startReader() {
+    stopRequested = false;
+    xSemaphoreTake(readerDone, 0);
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        readerTaskEntry,       // Task function
+        "AudioSDReader",       // Task name for debugging
+        READER_TASK_STACK,     // Stack size
+        this,                  // Task parameters
+        READER_TASK_PRIORITY,  // Task priority
+        &readerTask,           // Task handle
+        READER_TASK_CORE       // Core to run the task on
+    );
+
+    if (created != pdPASS) {
+        Serial.println("[ERROR] Failed to create SD reader task");
+        readerTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void AudioFileSourceSDBlock::stopReader() {
+    if (!readerTask) {
+        return;
+    }
+
+    // The task finishes the block it is reading, then signals and exits
+    stopRequested = true;
+    xTaskNotifyGive(readerTask);
+    xSemaphoreTake(readerDone, portMAX_DELAY);
+    readerTask = nullptr;
+}
+
+void AudioFileSourceSDBlock::fill() {
+    // A ring of two blocks hands out whole, contiguous blocks, and every read
+    // starts on a sector boundary because every read before it was a whole block
+    uint8_t* region = nullptr;
+    size_t len = min(ring.writeRegion(&region), blockSize);
+    if (len < blockSize) {
+        return;
+    }
+
+    uint32_t start = micros();
+    size_t got = file.read(region, len);
+    uint32_t elapsed = micros() - start;
+
+    if (got > 0) {
+        ring.commitWrite(got);
+        windowBytes += got;
+        windowBusyUs += elapsed;
+        if (windowBusyUs >= RATE_WINDOW_US) {
+            bytesPerSecond = (uint32_t)(((uint64_t)windowBytes * 1000000) / windowBusyUs);
+            windowBytes = 0;
+            windowBusyUs = 0;
+        }
+        latencyUs[latencyIndex % LATENCY_SAMPLES] = elapsed;
+        latencyIndex++;
+        blockCount++;
+    }
+    if (got < len) {
+        endOfFile = true;
+    }
+}
+
+void AudioFileSourceSDBlock::readerTaskEntry(void* parameter) {
+    AudioFileSourceSDBlock* self = static_cast<AudioFileSourceSDBlock*>(parameter);
+
+    while (!self->stopRequested) {
+        if (!self->endOfFile && self->ring.freeSpace() >= self->blockSize) {
+            self->fill();
+        } else {
+            // Sleep until the decoder frees a block (or a stop request)
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+        }
+    }
+
+    xSemaphoreGive(self->readerDone);
+    vTaskDelete(nullptr);
+}
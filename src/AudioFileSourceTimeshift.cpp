@@ -0,0 +1,22 @@
+#include "AudioFileSourceTimeshift.h"
+
+uint32_t AudioFileSourceTimeshift::read(void* data, uint32_t len) {
+    if (!store.isLive()) {
+        return store.read(static_cast<uint8_t*>(data), len);
+    }
+    return record(data, live ? live->read(data, len) : 0);
+}
+
+uint32_t AudioFileSourceTimeshift::readNonBlock(void* data, uint32_t len) {
+    if (!store.isLive()) {
+        return store.read(static_cast<uint8_t*>(data), len);
+    }
+    return record(data, live ? live->readNonBlock(data, len) : 0);
+}
+
+uint32_t AudioFileSourceTimeshift::record(void* data, uint32_t len) {
+    // Played as it arrived: the read position stays at the live edge
+    store.write(static_cast<const uint8_t*>(data), len);
+    store.skip(len);
+    return len;
+}
@@ -0,0 +1,190 @@
+#include "AudioGeneratorOggOpus.h"
+#include "libopus/opus.h"
+
+// OpusHead: magic, version, channels, pre-skip, input rate, gain, mapping family
+static const size_t OPUS_HEAD_BYTES = 19;
+
+static uint16_t readLe16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static bool startsWith(const uint8_t* packet, size_t len, const char* magic, size_t magicLen) {
+    return len >= magicLen && memcmp(packet, magic, magicLen) == 0;
+}
+
+AudioGeneratorOggOpus::~AudioGeneratorOggOpus() {
+    freeBuffers();
+}
+
+bool AudioGeneratorOggOpus::begin(AudioFileSource* source, AudioOutput* output) {
+    if (!source || !output || !source->isOpen()) {
+        return false;
+    }
+    file = source;
+    this->output = output;
+
+    // The decoder state stays in internal RAM, libopus touches it on every
+    // packet; the PCM buffer is only read out sample by sample
+    decoder = (OpusDecoder*)malloc(opus_decoder_get_size(2));
+    pcm = (int16_t*)heap_caps_malloc(MAX_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!pcm) {
+        pcm = (int16_t*)malloc(MAX_FRAMES * 2 * sizeof(int16_t));
+    }
+    if (!decoder || !pcm || !demuxer.allocate() || opus_decoder_init(decoder, RATE, 2) != OPUS_OK) {
+        Serial.println("[ERROR] Failed to allocate the Opus decoder");
+        freeBuffers();
+        return false;
+    }
+
+    pcmFrames = 0;
+    pcmPos = 0;
+    lastFrames = 0;
+    skipFrames = 0;
+    packets = 0;
+    decodeUs = 0;
+    pending = false;
+
+    output->SetRate(RATE);
+    output->SetBitsPerSample(16);
+    output->SetChannels(2);
+    if (!output->begin()) {
+        freeBuffers();
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+bool AudioGeneratorOggOpus::loop() {
+    while (running) {
+        // A sample the output refused last time goes first
+        if (pending) {
+            if (!output->ConsumeSample(lastSample)) {
+                break;
+            }
+            pending = false;
+        }
+        if (pcmPos == pcmFrames && !nextPacket()) {
+            break;
+        }
+        lastSample[AudioOutput::LEFTCHANNEL] = pcm[pcmPos * 2];
+        lastSample[AudioOutput::RIGHTCHANNEL] = pcm[pcmPos * 2 + 1];
+        pcmPos++;
+        pending = true;
+    }
+
+    file->loop();
+    output->loop();
+    return running;
+}
+
+bool AudioGeneratorOggOpus::stop() {
+    running = false;
+    freeBuffers();
+    output->stop();
+    return file->close();
+}
+
+void AudioGeneratorOggOpus::desync() {
+    // The source jumped: drop the half-read page and the decoder history
+    demuxer.reset();
+    if (decoder) {
+        opus_decoder_ctl(decoder, OPUS_RESET_STATE);
+    }
+    pcmFrames = 0;
+    pcmPos = 0;
+}
+
+size_t AudioGeneratorOggOpus::readSource(void* context, uint8_t* data, size_t len) {
+    return static_cast<AudioFileSource*>(context)->read(data, len);
+}
+
+bool AudioGeneratorOggOpus::nextPacket() {
+    while (true) {
+        const uint8_t* packet;
+        size_t len;
+        if (demuxer.next(readSource, file, &packet, &len) == OggDemuxer::Result::NeedData) {
+            // A stream that ran dry is retried on the next loop, a file ends
+            if (!file->isOpen() || (file->getSize() > 0 && file->getPos() >= file->getSize())) {
+                running = false;
+            }
+            return false;
+        }
+
+        if (startsWith(packet, len, "OpusHead", 8)) {
+            if (!startStream(packet, len)) {
+                running = false;
+                return false;
+            }
+            continue;
+        }
+        if (startsWith(packet, len, "OpusTags", 8) || len == 0) {
+            continue;
+        }
+        if (startsWith(packet, len, "\x01vorbis", 7)) {
+            Serial.println("[AUDIO] Ogg Vorbis is not supported, stream stopped");
+            running = false;
+            return false;
+        }
+
+        uint32_t start = micros();
+        int frames = opus_decode(decoder, packet, (opus_int32)len, pcm, MAX_FRAMES, 0);
+        if (frames <= 0 && lastFrames > 0) {
+            // Corrupt packet: ask libopus to conceal it (PLC), one packet long
+            frames = opus_decode(decoder, nullptr, 0, pcm, lastFrames, 0);
+        } else if (frames > 0) {
+            lastFrames = frames;
+        }
+        decodeUs += micros() - start;
+        if (frames <= 0) {
+            continue;  // Nothing to conceal it with yet, the packet is dropped
+        }
+        packets++;
+
+        // Pre-skip covers the encoder delay at the start of a stream
+        uint32_t skip = min(skipFrames, (uint32_t)frames);
+        skipFrames -= skip;
+        pcmPos = (int)skip;
+        pcmFrames = frames;
+        if (pcmPos < pcmFrames) {
+            return true;
+        }
+    }
+}
+
+bool AudioGeneratorOggOpus::startStream(const uint8_t* head, size_t len) {
+    // Only major version 0 is defined, minor versions stay compatible
+    if (len < OPUS_HEAD_BYTES || (head[8] & 0xF0) != 0) {
+        Serial.println("[AUDIO] Opus stream with an unknown header version");
+        return false;
+    }
+    uint8_t channels = head[9];
+    uint16_t preSkip = readLe16(head + 10);
+    int16_t gain = (int16_t)readLe16(head + 16);  // dB in Q7.8
+    uint8_t family = head[18];
+
+    // Mono and stereo only: surround needs the multistream decoder
+    if (channels == 0 || channels > 2 || (family != 0 && (len < OPUS_HEAD_BYTES + 2 || head[19] != 1))) {
+        Serial.printf("[AUDIO] Opus stream with %u channels (mapping %u) is not supported\n", channels, family);
+        return false;
+    }
+
+    // A chained stream starts from a clean decoder
+    opus_decoder_ctl(decoder, OPUS_RESET_STATE);
+    opus_decoder_ctl(decoder, OPUS_SET_GAIN(gain));
+    skipFrames = preSkip;
+    pcmFrames = 0;
+    pcmPos = 0;
+    lastFrames = 0;
+    Serial.printf("[AUDIO] Opus stream: %u channel(s), pre-skip %u, gain %.1f dB\n",
+                  channels, preSkip, gain / 256.0f);
+    return true;
+}
+
+void AudioGeneratorOggOpus::freeBuffers() {
+    free(decoder);
+    heap_caps_free(pcm);
+    decoder = nullptr;
+    pcm = nullptr;
+    demuxer.release();
+}
@@ -0,0 +1,261 @@
+#include "AudioGeneratorTone.h"
+
+// Wavetables: one cycle in 256 entries, indexed by the top 8 bits of the
+// phase and interpolated with the next 15. Peak 24000 leaves headroom.
+static const size_t TABLE_SIZE = 256;
+static const uint32_t TABLE_SHIFT = 24;
+
+static const int16_t SINE_TABLE[TABLE_SIZE] = {
+    0, 589, 1178, 1766, 2352, 2938, 3522, 4103, 4682, 5258, 5832, 6401, 6967, 7528, 8085, 8637,
+    9184, 9726, 10261, 10791, 11314, 11830, 12338, 12840, 13334, 13819, 14297, 14766, 15225, 15676, 16117, 16549,
+    16971, 17382, 17783, 18173, 18552, 18920, 19277, 19622, 19955, 20276, 20585, 20882, 21166, 21437, 21696, 21941,
+    22173, 22392, 22597, 22789, 22967, 23131, 23281, 23417, 23539, 23647, 23740, 23820, 23884, 23935, 23971, 23993,
+    24000, 23993, 23971, 23935, 23884, 23820, 23740, 23647, 23539, 23417, 23281, 23131, 22967, 22789, 22597, 22392,
+    22173, 21941, 21696, 21437, 21166, 20882, 20585, 20276, 19955, 19622, 19277, 18920, 18552, 18173, 17783, 17382,
+    16971, 16549, 16117, 15676, 15225, 14766, 14297, 13819, 13334, 12840, 12338, 11830, 11314, 10791, 10261, 9726,
+    9184, 8637, 8085, 7528, 6967, 6401, 5832, 5258, 4682, 4103, 3522, 2938, 2352, 1766, 1178, 589,
+    0, -589, -1178, -1766, -2352, -2938, -3522, -4103, -4682, -5258, -5832, -6401, -6967, -7528, -8085, -8637,
+    -9184, -9726, -10261, -10791, -11314, -11830, -12338, -12840, -13334, -13819, -14297, -14766, -15225, -15676, -16117, -16549,
+    -16971, -17382, -17783, -18173, -18552, -18920, -19277, -19622, -19955, -20276, -20585, -20882, -21166, -21437, -21696, -21941,
+    -22173, -22392, -22597, -22789, -22967, -23131, -23281, -23417, -23539, -23647, -23740, -23820, -23884, -23935, -23971, -23993,
+    -24000, -23993, -23971, -23935, -23884, -23820, -23740, -23647, -23539, -23417, -23281, -23131, -22967, -22789, -22597, -22392,
+    -22173, -21941, -21696, -21437, -21166, -20882, -20585, -20276, -19955, -19622, -19277, -18920, -18552, -18173, -17783, -17382,
+    -16971, -16549, -16117, -15676, -15225, -14766, -14297, -13819, -13334, -12840, -12338, -11830, -11314, -10791, -10261, -9726,
+    -9184, -8637, -8085, -7528, -6967, -6401, -5832, -5258, -4682, -4103, -3522, -2938, -2352, -1766, -1178, -589,
+};
+
+static const int16_t BELL_TABLE[TABLE_SIZE] = {
+    0, 1371, 2737, 4094, 5435, 6757, 8054, 9322, 10557, 11754, 12909, 14020, 15082, 16092, 17048, 17947,
+    18787, 19566, 20283, 20936, 21526, 22051, 22511, 22907, 23240, 23511, 23720, 23870, 23963, 24000, 23984, 23918,
+    23804, 23646, 23447, 23209, 22936, 22632, 22300, 21944, 21567, 21172, 20762, 20342, 19913, 19480, 19044, 18609,
+    18177, 17751, 17332, 16923, 16524, 16138, 15766, 15408, 15066, 14740, 14430, 14136, 13858, 13597, 13350, 13119,
+    12901, 12696, 12503, 12321, 12148, 11983, 11825, 11673, 11524, 11378, 11233, 11087, 10941, 10791, 10637, 10479,
+    10315, 10144, 9965, 9779, 9584, 9380, 9168, 8946, 8716, 8477, 8229, 7974, 7711, 7442, 7167, 6887,
+    6603, 6316, 6027, 5737, 5447, 5158, 4871, 4587, 4308, 4034, 3765, 3504, 3251, 3005, 2769, 2541,
+    2324, 2116, 1918, 1731, 1553, 1384, 1225, 1075, 933, 799, 671, 550, 434, 321, 213, 106,
+    0, -106, -213, -321, -434, -550, -671, -799, -933, -1075, -1225, -1384, -1553, -1731, -1918, -2116,
+    -2324, -2541, -2769, -3005, -3251, -3504, -3765, -4034, -4308, -4587, -4871, -5158, -5447, -5737, -6027, -6316,
+    -6603, -6887, -7167, -7442, -7711, -7974, -8229, -8477, -8716, -8946, -9168, -9380, -9584, -9779, -9965, -10144,
+    -10315, -10479, -10637, -10791, -10941, -11087, -11233, -11378, -11524, -11673, -11825, -11983, -12148, -12321, -12503, -12696,
+    -12901, -13119, -13350, -13597, -13858, -14136, -14430, -14740, -15066, -15408, -15766, -16138, -16524, -16923, -17332, -17751,
+    -18177, -18609, -19044, -19480, -19913, -20342, -20762, -21172, -21567, -21944, -22300, -22632, -22936, -23209, -23447, -23646,
+    -23804, -23918, -23984, -24000, -23963, -23870, -23720, -23511, -23240, -22907, -22511, -22051, -21526, -20936, -20283, -19566,
+    -18787, -17947, -17048, -16092, -15082, -14020, -12909, -11754, -10557, -9322, -8054, -6757, -5435, -4094, -2737, -1371,
+};
+
+static const int16_t SQUARE_TABLE[TABLE_SIZE] = {
+    0, 3162, 6261, 9238, 12035, 14605, 16903, 18899, 20568, 21901, 22896, 23563, 23921, 24000, 23835, 23468,
+    22944, 22312, 21617, 20906, 20221, 19597, 19066, 18650, 18363, 18213, 18200, 18314, 18541, 18862, 19253, 19686,
+    20136, 20575, 20978, 21324, 21594, 21776, 21864, 21854, 21752, 21566, 21310, 21000, 20657, 20302, 19955, 19637,
+    19365, 19155, 19018, 18961, 18986, 19089, 19264, 19499, 19781, 20091, 20412, 20723, 21008, 21248, 21431, 21545,
+    21583, 21545, 21431, 21248, 21008, 20723, 20412, 20091, 19781, 19499, 19264, 19089, 18986, 18961, 19018, 19155,
+    19365, 19637, 19955, 20302, 20657, 21000, 21310, 21566, 21752, 21854, 21864, 21776, 21594, 21324, 20978, 20575,
+    20136, 19686, 19253, 18862, 18541, 18314, 18200, 18213, 18363, 18650, 19066, 19597, 20221, 20906, 21617, 22312,
+    22944, 23468, 23835, 24000, 23921, 23563, 22896, 21901, 20568, 18899, 16903, 14605, 12035, 9238, 6261, 3162,
+    0, -3162, -6261, -9238, -12035, -14605, -16903, -18899, -20568, -21901, -22896, -23563, -23921, -24000, -23835, -23468,
+    -22944, -22312, -21617, -20906, -20221, -19597, -19066, -18650, -18363, -18213, -18200, -18314, -18541, -18862, -19253, -19686,
+    -20136, -20575, -20978, -21324, -21594, -21776, -21864, -21854, -21752, -21566, -21310, -21000, -20657, -20302, -19955, -19637,
+    -19365, -19155, -19018, -18961, -18986, -19089, -19264, -19499, -19781, -20091, -20412, -20723, -21008, -21248, -21431, -21545,
+    -21583, -21545, -21431, -21248, -21008, -20723, -20412, -20091, -19781, -19499, -19264, -19089, -18986, -18961, -19018, -19155,
+    -19365, -19637, -19955, -20302, -20657, -21000, -21310, -21566, -21752, -21854, -21864, -21776, -21594, -21324, -20978, -20575,
+    -20136, -19686, -19253, -18862, -18541, -18314, -18200, -18213, -18363, -18650, -19066, -19597, -20221, -20906, -21617, -22312,
+    -22944, -23468, -23835, -24000, -23921, -23563, -22896, -21901, -20568, -18899, -16903, -14605, -12035, -9238, -6261, -3162,
+};
+// Fade at both ends of a step, 256 samples (6 ms)
+static const uint32_t EDGE_SHIFT = 8;
+static const uint32_t EDGE_SAMPLES = 1 << EDGE_SHIFT;
+
+// Rising intensity: from -18 dB to full, recomputed every 256 samples
+static const int32_t START_LEVEL = 4096;
+static const int32_t FULL_LEVEL = 32767;
+static const uint32_t LEVEL_UPDATE = 256;
+
+namespace {
+
+enum class Wave : uint8_t {
+    Sine,
+    Bell,   // Decaying harmonics, for chimes
+    Square  // Odd harmonics up to the 9th, cuts through
+};
+
+struct ToneStep {
+    uint16_t startHz;  // 0 for a pause
+    uint16_t endHz;    // Glides to this pitch over the step, startHz for a steady tone
+    uint16_t ms;
+    Wave wave;
+};
+
+struct TonePattern {
+    const char* name;
+    const ToneStep* steps;
+    uint8_t count;
+};
+
+const ToneStep BEEPS[] = {
+    {880, 880, 100, Wave::Square}, {0, 0, 80, Wave::Sine},
+    {880, 880, 100, Wave::Square}, {0, 0, 80, Wave::Sine},
+    {880, 880, 100, Wave::Square}, {0, 0, 80, Wave::Sine},
+    {880, 880, 100, Wave::Square}, {0, 0, 600, Wave::Sine},
+};
+
+const ToneStep CHIME[] = {
+    {659, 659, 250, Wave::Bell},
+    {784, 784, 250, Wave::Bell},
+    {1047, 1047, 500, Wave::Bell},
+    {0, 0, 700, Wave::Sine},
+};
+
+const ToneStep RISE[] = {
+    {440, 880, 600, Wave::Sine}, {0, 0, 150, Wave::Sine},
+    {440, 880, 600, Wave::Sine}, {0, 0, 650, Wave::Sine},
+};
+
+const ToneStep SIREN[] = {
+    {600, 1200, 500, Wave::Square},
+    {1200, 600, 500, Wave::Square},
+};
+
+const TonePattern PATTERNS[] = {
+    {"beeps", BEEPS, sizeof(BEEPS) / sizeof(BEEPS[0])},
+    {"chime", CHIME, sizeof(CHIME) / sizeof(CHIME[0])},
+    {"rise", RISE, sizeof(RISE) / sizeof(RISE[0])},
+    {"siren", SIREN, sizeof(SIREN) / sizeof(SIREN[0])},
+};
+
+const uint8_t PATTERN_COUNT = sizeof(PATTERNS) / sizeof(PATTERNS[0]);
+
+const int16_t* tableFor(Wave wave) {
+    switch (wave) {
+        case Wave::Bell: return BELL_TABLE;
+        case Wave::Square: return SQUARE_TABLE;
+        case Wave::Sine:
+        default: return SINE_TABLE;
+    }
+}
+
+// Phase advance per sample of a pitch, a cycle is 2^32
+uint32_t hzToIncrement(uint16_t hz) {
+    return (uint32_t)(((uint64_t)hz << 32) / AudioGeneratorTone::RATE);
+}
+
+}  // namespace
+
+void AudioGeneratorTone::setPattern(uint8_t pattern, uint32_t rampMs) {
+    this->pattern = pattern < PATTERN_COUNT ? pattern : 0;
+    rampSamples = (uint32_t)((uint64_t)rampMs * RATE / 1000);
+}
+
+bool AudioGeneratorTone::begin(AudioFileSource* source, AudioOutput* output) {
+    (void)source;
+    if (!output) {
+        return false;
+    }
+    file = nullptr;
+    this->output = output;
+
+    step = 0;
+    phase = 0;
+    elapsed = 0;
+    level = rampSamples > 0 ? START_LEVEL : FULL_LEVEL;
+    pending = false;
+    startStep();
+
+    output->SetRate(RATE);
+    output->SetBitsPerSample(16);
+    output->SetChannels(2);
+    if (!output->begin()) {
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+bool AudioGeneratorTone::loop() {
+    while (running) {
+        // A sample the output refused last time goes first
+        if (!pending) {
+            lastSample[AudioOutput::LEFTCHANNEL] = render();
+            lastSample[AudioOutput::RIGHTCHANNEL] = lastSample[AudioOutput::LEFTCHANNEL];
+            pending = true;
+        }
+        if (!output->ConsumeSample(lastSample)) {
+            break;
+        }
+        pending = false;
+    }
+    if (output) {
+        output->loop();
+    }
+    return running;
+}
+
+bool AudioGeneratorTone::stop() {
+    running = false;
+    output->stop();
+    return true;
+}
+
+uint8_t AudioGeneratorTone::patternCount() {
+    return PATTERN_COUNT;
+}
+
+const char* AudioGeneratorTone::patternName(uint8_t pattern) {
+    return PATTERNS[pattern < PATTERN_COUNT ? pattern : 0].name;
+}
+
+int AudioGeneratorTone::fromName(const char* name) {
+    for (uint8_t i = 0; name && i < PATTERN_COUNT; i++) {
+        if (strcasecmp(name, PATTERNS[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AudioGeneratorTone::startStep() {
+    const ToneStep& current = PATTERNS[pattern].steps[step];
+    stepPos = 0;
+    stepLen = max((uint32_t)1, (uint32_t)current.ms * RATE / 1000);
+    if (current.startHz == 0) {
+        table = nullptr;
+        increment = 0;
+        glide = 0;
+        return;
+    }
+    // The phase carries on from the last step, the edge fade hides the seam
+    table = tableFor(current.wave);
+    increment = hzToIncrement(current.startHz);
+    glide = (int32_t)(((int64_t)hzToIncrement(current.endHz) - increment) / (int64_t)stepLen);
+}
+
+int16_t AudioGeneratorTone::render() {
+    if (stepPos == stepLen) {
+        step = (step + 1) % PATTERNS[pattern].count;
+        startStep();
+    }
+
+    int32_t sample = 0;
+    if (table) {
+        uint32_t index = phase >> TABLE_SHIFT;
+        int32_t a = table[index];
+        int32_t b = table[(index + 1) & (TABLE_SIZE - 1)];
+        int32_t frac = (phase >> (TABLE_SHIFT - 15)) & 0x7FFF;
+        sample = a + (((b - a) * frac) >> 15);
+        phase += increment;
+        increment += (uint32_t)glide;
+
+        uint32_t edge = min(stepPos, stepLen - 1 - stepPos);
+        if (edge < EDGE_SAMPLES) {
+            sample = (sample * (int32_t)edge) >> EDGE_SHIFT;
+        }
+        sample = (sample * level) >> 15;
+    }
+    stepPos++;
+
+    if (rampSamples > 0 && level < FULL_LEVEL && (++elapsed % LEVEL_UPDATE) == 0) {
+        level = elapsed >= rampSamples
+            ? FULL_LEVEL
+            : START_LEVEL + (int32_t)((int64_t)(FULL_LEVEL - START_LEVEL) * elapsed / rampSamples);
+    }
+    return (int16_t)sample;
+}
@@ -0,0 +1,107 @@
+#include "AudioJitterBuffer.h"
+
+// Throughput is measured over this much unthrottled time, the drain rate
+// and the peak decay over windows of this length in wall time
+static const uint32_t THROUGHPUT_WINDOW_MS = 1000;
+
+// Headroom on top of the measured jitter, covers decoder frame granularity
+static const float SAFETY_MARGIN_MS = 250.0f;
+
+// Peak gap decay per throughput window; the depth shrinks by about 10%/s
+static const float PEAK_DECAY = 0.9f;
+
+void AudioJitterBuffer::setLimits(size_t minBytes, size_t maxBytes) {
+    minDepth = max(minBytes, (size_t)4096);
+    maxDepth = max(maxBytes, minDepth);
+    targetDepth = constrain((size_t)targetDepth.load(), minDepth, maxDepth);
+}
+
+bool AudioJitterBuffer::allocate() {
+    return ring.allocate(maxDepth);
+}
+
+void AudioJitterBuffer::reset() {
+    ring.reset();
+
+    lastArrivalMs = 0;
+    windowStartMs = millis();
+    windowReadStart = 0;
+    activeMs = 0;
+    activeBytes = 0;
+    drainRate = 0;
+    gapMeanMs = 0.0f;
+    gapDevMs = 0.0f;
+    peakGapMs = 0.0f;
+
+    // A fresh stream starts at the minimum depth for a short startup delay
+    targetDepth = minDepth;
+    jitterMs = 0;
+    throughput = 0;
+}
+
+void AudioJitterBuffer::onArrival(size_t bytes) {
+    uint32_t now = millis();
+
+    // Space ran out, the producer read less than the link had to offer
+    bool capped = ring.available() >= targetDepth.load();
+
+    // Inter-arrival gap statistics, smoothed like a TCP RTT estimator
+    if (lastArrivalMs != 0) {
+        float gap = (float)(now - lastArrivalMs);
+        if (gapMeanMs == 0.0f) {
+            gapMeanMs = gap;
+        }
+        gapDevMs += (fabsf(gap - gapMeanMs) - gapDevMs) / 4.0f;
+        gapMeanMs += (gap - gapMeanMs) / 8.0f;
+
+        // React to a long stall right away instead of at the end of the window
+        if (gap > peakGapMs) {
+            peakGapMs = gap;
+            updateTarget();
+        }
+
+        // Throughput only over gaps the link alone decided: not after a
+        // throttle and not for a read the space capped
+        if (!capped) {
+            activeMs += now - lastArrivalMs;
+            activeBytes += bytes;
+        }
+    }
+    lastArrivalMs = capped ? 0 : now;
+
+    if (activeMs >= THROUGHPUT_WINDOW_MS) {
+        uint32_t rate = (uint32_t)(((uint64_t)activeBytes * 1000) / activeMs);
+        uint32_t previous = throughput.load();
+        throughput = previous ? (previous * 3 + rate) / 4 : rate;
+        activeMs = 0;
+        activeBytes = 0;
+    }
+
+    uint32_t elapsed = now - windowStartMs;
+    if (elapsed >= THROUGHPUT_WINDOW_MS) {
+        // The decoder's consumption rate is the stream bitrate
+        uint32_t readTotal = ring.totalRead();
+        drainRate = (uint32_t)(((uint64_t)(readTotal - windowReadStart) * 1000) / elapsed);
+        windowReadStart = readTotal;
+
+        windowStartMs = now;
+        peakGapMs *= PEAK_DECAY;
+        updateTarget();
+    }
+}
+
+void AudioJitterBuffer::updateTarget() {
+    // Size the buffer in stream time: prefer the decoder's consumption rate,
+    // the network rate is only a stand-in until playback has started
+    uint32_t drain = drainRate.load();
+    uint32_t rate = drain ? drain : throughput.load();
+    if (rate == 0) {
+        return;  // No rate yet, keep the current depth
+    }
+
+    float jitter = peakGapMs + 4.0f * gapDevMs;
+    jitterMs = (uint32_t)jitter;
+
+    size_t depth = (size_t)(((jitter + SAFETY_MARGIN_MS) * rate) / 1000.0f);
+    targetDepth = constrain(depth, minDepth, maxDepth);
+}
@@ -1,168 +1,1949 @@
 #include "AudioManager.h"
 #include "ConfigManager.h"
+#include "Mp3Indexer.h"
 #include <SD.h>
 #include <SPI.h>
 #include <HTTPClient.h>
-#include <WiFiClientSecure.h>
 
 // Initialize static member
 AudioManager* AudioManager::instance = nullptr;
 
-// Audio callbacks
-void MDCallback(void *cbData, const char *type, bool isUnicode, const char *string) {
-    const char *ptr = reinterpret_cast<const char *>(cbData);
-    (void) isUnicode; // Punt this ball for now
-    if (strcmp(type, "SS") == 0) {
-        Serial.printf("METADATA(%s) '%s' = '%s'\n", ptr, type, string);
-    } else {
-        // Ignore other metadata types for now
-    }
+// Audio task settings: the decoder runs on core 1 (the display task owns core 0)
+// above every application task, the network reader runs on core 0 next to WiFi
+static const uint32_t AUDIO_TASK_STACK = AudioDecoder::TASK_STACK;  // libmad, Helix AAC, libopus
+static const UBaseType_t AUDIO_TASK_PRIORITY = 5;
+static const BaseType_t AUDIO_TASK_CORE = 1;
+static const uint32_t NETWORK_TASK_STACK = 4096;
+static const UBaseType_t NETWORK_TASK_PRIORITY = 3;
+static const BaseType_t NETWORK_TASK_CORE = 0;
+
+// Reconnects and variant switches run in their own task: a dead host can
+// take the whole connect timeout, and resolving plus a TLS handshake need a
+// deep stack
+static const uint32_t DIAL_TASK_STACK = 16384;
+static const UBaseType_t DIAL_TASK_PRIORITY = 2;
+static const BaseType_t DIAL_TASK_CORE = 0;
+static const uint32_t STATS_LOG_INTERVAL = 10000;  // 10 seconds
+static const uint32_t PREBUFFER_TIMEOUT = 10000;   // Give up on a stream that never fills
+
+// Stall watchdog settings
+static const uint32_t FALLBACK_LEAD_MS = 500;       // Switch while this much audio is still buffered
+static const uint32_t RECONNECT_BACKOFF_MIN = 500;  // First retry delay after a failed connect
+static const uint32_t RECONNECT_BACKOFF_MAX = 8000;
+
+// Room kept free in the ring of a held stream so the network task keeps reading
+static const size_t PREPARED_READ_SLACK = 4096;
+
+// Stream data a decoder pass needs at the least, about 100 ms at 320 kbps
+static const size_t DECODE_MIN_BYTES = 4096;
+
+// SD read size for local files, large sequential sector-aligned transfers
+static const size_t SD_READ_BLOCK = 32 * 1024;
+
+// Stream bytes inspected to detect the codec, covers a few frames at 64 kbps
+static const size_t CODEC_PROBE_BYTES = 2048;
+
+// Loudness normalization: a slow gain within a range the I2S gain can carry
+static const uint32_t LOUDNESS_UPDATE_INTERVAL = 100;
+static const float LOUDNESS_SLEW_DB = 0.1f;         // Per update, 1 dB per second
+static const float LOUDNESS_MIN_GAIN_DB = -12.0f;
+static const float LOUDNESS_MAX_GAIN_DB = 6.0f;
+static const uint32_t GAIN_PUBLISH_INTERVAL = 60000;  // Hand out the learned gain every minute
+
+// Timeshift: stream bytes moved into the history per pass, and the fade that
+// hides the restart of the decoder after a seek or pause
+static const size_t TIMESHIFT_CHUNK = 2048;
+static const uint32_t TIMESHIFT_FADE_MS = 30;
+
+// Adaptive bitrate: how often the buffer of the stream on air is evaluated
+static const uint32_t BITRATE_CHECK_INTERVAL = 1000;
+
+// Time since a timestamp written by another task, zero if it lies just ahead of now
+static uint32_t elapsedSince(uint32_t now, uint32_t then) {
+    int32_t elapsed = (int32_t)(now - then);
+    return elapsed > 0 ? (uint32_t)elapsed : 0;
 }
 
 // Constructor is defined as default in the header file
 
 AudioManager::~AudioManager() {
-    cleanup();
+    stop();
 }
 
 void AudioManager::begin() {
     // Initialize I2S audio output
     audioOutput = new AudioOutputI2S();
     audioOutput->SetGain(currentVolume / 100.0);
-    
+
+    // Decoders feed the processing stages, the last stage feeds I2S
+    mixerStage = new AudioOutputClipMixer(audioOutput);
+    mixerStage->setDuckLevel(duckDb);
+    fadeStage = new AudioOutputFade(mixerStage);
+    spectrumStage = new AudioOutputSpectrum(fadeStage);
+    eqStage = new AudioOutputEqualizer(spectrumStage);
+    loudnessStage = new AudioOutputLoudness(eqStage);
+    crossfadeStage = new AudioOutputCrossfade(loudnessStage);
+
     // Use regular SD card which was already initialized in main.cpp
     // SD_MMC replaced with SD to fix initialization errors
     if (!SD.begin(SD_CS)) {
         Serial.println("SD initialization check failed in AudioManager!");
         // Continue anyway as SD might already be initialized
     }
+
+    // Stream ring lives in PSRAM, the second slot allocates on the first switch
+    stream->jitterBuffer.allocate();
+
+    // Pause and rewind need the history; streams play without it otherwise
+    if (timeshiftBytes > 0 && timeshift.allocate(timeshiftBytes)) {
+        Serial.printf("[AUDIO] Timeshift history: %u KB\n", (unsigned)(timeshift.capacity() / 1024));
+    }
+
+    pipelineMutex = xSemaphoreCreateMutex();
+    networkMutex = xSemaphoreCreateMutex();
+
+    // Single slot mailbox, the UI only cares about the latest title
+    nowPlayingQueue = xQueueCreate(1, sizeof(NowPlaying));
+
+    // A few learned gains may pile up when stations are switched quickly
+    learnedGainQueue = xQueueCreate(4, sizeof(LearnedGain));
+    if (!pipelineMutex || !networkMutex || !nowPlayingQueue || !learnedGainQueue) {
+        Serial.println("[ERROR] Failed to create audio mutexes");
+        return;
+    }
+
+    // Decoder pump: owns AudioGenerator::loop() so a slow LVGL frame or a
+    // TLS handshake elsewhere cannot starve I2S
+    BaseType_t audioTaskCreated = xTaskCreatePinnedToCore(
+        audioTask,            // Task function
+        "AudioTask",          // Task name for debugging
+        AUDIO_TASK_STACK,     // Stack size
+        this,                 // Task parameters
+        AUDIO_TASK_PRIORITY,  // Task priority
+        &audioTaskHandle,     // Task handle
+        AUDIO_TASK_CORE       // Core to run the task on
+    );
+
+    // Network reader: moves socket data into the stream ring
+    BaseType_t networkTaskCreated = xTaskCreatePinnedToCore(
+        networkTask,            // Task function
+        "AudioNetTask",         // Task name for debugging
+        NETWORK_TASK_STACK,     // Stack size
+        this,                   // Task parameters
+        NETWORK_TASK_PRIORITY,  // Task priority
+        &networkTaskHandle,     // Task handle
+        NETWORK_TASK_CORE       // Core to run the task on
+    );
+
+    // Dialer: reconnects dropped streams without holding networkMutex, and
+    // connects bitrate variants off the main loop
+    BaseType_t dialTaskCreated = xTaskCreatePinnedToCore(
+        dialTask,             // Task function
+        "AudioDialTask",      // Task name for debugging
+        DIAL_TASK_STACK,      // Stack size
+        this,                 // Task parameters
+        DIAL_TASK_PRIORITY,   // Task priority
+        &dialTaskHandle,      // Task handle
+        DIAL_TASK_CORE        // Core to run the task on
+    );
+
+    if (audioTaskCreated != pdPASS || networkTaskCreated != pdPASS || dialTaskCreated != pdPASS) {
+        Serial.println("[ERROR] Failed to create audio tasks!");
+    }
 }
 
 void AudioManager::loop() {
-    if (audioGenerator && audioGenerator->isRunning()) {
-        if (!audioGenerator->loop()) {
+    pump();
+}
+
+bool AudioManager::pump() {
+    if (!pipelineMutex || xSemaphoreTake(pipelineMutex, portMAX_DELAY) != pdTRUE) {
+        return false;
+    }
+
+    bool active = false;
+    bool finished = false;
+    uint32_t now = millis();
+
+    if (incoming && !checkPendingSwitch(now)) {
+        finished = true;
+    }
+
+    if (isStreaming) {
+        uint32_t onset = 0;
+        switch (streamState) {
+            case StreamState::PreBuffering:
+                // Hold the decoder back until the jitter buffer reached its watermark
+                if (holdForTrigger) {
+                    keepPreparedBufferFresh();
+                } else if (stream->jitterBuffer.isPrimed()) {
+                    Serial.printf("[AUDIO] Pre-buffered %u bytes in %lu ms\n",
+                                  (unsigned)stream->jitterBuffer.getRing().available(), now - preBufferStart);
+                    if (stream->codec == StreamCodec::Unknown) {
+                        detectStreamCodec();
+                    }
+                    if (!startStreamDecoder()) {
+                        cleanup();
+                        finished = true;
+                    }
+                } else if (elapsedSince(now, stream->lastDataMs) >= stallTimeoutMs ||
+                           now - preBufferStart >= PREBUFFER_TIMEOUT) {
+                    Serial.println("[AUDIO] Stream did not deliver enough data to start");
+                    if (!enterFallback(stream->lastDataMs)) {
+                        cleanup();
+                        finished = true;
+                    }
+                } else {
+                    active = true;
+                }
+                break;
+
+            case StreamState::Playing:
+                if (paused || !timeshift.isLive()) {
+                    // The decoder is not reading the stream ring, keep it
+                    // flowing into the history instead. The history covers
+                    // for the network until playback is back at the edge.
+                    feedTimeshift();
+                    if (!paused) {
+                        updateLoudness(now);
+                    }
+                } else if (checkStreamStall(now, onset)) {
+                    enterFallback(onset);
+                } else {
+                    updateLoudness(now);
+                }
+                break;
+
+            case StreamState::Fallback:
+                checkStreamRecovery(now);
+                break;
+        }
+    }
+
+    // How full the jitter buffer runs while the stream plays
+    if (isStreaming && streamState == StreamState::Playing && !paused) {
+        telemetry.sampleFill(stream->jitterBuffer.getRing().available(),
+                             stream->jitterBuffer.getTargetDepth(), now);
+    }
+
+    bool decoding = audioGenerator && audioGenerator->isRunning() && !paused && decoderFed();
+    if (decoding) {
+        uint32_t pipelineStart = telemetry.beginPipeline();
+        uint32_t samplesBefore = fadeStage->getSamplesConsumed();
+        if (audioGenerator->loop()) {
+            active = true;
+            if (isStreaming && streamState == StreamState::Playing) {
+                telemetry.endPipeline(pipelineStart, fadeStage->getSamplesConsumed() - samplesBefore,
+                                      AudioCodec::frameSamples(stream->codec));
+            }
+            recordFirstSample();
+        } else if (isStreaming && stream->wanted && streamState == StreamState::Playing) {
+            // The ring emptied in the middle of a pass and the decoder took
+            // the short read for the end of the stream
+            Serial.println("[AUDIO] Stream decoder ran dry");
+            enterFallback(lastProgressMs);
+        } else if (isStreaming && stream->wanted && streamState == StreamState::Fallback) {
+            // Keep the fallback track looping until the stream is back
+            releaseDecoder();
+            startFallbackTrack();
+        } else if (incoming) {
+            // The old station ended while the next one is still buffering
+            releaseDecoder();
+            finished = !commitSwitch(false);
+        } else {
             // Playback finished or error occurred
             audioGenerator->stop();
             cleanup();
-            notifyPlaybackState(false);
+            finished = true;
+        }
+    }
+
+    // Clips mix into the decoder output, without one they play over silence
+    decoding = audioGenerator && audioGenerator->isRunning() && !paused && decoding;
+    if (!decoding) {
+        mixerStage->fillIdle();
+    }
+    clipPlaying = mixerStage->isActive();
+    if (clipPlaying) {
+        active = true;
+    }
+
+    bufferLow = isStreaming && !holdForTrigger &&
+                (streamState == StreamState::Fallback ||
+                 (streamState == StreamState::Playing && !paused && timeshift.isLive() &&
+                  !stream->jitterBuffer.isPrimed()));
+
+    xSemaphoreGive(pipelineMutex);
+
+    if (finished) {
+        notifyPlaybackState(false);
+    }
+    return active;
+}
+
+bool AudioManager::decoderFed() {
+    // Caller holds pipelineMutex. Reads from the stream ring never wait, so a
+    // pass only runs with enough data for it; while the ring is starved the
+    // pass is skipped and the stall watchdog decides on the fallback.
+    // The SD block reader does not wait either, a pass waits for its block.
+    if (sdSource && fileSource == sdSource) {
+        return sdSource->ready(DECODE_MIN_BYTES);
+    }
+    if (!isStreaming || streamState != StreamState::Playing) {
+        return true;
+    }
+    bool fromRing = fileSource == &stream->ringSource ||
+                    (fileSource == &timeshiftSource && timeshift.isLive());
+    return !fromRing || stream->ringSource.ready(DECODE_MIN_BYTES);
+}
+
+void AudioManager::recordFirstSample() {
+    // Caller holds pipelineMutex
+    uint32_t samples = fadeStage->getSamplesConsumed();
+
+    // Trigger-to-first-sample latency of an alarm
+    if (awaitingFirstSample && samples != triggerSampleCount) {
+        awaitingFirstSample = false;
+        uint32_t latency = millis() - triggerMs;
+        lastTriggerLatency = latency;
+        Serial.printf("[AUDIO] First sample %u ms after alarm trigger (%s start)\n",
+                      latency, lastWarmStart ? "warm" : "cold");
+    }
+
+    // Request-to-first-sample latency of a station switch
+    if (awaitingSwitchSample && samples != switchSampleCount) {
+        awaitingSwitchSample = false;
+        uint32_t latency = millis() - switchRequestMs;
+        lastSwitchMs = latency;
+        if (latency > maxSwitchMs) {
+            maxSwitchMs = latency;
+        }
+        switchCount++;
+        if (switchGapless) {
+            gaplessCount++;
         }
+        Serial.printf("[AUDIO] Station on air %u ms after the request (%s)\n",
+                      latency, switchGapless ? "crossfade" : "cold start");
     }
 }
 
-bool AudioManager::playStream(const char* url) {
+bool AudioManager::playStream(const char* url, StreamCodec codec) {
+    if (!url) return false;
+
+    // Local files go through the SD path
+    if (!String(url).startsWith("http")) {
+        stop();
+        return playFile(url);
+    }
+
+    // Keep the current audio playing while the new station connects
+    if (beginSwitch(url, codec)) {
+        return true;
+    }
+
     stop();
-    
-    Serial.printf("Connecting to stream: %s\n", url);
-    
-    // Create stream source
-    if (String(url).startsWith("http")) {
-        // HTTP stream
-        auto* stream = new AudioFileSourceHTTPStream();
-        if (!stream->open(url)) {
-            Serial.println("Failed to open HTTP stream");
-            delete stream;
-            return false;
-        }
-        
-        // Create buffered source
-        bufferedSource = new AudioFileSourceBuffer(stream, 1024 * 8);
-        fileSource = bufferedSource;
+    uint32_t requestMs = millis();
+    if (!openStream(url, codec, false)) {
+        return false;
+    }
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    switchRequestMs = requestMs;
+    switchSampleCount = fadeStage->getSamplesConsumed();
+    switchGapless = false;
+    awaitingSwitchSample = true;
+    xSemaphoreGive(pipelineMutex);
+
+    notifyPlaybackState(true);
+    return true;
+}
+
+bool AudioManager::beginSwitch(const char* url, StreamCodec codec) {
+    if (!pipelineMutex || crossfadeMs == 0) {
+        return false;
+    }
+
+    // Only worth it while something is audible; a held stream is silent
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool onAir = audioGenerator && audioGenerator->isRunning() && !holdForTrigger && !paused;
+    if (onAir) {
+        // A switch still in progress is superseded by this one
+        dropIncoming();
+    }
+    AudioStreamSlot& slot = (stream == &slots[0]) ? slots[1] : slots[0];
+    bool fits = onAir && fitsPsramBudget(slot);
+    if (fits && !crossfadeStage->allocate(crossfadeMs)) {
+        fits = false;
+    }
+    xSemaphoreGive(pipelineMutex);
+
+    if (!onAir) {
+        return false;
+    }
+    if (!fits) {
+        Serial.println("[AUDIO] Not enough PSRAM budget for a gapless switch, stopping first");
+        return false;
+    }
+
+    uint32_t requestMs = millis();
+    Serial.printf("Connecting to stream: %s (next station)\n", url);
+
+    if (!connectNextSlot(slot, url, url, codec)) {
+        // The old station keeps playing
+        Serial.println("Failed to open HTTP stream");
+        return false;
+    }
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    incoming = &slot;
+    switchRequestMs = requestMs;
+    awaitingSwitchSample = false;
+    xSemaphoreGive(pipelineMutex);
+    return true;
+}
+
+bool AudioManager::connectNextSlot(AudioStreamSlot& slot, const char* url, const char* resolveUrl,
+                                   StreamCodec codec) {
+    // Wait for the network task to leave the slot alone, then connect while
+    // it keeps feeding the station on air
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    claimSlot(slot);
+    slot.wanted = false;
+    slot.reader.close();
+    xSemaphoreGive(networkMutex);
+
+    String streamUrl;
+    bool opened = slot.jitterBuffer.allocate() && connectSlot(slot, resolveUrl, streamUrl);
+
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    if (opened) {
+        attachStream(slot, url, streamUrl.c_str(), codec, resolveUrl);
     } else {
-        // Local file
-        fileSource = new AudioFileSourceSD(url);
+        slot.reader.close();
     }
-    
-    // Create MP3 decoder
-    audioGenerator = new AudioGeneratorMP3();
-    if (!audioGenerator->begin(fileSource, audioOutput)) {
-        Serial.println("Failed to start MP3 decoder");
+    slot.connecting = false;
+    xSemaphoreGive(networkMutex);
+    return opened;
+}
+
+void AudioManager::claimSlot(AudioStreamSlot& slot) {
+    // Caller holds networkMutex. Waits out a reconnect the dial task runs
+    // outside the lock, then keeps both tasks away from the reader.
+    while (slot.connecting.exchange(true)) {
+        xSemaphoreGive(networkMutex);
+        vTaskDelay(pdMS_TO_TICKS(5));
+        xSemaphoreTake(networkMutex, portMAX_DELAY);
+    }
+}
+
+bool AudioManager::fitsPsramBudget(const AudioStreamSlot& slot) const {
+    // Caller holds pipelineMutex. Peak use is both rings plus the crossfade tail.
+    size_t needed = stream->ringBytes() + slot.ringBytes();
+    if (crossfadeStage->getBufferBytes() == 0) {
+        needed += AudioOutputCrossfade::bufferBytesFor(crossfadeMs);
+    } else {
+        needed += crossfadeStage->getBufferBytes();
+    }
+    return needed <= psramBudget;
+}
+
+bool AudioManager::checkPendingSwitch(uint32_t now) {
+    // Caller holds pipelineMutex
+    AudioJitterBuffer& next = incoming->jitterBuffer;
+    if (next.isPrimed()) {
+        Serial.printf("[AUDIO] Next station pre-buffered %u bytes in %lu ms\n",
+                      (unsigned)next.getRing().available(), now - switchRequestMs);
+        return commitSwitch(true);
+    }
+    if (now - switchRequestMs >= PREBUFFER_TIMEOUT && incomingIsVariant) {
+        // The variant on air still plays, adaptBitrate() backs off
+        Serial.println("[AUDIO] Stream variant is slow to buffer, staying");
+        dropIncoming();
+        return true;
+    }
+    if (now - switchRequestMs >= PREBUFFER_TIMEOUT) {
+        // Hand over anyway; pre-buffer timeout and fallback apply from here
+        Serial.println("[AUDIO] Next station is slow to buffer, switching over");
+        return commitSwitch(false);
+    }
+    return true;
+}
+
+bool AudioManager::commitSwitch(bool overlap) {
+    // Caller holds pipelineMutex. Decode a short tail of the old station into
+    // the crossfade buffer; the decoder returns once the tail is complete.
+    overlap = overlap && audioGenerator && audioGenerator->isRunning();
+    if (overlap) {
+        crossfadeStage->beginCapture();
+        for (int pass = 0; pass < 8 && !crossfadeStage->isCaptureFull(); pass++) {
+            if (!audioGenerator->loop()) {
+                break;
+            }
+        }
+    }
+    releaseDecoder();
+
+    // Another variant of the station on air keeps its title, gain and fade
+    bool variant = incomingIsVariant;
+    incomingIsVariant = false;
+    if (!variant) {
+        publishLearnedGain();
+    }
+
+    // Retire the old connection, the network task closes it
+    AudioStreamSlot* previous = stream;
+    previous->onAir = false;
+    previous->wanted = false;
+    previous->ringSource.close();
+
+    stream = incoming;
+    incoming = nullptr;
+    stream->onAir = true;
+    if (!variant) {
+        char streamTitle[IcyMetadataParser::TITLE_SIZE];
+        stream->reader.copyStreamTitle(streamTitle, sizeof(streamTitle));
+        postNowPlaying(streamTitle);
+        startLoudness(stream->startGainDb);
+        telemetry.reset();
+    }
+    if (overlap && stream->codec == StreamCodec::Unknown) {
+        detectStreamCodec();
+    }
+
+    // The timeshift history carries on across variants of one codec.
+    // Fallback and the fade-in of the old station end here.
+    fileSource = streamSource(!variant || stream->codec != previous->codec);
+    if (!variant) {
+        fadeStage->cancel();
+    }
+    streamState = StreamState::PreBuffering;
+    preBufferStart = switchRequestMs;
+    holdForTrigger = false;
+    isStreaming = true;
+    playing = true;
+
+    if (!variant) {
+        // Samples counted from here belong to the new station
+        switchSampleCount = fadeStage->getSamplesConsumed();
+        switchGapless = overlap;
+        awaitingSwitchSample = true;
+    }
+
+    if (!overlap) {
+        // Cold handover, the pre-buffer pass starts the decoder as usual
+        crossfadeStage->cancel();
+        return true;
+    }
+
+    crossfadeStage->startCrossfade();
+    if (!startStreamDecoder()) {
         cleanup();
         return false;
     }
-    
-    isStreaming = true;
-    notifyPlaybackState(true);
     return true;
 }
 
-bool AudioManager::playFile(const char* filename) {
+void AudioManager::dropIncoming() {
+    // Caller holds pipelineMutex
+    if (!incoming) {
+        return;
+    }
+    incoming->wanted = false;
+    incoming->ringSource.close();
+    incoming = nullptr;
+    incomingIsVariant = false;
+}
+
+void AudioManager::adaptBitrate() {
+    if (!pipelineMutex || !streamVariantLookup) {
+        return;
+    }
+    uint32_t now = millis();
+    if (now - lastBitrateCheck < BITRATE_CHECK_INTERVAL) {
+        return;
+    }
+    lastBitrateCheck = now;
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    if (!isStreaming) {
+        variantsUrl[0] = '\0';
+        variantCount = 0;
+        currentVariant = -1;
+        requestedVariant = -1;
+        xSemaphoreGive(pipelineMutex);
+        return;
+    }
+    if (incoming || dialVariant >= 0) {
+        // A station or variant switch is in progress
+        xSemaphoreGive(pipelineMutex);
+        return;
+    }
+
+    // The station changed, or the variant on air did without us
+    int onAir = variantOnAir();
+    if (strcmp(stream->url, variantsUrl) != 0 || (requestedVariant < 0 && onAir != currentVariant)) {
+        loadVariants(stream->url);
+    } else if (requestedVariant >= 0) {
+        if (onAir == requestedVariant) {
+            Serial.printf("[AUDIO] Now playing the %u kbps variant\n", variants[onAir].kbps);
+            bitrateSelector.onSwitched(onAir, now);
+            variantSwitches++;
+        } else {
+            bitrateSelector.onSwitchFailed();
+        }
+        currentVariant = onAir;
+        requestedVariant = -1;
+    }
+
+    // Only a stream playing live is worth judging by its buffer
+    int next = -1;
+    if (adaptiveBitrate && currentVariant >= 0 && crossfadeMs > 0 && streamState == StreamState::Playing &&
+        !holdForTrigger && !paused && timeshift.isLive()) {
+        AudioBitrateSelector::Health health;
+        health.throughput = stream->jitterBuffer.getThroughput();
+        health.fill = stream->jitterBuffer.getRing().available();
+        health.target = stream->jitterBuffer.getTargetDepth();
+        health.underruns = stream->ringSource.getUnderrunCount();
+        next = bitrateSelector.update(health, now);
+    }
+    xSemaphoreGive(pipelineMutex);
+
+    if (next >= 0 && next != currentVariant && dialTaskHandle) {
+        dialVariant = next;
+        xTaskNotifyGive(dialTaskHandle);
+    }
+}
+
+bool AudioManager::beginVariantSwitch(int variant) {
+    const StreamVariant& target = variants[variant];
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool onAir = audioGenerator && audioGenerator->isRunning() && !incoming && !holdForTrigger && !paused;
+    AudioStreamSlot& slot = (stream == &slots[0]) ? slots[1] : slots[0];
+    bool fits = onAir && fitsPsramBudget(slot) && crossfadeStage->allocate(crossfadeMs);
+    char url[sizeof(stream->url)];
+    strlcpy(url, stream->url, sizeof(url));
+    xSemaphoreGive(pipelineMutex);
+
+    if (!fits) {
+        return false;
+    }
+
+    Serial.printf("[AUDIO] Switching to the %u kbps variant: %s\n", target.kbps, target.url);
+    uint32_t requestMs = millis();
+    if (!connectNextSlot(slot, url, target.url, target.codec)) {
+        Serial.println("[AUDIO] Failed to open stream variant");
+        return false;
+    }
+
+    // The station may have ended while the variant connected
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool current = isStreaming && !incoming && strcmp(stream->url, url) == 0;
+    if (current) {
+        incoming = &slot;
+        incomingIsVariant = true;
+        switchRequestMs = requestMs;
+        requestedVariant = variant;
+    } else {
+        slot.wanted = false;
+        slot.ringSource.close();
+    }
+    xSemaphoreGive(pipelineMutex);
+    return current;
+}
+
+void AudioManager::loadVariants(const char* url) {
+    // Caller holds pipelineMutex
+    strlcpy(variantsUrl, url, sizeof(variantsUrl));
+    variantCount = streamVariantLookup(url, variants, AudioBitrateSelector::MAX_VARIANTS);
+    variantCount = min(variantCount, AudioBitrateSelector::MAX_VARIANTS);
+
+    // Ascending bitrate, the selector steps through them in order
+    for (size_t i = 1; i < variantCount; i++) {
+        StreamVariant variant = variants[i];
+        size_t j = i;
+        for (; j > 0 && variants[j - 1].kbps > variant.kbps; j--) {
+            variants[j] = variants[j - 1];
+        }
+        variants[j] = variant;
+    }
+
+    requestedVariant = -1;
+    currentVariant = variantOnAir();
+    uint16_t kbps[AudioBitrateSelector::MAX_VARIANTS];
+    for (size_t i = 0; i < variantCount; i++) {
+        kbps[i] = variants[i].kbps;
+    }
+    bitrateSelector.reset(kbps, variantCount, currentVariant >= 0 ? currentVariant : 0);
+
+    if (variantCount > 1 && currentVariant < 0) {
+        Serial.println("[AUDIO] Station URL is not one of its variants, bitrate stays fixed");
+    }
+}
+
+int AudioManager::variantOnAir() const {
+    // The variant is the URL the stream on air was resolved from
+    for (size_t i = 0; i < variantCount; i++) {
+        if (strcmp(variants[i].url, stream->resolveUrl) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+AudioManager::BitrateStats AudioManager::getBitrateStats() const {
+    BitrateStats stats;
+    stats.enabled = adaptiveBitrate && currentVariant >= 0 && variantCount > 1;
+    stats.variant = currentVariant;
+    stats.kbps = currentVariant >= 0 ? variants[currentVariant].kbps : 0;
+    stats.variantCount = variantCount;
+    stats.pending = requestedVariant >= 0;
+    stats.switches = variantSwitches;
+    return stats;
+}
+
+bool AudioManager::prepareStream(const char* url, StreamCodec codec) {
     stop();
-    
-    if (!filename) return false;
-    
-    // Check if file exists on SD card
-    if (!SD.exists(filename)) {
-        Serial.printf("File not found: %s\n", filename);
+
+    if (!url || !String(url).startsWith("http")) {
         return false;
     }
-    
-    // Create file source directly from filename
-    fileSource = new AudioFileSourceSD(filename);
-    
-    if (!fileSource->isOpen()) {
-        Serial.printf("Failed to open file: %s\n", filename);
-        cleanup();
+
+    Serial.printf("[AUDIO] Warm start: pre-buffering %s\n", url);
+    return openStream(url, codec, true);
+}
+
+bool AudioManager::commitPreparedStream(const char* url) {
+    if (!pipelineMutex || !url) {
         return false;
     }
-    
-    // Create buffered source
-    bufferedSource = new AudioFileSourceBuffer(fileSource, 8 * 1024);
-    
-    // Create MP3 decoder
-    audioGenerator = new AudioGeneratorMP3();
-    if (!audioGenerator->begin(bufferedSource, audioOutput)) {
-        Serial.println("Failed to start MP3 decoder");
-        cleanup();
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    if (!isStreaming || !holdForTrigger || strcmp(stream->url, url) != 0) {
+        xSemaphoreGive(pipelineMutex);
         return false;
     }
-    
-    isStreaming = false;
+
+    // The decoder starts on the next audio task pass if the buffer is primed,
+    // otherwise the normal pre-buffer and stall handling takes over from here
+    holdForTrigger = false;
+    applyPendingFade();
+    preBufferStart = millis();
+    lastWarmStart = true;
+    playing = true;
+    xSemaphoreGive(pipelineMutex);
+
+    Serial.printf("[AUDIO] Warm start: %u bytes ready\n", (unsigned)stream->jitterBuffer.getRing().available());
     notifyPlaybackState(true);
     return true;
 }
 
-void AudioManager::stop() {
-    if (audioGenerator) {
-        if (audioGenerator->isRunning()) {
-            audioGenerator->stop();
-            notifyPlaybackState(false);
+void AudioManager::markTrigger() {
+    if (!pipelineMutex) {
+        return;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    triggerMs = millis();
+    triggerSampleCount = fadeStage->getSamplesConsumed();
+    awaitingFirstSample = true;
+    lastWarmStart = false;
+    alarmPending = true;
+    xSemaphoreGive(pipelineMutex);
+}
+
+bool AudioManager::tapStream(const char* url, AudioRingBuffer* ring) {
+    if (!networkMutex || !url || !ring) {
+        return false;
+    }
+    bool tapped = false;
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    for (AudioStreamSlot& slot : slots) {
+        if (slot.wanted && !slot.connecting && slot.reader.isOpen() && strcmp(slot.url, url) == 0) {
+            slot.reader.setTap(ring);
+            tapped = true;
+            break;
         }
     }
-    cleanup();
+    xSemaphoreGive(networkMutex);
+    return tapped;
 }
 
-void AudioManager::setVolume(uint8_t volume) {
-    currentVolume = constrain(volume, 0, 100);
-    if (audioOutput) {
-        audioOutput->SetGain(currentVolume / 100.0);
+void AudioManager::untapStream(AudioRingBuffer* ring) {
+    if (!networkMutex) {
+        return;
+    }
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    for (AudioStreamSlot& slot : slots) {
+        if (slot.reader.getTap() == ring) {
+            slot.reader.setTap(nullptr);
+        }
     }
+    xSemaphoreGive(networkMutex);
 }
 
-void AudioManager::cleanup() {
-    if (audioGenerator) {
-        if (audioGenerator->isRunning()) {
-            audioGenerator->stop();
+bool AudioManager::isTapped(const AudioRingBuffer* ring, uint32_t& dropped) {
+    if (!networkMutex) {
+        return false;
+    }
+    bool tapped = false;
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    for (AudioStreamSlot& slot : slots) {
+        // A slot being reconnected elsewhere keeps its tap until the reader closes
+        if (slot.reader.getTap() == ring && slot.wanted && !slot.connecting) {
+            dropped = slot.reader.getTapDropped();
+            tapped = true;
         }
-        delete audioGenerator;
-        audioGenerator = nullptr;
     }
-    
-    if (bufferedSource) {
-        delete bufferedSource;
-        bufferedSource = nullptr;
+    xSemaphoreGive(networkMutex);
+    return tapped;
+}
+
+bool AudioManager::checkFallbackReadable() {
+    if (fallbackPath[0] == '\0') {
+        return false;
+    }
+
+    // Read the first bytes so a dead card or a broken file shows up before
+    // the alarm needs it, not when it does
+    File file = SD.open(fallbackPath, FILE_READ);
+    uint8_t header[4];
+    bool readable = file && file.read(header, sizeof(header)) == sizeof(header);
+    if (file) {
+        file.close();
     }
-    
-    if (fileSource) {
-        delete fileSource;
-        fileSource = nullptr;
+    if (!readable) {
+        Serial.printf("[ERROR] Fallback audio not readable: %s\n", fallbackPath);
     }
-    
-    isStreaming = false;
+    return readable;
 }
 
-void AudioManager::notifyPlaybackState(bool isPlaying) {
-    lastStateChange = millis();
-    if (playbackStateCallback) {
-        playbackStateCallback(isPlaying);
+bool AudioManager::openStream(const char* url, StreamCodec codec, bool hold) {
+    Serial.printf("Connecting to stream: %s\n", url);
+
+    // Connect outside networkMutex, like the next station of a switch, so a
+    // slow host does not hold up the tap and status calls
+    if (!connectNextSlot(*stream, url, url, codec)) {
+        Serial.println("Failed to open HTTP stream");
+        return false;
+    }
+    stream->onAir = true;
+
+    // The previous station's title must not linger
+    postNowPlaying("");
+    uint32_t now = millis();
+
+    // The audio task starts the decoder once the jitter buffer is primed,
+    // a held stream waits for commitPreparedStream() on top of that
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    fileSource = streamSource(true);
+    if (!hold) {
+        applyPendingFade();
+    }
+    startLoudness(stream->startGainDb);
+    telemetry.reset();
+    streamState = StreamState::PreBuffering;
+    preBufferStart = now;
+    holdForTrigger = hold;
+    isStreaming = true;
+    playing = !hold;
+    xSemaphoreGive(pipelineMutex);
+    return true;
+}
+
+bool AudioManager::connectSlot(AudioStreamSlot& slot, const char* url, String& streamUrl) {
+    // Caller keeps the network task away from slot.reader
+    StreamResolver& resolver = StreamResolver::getInstance();
+    if (!resolver.resolve(url, streamUrl)) {
+        // Worth a try, the station URL may be a plain stream after all
+        streamUrl = url;
+    }
+    if (slot.reader.open(streamUrl.c_str())) {
+        return true;
+    }
+
+    // A cached stream URL may have moved; resolve once more from the station URL
+    resolver.reportFailure(url);
+    String fresh;
+    if (!resolver.resolve(url, fresh) || fresh == streamUrl) {
+        return false;
+    }
+    streamUrl = fresh;
+    return slot.reader.open(streamUrl.c_str());
+}
+
+void AudioManager::attachStream(AudioStreamSlot& slot, const char* url, const char* streamUrl,
+                                StreamCodec codec, const char* resolveUrl) {
+    // Caller holds networkMutex and has opened slot.reader
+    slot.jitterBuffer.reset();
+    slot.ringSource.reopen();
+    slot.ringSource.setRefillLevel(slot.jitterBuffer.getStartWatermark());
+
+    // A codec from the station record skips detection; otherwise trust a
+    // specific Content-Type and fall back to probing the first frames
+    slot.codecDetected = false;
+    if (codec == StreamCodec::Unknown) {
+        codec = AudioCodec::fromContentType(slot.reader.getContentType());
+        if (codec != StreamCodec::Unknown) {
+            Serial.printf("[AUDIO] Stream codec %s from Content-Type '%s'\n",
+                          AudioCodec::name(codec), slot.reader.getContentType());
+            slot.codecDetected = true;
+        }
+    }
+    slot.codec = codec;
+
+    // Start at the level the station had last time
+    slot.startGainDb = stationGainLookup ? stationGainLookup(url) : 0.0f;
+
+    // Keep the URLs so the network task can reconnect on its own
+    strlcpy(slot.url, url, sizeof(slot.url));
+    strlcpy(slot.streamUrl, streamUrl, sizeof(slot.streamUrl));
+    strlcpy(slot.resolveUrl, resolveUrl ? resolveUrl : url, sizeof(slot.resolveUrl));
+    uint32_t now = millis();
+    slot.connectedMs = now;
+    slot.lastDataMs = now;
+    slot.dataResumedMs = now;
+    slot.backoff = 0;
+    slot.nextConnectMs = 0;
+    slot.awaitingData = false;
+    slot.reconnectRequested = false;
+    slot.wanted = true;
+}
+
+bool AudioManager::playFile(const char* filename, uint32_t startMs) {
+    stop();
+
+    if (!filename) return false;
+
+    // Check if file exists on SD card
+    if (!SD.exists(filename)) {
+        Serial.printf("File not found: %s\n", filename);
+        return false;
+    }
+
+    // Find the frame to start at before opening, so the first block read
+    // already holds it
+    uint32_t startPos = 0;
+    uint32_t startAt = 0;
+    if (startMs > 0) {
+        Mp3Indexer& indexer = Mp3Indexer::getInstance();
+        if (indexer.lookup(filename, startMs, startPos, startAt)) {
+            Serial.printf("[AUDIO] Starting %s at %u ms (byte %u)\n", filename, startAt, startPos);
+        } else if (indexer.estimate(filename, startMs, startPos)) {
+            startAt = startMs;
+            Serial.printf("[AUDIO] No frame index for %s, starting at estimated byte %u\n", filename, startPos);
+        } else {
+            startPos = 0;
+        }
+    } else {
+        // Have the index ready by the time the file is resumed
+        Mp3Indexer::getInstance().request(filename);
+    }
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+
+    // Large-block reader, keeps SD traffic to a few long transfers
+    sdSource = new AudioFileSourceSDBlock(filename, SD_READ_BLOCK, startPos);
+    fileSource = sdSource;
+    strlcpy(filePath, filename, sizeof(filePath));
+    filePlaying = true;
+    fileStartMs = startAt;
+    fileStartSamples = fadeStage->getSamplesConsumed();
+
+    if (!fileSource->isOpen()) {
+        Serial.printf("Failed to open file: %s\n", filename);
+        cleanup();
+        xSemaphoreGive(pipelineMutex);
+        return false;
+    }
+    applyPendingFade();
+    startLoudness(0.0f);
+
+    // Create MP3 decoder
+    audioGenerator = AudioDecoder::create(StreamCodec::MP3, mp3Backend);
+    if (!audioGenerator->begin(fileSource, crossfadeStage)) {
+        Serial.println("Failed to start MP3 decoder");
+        cleanup();
+        xSemaphoreGive(pipelineMutex);
+        return false;
+    }
+
+    isStreaming = false;
+    playing = true;
+    xSemaphoreGive(pipelineMutex);
+
+    notifyPlaybackState(true);
+    return true;
+}
+
+void AudioManager::stop() {
+    if (!pipelineMutex || !networkMutex) {
+        return;
+    }
+
+    // Release the stream slots before taking the locks; a station that is
+    // still connecting for a switch goes as well
+    for (AudioStreamSlot& slot : slots) {
+        slot.wanted = false;
+        slot.onAir = false;
+        slot.ringSource.close();
+    }
+
+    // A slot being dialed is closed by its dialer once it sees it unwanted
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    for (AudioStreamSlot& slot : slots) {
+        if (!slot.connecting) {
+            slot.reader.close();
+        }
+    }
+    xSemaphoreGive(networkMutex);
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool wasRunning = playing;
+    cleanup();
+    xSemaphoreGive(pipelineMutex);
+
+    if (wasRunning) {
+        notifyPlaybackState(false);
+    }
+}
+
+void AudioManager::setVolume(uint8_t volume) {
+    currentVolume = constrain(volume, 0, 100);
+    applyGain();
+}
+
+void AudioManager::applyGain() {
+    // The normalization gain rides on top of the volume
+    if (audioOutput) {
+        audioOutput->SetGain(currentVolume / 100.0f * powf(10.0f, loudnessGainDb / 20.0f));
+    }
+}
+
+void AudioManager::setLoudnessNormalization(bool enabled, float targetLufs) {
+    normalizeLoudness = enabled;
+    loudnessTargetLufs = constrain(targetLufs, -30.0f, -10.0f);
+    if (!enabled) {
+        loudnessGainDb = 0.0f;
+        applyGain();
+    }
+}
+
+void AudioManager::startLoudness(float gainDb) {
+    // Caller holds pipelineMutex
+    loudnessStage->reset();
+    shortTermLufs = NAN;
+    loudnessGainDb = normalizeLoudness ? constrain(gainDb, LOUDNESS_MIN_GAIN_DB, LOUDNESS_MAX_GAIN_DB) : 0.0f;
+    gainAdapted = false;
+    lastGainPublish = millis();
+    applyGain();
+}
+
+void AudioManager::updateLoudness(uint32_t now) {
+    // Caller holds pipelineMutex
+    if (now - lastLoudnessUpdate < LOUDNESS_UPDATE_INTERVAL) {
+        return;
+    }
+    lastLoudnessUpdate = now;
+    if (!loudnessStage->isSettled()) {
+        return;
+    }
+    float lufs = loudnessStage->getShortTermLufs();
+    shortTermLufs = lufs;
+    if (!normalizeLoudness) {
+        return;
+    }
+
+    // Move towards the gain that lands on the target, slowly enough that
+    // the level of a song or a voice does not pump
+    float target = constrain(loudnessTargetLufs - lufs, LOUDNESS_MIN_GAIN_DB, LOUDNESS_MAX_GAIN_DB);
+    float gain = loudnessGainDb;
+    float step = constrain(target - gain, -LOUDNESS_SLEW_DB, LOUDNESS_SLEW_DB);
+    if (fabsf(step) >= 0.01f) {
+        loudnessGainDb = gain + step;
+        gainAdapted = true;
+        applyGain();
+    }
+
+    if (now - lastGainPublish >= GAIN_PUBLISH_INTERVAL) {
+        publishLearnedGain();
+        lastGainPublish = now;
+    }
+}
+
+void AudioManager::publishLearnedGain() {
+    // Caller holds pipelineMutex
+    if (!isStreaming || !gainAdapted || !learnedGainQueue) {
+        return;
+    }
+    LearnedGain learned;
+    strlcpy(learned.url, stream->url, sizeof(learned.url));
+    learned.gainDb = loudnessGainDb;
+    xQueueSend(learnedGainQueue, &learned, 0);  // Dropped if nobody collects them
+}
+
+bool AudioManager::takeLearnedGain(String& url, float& gainDb) {
+    LearnedGain learned;
+    if (!learnedGainQueue || xQueueReceive(learnedGainQueue, &learned, 0) != pdTRUE) {
+        return false;
+    }
+    url = learned.url;
+    gainDb = learned.gainDb;
+    return true;
+}
+
+void AudioManager::setEqualizer(const EqBand* bands, size_t count) {
+    if (!pipelineMutex || !eqStage) {
+        return;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    eqStage->setBands(bands, count);
+    xSemaphoreGive(pipelineMutex);
+    Serial.printf("[AUDIO] Equalizer set to %u bands\n", (unsigned)min(count, EQ_MAX_BANDS));
+}
+
+bool AudioManager::setEqualizerKernel(AudioOutputEqualizer::Kernel kernel) {
+    if (!pipelineMutex || !eqStage) {
+        return false;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool ok = eqStage->setKernel(kernel);
+    xSemaphoreGive(pipelineMutex);
+    return ok;
+}
+
+void AudioManager::setSpectrumEnabled(bool enabled) {
+    if (!pipelineMutex || !spectrumStage) {
+        return;
+    }
+    // The audio task writes the history only inside pump()
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    spectrumStage->setEnabled(enabled);
+    xSemaphoreGive(pipelineMutex);
+}
+
+bool AudioManager::getSpectrum(uint8_t* bars, size_t count) {
+    // Lock free: the FFT must not hold up the decoder
+    return spectrumStage && spectrumStage->analyze(bars, count);
+}
+
+const PcmClip* AudioManager::findClip(const char* path) const {
+    for (size_t i = 0; i < clipCount; i++) {
+        if (strcmp(clips[i].path, path) == 0) {
+            return &clips[i].pcm;
+        }
+    }
+    return nullptr;
+}
+
+bool AudioManager::loadClip(const char* path) {
+    if (!path || !*path) {
+        return false;
+    }
+    if (findClip(path)) {
+        return true;
+    }
+    if (clipCount == MAX_CLIPS || strlen(path) >= sizeof(clips[0].path)) {
+        Serial.printf("[ERROR] Cannot keep clip %s\n", path);
+        return false;
+    }
+    // Decoded outside the pipeline lock; the slot is published only when complete
+    LoadedClip& clip = clips[clipCount];
+    if (!AudioDecoder::decodeClip(path, mp3Backend, clip.pcm)) {
+        return false;
+    }
+    strlcpy(clip.path, path, sizeof(clip.path));
+    clipCount++;
+    return true;
+}
+
+bool AudioManager::playClip(const char* path, float gainDb) {
+    if (!pipelineMutex || !mixerStage || !loadClip(path)) {
+        return false;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool ok = mixerStage->play(findClip(path), gainDb, true);
+    xSemaphoreGive(pipelineMutex);
+    if (ok) {
+        clipPlaying = true;
+        Serial.printf("[AUDIO] Clip %s\n", path);
+    }
+    return ok;
+}
+
+void AudioManager::stopClips() {
+    if (!pipelineMutex || !mixerStage) {
+        return;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    mixerStage->stopAll();
+    xSemaphoreGive(pipelineMutex);
+}
+
+void AudioManager::setDuckLevel(float db) {
+    duckDb = db;
+    if (!pipelineMutex || !mixerStage) {
+        return;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    mixerStage->setDuckLevel(db);
+    xSemaphoreGive(pipelineMutex);
+}
+
+void AudioManager::setFadeIn(uint32_t durationMs, AudioOutputFade::Curve curve) {
+    if (!pipelineMutex) {
+        return;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    pendingFadeMs = durationMs;
+    pendingFadeCurve = curve;
+    xSemaphoreGive(pipelineMutex);
+}
+
+void AudioManager::applyPendingFade() {
+    // Caller holds pipelineMutex. The fade belongs to one playback only,
+    // whatever starts after it plays at full volume again.
+    if (pendingFadeMs > 0) {
+        fadeStage->startFadeIn(pendingFadeMs, pendingFadeCurve);
+        pendingFadeMs = 0;
+    } else {
+        fadeStage->cancel();
+    }
+}
+
+void AudioManager::setStallTimeout(uint32_t ms) {
+    stallTimeoutMs = constrain(ms, (uint32_t)500, (uint32_t)10000);
+}
+
+void AudioManager::setBufferLimits(size_t minBytes, size_t maxBytes) {
+    for (AudioStreamSlot& slot : slots) {
+        slot.jitterBuffer.setLimits(minBytes, maxBytes);
+    }
+}
+
+void AudioManager::setPreBufferPercent(uint8_t percent) {
+    for (AudioStreamSlot& slot : slots) {
+        slot.jitterBuffer.setPreBufferPercent(percent);
+    }
+}
+
+void AudioManager::setFallbackFile(const char* path) {
+    strlcpy(fallbackPath, path ? path : "", sizeof(fallbackPath));
+}
+
+bool AudioManager::startStreamDecoder() {
+    // Caller holds pipelineMutex
+    streamState = StreamState::Playing;
+    lastReadTotal = stream->jitterBuffer.getRing().totalRead();
+    lastProgressMs = millis();
+
+    // The history indexes MPEG and ADTS frames only, Opus plays live
+    if (stream->codec == StreamCodec::Opus && fileSource == &timeshiftSource) {
+        fileSource = &stream->ringSource;
+    }
+
+    // Create the decoder for the stream codec, fed from the ring
+    audioGenerator = AudioDecoder::create(stream->codec, mp3Backend);
+    if (!audioGenerator->begin(fileSource, crossfadeStage)) {
+        Serial.printf("Failed to start %s decoder\n", AudioCodec::name(stream->codec));
+        return false;
+    }
+    return true;
+}
+
+void AudioManager::detectStreamCodec() {
+    // Caller holds pipelineMutex. Probe a few frames at the start of the ring;
+    // the buffer is static to keep it off the audio task stack.
+    static uint8_t probe[CODEC_PROBE_BYTES];
+    size_t len = stream->jitterBuffer.getRing().peek(probe, sizeof(probe));
+
+    StreamCodec codec = AudioCodec::fromFrameSync(probe, len);
+    if (codec == StreamCodec::Unknown) {
+        // Not worth caching; the MP3 decoder resyncs on its own
+        Serial.println("[AUDIO] Stream codec not recognized, trying MP3");
+        stream->codec = StreamCodec::MP3;
+        return;
+    }
+
+    Serial.printf("[AUDIO] Stream codec %s from frame sync\n", AudioCodec::name(codec));
+    stream->codec = codec;
+    stream->codecDetected = true;
+}
+
+bool AudioManager::takeDetectedCodec(String& url, StreamCodec& codec) {
+    // A station switched away from may still have a detection to hand out
+    for (AudioStreamSlot& slot : slots) {
+        if (slot.codecDetected.exchange(false)) {
+            if (strcmp(slot.resolveUrl, slot.url) != 0) {
+                continue;  // Codec of a variant, not of the station URL
+            }
+            url = slot.url;
+            codec = slot.codec;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AudioManager::checkStreamStall(uint32_t now, uint32_t& onset) {
+    // Caller holds pipelineMutex
+    const AudioRingBuffer& ring = stream->jitterBuffer.getRing();
+
+    // Decoder progress: the read position must keep moving
+    uint32_t readTotal = ring.totalRead();
+    if (readTotal != lastReadTotal) {
+        lastReadTotal = readTotal;
+        lastProgressMs = now;
+    }
+
+    // Byte rate: the producer must keep getting data (or be throttled by a full ring)
+    uint32_t lastData = stream->lastDataMs;
+    uint32_t silentMs = elapsedSince(now, lastData);
+    if (silentMs >= stallTimeoutMs) {
+        Serial.printf("[AUDIO] No stream data for %u ms\n", silentMs);
+        onset = lastData;
+        return true;
+    }
+
+    // Don't wait for the deadline if the buffer runs dry before it, the
+    // fallback has to start while there is still stream audio to cover it
+    uint32_t drain = stream->jitterBuffer.getDrainRate();
+    if (drain > 0 && silentMs >= FALLBACK_LEAD_MS) {
+        uint32_t bufferedMs = (uint32_t)(((uint64_t)ring.available() * 1000) / drain);
+        if (bufferedMs < FALLBACK_LEAD_MS) {
+            Serial.printf("[AUDIO] Stream silent for %u ms, %u ms of audio left\n", silentMs, bufferedMs);
+            onset = lastData;
+            return true;
+        }
+    }
+
+    if (elapsedSince(now, lastProgressMs) >= stallTimeoutMs) {
+        Serial.println("[AUDIO] Stream decoder stopped making progress");
+        onset = lastProgressMs;
+        return true;
+    }
+    return false;
+}
+
+bool AudioManager::enterFallback(uint32_t onset) {
+    // Caller holds pipelineMutex
+    releaseDecoder();
+    streamState = StreamState::Fallback;
+    fallbackStartMs = millis();
+    stallCount++;
+
+    // Stale stream data is useless once the fallback plays; dial again so
+    // the stream comes back on a fresh connection
+    stream->jitterBuffer.getRing().discard(stream->jitterBuffer.getRing().available());
+    stream->reconnectRequested = true;
+
+    if (!startFallbackTrack()) {
+        Serial.println("[AUDIO] Fallback track unavailable, waiting for the stream");
+        return false;
+    }
+
+    uint32_t latency = elapsedSince(millis(), onset);
+    lastTimeToFallback = latency;
+    if (latency > maxTimeToFallback) {
+        maxTimeToFallback = latency;
+    }
+    Serial.printf("[AUDIO] Stream stalled, fallback track started %u ms after onset\n", latency);
+    return true;
+}
+
+bool AudioManager::startFallbackTrack() {
+    // Caller holds pipelineMutex
+    if (fallbackPath[0] == '\0' || !SD.exists(fallbackPath)) {
+        // An alarm must not wait in silence for the stream to come back
+        return alarmPlayback && startTone(0, 0);
+    }
+
+    sdSource = new AudioFileSourceSDBlock(fallbackPath, SD_READ_BLOCK);
+    fileSource = sdSource;
+    if (!fileSource->isOpen()) {
+        Serial.printf("Failed to open file: %s\n", fallbackPath);
+        releaseDecoder();
+        return false;
+    }
+
+    audioGenerator = AudioDecoder::create(StreamCodec::MP3, mp3Backend);
+    if (!audioGenerator->begin(fileSource, crossfadeStage)) {
+        Serial.println("Failed to start MP3 decoder");
+        releaseDecoder();
+        return false;
+    }
+    return true;
+}
+
+bool AudioManager::startTone(uint8_t pattern, uint32_t rampMs) {
+    // Caller holds pipelineMutex
+    toneGenerator.setPattern(pattern, rampMs);
+    if (!toneGenerator.begin(nullptr, audioOutput)) {
+        Serial.println("[ERROR] Failed to start the alarm tone");
+        return false;
+    }
+    audioGenerator = &toneGenerator;
+
+    // Fill the DMA buffers now instead of on the next audio task pass
+    toneGenerator.loop();
+    Serial.printf("[AUDIO] Playing alarm tone \"%s\"\n", AudioGeneratorTone::patternName(pattern));
+    return true;
+}
+
+bool AudioManager::playTone(uint8_t pattern, uint32_t rampMs) {
+    if (!pipelineMutex) {
+        return false;
+    }
+    uint32_t start = micros();
+
+    // Unlike stop() this does not queue up for networkMutex behind the
+    // network task; it drops unwanted slots itself
+    for (AudioStreamSlot& slot : slots) {
+        slot.wanted = false;
+        slot.onAir = false;
+        slot.ringSource.close();
+    }
+
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    cleanup();
+
+    // The tone bypasses fadeStage and ramps itself, the fade must not be
+    // left over for whatever plays next
+    pendingFadeMs = 0;
+    fadeStage->cancel();
+    startLoudness(0.0f);
+
+    if (!startTone(pattern, rampMs)) {
+        xSemaphoreGive(pipelineMutex);
+        return false;
+    }
+    isStreaming = false;
+    playing = true;
+
+    // fadeStage does not see the tone, so recordFirstSample() can't either
+    if (awaitingFirstSample) {
+        awaitingFirstSample = false;
+        lastTriggerLatency = millis() - triggerMs;
+        Serial.printf("[AUDIO] First sample %u ms after alarm trigger (tone)\n", lastTriggerLatency.load());
+    }
+    xSemaphoreGive(pipelineMutex);
+
+    Serial.printf("[AUDIO] Tone started in %lu us\n", (unsigned long)(micros() - start));
+    notifyPlaybackState(true);
+    return true;
+}
+
+void AudioManager::checkStreamRecovery(uint32_t now) {
+    // Caller holds pipelineMutex. Only switch back on a connection made after
+    // the stall that is delivering data again and has refilled the buffer.
+    if ((int32_t)(stream->connectedMs.load() - fallbackStartMs) < 0 ||
+        elapsedSince(now, stream->lastDataMs) >= stallTimeoutMs ||
+        !stream->jitterBuffer.isPrimed()) {
+        return;
+    }
+
+    // Played on from the live edge, the history from before the stall stays
+    releaseDecoder();
+    fileSource = streamSource(false);
+    timeshift.skip(timeshift.available());
+    stream->ringSource.reopen();
+    if (!startStreamDecoder()) {
+        // Try again on the next pass, the fallback track restarts meanwhile
+        releaseDecoder();
+        streamState = StreamState::Fallback;
+        startFallbackTrack();
+        return;
+    }
+
+    uint32_t latency = elapsedSince(millis(), stream->dataResumedMs);
+    lastTimeToRecover = latency;
+    if (latency > maxTimeToRecover) {
+        maxTimeToRecover = latency;
+    }
+    recoveryCount++;
+    Serial.printf("[AUDIO] Stream recovered, back on air %u ms after data resumed\n", latency);
+}
+
+AudioFileSource* AudioManager::streamSource(bool newStation) {
+    // Caller holds pipelineMutex, the decoder is not running
+    if (!timeshift.isAllocated()) {
+        return &stream->ringSource;
+    }
+    if (newStation) {
+        timeshift.reset();
+        paused = false;
+    }
+    timeshiftSource.setLive(&stream->ringSource);
+    return &timeshiftSource;
+}
+
+void AudioManager::feedTimeshift() {
+    // Caller holds pipelineMutex. The chunk is static to keep it off the
+    // audio task stack; only what is buffered now is moved, so a fast
+    // producer cannot keep the audio task here.
+    static uint8_t chunk[TIMESHIFT_CHUNK];
+    AudioRingBuffer& ring = stream->jitterBuffer.getRing();
+    size_t pending = ring.available();
+    while (pending > 0) {
+        size_t len = ring.read(chunk, min(pending, sizeof(chunk)));
+        if (len == 0) {
+            break;
+        }
+        timeshift.write(chunk, len);
+        pending -= len;
+    }
+
+    // The stall watchdog takes over again once playback is back at the edge
+    lastReadTotal = ring.totalRead();
+    lastProgressMs = millis();
+}
+
+bool AudioManager::pause() {
+    if (!pipelineMutex) {
+        return false;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool ok = isStreaming && streamState == StreamState::Playing &&
+              audioGenerator && fileSource == &timeshiftSource;
+    if (ok && !paused) {
+        paused = true;
+        // Silence instead of the last DMA buffers playing in a loop
+        audioOutput->flush();
+        Serial.println("[AUDIO] Stream paused, timeshift keeps recording");
+    }
+    xSemaphoreGive(pipelineMutex);
+    return ok;
+}
+
+bool AudioManager::resume() {
+    if (!pipelineMutex) {
+        return false;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool ok = paused;
+    if (ok) {
+        paused = false;
+        fadeStage->startFadeIn(TIMESHIFT_FADE_MS, AudioOutputFade::Curve::Linear);
+        Serial.printf("[AUDIO] Stream resumed %u ms behind live\n", timeshift.getDelayMs());
+    }
+    xSemaphoreGive(pipelineMutex);
+    return ok;
+}
+
+bool AudioManager::seekBehindLive(uint32_t ms) {
+    if (!pipelineMutex) {
+        return false;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    bool ok = isStreaming && streamState == StreamState::Playing && fileSource == &timeshiftSource;
+    if (ok) {
+        // Bring the history up to date so the offset counts from the real edge
+        feedTimeshift();
+        ok = timeshift.seekBehindLive(ms);
+    }
+
+    bool finished = false;
+    if (ok) {
+        // The history is indexed by frame, so the new decoder starts on a
+        // frame boundary and needs no resync
+        releaseDecoder();
+        fileSource = &timeshiftSource;
+        paused = false;
+        fadeStage->startFadeIn(TIMESHIFT_FADE_MS, AudioOutputFade::Curve::Linear);
+        if (!startStreamDecoder()) {
+            cleanup();
+            finished = true;
+            ok = false;
+        } else {
+            Serial.printf("[AUDIO] Timeshift: %u ms behind live\n", timeshift.getDelayMs());
+        }
+    }
+    xSemaphoreGive(pipelineMutex);
+
+    if (finished) {
+        notifyPlaybackState(false);
+    }
+    return ok;
+}
+
+AudioManager::TimeshiftStatus AudioManager::getTimeshiftStatus() const {
+    TimeshiftStatus status = {};
+    if (!pipelineMutex) {
+        return status;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    status.enabled = timeshift.isAllocated();
+    status.paused = paused;
+    status.delayMs = timeshift.getDelayMs();
+    status.windowMs = timeshift.getWindowMs();
+    status.capacity = timeshift.capacity();
+    xSemaphoreGive(pipelineMutex);
+    return status;
+}
+
+AudioManager::PumpStats AudioManager::getPumpStats() const {
+    const AudioRingBuffer& ring = stream->jitterBuffer.getRing();
+    PumpStats stats;
+    stats.bufferCapacity = ring.capacity();
+    stats.bufferFill = ring.available();
+    stats.fillPercent = ring.fillPercent();
+    stats.targetDepth = stream->jitterBuffer.getTargetDepth();
+    stats.jitterMs = stream->jitterBuffer.getJitterMs();
+    stats.throughput = stream->jitterBuffer.getThroughput();
+    stats.underruns = stream->ringSource.getUnderrunCount();
+    stats.underrunMs = stream->ringSource.getUnderrunMs();
+    stats.bytesReceived = stream->reader.getBytesReceived();
+    return stats;
+}
+
+uint32_t AudioManager::getFilePosition(String& path) const {
+    path = "";
+    if (!pipelineMutex) {
+        return 0;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    path = filePath;
+    uint32_t position = filePositionMs();
+    xSemaphoreGive(pipelineMutex);
+    return position;
+}
+
+uint32_t AudioManager::filePositionMs() const {
+    // Caller holds pipelineMutex
+    int rate = fadeStage->getRate();
+    if (!filePlaying || rate <= 0) {
+        return fileStartMs;
+    }
+    uint32_t samples = fadeStage->getSamplesConsumed() - fileStartSamples;
+    return fileStartMs + (uint32_t)((uint64_t)samples * 1000 / rate);
+}
+
+AudioFileSourceSDBlock::ReadStats AudioManager::getSdReadStats() const {
+    if (!pipelineMutex) {
+        return lastSdStats;
+    }
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    AudioFileSourceSDBlock::ReadStats stats = sdSource ? sdSource->getReadStats() : lastSdStats;
+    xSemaphoreGive(pipelineMutex);
+    return stats;
+}
+
+AudioManager::SwitchStats AudioManager::getSwitchStats() const {
+    SwitchStats stats;
+    stats.switches = switchCount;
+    stats.gapless = gaplessCount;
+    stats.lastSwitchMs = lastSwitchMs;
+    stats.maxSwitchMs = maxSwitchMs;
+    stats.pending = incoming != nullptr;
+    stats.psramBytes = crossfadeStage ? crossfadeStage->getBufferBytes() : 0;
+    for (const AudioStreamSlot& slot : slots) {
+        const AudioRingBuffer& ring = slot.jitterBuffer.getRing();
+        stats.psramBytes += ring.isAllocated() ? ring.capacity() : 0;
+    }
+    stats.psramBudget = psramBudget;
+    return stats;
+}
+
+AudioManager::StallStats AudioManager::getStallStats() const {
+    StallStats stats;
+    stats.stalls = stallCount;
+    stats.recoveries = recoveryCount;
+    stats.reconnects = reconnectCount;
+    stats.lastTimeToFallback = lastTimeToFallback;
+    stats.maxTimeToFallback = maxTimeToFallback;
+    stats.lastTimeToRecover = lastTimeToRecover;
+    stats.maxTimeToRecover = maxTimeToRecover;
+    stats.inFallback = isStreaming && streamState == StreamState::Fallback;
+    return stats;
+}
+
+void AudioManager::keepPreparedBufferFresh() {
+    // Caller holds pipelineMutex. A held stream must stay live rather than
+    // stop reading (and get dropped by the server), so the oldest data goes
+    // and the ring stays just below the target depth.
+    AudioRingBuffer& ring = stream->jitterBuffer.getRing();
+    size_t target = stream->jitterBuffer.getTargetDepth();
+    size_t available = ring.available();
+    if (available + PREPARED_READ_SLACK > target) {
+        ring.discard(available + PREPARED_READ_SLACK - target);
+    }
+}
+
+void AudioManager::releaseDecoder() {
+    // Caller holds pipelineMutex
+    if (audioGenerator) {
+        if (audioGenerator->isRunning()) {
+            audioGenerator->stop();
+        }
+        if (audioGenerator != &toneGenerator) {
+            delete audioGenerator;
+        }
+        audioGenerator = nullptr;
+    }
+
+    // Samples from a decoder that is going away don't count as the first one
+    triggerSampleCount = fadeStage->getSamplesConsumed();
+
+    if (filePlaying) {
+        // Remember where the file stopped
+        fileStartMs = filePositionMs();
+        filePlaying = false;
+    }
+
+    if (sdSource) {
+        // Keep the read statistics of the last file around for getSdReadStats()
+        lastSdStats = sdSource->getReadStats();
+        if (lastSdStats.blocks > 0) {
+            Serial.printf("[AUDIO] SD reads: %u blocks, %u B/s, latency p50 %u us, p95 %u us, p99 %u us, underruns: %u\n",
+                          lastSdStats.blocks, lastSdStats.bytesPerSecond, lastSdStats.p50Us,
+                          lastSdStats.p95Us, lastSdStats.p99Us, lastSdStats.underruns);
+        }
+        sdSource = nullptr;
+    }
+
+    // The ring and timeshift sources are members and outlive the decoder
+    if (fileSource && fileSource != &stream->ringSource && fileSource != &timeshiftSource) {
+        delete fileSource;
+    }
+    fileSource = nullptr;
+}
+
+void AudioManager::cleanup() {
+    // Caller holds pipelineMutex
+    releaseDecoder();
+
+    // Stops the sink if a switch kept it running for a decoder that never came
+    crossfadeStage->cancel();
+    dropIncoming();
+
+    if (isStreaming) {
+        publishLearnedGain();
+
+        // Tell the network task to drop the connection
+        stream->wanted = false;
+        stream->onAir = false;
+        stream->ringSource.close();
+        postNowPlaying("");
+    }
+
+    isStreaming = false;
+    streamState = StreamState::PreBuffering;
+    holdForTrigger = false;
+    paused = false;
+    playing = false;
+}
+
+void AudioManager::postNowPlaying(const char* streamTitle) {
+    if (!nowPlayingQueue) {
+        return;
+    }
+    NowPlaying nowPlaying;
+    nowPlaying.fromStreamTitle(streamTitle);
+    xQueueOverwrite(nowPlayingQueue, &nowPlaying);
+}
+
+bool AudioManager::receiveNowPlaying(NowPlaying& nowPlaying) {
+    return nowPlayingQueue && xQueueReceive(nowPlayingQueue, &nowPlaying, 0) == pdTRUE;
+}
+
+void AudioManager::notifyPlaybackState(bool isPlaying) {
+    lastStateChange = millis();
+    // Only the playback an alarm started falls back to the tone
+    alarmPlayback = isPlaying && alarmPending.exchange(false);
+    if (playbackStateCallback) {
+        playbackStateCallback(isPlaying);
+    }
+}
+
+void AudioManager::audioTask(void* parameter) {
+    AudioManager* self = static_cast<AudioManager*>(parameter);
+    uint32_t lastStatsLog = 0;
+
+    while (1) {
+        bool active = self->pump();
+
+        // Log pipeline health while a stream is running
+        uint32_t now = millis();
+        if (active && self->isStreaming && now - lastStatsLog >= STATS_LOG_INTERVAL) {
+            PumpStats stats = self->getPumpStats();
+            Serial.printf("[AUDIO] Buffer %u/%u bytes (target %u), jitter %u ms, %u B/s, underruns: %u (%u ms)\n",
+                          (unsigned)stats.bufferFill, (unsigned)stats.bufferCapacity,
+                          (unsigned)stats.targetDepth, stats.jitterMs, stats.throughput,
+                          stats.underruns, stats.underrunMs);
+            AudioTelemetry::Snapshot telemetry = self->getTelemetry();
+            if (telemetry.pipelineFrames > 0) {
+                Serial.printf("[AUDIO] Pipeline p50 %u us, p95 %u us, p99 %u us per frame, telemetry %u.%03u%% CPU\n",
+                              telemetry.pipelineP50Us, telemetry.pipelineP95Us, telemetry.pipelineP99Us,
+                              telemetry.overheadPpm / 10000, (telemetry.overheadPpm / 10) % 1000);
+            }
+            if (self->isSpectrumEnabled()) {
+                Serial.printf("[AUDIO] Spectrum: %u us per frame\n", self->getSpectrumFrameMicros());
+            }
+#ifdef AUDIO_BENCHMARK
+            Serial.printf("[AUDIO] Audio task stack: %u of %u B unused\n",
+                          (unsigned)uxTaskGetStackHighWaterMark(nullptr), (unsigned)AUDIO_TASK_STACK);
+            Serial.printf("[AUDIO] EQ %s: %u bands, %u cycles per frame\n",
+                          AudioOutputEqualizer::kernelName(self->eqStage->getKernel()),
+                          (unsigned)self->eqStage->getBandCount(), self->eqStage->getCyclesPerFrame());
+#endif
+            lastStatsLog = now;
+        }
+
+        // The decoder returns as soon as the I2S DMA buffers are full, so a
+        // one tick sleep keeps them topped up without spinning
+        vTaskDelay(pdMS_TO_TICKS(active ? 1 : 10));
+    }
+}
+
+void AudioManager::networkTask(void* parameter) {
+    AudioManager* self = static_cast<AudioManager*>(parameter);
+
+    while (1) {
+        int moved = 0;
+        uint32_t now = millis();
+
+        // Both slots are pumped while a switch overlaps the old and new station
+        xSemaphoreTake(self->networkMutex, portMAX_DELAY);
+        for (AudioStreamSlot& slot : self->slots) {
+            moved = max(moved, self->pumpSlot(slot, now));
+        }
+        xSemaphoreGive(self->networkMutex);
+
+        vTaskDelay(pdMS_TO_TICKS(moved > 0 ? 1 : 5));
+    }
+}
+
+void AudioManager::dialTask(void* parameter) {
+    AudioManager* self = static_cast<AudioManager*>(parameter);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (AudioStreamSlot& slot : self->slots) {
+            if (slot.redial) {
+                self->redialSlot(slot);
+            }
+        }
+
+        int variant = self->dialVariant;
+        if (variant >= 0) {
+            if (!self->beginVariantSwitch(variant)) {
+                xSemaphoreTake(self->pipelineMutex, portMAX_DELAY);
+                self->bitrateSelector.onSwitchFailed();
+                xSemaphoreGive(self->pipelineMutex);
+            }
+            self->dialVariant = -1;
+        }
+    }
+}
+
+void AudioManager::redialSlot(AudioStreamSlot& slot) {
+    // slot.connecting is set: the network task and the other callers leave
+    // the reader alone until the connect is over, without waiting for it
+    char streamUrl[sizeof(slot.streamUrl)];
+    char resolveUrl[sizeof(slot.resolveUrl)];
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    strlcpy(streamUrl, slot.streamUrl, sizeof(streamUrl));
+    strlcpy(resolveUrl, slot.resolveUrl, sizeof(resolveUrl));
+    xSemaphoreGive(networkMutex);
+
+    bool opened = slot.wanted && slot.reader.open(streamUrl);
+
+    // The stream behind a playlist or redirect may have moved
+    String fresh;
+    bool resolved = false;
+    if (!opened && slot.wanted && strcmp(streamUrl, resolveUrl) != 0) {
+        StreamResolver::getInstance().reportFailure(resolveUrl);
+        resolved = StreamResolver::getInstance().resolve(resolveUrl, fresh);
+    }
+
+    xSemaphoreTake(networkMutex, portMAX_DELAY);
+    uint32_t now = millis();
+    if (opened && slot.wanted) {
+        slot.connectedMs = now;
+        reconnectCount++;
+        slot.awaitingData = true;
+    } else {
+        // Stopped while dialing, or the connect failed
+        slot.reader.close();
+        if (resolved) {
+            strlcpy(slot.streamUrl, fresh.c_str(), sizeof(slot.streamUrl));
+        }
+        slot.nextConnectMs = now + slot.backoff;
+        slot.backoff = min(slot.backoff * 2, RECONNECT_BACKOFF_MAX);
+    }
+    slot.redial = false;
+    slot.connecting = false;
+    xSemaphoreGive(networkMutex);
+}
+
+int AudioManager::pumpSlot(AudioStreamSlot& slot, uint32_t now) {
+    // Caller holds networkMutex
+    AudioStreamReader& reader = slot.reader;
+    if (slot.connecting) {
+        // playStream() is dialing the next station on this slot
+        return 0;
+    }
+    if (slot.backoff == 0) {
+        slot.backoff = RECONNECT_BACKOFF_MIN;
+    }
+
+    int moved = 0;
+    if (!slot.wanted) {
+        // Playback stopped, nobody will read what we fetch
+        reader.close();
+        slot.backoff = RECONNECT_BACKOFF_MIN;
+        slot.nextConnectMs = 0;
+    } else if (slot.reconnectRequested.exchange(false)) {
+        Serial.println("[AUDIO] Reconnecting stalled stream");
+        reader.close();
+        slot.nextConnectMs = now;
+    } else if (!reader.isOpen()) {
+        // Dial again with exponential backoff while the fallback covers. The
+        // dial task connects, this task keeps pumping the other slot.
+        if ((int32_t)(now - slot.nextConnectMs) >= 0 && dialTaskHandle) {
+            slot.connecting = true;
+            slot.redial = true;
+            xTaskNotifyGive(dialTaskHandle);
+        }
+    } else {
+        AudioJitterBuffer& jitter = slot.jitterBuffer;
+        size_t target = jitter.getTargetDepth();
+        moved = reader.pump(jitter.getRing(), target);
+        if (reader.takeTitleChange() && slot.onAir) {
+            char streamTitle[IcyMetadataParser::TITLE_SIZE];
+            reader.copyStreamTitle(streamTitle, sizeof(streamTitle));
+            Serial.printf("[AUDIO] Now playing: %s\n", streamTitle);
+            postNowPlaying(streamTitle);
+        }
+        if (moved > 0) {
+            jitter.onArrival(moved);
+            slot.ringSource.setRefillLevel(jitter.getStartWatermark());
+            slot.lastDataMs = now;
+            if (slot.awaitingData) {
+                slot.dataResumedMs = now;
+                slot.awaitingData = false;
+            }
+            slot.backoff = RECONNECT_BACKOFF_MIN;
+        } else if (moved == 0 && jitter.getRing().available() >= target) {
+            // Throttled by a full buffer, not a stall
+            jitter.markThrottled();
+            slot.lastDataMs = now;
+        } else if (moved < 0) {
+            Serial.println("[AUDIO] Stream connection lost");
+            reader.close();
+            slot.nextConnectMs = now;
+        } else {
+            // A socket that stays open but silent never reports an error
+            uint32_t lastActivity = slot.lastDataMs;
+            uint32_t connected = slot.connectedMs;
+            if ((int32_t)(connected - lastActivity) > 0) {
+                lastActivity = connected;
+            }
+            if (elapsedSince(now, lastActivity) >= 2 * stallTimeoutMs) {
+                Serial.println("[AUDIO] Stream connection silent, dropping it");
+                reader.close();
+                slot.nextConnectMs = now;
+            }
+        }
     }
+    return moved;
 }
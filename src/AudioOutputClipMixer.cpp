@@ -0,0 +1,204 @@
+#include "AudioOutputClipMixer.h"
+#include <math.h>
+
+// Full scale gain in Q15
+static const int32_t GAIN_ONE = 1 << 15;
+
+// Main audio goes down fast enough that the clip's first word is clear,
+// and comes back slowly so the return is not heard as a jump
+static const uint32_t DUCK_ATTACK_MS = 30;
+static const uint32_t DUCK_RELEASE_MS = 400;
+
+// Output rate while clips play without a decoder
+static const int IDLE_RATE = 44100;
+
+// Frames rendered per fillIdle() call at most, the I2S DMA refuses earlier
+static const uint32_t IDLE_CHUNK = 1024;
+
+static inline int16_t saturate(int32_t value) {
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+bool AudioOutputClipMixer::play(const PcmClip* clip, float gainDb, bool duck) {
+    if (!clip || !clip->samples || clip->frames == 0 || clip->rate == 0) {
+        return false;
+    }
+    for (Voice& voice : voices) {
+        if (voice.clip) {
+            continue;
+        }
+        voice.clip = clip;
+        voice.pos = 0;
+        voice.frac = 0;
+        voice.step = hertz > 0 ? (uint32_t)(((uint64_t)clip->rate << 16) / hertz) : 1u << 16;
+        voice.gain = (int32_t)(GAIN_ONE * powf(10.0f, min(gainDb, 0.0f) / 20.0f));
+        voice.duck = duck;
+        activeVoices++;
+        if (duck) {
+            duckingVoices++;
+        }
+        return true;
+    }
+    return false;
+}
+
+void AudioOutputClipMixer::stopAll() {
+    for (Voice& voice : voices) {
+        voice.clip = nullptr;
+    }
+    activeVoices = 0;
+    duckingVoices = 0;
+}
+
+void AudioOutputClipMixer::setDuckLevel(float db) {
+    float gain = powf(10.0f, min(db, 0.0f) / 20.0f);
+    duckLevel = (uint32_t)(gain * GAIN_ONE) << 16;
+    updateSteps();
+}
+
+void AudioOutputClipMixer::updateSteps() {
+    int rate = hertz > 0 ? hertz : IDLE_RATE;
+    uint32_t range = DUCK_ONE - duckLevel;
+    attackStep = max((uint32_t)1, (uint32_t)((uint64_t)range * 1000 / ((uint64_t)rate * DUCK_ATTACK_MS)));
+    releaseStep = max((uint32_t)1, (uint32_t)((uint64_t)range * 1000 / ((uint64_t)rate * DUCK_RELEASE_MS)));
+}
+
+bool AudioOutputClipMixer::SetRate(int hz) {
+    bool ok = AudioOutputStage::SetRate(hz);
+    if (hz > 0) {
+        for (Voice& voice : voices) {
+            if (voice.clip) {
+                voice.step = (uint32_t)(((uint64_t)voice.clip->rate << 16) / hz);
+            }
+        }
+    }
+    updateSteps();
+    return ok;
+}
+
+bool AudioOutputClipMixer::begin() {
+    upstreamBegun = true;
+    if (sinkRunning) {
+        // Clips kept the sink running, the decoder joins in
+        return true;
+    }
+    sinkRunning = sink->begin();
+    return sinkRunning;
+}
+
+bool AudioOutputClipMixer::stop() {
+    upstreamBegun = false;
+    if (activeVoices > 0) {
+        // fillIdle() stops the sink after the last clip
+        return true;
+    }
+    sinkRunning = false;
+    return sink->stop();
+}
+
+void AudioOutputClipMixer::mix(const int16_t in[2], int16_t out[2]) const {
+    int32_t gain = (int32_t)(duckGain >> 16);
+    int32_t left = ((int32_t)in[0] * gain) >> 15;
+    int32_t right = ((int32_t)in[1] * gain) >> 15;
+
+    for (const Voice& voice : voices) {
+        if (!voice.clip) {
+            continue;
+        }
+        const int16_t* samples = voice.clip->samples;
+        int32_t a = samples[voice.pos];
+        int32_t b = voice.pos + 1 < voice.clip->frames ? samples[voice.pos + 1] : a;
+        int32_t value = a + (((b - a) * (int32_t)(voice.frac >> 1)) >> 15);
+        value = (value * voice.gain) >> 15;
+        left += value;
+        right += value;
+    }
+
+    out[0] = saturate(left);
+    out[1] = saturate(right);
+}
+
+void AudioOutputClipMixer::advance() {
+    for (Voice& voice : voices) {
+        if (!voice.clip) {
+            continue;
+        }
+        voice.frac += voice.step;
+        voice.pos += voice.frac >> 16;
+        voice.frac &= 0xFFFF;
+        if (voice.pos >= voice.clip->frames) {
+            if (voice.duck) {
+                duckingVoices--;
+            }
+            voice.clip = nullptr;
+            activeVoices--;
+        }
+    }
+
+    // Ramp the main audio towards the duck level or back to unity
+    uint32_t target = duckingVoices > 0 ? duckLevel : DUCK_ONE;
+    if (duckGain > target) {
+        duckGain = duckGain - target > attackStep ? duckGain - attackStep : target;
+    } else if (duckGain < target) {
+        duckGain = target - duckGain > releaseStep ? duckGain + releaseStep : target;
+    }
+}
+
+bool AudioOutputClipMixer::ConsumeSample(int16_t sample[2]) {
+    if (activeVoices == 0 && duckGain == DUCK_ONE) {
+        return sink->ConsumeSample(sample);
+    }
+
+    int16_t mixed[2];
+    mix(sample, mixed);
+
+    // The decoder retries a sample the sink refused, only advance on success
+    if (!sink->ConsumeSample(mixed)) {
+        return false;
+    }
+    advance();
+    return true;
+}
+
+bool AudioOutputClipMixer::fillIdle() {
+    if (activeVoices == 0) {
+        duckGain = DUCK_ONE;
+        if (sinkRunning && !upstreamBegun) {
+            sinkRunning = false;
+            sink->stop();
+        }
+        return false;
+    }
+
+    if (!sinkRunning) {
+        if (hertz <= 0) {
+            SetRate(IDLE_RATE);
+        } else {
+            sink->SetRate(hertz);
+        }
+        sink->SetBitsPerSample(16);
+        sink->SetChannels(2);
+        sinkRunning = sink->begin();
+        if (!sinkRunning) {
+            stopAll();
+            return false;
+        }
+    }
+
+    static const int16_t silence[2] = {0, 0};
+    for (uint32_t i = 0; i < IDLE_CHUNK && activeVoices > 0; i++) {
+        int16_t mixed[2];
+        mix(silence, mixed);
+        if (!sink->ConsumeSample(mixed)) {
+            break;
+        }
+        advance();
+    }
+    return activeVoices > 0;
+}
@@ -0,0 +1,155 @@
+#include "AudioOutputCrossfade.h"
+#include <esp_heap_caps.h>
+
+// Full scale gain in Q15
+static const uint32_t GAIN_ONE = 1 << 15;
+
+// Highest sample rate the tail buffer is sized for
+static const uint32_t MAX_RATE = 48000;
+
+AudioOutputCrossfade::~AudioOutputCrossfade() {
+    release();
+}
+
+size_t AudioOutputCrossfade::bufferBytesFor(uint32_t durationMs) {
+    return ((size_t)MAX_RATE * durationMs / 1000) * sizeof(Frame);
+}
+
+bool AudioOutputCrossfade::allocate(uint32_t durationMs) {
+    size_t needed = (size_t)MAX_RATE * durationMs / 1000;
+    if (tail && capacity == needed) {
+        return true;
+    }
+
+    release();
+    if (needed == 0) {
+        return false;
+    }
+
+    tail = (Frame*)heap_caps_malloc(needed * sizeof(Frame), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!tail) {
+        Serial.printf("[ERROR] Failed to allocate %u byte crossfade buffer\n",
+                      (unsigned)(needed * sizeof(Frame)));
+        return false;
+    }
+    capacity = needed;
+    this->durationMs = durationMs;
+    return true;
+}
+
+void AudioOutputCrossfade::release() {
+    cancel();
+    if (tail) {
+        heap_caps_free(tail);
+        tail = nullptr;
+    }
+    capacity = 0;
+}
+
+void AudioOutputCrossfade::beginCapture() {
+    frames = 0;
+    mixPos = 0;
+    if (!tail) {
+        return;
+    }
+
+    // Capture the crossfade length at the rate of the outgoing decoder
+    uint32_t rate = hertz > 0 ? (uint32_t)hertz : 44100;
+    captureFrames = min(capacity, (size_t)((uint64_t)rate * durationMs / 1000));
+    mode = Mode::Capture;
+}
+
+void AudioOutputCrossfade::startCrossfade() {
+    if (frames == 0) {
+        // Nothing captured; the new decoder starts without a fade, the sink
+        // still has to survive the decoder change
+        mode = stopDeferred ? Mode::Mix : Mode::PassThrough;
+        step = 0;
+        return;
+    }
+
+    // A new decoder at a different rate plays the tail slightly off pitch,
+    // too short to notice next to a station change
+    mode = Mode::Mix;
+    mixPos = 0;
+    phase = 0;
+    step = (uint32_t)(((uint64_t)GAIN_ONE << 16) / frames);
+}
+
+void AudioOutputCrossfade::cancel() {
+    mode = Mode::PassThrough;
+    frames = 0;
+    mixPos = 0;
+    if (stopDeferred) {
+        stopDeferred = false;
+        sinkRunning = false;
+        sink->stop();
+    }
+}
+
+bool AudioOutputCrossfade::begin() {
+    if (sinkRunning) {
+        // The new decoder of a switch takes over the running sink
+        stopDeferred = false;
+        if (mode == Mode::Mix && frames == 0) {
+            mode = Mode::PassThrough;
+        }
+        return true;
+    }
+    sinkRunning = sink->begin();
+    return sinkRunning;
+}
+
+bool AudioOutputCrossfade::stop() {
+    if (mode != Mode::PassThrough) {
+        stopDeferred = true;
+        return true;
+    }
+    sinkRunning = false;
+    return sink->stop();
+}
+
+bool AudioOutputCrossfade::ConsumeSample(int16_t sample[2]) {
+    switch (mode) {
+        case Mode::PassThrough:
+            return sink->ConsumeSample(sample);
+
+        case Mode::Capture:
+            // Refusing the sample makes the decoder return from loop()
+            if (frames >= captureFrames) {
+                return false;
+            }
+            tail[frames][0] = sample[0];
+            tail[frames][1] = sample[1];
+            frames++;
+            return true;
+
+        case Mode::Mix:
+            break;
+    }
+
+    if (mixPos >= frames) {
+        mode = Mode::PassThrough;
+        return sink->ConsumeSample(sample);
+    }
+
+    uint32_t in = phase >> 16;
+    uint32_t out = GAIN_ONE - in;
+    int16_t mixed[2];
+    for (int ch = 0; ch < 2; ch++) {
+        int32_t value = ((int32_t)tail[mixPos][ch] * (int32_t)out +
+                         (int32_t)sample[ch] * (int32_t)in) >> 15;
+        mixed[ch] = (int16_t)constrain(value, -32768, 32767);
+    }
+
+    // The decoder retries a sample the sink refused, only advance on success
+    if (!sink->ConsumeSample(mixed)) {
+        return false;
+    }
+    mixPos++;
+    phase += step;
+    if (mixPos >= frames) {
+        mode = Mode::PassThrough;
+    }
+    return true;
+}
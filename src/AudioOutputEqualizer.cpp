@@ -0,0 +1,241 @@
+#include "AudioOutputEqualizer.h"
+#include <math.h>
+
+// stop() waits this long for the sink to take the last block; a block is
+// under 1 ms of audio, the DMA frees that much quickly
+static const uint32_t FLUSH_TIMEOUT_MS = 20;
+
+#if EQ_HAVE_ESP_DSP
+#include <dsps_biquad.h>
+
+// Q28 coefficients to float
+static const float COEFF_SCALE = 1.0f / (float)(1 << 28);
+#endif
+
+void AudioOutputEqualizer::setBands(const EqBand* bands, size_t count) {
+    if (!bands) {
+        count = 0;
+    }
+    count = min(count, EQ_MAX_BANDS);
+
+    // Samples collected under the old bands are passed on as they are
+    if (collected > 0 && pending == 0) {
+        pending = collected;
+        drained = 0;
+        collected = 0;
+    }
+
+    if (count > 0) {
+        memcpy(this->bands, bands, count * sizeof(EqBand));
+    }
+    bandCount = count;
+    design();
+    resetState();
+}
+
+bool AudioOutputEqualizer::setKernel(Kernel kernel) {
+#if !EQ_HAVE_ESP_DSP
+    if (kernel == Kernel::EspDsp) {
+        return false;
+    }
+#endif
+    this->kernel = kernel;
+    resetState();
+    filterCycles = 0;
+    filterFrames = 0;
+    return true;
+}
+
+uint32_t AudioOutputEqualizer::getCyclesPerFrame() const {
+    return filterFrames ? (uint32_t)(filterCycles / filterFrames) : 0;
+}
+
+void AudioOutputEqualizer::design() {
+    if (hertz <= 0 || bandCount == 0) {
+        return;
+    }
+
+    // Take the largest boost off the first band so a full scale signal
+    // still fits after the cascade
+    float maxBoost = 0.0f;
+    for (size_t i = 0; i < bandCount; i++) {
+        maxBoost = max(maxBoost, bands[i].gainDb);
+    }
+    float headroom = powf(10.0f, -maxBoost / 20.0f);
+
+    for (size_t i = 0; i < bandCount; i++) {
+        eqDesign(bands[i], hertz, i == 0 ? headroom : 1.0f, coeffs[i]);
+#if EQ_HAVE_ESP_DSP
+        floatCoeffs[i][0] = coeffs[i].b0 * COEFF_SCALE;
+        floatCoeffs[i][1] = coeffs[i].b1 * COEFF_SCALE;
+        floatCoeffs[i][2] = coeffs[i].b2 * COEFF_SCALE;
+        floatCoeffs[i][3] = coeffs[i].a1 * COEFF_SCALE;
+        floatCoeffs[i][4] = coeffs[i].a2 * COEFF_SCALE;
+#endif
+    }
+}
+
+void AudioOutputEqualizer::resetState() {
+    memset(state, 0, sizeof(state));
+#if EQ_HAVE_ESP_DSP
+    memset(floatState, 0, sizeof(floatState));
+#endif
+}
+
+bool AudioOutputEqualizer::SetRate(int hz) {
+    bool ok = AudioOutputStage::SetRate(hz);
+    design();
+    resetState();
+    return ok;
+}
+
+bool AudioOutputEqualizer::stop() {
+    // The end of the stream is still in the block, pass it on before the
+    // sink stops
+    flushBlock();
+    collected = 0;
+    pending = 0;
+    drained = 0;
+    resetState();
+    return AudioOutputStage::stop();
+}
+
+bool AudioOutputEqualizer::ConsumeSample(int16_t sample[2]) {
+    // The decoder retries a refused sample, so the previous block has to be
+    // out before this one is taken
+    if (pending > 0 && !drain()) {
+        return false;
+    }
+    if (bandCount == 0) {
+        return sink->ConsumeSample(sample);
+    }
+
+    block[collected * 2] = sample[0];
+    block[collected * 2 + 1] = sample[1];
+    if (++collected == BLOCK_FRAMES) {
+        process(block, BLOCK_FRAMES);
+        pending = BLOCK_FRAMES;
+        drained = 0;
+        collected = 0;
+        drain();
+    }
+    return true;
+}
+
+void AudioOutputEqualizer::flushBlock() {
+    uint32_t start = millis();
+    while (pending > 0 && !drain() && millis() - start < FLUSH_TIMEOUT_MS) {
+        delay(1);
+    }
+    if (pending == 0 && collected > 0) {
+        if (bandCount > 0) {
+            process(block, collected);
+        }
+        pending = collected;
+        drained = 0;
+        collected = 0;
+        while (!drain() && millis() - start < FLUSH_TIMEOUT_MS) {
+            delay(1);
+        }
+    }
+}
+
+bool AudioOutputEqualizer::drain() {
+    while (drained < pending) {
+        if (!sink->ConsumeSample(&block[drained * 2])) {
+            return false;
+        }
+        drained++;
+    }
+    pending = 0;
+    drained = 0;
+    return true;
+}
+
+void AudioOutputEqualizer::process(int16_t* pcm, size_t frames) {
+#ifdef AUDIO_BENCHMARK
+    uint32_t start = ESP.getCycleCount();
+#endif
+
+    switch (kernel) {
+        case Kernel::Reference:
+            eqProcessReference(coeffs, state, bandCount, pcm, frames);
+            break;
+
+#if EQ_HAVE_ESP_DSP
+        case Kernel::EspDsp: {
+            float left[BLOCK_FRAMES];
+            float right[BLOCK_FRAMES];
+            for (size_t n = 0; n < frames; n++) {
+                left[n] = pcm[n * 2];
+                right[n] = pcm[n * 2 + 1];
+            }
+            for (size_t band = 0; band < bandCount; band++) {
+                dsps_biquad_f32(left, left, frames, floatCoeffs[band], floatState[band * 2]);
+                dsps_biquad_f32(right, right, frames, floatCoeffs[band], floatState[band * 2 + 1]);
+            }
+            for (size_t n = 0; n < frames; n++) {
+                pcm[n * 2] = (int16_t)constrain(lrintf(left[n]), -32768L, 32767L);
+                pcm[n * 2 + 1] = (int16_t)constrain(lrintf(right[n]), -32768L, 32767L);
+            }
+            break;
+        }
+#endif
+
+        case Kernel::Block:
+        default:
+            eqProcessBlock(coeffs, state, bandCount, pcm, frames, work);
+            break;
+    }
+
+#ifdef AUDIO_BENCHMARK
+    filterCycles += ESP.getCycleCount() - start;
+    filterFrames += frames;
+#endif
+}
+
+void AudioOutputEqualizer::benchmark(const EqBand* bands, size_t count) {
+    static const int BLOCKS = 256;
+    static const uint32_t RATE = 44100;
+
+    AudioOutputEqualizer* eq = new AudioOutputEqualizer(nullptr);
+    eq->hertz = RATE;
+    eq->setBands(bands, count);
+
+    // Full scale noise, filtered block by block like real playback
+    int16_t pcm[BLOCK_FRAMES * 2];
+    uint32_t seed = 12345;
+    uint32_t cpuHz = getCpuFrequencyMhz() * 1000000UL;
+
+    const Kernel kernels[] = {Kernel::Reference, Kernel::Block, Kernel::EspDsp};
+    for (Kernel kernel : kernels) {
+        if (!eq->setKernel(kernel)) {
+            continue;
+        }
+        uint64_t cycles = 0;
+        for (int b = 0; b < BLOCKS; b++) {
+            for (size_t i = 0; i < BLOCK_FRAMES * 2; i++) {
+                seed = seed * 1664525 + 1013904223;
+                pcm[i] = (int16_t)(seed >> 16);
+            }
+            uint32_t start = ESP.getCycleCount();
+            eq->process(pcm, BLOCK_FRAMES);
+            cycles += ESP.getCycleCount() - start;
+        }
+        uint32_t perFrame = (uint32_t)(cycles / (BLOCKS * BLOCK_FRAMES));
+        float load = 100.0f * perFrame * RATE / cpuHz;
+        Serial.printf("[AUDIO] EQ %s, %u bands: %u cycles per stereo frame, %.2f%% of a core at 44.1 kHz\n",
+                      kernelName(kernel), (unsigned)count, perFrame, load);
+    }
+
+    delete eq;
+}
+
+const char* AudioOutputEqualizer::kernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Reference: return "reference";
+        case Kernel::EspDsp: return "esp-dsp";
+        case Kernel::Block:
+        default: return "block";
+    }
+}
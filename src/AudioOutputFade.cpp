@@ -0,0 +1,92 @@
+#include "AudioOutputFade.h"
+
+// Full scale gain in Q15
+static const uint32_t GAIN_ONE = 1 << 15;
+
+void AudioOutputFade::startFadeIn(uint32_t durationMs, Curve curve) {
+    this->durationMs = durationMs;
+    this->curve = curve;
+    fading = durationMs > 0;
+    phase = 0;
+    step = 0;
+
+    // The decoder announces the sample rate when it starts; until then the
+    // ramp holds at silence
+    pendingStart = fading;
+    if (fading && hertz > 0) {
+        armRamp();
+    }
+}
+
+void AudioOutputFade::cancel() {
+    fading = false;
+    pendingStart = false;
+}
+
+void AudioOutputFade::armRamp() {
+    uint64_t samples = ((uint64_t)hertz * durationMs) / 1000;
+    if (samples == 0) {
+        samples = 1;
+    }
+    step = (uint32_t)(((uint64_t)GAIN_ONE << 16) / samples);
+    if (step == 0) {
+        step = 1;
+    }
+    pendingStart = false;
+}
+
+bool AudioOutputFade::SetRate(int hz) {
+    bool ok = AudioOutputStage::SetRate(hz);
+    if (fading && pendingStart) {
+        armRamp();
+    }
+    return ok;
+}
+
+bool AudioOutputFade::ConsumeSample(int16_t sample[2]) {
+    if (!fading) {
+        if (!sink->ConsumeSample(sample)) {
+            return false;
+        }
+        samplesConsumed++;
+        return true;
+    }
+
+    // Linear ramp position in Q15
+    uint32_t x = phase >> 16;
+    uint32_t gain = x;
+    if (curve == Curve::Perceptual) {
+        gain = (((x * x) >> 15) * x) >> 15;
+    }
+
+    int16_t scaled[2];
+    scaled[0] = (int16_t)(((int32_t)sample[0] * (int32_t)gain) >> 15);
+    scaled[1] = (int16_t)(((int32_t)sample[1] * (int32_t)gain) >> 15);
+
+    // The decoder retries a sample the sink refused, only advance on success
+    if (!sink->ConsumeSample(scaled)) {
+        return false;
+    }
+    samplesConsumed++;
+
+    if (!pendingStart) {
+        uint32_t next = phase + step;
+        if (next < phase || (next >> 16) >= GAIN_ONE) {
+            fading = false;  // Ramp complete, pass samples through untouched
+        } else {
+            phase = next;
+        }
+    }
+    return true;
+}
+
+const char* AudioOutputFade::curveName(Curve curve) {
+    return curve == Curve::Perceptual ? "perceptual" : "linear";
+}
+
+AudioOutputFade::Curve AudioOutputFade::curveFromName(const char* name) {
+    if (name && strcmp(name, "perceptual") == 0) {
+        return Curve::Perceptual;
+    }
+    return Curve::Linear;
+}
@@ -0,0 +1,100 @@
+#include "AudioOutputLoudness.h"
+#include <math.h>
+
+// BS.1770 absolute gate
+static const float GATE_LUFS = -70.0f;
+
+static float lufsFromMeanSquare(float meanSquare) {
+    return -0.691f + 10.0f * log10f(meanSquare);
+}
+
+void AudioOutputLoudness::reset() {
+    memset(history, 0, sizeof(history));
+    blockSum = 0.0f;
+    blockFill = 0;
+    average = 0.0f;
+    gatedBlocks = 0;
+}
+
+float AudioOutputLoudness::getShortTermLufs() const {
+    return average > 0.0f ? lufsFromMeanSquare(average) : GATE_LUFS;
+}
+
+bool AudioOutputLoudness::SetRate(int hz) {
+    bool ok = AudioOutputStage::SetRate(hz);
+    design();
+    reset();
+    return ok;
+}
+
+void AudioOutputLoudness::design() {
+    if (hertz <= 0) {
+        return;
+    }
+
+    // The BS.1770 filters are specified at 48 kHz; these are the analog
+    // prototypes behind them, re-derived for the decoder's rate
+    float rate = (float)hertz;
+
+    // Stage 1: +4 dB high shelf around 1.7 kHz
+    float K = tanf((float)M_PI * 1681.974451f / rate);
+    float Q = 0.7071752370f;
+    float Vh = powf(10.0f, 3.999843854f / 20.0f);
+    float Vb = powf(Vh, 0.4996667742f);
+    float a0 = 1.0f + K / Q + K * K;
+    shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    shelf.b1 = 2.0f * (K * K - Vh) / a0;
+    shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    shelf.a1 = 2.0f * (K * K - 1.0f) / a0;
+    shelf.a2 = (1.0f - K / Q + K * K) / a0;
+
+    // Stage 2: high pass at 38 Hz
+    K = tanf((float)M_PI * 38.13547088f / rate);
+    Q = 0.5003270373f;
+    a0 = 1.0f + K / Q + K * K;
+    highpass.b0 = 1.0f;
+    highpass.b1 = -2.0f;
+    highpass.b2 = 1.0f;
+    highpass.a1 = 2.0f * (K * K - 1.0f) / a0;
+    highpass.a2 = (1.0f - K / Q + K * K) / a0;
+
+    blockLength = max((uint32_t)(rate * BLOCK_SECONDS), (uint32_t)1);
+    alpha = 1.0f - expf(-BLOCK_SECONDS / TIME_CONSTANT_SECONDS);
+}
+
+float AudioOutputLoudness::weight(float x, float* z) {
+    // Transposed direct form II, two stages
+    float y = shelf.b0 * x + z[0];
+    z[0] = shelf.b1 * x - shelf.a1 * y + z[1];
+    z[1] = shelf.b2 * x - shelf.a2 * y;
+
+    float w = highpass.b0 * y + z[2];
+    z[2] = highpass.b1 * y - highpass.a1 * w + z[3];
+    z[3] = highpass.b2 * y - highpass.a2 * w;
+    return w;
+}
+
+bool AudioOutputLoudness::ConsumeSample(int16_t sample[2]) {
+    // Measure only what the sink took, a refused sample comes again
+    int16_t left = sample[0];
+    int16_t right = sample[1];
+    if (!sink->ConsumeSample(sample)) {
+        return false;
+    }
+
+    float l = weight(left * (1.0f / 32768.0f), history[0]);
+    float r = weight(right * (1.0f / 32768.0f), history[1]);
+    blockSum += l * l + r * r;
+
+    if (++blockFill >= blockLength) {
+        // Channel powers add up (BS.1770 weights both front channels with 1)
+        float meanSquare = blockSum / blockFill;
+        if (meanSquare > 0.0f && lufsFromMeanSquare(meanSquare) > GATE_LUFS) {
+            average = gatedBlocks == 0 ? meanSquare : average + alpha * (meanSquare - average);
+            gatedBlocks++;
+        }
+        blockSum = 0.0f;
+        blockFill = 0;
+    }
+    return true;
+}
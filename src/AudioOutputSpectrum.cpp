@@ -0,0 +1,187 @@
+#include "AudioOutputSpectrum.h"
+#include <math.h>
+#if SPECTRUM_HAVE_ESP_DSP
+#include <dsps_fft2r.h>
+#endif
+
+// The band above this is dropped by decimation; bars stop below it
+static const uint32_t TARGET_RATE = 22050;
+
+// Bar range and scale
+static const float LOWEST_BAR_HZ = 50.0f;
+static const float FLOOR_DB = -60.0f;
+
+// Bars rise at once and fall by this much per frame (of 255), so a beat
+// stays visible for a few frames
+static const float BAR_RELEASE = 10.0f;
+
+static const size_t HALF_SIZE = AudioOutputSpectrum::FFT_SIZE / 2;
+
+#if SPECTRUM_HAVE_ESP_DSP
+static bool espDspReady = false;
+#endif
+
+AudioOutputSpectrum::AudioOutputSpectrum(AudioOutput* sink) : AudioOutputStage(sink) {
+    for (size_t i = 0; i < FFT_SIZE; i++) {
+        window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (FFT_SIZE - 1));
+    }
+    for (size_t k = 0; k < HALF_SIZE; k++) {
+        twiddleCos[k] = cosf(2.0f * (float)M_PI * k / FFT_SIZE);
+        twiddleSin[k] = -sinf(2.0f * (float)M_PI * k / FFT_SIZE);
+    }
+#if SPECTRUM_HAVE_ESP_DSP
+    if (!espDspReady) {
+        espDspReady = dsps_fft2r_init_fc32(NULL, HALF_SIZE) == ESP_OK;
+    }
+#endif
+}
+
+void AudioOutputSpectrum::setEnabled(bool enable) {
+    if (enable == enabled.load()) {
+        return;
+    }
+    if (enable) {
+        // The audio task leaves the history alone until enabled is set
+        memset(history, 0, sizeof(history));
+        written = 0;
+        analyzedAt = 0;
+        memset(smoothed, 0, sizeof(smoothed));
+    }
+    enabled = enable;
+}
+
+bool AudioOutputSpectrum::SetRate(int hz) {
+    bool ok = AudioOutputStage::SetRate(hz);
+    if (hz > 0) {
+        decimation = max((uint32_t)1, ((uint32_t)hz + TARGET_RATE / 2) / TARGET_RATE);
+        analysisRate = hz / decimation;
+    }
+    decimationSum = 0;
+    decimationFill = 0;
+    return ok;
+}
+
+bool AudioOutputSpectrum::ConsumeSample(int16_t sample[2]) {
+    // Look only at what the sink took, a refused sample comes again
+    int16_t left = sample[0];
+    int16_t right = sample[1];
+    if (!sink->ConsumeSample(sample)) {
+        return false;
+    }
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    // Mono, averaged over the decimation factor
+    decimationSum += left + right;
+    if (++decimationFill < decimation) {
+        return true;
+    }
+    uint32_t pos = written.load(std::memory_order_relaxed);
+    history[pos & (FFT_SIZE - 1)] = decimationSum / (int32_t)(2 * decimation);
+    written.store(pos + 1, std::memory_order_release);
+    decimationSum = 0;
+    decimationFill = 0;
+    return true;
+}
+
+bool AudioOutputSpectrum::analyze(uint8_t* bars, size_t count) {
+    uint32_t total = written.load(std::memory_order_acquire);
+    if (!enabled || total == analyzedAt || count == 0) {
+        return false;
+    }
+    analyzedAt = total;
+    if (count > MAX_BARS) {
+        count = MAX_BARS;
+    }
+    uint32_t start = micros();
+
+    // Even samples into the real parts, odd ones into the imaginary parts:
+    // a real FFT of FFT_SIZE points from one complex FFT of half the size
+    for (size_t i = 0; i < FFT_SIZE; i++) {
+        fft[i] = history[(total + i) & (FFT_SIZE - 1)] * window[i];
+    }
+    transform();
+
+    // Sum the power of the bins of each bar; the reference is a full scale
+    // sine, whose peak bin is FFT_SIZE / 4 after the Hann window
+    float binHz = (float)analysisRate.load() / FFT_SIZE;
+    float topHz = binHz * (HALF_SIZE - 1);
+    float reference = 32768.0f * FFT_SIZE / 4;
+    reference *= reference;
+    float ratio = powf(topHz / LOWEST_BAR_HZ, 1.0f / count);
+    float lowHz = LOWEST_BAR_HZ;
+
+    for (size_t b = 0; b < count; b++) {
+        float highHz = lowHz * ratio;
+        // Bars narrower than a bin at the bottom share the nearest one
+        size_t first = (size_t)(lowHz / binHz + 0.5f);
+        size_t last = (size_t)(highHz / binHz + 0.5f);
+        first = constrain(first, (size_t)1, HALF_SIZE - 1);
+        last = last > first ? min(last - 1, HALF_SIZE - 1) : first;
+        lowHz = highHz;
+
+        float sum = 0.0f;
+        for (size_t k = first; k <= last; k++) {
+            // Untangle the bin from the half-size transform
+            size_t m = (HALF_SIZE - k) & (HALF_SIZE - 1);
+            float zr = fft[2 * k], zi = fft[2 * k + 1];
+            float cr = fft[2 * m], ci = -fft[2 * m + 1];
+            float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+            float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+            float xr = er + twiddleCos[k] * or_ - twiddleSin[k] * oi;
+            float xi = ei + twiddleCos[k] * oi + twiddleSin[k] * or_;
+            sum += xr * xr + xi * xi;
+        }
+        float db = sum > 0.0f ? 10.0f * log10f(sum / reference) : FLOOR_DB;
+        float level = constrain((db - FLOOR_DB) * (255.0f / -FLOOR_DB), 0.0f, 255.0f);
+        smoothed[b] = max(level, smoothed[b] - BAR_RELEASE);
+        bars[b] = (uint8_t)smoothed[b];
+    }
+
+    uint32_t elapsed = micros() - start;
+    uint32_t average = frameMicros.load();
+    frameMicros = average == 0 ? elapsed : average + ((int32_t)(elapsed - average) >> 3);
+    return true;
+}
+
+void AudioOutputSpectrum::transform() {
+    // In place complex FFT of HALF_SIZE interleaved values
+#if SPECTRUM_HAVE_ESP_DSP
+    if (espDspReady) {
+        dsps_fft2r_fc32(fft, HALF_SIZE);
+        dsps_bit_rev_fc32(fft, HALF_SIZE);
+        return;
+    }
+#endif
+    // Portable radix 2: bit reversal, then butterflies with the twiddles
+    // of the full size at twice the stride
+    for (size_t i = 1, j = 0; i < HALF_SIZE; i++) {
+        size_t bit = HALF_SIZE >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(fft[2 * i], fft[2 * j]);
+            std::swap(fft[2 * i + 1], fft[2 * j + 1]);
+        }
+    }
+    for (size_t len = 2; len <= HALF_SIZE; len <<= 1) {
+        size_t stride = 2 * (HALF_SIZE / len);
+        for (size_t i = 0; i < HALF_SIZE; i += len) {
+            for (size_t j = 0; j < len / 2; j++) {
+                float wr = twiddleCos[j * stride];
+                float wi = twiddleSin[j * stride];
+                float* a = &fft[2 * (i + j)];
+                float* b = &fft[2 * (i + j + len / 2)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
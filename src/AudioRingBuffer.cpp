@@ -0,0 +1,133 @@
+#include "AudioRingBuffer.h"
+#include <esp_heap_caps.h>
+
+AudioRingBuffer::~AudioRingBuffer() {
+    release();
+}
+
+bool AudioRingBuffer::allocate(size_t capacity) {
+    // Round up to a power of two so positions can be masked instead of divided
+    size_t rounded = 1024;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    if (buffer && size == rounded) {
+        reset();
+        return true;
+    }
+
+    release();
+
+    buffer = (uint8_t*)heap_caps_malloc(rounded, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buffer) {
+        // Fall back to internal RAM so playback still works without PSRAM
+        buffer = (uint8_t*)heap_caps_malloc(rounded, MALLOC_CAP_8BIT);
+    }
+
+    if (!buffer) {
+        Serial.printf("[ERROR] Failed to allocate %u byte audio ring\n", (unsigned)rounded);
+        return false;
+    }
+
+    size = rounded;
+    mask = rounded - 1;
+    reset();
+    return true;
+}
+
+void AudioRingBuffer::release() {
+    if (buffer) {
+        heap_caps_free(buffer);
+        buffer = nullptr;
+    }
+    size = 0;
+    mask = 0;
+    reset();
+}
+
+void AudioRingBuffer::reset() {
+    head.store(0, std::memory_order_release);
+    tail.store(0, std::memory_order_release);
+}
+
+size_t AudioRingBuffer::write(const uint8_t* data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        uint8_t* region = nullptr;
+        size_t chunk = writeRegion(&region);
+        if (chunk == 0) {
+            break;  // Ring is full
+        }
+        chunk = min(chunk, len - written);
+        memcpy(region, data + written, chunk);
+        commitWrite(chunk);
+        written += chunk;
+    }
+    return written;
+}
+
+size_t AudioRingBuffer::writeRegion(uint8_t** region) {
+    if (!buffer) {
+        return 0;
+    }
+
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    size_t free = size - (h - t);
+    size_t offset = h & mask;
+
+    // Only hand out the part up to the physical end of the storage
+    *region = buffer + offset;
+    return min(free, size - offset);
+}
+
+void AudioRingBuffer::commitWrite(size_t len) {
+    head.store(head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+}
+
+size_t AudioRingBuffer::read(uint8_t* data, size_t len) {
+    size_t count = peek(data, len);
+    tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRingBuffer::peek(uint8_t* data, size_t len) const {
+    if (!buffer) {
+        return 0;
+    }
+
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    size_t count = min((size_t)(h - t), len);
+
+    size_t offset = t & mask;
+    size_t first = min(count, size - offset);
+    memcpy(data, buffer + offset, first);
+    if (count > first) {
+        memcpy(data + first, buffer, count - first);
+    }
+    return count;
+}
+
+size_t AudioRingBuffer::readRegion(const uint8_t** region) const {
+    if (!buffer) {
+        return 0;
+    }
+
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    size_t offset = t & mask;
+
+    // Only hand out the part up to the physical end of the storage
+    *region = buffer + offset;
+    return min((size_t)(h - t), size - offset);
+}
+
+size_t AudioRingBuffer::discard(size_t len) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    size_t count = min((size_t)(h - t), len);
+    tail.store(t + count, std::memory_order_release);
+    return count;
+}
@@ -0,0 +1,155 @@
+#include "AudioStreamReader.h"
+
+AudioStreamReader::~AudioStreamReader() {
+    close();
+}
+
+bool AudioStreamReader::open(const char* url) {
+    close();
+
+    if (!url) {
+        return false;
+    }
+
+    http.setReuse(false);
+    http.setTimeout(5000);
+    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    http.setUserAgent("Radiowecker/1.0");
+
+    // Content-Type tells us the codec before the first byte arrives,
+    // icy-metaint how often the server interleaves title metadata
+    static const char* headerKeys[] = {"Content-Type", "icy-metaint"};
+    http.collectHeaders(headerKeys, 2);
+
+    bool secure = strncmp(url, "https://", 8) == 0;
+    if (!http.begin(secure ? secureClient : client, url)) {
+        Serial.printf("[ERROR] Invalid stream URL: %s\n", url);
+        return false;
+    }
+    http.addHeader("Icy-MetaData", "1");
+
+    int httpCode = http.GET();
+    if (httpCode != HTTP_CODE_OK) {
+        Serial.printf("[ERROR] Stream request failed, HTTP code: %d\n", httpCode);
+        http.end();
+        return false;
+    }
+
+    strlcpy(contentType, http.header("Content-Type").c_str(), sizeof(contentType));
+    metadata.reset();
+    titleChanged = false;
+    metaInterval = http.header("icy-metaint").toInt();
+    audioUntilMeta = metaInterval;
+    metaRemaining = -1;
+
+    stream = http.getStreamPtr();
+    bytesReceived = 0;
+    return stream != nullptr;
+}
+
+void AudioStreamReader::close() {
+    tap = nullptr;
+    if (stream) {
+        stream = nullptr;
+        http.end();
+    }
+}
+
+int AudioStreamReader::pump(AudioRingBuffer& ring, size_t maxFill) {
+    if (!stream) {
+        return -1;
+    }
+
+    int moved = 0;
+    while (true) {
+        int pending = stream->available();
+        if (pending <= 0) {
+            // Nothing buffered: either the server is slow or the socket is gone
+            if (moved == 0 && !stream->connected()) {
+                return -1;
+            }
+            break;
+        }
+
+        // Metadata blocks are taken out of the stream before the decoder sees it
+        if (metaInterval > 0 && audioUntilMeta == 0) {
+            if (!pumpMetadata()) {
+                break;
+            }
+            continue;
+        }
+
+        size_t fill = ring.available();
+        if (fill >= maxFill) {
+            break;  // Buffer is at its target depth, the decoder is behind us
+        }
+
+        uint8_t* region = nullptr;
+        size_t space = min(ring.writeRegion(&region), maxFill - fill);
+        if (space == 0) {
+            break;
+        }
+
+        size_t chunk = min(min((size_t)pending, space), MAX_READ_CHUNK);
+        if (metaInterval > 0) {
+            chunk = min(chunk, audioUntilMeta);
+        }
+        int got = stream->read(region, chunk);
+        if (got <= 0) {
+            break;
+        }
+        if (metaInterval > 0) {
+            audioUntilMeta -= got;
+        }
+
+        if (tap) {
+            tapDropped += got - tap->write(region, got);
+        }
+        ring.commitWrite(got);
+        moved += got;
+        bytesReceived += got;
+
+        if (moved >= (int)MAX_READ_CHUNK) {
+            break;  // Give the other side of the pipeline a chance to run
+        }
+    }
+
+    return moved;
+}
+
+bool AudioStreamReader::pumpMetadata() {
+    while (audioUntilMeta == 0) {
+        int pending = stream->available();
+        if (pending <= 0) {
+            return false;  // Rest of the block is still in flight
+        }
+
+        if (metaRemaining < 0) {
+            // Length byte in units of 16 bytes, zero means no metadata
+            int length = stream->read();
+            if (length < 0) {
+                return false;
+            }
+            metaRemaining = length * 16;
+            metadata.beginBlock();
+        } else {
+            uint8_t chunk[64];
+            size_t want = min(min((size_t)pending, (size_t)metaRemaining), sizeof(chunk));
+            int got = stream->read(chunk, want);
+            if (got <= 0) {
+                return false;
+            }
+            metadata.feed(chunk, got);
+            metaRemaining -= got;
+        }
+
+        if (metaRemaining == 0) {
+            if (metadata.endBlock()) {
+                titleChanged = true;
+            }
+            metaRemaining = -1;
+            audioUntilMeta = metaInterval;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+#include "AudioTelemetry.h"
+
+void AudioTelemetry::reset() {
+    for (std::atomic<uint32_t>& count : fillCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint32_t>& count : pipelineCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    overheadPpm = 0;
+    maxOverheadPpm = 0;
+
+    uint32_t now = millis();
+    resetMs = now;
+    lastFillSample = now;
+    windowStart = now;
+    windowCycles = 0;
+    cpuMHz = ESP.getCpuFreqMHz();
+}
+
+void AudioTelemetry::sampleFill(size_t available, size_t target, uint32_t now) {
+    if (now - lastFillSample < FILL_SAMPLE_MS) {
+        return;
+    }
+    uint32_t start = ESP.getCycleCount();
+    lastFillSample = now;
+
+    size_t bucket = target > 0 ? (available * FILL_BUCKETS) / target : FILL_BUCKETS - 1;
+    fillCounts[min(bucket, FILL_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+
+    if (now - windowStart >= OVERHEAD_WINDOW_MS) {
+        closeWindow(now);
+    }
+    windowCycles += ESP.getCycleCount() - start;
+}
+
+void AudioTelemetry::endPipeline(uint32_t start, uint32_t samples, uint32_t frameSamples) {
+    uint32_t entry = ESP.getCycleCount();
+    if (samples > 0) {
+        // Scale the pass to one frame, a pass decodes as many as fit the output
+        uint32_t us = (uint32_t)(((uint64_t)(entry - start) * frameSamples) / ((uint64_t)samples * cpuMHz));
+        pipelineCounts[pipelineBucket(us)].fetch_add(1, std::memory_order_relaxed);
+    }
+    windowCycles += ESP.getCycleCount() - entry;
+}
+
+void AudioTelemetry::closeWindow(uint32_t now) {
+    // Parts per million of the cycles the core had in the window
+    uint64_t available = (uint64_t)(now - windowStart) * 1000 * cpuMHz;
+    uint32_t ppm = (uint32_t)(((uint64_t)windowCycles * 1000000) / available);
+    overheadPpm = ppm;
+    if (ppm > maxOverheadPpm) {
+        maxOverheadPpm = ppm;
+    }
+    windowStart = now;
+    windowCycles = 0;
+}
+
+AudioTelemetry::Snapshot AudioTelemetry::getSnapshot() const {
+    Snapshot snapshot = {};
+    for (size_t i = 0; i < FILL_BUCKETS; i++) {
+        snapshot.fill[i] = fillCounts[i].load(std::memory_order_relaxed);
+        snapshot.fillSamples += snapshot.fill[i];
+    }
+
+    uint32_t counts[PIPELINE_BUCKETS];
+    for (size_t i = 0; i < PIPELINE_BUCKETS; i++) {
+        counts[i] = pipelineCounts[i].load(std::memory_order_relaxed);
+        snapshot.pipelineFrames += counts[i];
+    }
+
+    // Walk the buckets once, the counts are cumulative from here on
+    uint32_t total = snapshot.pipelineFrames;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < PIPELINE_BUCKETS && total > 0; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        seen += counts[i];
+        uint32_t limit = bucketLimit(i);
+        if (snapshot.pipelineP50Us == 0 && (uint64_t)seen * 100 >= (uint64_t)total * 50) {
+            snapshot.pipelineP50Us = limit;
+        }
+        if (snapshot.pipelineP95Us == 0 && (uint64_t)seen * 100 >= (uint64_t)total * 95) {
+            snapshot.pipelineP95Us = limit;
+        }
+        if (snapshot.pipelineP99Us == 0 && (uint64_t)seen * 100 >= (uint64_t)total * 99) {
+            snapshot.pipelineP99Us = limit;
+        }
+        snapshot.pipelineMaxUs = limit;
+    }
+
+    snapshot.overheadPpm = overheadPpm;
+    snapshot.maxOverheadPpm = maxOverheadPpm;
+    snapshot.sinceMs = millis() - resetMs;
+    return snapshot;
+}
+
+size_t AudioTelemetry::pipelineBucket(uint32_t us) {
+    // 1 us steps below 16 us, then four steps per power of two (within 25%)
+    // up to the last bucket, which also takes everything from 64 ms
+    if (us < 16) {
+        return us;
+    }
+    uint32_t msb = 31 - __builtin_clz(us);
+    size_t bucket = 16 + (msb - 4) * 4 + ((us >> (msb - 2)) & 3);
+    return min(bucket, PIPELINE_BUCKETS - 1);
+}
+
+uint32_t AudioTelemetry::bucketLimit(size_t bucket) {
+    // Largest time in a bucket
+    if (bucket < 16) {
+        return bucket;
+    }
+    uint32_t msb = (bucket - 16) / 4 + 4;
+    uint32_t step = 1u << (msb - 2);
+    return (4 + (bucket - 16) % 4) * step + step - 1;
+}
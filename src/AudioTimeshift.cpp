@@ -0,0 +1,220 @@
+#include "AudioTimeshift.h"
+#include <esp_heap_caps.h>
+
+// Smallest frame expected on average (32 kbps MP3 at 44.1 kHz is 104 bytes),
+// sizes the frame index against the history
+static const size_t MIN_AVERAGE_FRAME = 96;
+
+// Enough to hold an ID3v2 header and any frame header
+static const uint32_t SCAN_LOOKAHEAD = 10;
+
+AudioTimeshift::~AudioTimeshift() {
+    release();
+}
+
+bool AudioTimeshift::allocate(size_t bytes) {
+    // Power of two sizes so positions can be masked instead of divided
+    size_t rounded = 64 * 1024;
+    while (rounded * 2 <= bytes) {
+        rounded <<= 1;
+    }
+    size_t frames = 1024;
+    while (frames < rounded / MIN_AVERAGE_FRAME) {
+        frames <<= 1;
+    }
+
+    release();
+    buffer = (uint8_t*)heap_caps_malloc(rounded, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    index = (uint32_t*)heap_caps_malloc(frames * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buffer || !index) {
+        // No internal RAM fallback, minutes of audio only fit into PSRAM
+        Serial.printf("[ERROR] Failed to allocate %u byte timeshift buffer\n", (unsigned)rounded);
+        release();
+        return false;
+    }
+
+    size = rounded;
+    mask = rounded - 1;
+    indexMask = frames - 1;
+    reset();
+    return true;
+}
+
+void AudioTimeshift::release() {
+    if (buffer) {
+        heap_caps_free(buffer);
+        buffer = nullptr;
+    }
+    if (index) {
+        heap_caps_free(index);
+        index = nullptr;
+    }
+    size = 0;
+    mask = 0;
+    indexMask = 0;
+    reset();
+}
+
+void AudioTimeshift::reset() {
+    writePos = 0;
+    readPos = 0;
+    oldest = 0;
+    frameHead = 0;
+    frameTail = 0;
+    frameUs = 0;
+    scanPos = 0;
+    inSync = false;
+}
+
+void AudioTimeshift::write(const uint8_t* data, size_t len) {
+    if (!buffer || len == 0) {
+        return;
+    }
+
+    // Only the newest bytes of an oversized write can be kept
+    if (len > size) {
+        data += len - size;
+        writePos += len - size;
+        len = size;
+    }
+
+    size_t offset = writePos & mask;
+    size_t first = min(len, size - offset);
+    memcpy(buffer + offset, data, first);
+    memcpy(buffer, data + first, len - first);
+    writePos += len;
+
+    // Drop what was overwritten, from the frame index as well
+    if (writePos - oldest > size) {
+        oldest = writePos - size;
+        while (frameTail != frameHead && (int32_t)(index[frameTail & indexMask] - oldest) < 0) {
+            frameTail++;
+        }
+        if ((int32_t)(readPos - oldest) < 0) {
+            // Paused for longer than the window: continue from the oldest frame
+            readPos = frameTail != frameHead ? index[frameTail & indexMask] : oldest;
+        }
+    }
+
+    indexFrames();
+}
+
+size_t AudioTimeshift::read(uint8_t* data, size_t len) {
+    len = min(len, available());
+    if (len == 0) {
+        return 0;
+    }
+    size_t offset = readPos & mask;
+    size_t first = min(len, size - offset);
+    memcpy(data, buffer + offset, first);
+    memcpy(data + first, buffer, len - first);
+    readPos += len;
+    return len;
+}
+
+bool AudioTimeshift::headerAt(uint32_t pos, AudioCodec::FrameHeader& header) const {
+    uint8_t bytes[AudioCodec::FRAME_HEADER_BYTES];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = byteAt(pos + i);
+    }
+    return AudioCodec::parseFrameHeader(bytes, header);
+}
+
+void AudioTimeshift::indexFrames() {
+    // Headers that scrolled out of the window are gone
+    if ((int32_t)(scanPos - oldest) < 0) {
+        scanPos = oldest;
+        inSync = false;
+    }
+
+    // scanPos runs ahead of writePos while the body of a frame is arriving
+    while ((int32_t)(writePos - scanPos) >= (int32_t)SCAN_LOOKAHEAD) {
+        uint32_t buffered = writePos - scanPos;
+
+        // ID3v2 tag in front of the first frame, syncsafe size
+        if (byteAt(scanPos) == 'I' && byteAt(scanPos + 1) == 'D' && byteAt(scanPos + 2) == '3') {
+            uint32_t tagSize = ((uint32_t)(byteAt(scanPos + 6) & 0x7F) << 21) |
+                               ((uint32_t)(byteAt(scanPos + 7) & 0x7F) << 14) |
+                               ((uint32_t)(byteAt(scanPos + 8) & 0x7F) << 7) |
+                               (byteAt(scanPos + 9) & 0x7F);
+            if (buffered < 10 + tagSize) {
+                break;
+            }
+            scanPos += 10 + tagSize;
+            continue;
+        }
+
+        AudioCodec::FrameHeader header;
+        if (!headerAt(scanPos, header)) {
+            inSync = false;
+            scanPos++;
+            continue;
+        }
+
+        if (!inSync) {
+            // A sync pattern inside frame data is common: confirm a fresh
+            // sync with the header of the following frame
+            if (buffered < header.length + SCAN_LOOKAHEAD) {
+                break;
+            }
+            AudioCodec::FrameHeader next;
+            if (!headerAt(scanPos + header.length, next)) {
+                scanPos++;
+                continue;
+            }
+            inSync = true;
+        }
+
+        if (frameUs == 0) {
+            frameUs = (uint32_t)((uint64_t)header.samples * 1000000 / header.sampleRate);
+        }
+        addFrame(scanPos);
+        scanPos += header.length;
+    }
+}
+
+void AudioTimeshift::addFrame(uint32_t pos) {
+    if (frameHead - frameTail > indexMask) {
+        frameTail++;  // Index full, the history holds unusually small frames
+    }
+    index[frameHead & indexMask] = pos;
+    frameHead++;
+}
+
+uint32_t AudioTimeshift::frameAt(uint32_t pos) const {
+    // Last frame starting at or before pos; frame starts grow with the number
+    uint32_t low = frameTail;
+    uint32_t high = frameHead;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if ((int32_t)(index[mid & indexMask] - pos) <= 0) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+bool AudioTimeshift::seekBehindLive(uint32_t ms) {
+    if (frameHead == frameTail || frameUs == 0) {
+        return false;
+    }
+
+    // The newest frame is the live edge, its data may still be arriving
+    uint32_t frames = (uint32_t)((uint64_t)ms * 1000 / frameUs);
+    uint32_t frame = frameHead - 1 - min(frames, frameHead - 1 - frameTail);
+    readPos = index[frame & indexMask];
+    return true;
+}
+
+uint32_t AudioTimeshift::getDelayMs() const {
+    if (frameHead == frameTail || isLive()) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)(frameHead - 1 - frameAt(readPos)) * frameUs / 1000);
+}
+
+uint32_t AudioTimeshift::getWindowMs() const {
+    return (uint32_t)((uint64_t)(frameHead - frameTail) * frameUs / 1000);
+}
@@ -87,7 +87,7 @@ bool ConfigManager::loadConfigFromSPIFFS() {
     }
     
     // Allocate a temporary JsonDocument
-    DynamicJsonDocument doc(4096);
+    DynamicJsonDocument doc(8192);
     DeserializationError error = deserializeJson(doc, configFile);
     configFile.close();
     
@@ -110,7 +110,7 @@ bool ConfigManager::saveConfigToSPIFFS() {
     }
     
     // Create JSON document
-    DynamicJsonDocument doc(4096);
+    DynamicJsonDocument doc(8192);
     
     // WiFi
     JsonObject wifi = doc.createNestedObject("wifi");
@@ -128,6 +128,7 @@ bool ConfigManager::saveConfigToSPIFFS() {
     display["timeout"] = displayConfig.timeout;
     display["auto_brightness"] = displayConfig.auto_brightness;
     display["theme"] = displayConfig.theme;
+    display["spectrum"] = displayConfig.spectrum;
     
     // Alarms
     JsonArray alarmsArray = doc.createNestedArray("alarms");
@@ -147,6 +148,7 @@ bool ConfigManager::saveConfigToSPIFFS() {
         alarmObj["station_id"] = alarm.station_id;
         alarmObj["volume"] = alarm.volume;
         alarmObj["fade_in"] = alarm.fade_in;
+        alarmObj["fade_curve"] = alarm.fade_curve;
         alarmObj["duration"] = alarm.duration;
     }
     
@@ -158,6 +160,23 @@ bool ConfigManager::saveConfigToSPIFFS() {
         stationObj["name"] = station.name;
         stationObj["url"] = station.url;
         stationObj["genre"] = station.genre;
+        if (station.codec.length() > 0) {
+            stationObj["codec"] = station.codec;
+        }
+        if (station.gain_db != 0.0f) {
+            stationObj["gain_db"] = station.gain_db;
+        }
+        if (!station.variants.empty()) {
+            JsonArray variantsArray = stationObj.createNestedArray("variants");
+            for (const auto& variant : station.variants) {
+                JsonObject variantObj = variantsArray.createNestedObject();
+                variantObj["url"] = variant.url;
+                variantObj["bitrate"] = variant.bitrate;
+                if (variant.codec.length() > 0) {
+                    variantObj["codec"] = variant.codec;
+                }
+            }
+        }
     }
     
     // Weather
@@ -174,6 +193,55 @@ bool ConfigManager::saveConfigToSPIFFS() {
     system["hostname"] = systemConfig.hostname;
     system["ota_password"] = systemConfig.ota_password;
     
+    // Audio
+    JsonObject audio = doc.createNestedObject("audio");
+    audio["buffer_min_kb"] = audioConfig.buffer_min_kb;
+    audio["buffer_max_kb"] = audioConfig.buffer_max_kb;
+    audio["prebuffer_percent"] = audioConfig.prebuffer_percent;
+    audio["stall_timeout_ms"] = audioConfig.stall_timeout_ms;
+    audio["warm_start_s"] = audioConfig.warm_start_s;
+    audio["crossfade_ms"] = audioConfig.crossfade_ms;
+    audio["psram_budget_kb"] = audioConfig.psram_budget_kb;
+    audio["resolve_ttl_h"] = audioConfig.resolve_ttl_h;
+    audio["mp3_decoder"] = audioConfig.mp3_decoder;
+    audio["normalize_loudness"] = audioConfig.normalize_loudness;
+    audio["loudness_target_lufs"] = audioConfig.loudness_target_lufs;
+    audio["timeshift_kb"] = audioConfig.timeshift_kb;
+    audio["adaptive_bitrate"] = audioConfig.adaptive_bitrate;
+    audio["duck_db"] = audioConfig.duck_db;
+    audio["hourly_chime"] = audioConfig.hourly_chime;
+    audio["record_buffer_kb"] = audioConfig.record_buffer_kb;
+    audio["tls_trust_store"] = audioConfig.tls_trust_store;
+    audio["tls_verify"] = audioConfig.tls_verify;
+    
+    // Equalizer
+    JsonObject equalizer = doc.createNestedObject("equalizer");
+    equalizer["preset"] = equalizerConfig.preset;
+    JsonArray presetsArray = equalizer.createNestedArray("presets");
+    for (const auto& preset : equalizerConfig.presets) {
+        JsonObject presetObj = presetsArray.createNestedObject();
+        presetObj["name"] = preset.name;
+        JsonArray bandsArray = presetObj.createNestedArray("bands");
+        for (const auto& band : preset.bands) {
+            JsonObject bandObj = bandsArray.createNestedObject();
+            bandObj["type"] = band.type;
+            bandObj["freq"] = band.freq;
+            bandObj["gain_db"] = band.gain_db;
+            bandObj["q"] = band.q;
+        }
+    }
+    
+    // Podcasts
+    JsonObject podcasts = doc.createNestedObject("podcasts");
+    JsonArray feedsArray = podcasts.createNestedArray("feeds");
+    for (const auto& feed : podcastConfig.feeds) {
+        JsonObject feedObj = feedsArray.createNestedObject();
+        feedObj["name"] = feed.name;
+        feedObj["url"] = feed.url;
+    }
+    podcasts["quota_mb"] = podcastConfig.quota_mb;
+    podcasts["fetch_hour"] = podcastConfig.fetch_hour;
+    
     // Fallback audio
     doc["fallback_audio"] = fallbackAudio;
     
@@ -228,7 +296,7 @@ bool ConfigManager::loadConfig() {
     }
     
     // Allocate a temporary JsonDocument
-    DynamicJsonDocument doc(4096);
+    DynamicJsonDocument doc(8192);
     DeserializationError error = deserializeJson(doc, configFile);
     configFile.close();
     
@@ -256,7 +324,7 @@ bool ConfigManager::saveConfig() {
     }
     
     // Create JSON document
-    DynamicJsonDocument doc(4096);
+    DynamicJsonDocument doc(8192);
     
     // WiFi
     JsonObject wifi = doc.createNestedObject("wifi");
@@ -274,6 +342,7 @@ bool ConfigManager::saveConfig() {
     display["timeout"] = displayConfig.timeout;
     display["auto_brightness"] = displayConfig.auto_brightness;
     display["theme"] = displayConfig.theme;
+    display["spectrum"] = displayConfig.spectrum;
     
     // Alarms
     JsonArray alarmsArray = doc.createNestedArray("alarms");
@@ -293,6 +362,7 @@ bool ConfigManager::saveConfig() {
         alarmObj["station_id"] = alarm.station_id;
         alarmObj["volume"] = alarm.volume;
         alarmObj["fade_in"] = alarm.fade_in;
+        alarmObj["fade_curve"] = alarm.fade_curve;
         alarmObj["duration"] = alarm.duration;
     }
     
@@ -304,6 +374,23 @@ bool ConfigManager::saveConfig() {
         stationObj["name"] = station.name;
         stationObj["url"] = station.url;
         stationObj["genre"] = station.genre;
+        if (station.codec.length() > 0) {
+            stationObj["codec"] = station.codec;
+        }
+        if (station.gain_db != 0.0f) {
+            stationObj["gain_db"] = station.gain_db;
+        }
+        if (!station.variants.empty()) {
+            JsonArray variantsArray = stationObj.createNestedArray("variants");
+            for (const auto& variant : station.variants) {
+                JsonObject variantObj = variantsArray.createNestedObject();
+                variantObj["url"] = variant.url;
+                variantObj["bitrate"] = variant.bitrate;
+                if (variant.codec.length() > 0) {
+                    variantObj["codec"] = variant.codec;
+                }
+            }
+        }
     }
     
     // Weather
@@ -320,6 +407,55 @@ bool ConfigManager::saveConfig() {
     system["hostname"] = systemConfig.hostname;
     system["ota_password"] = systemConfig.ota_password;
     
+    // Audio
+    JsonObject audio = doc.createNestedObject("audio");
+    audio["buffer_min_kb"] = audioConfig.buffer_min_kb;
+    audio["buffer_max_kb"] = audioConfig.buffer_max_kb;
+    audio["prebuffer_percent"] = audioConfig.prebuffer_percent;
+    audio["stall_timeout_ms"] = audioConfig.stall_timeout_ms;
+    audio["warm_start_s"] = audioConfig.warm_start_s;
+    audio["crossfade_ms"] = audioConfig.crossfade_ms;
+    audio["psram_budget_kb"] = audioConfig.psram_budget_kb;
+    audio["resolve_ttl_h"] = audioConfig.resolve_ttl_h;
+    audio["mp3_decoder"] = audioConfig.mp3_decoder;
+    audio["normalize_loudness"] = audioConfig.normalize_loudness;
+    audio["loudness_target_lufs"] = audioConfig.loudness_target_lufs;
+    audio["timeshift_kb"] = audioConfig.timeshift_kb;
+    audio["adaptive_bitrate"] = audioConfig.adaptive_bitrate;
+    audio["duck_db"] = audioConfig.duck_db;
+    audio["hourly_chime"] = audioConfig.hourly_chime;
+    audio["record_buffer_kb"] = audioConfig.record_buffer_kb;
+    audio["tls_trust_store"] = audioConfig.tls_trust_store;
+    audio["tls_verify"] = audioConfig.tls_verify;
+    
+    // Equalizer
+    JsonObject equalizer = doc.createNestedObject("equalizer");
+    equalizer["preset"] = equalizerConfig.preset;
+    JsonArray presetsArray = equalizer.createNestedArray("presets");
+    for (const auto& preset : equalizerConfig.presets) {
+        JsonObject presetObj = presetsArray.createNestedObject();
+        presetObj["name"] = preset.name;
+        JsonArray bandsArray = presetObj.createNestedArray("bands");
+        for (const auto& band : preset.bands) {
+            JsonObject bandObj = bandsArray.createNestedObject();
+            bandObj["type"] = band.type;
+            bandObj["freq"] = band.freq;
+            bandObj["gain_db"] = band.gain_db;
+            bandObj["q"] = band.q;
+        }
+    }
+    
+    // Podcasts
+    JsonObject podcasts = doc.createNestedObject("podcasts");
+    JsonArray feedsArray = podcasts.createNestedArray("feeds");
+    for (const auto& feed : podcastConfig.feeds) {
+        JsonObject feedObj = feedsArray.createNestedObject();
+        feedObj["name"] = feed.name;
+        feedObj["url"] = feed.url;
+    }
+    podcasts["quota_mb"] = podcastConfig.quota_mb;
+    podcasts["fetch_hour"] = podcastConfig.fetch_hour;
+    
     // Fallback audio
     doc["fallback_audio"] = fallbackAudio;
     
@@ -360,6 +496,18 @@ bool ConfigManager::resetToDefault() {
     return saveConfig();
 }
 
+static std::vector<EqPresetConfig> defaultEqualizerPresets() {
+    return {
+        {"flat", {}},
+        {"bass", {{"lowshelf", 100.0f, 6.0f, 0.707f}, {"peaking", 250.0f, -1.5f, 1.0f}}},
+        {"voice", {{"lowshelf", 120.0f, -4.0f, 0.707f}, {"peaking", 2500.0f, 3.0f, 1.0f},
+                   {"highshelf", 8000.0f, -2.0f, 0.707f}}},
+        {"treble", {{"peaking", 3500.0f, 1.5f, 1.0f}, {"highshelf", 6000.0f, 5.0f, 0.707f}}},
+        {"loudness", {{"lowshelf", 80.0f, 6.0f, 0.707f}, {"peaking", 1000.0f, -2.0f, 0.8f},
+                      {"highshelf", 10000.0f, 4.0f, 0.707f}}}
+    };
+}
+
 bool ConfigManager::parseConfig(JsonDocument& doc) {
     // WiFi
     wifiConfig.ssid = doc["wifi"]["ssid"].as<String>();
@@ -374,6 +522,7 @@ bool ConfigManager::parseConfig(JsonDocument& doc) {
     displayConfig.timeout = doc["display"]["timeout"] | 30;
     displayConfig.auto_brightness = doc["display"]["auto_brightness"] | true;
     displayConfig.theme = doc["display"]["theme"].as<String>();
+    displayConfig.spectrum = doc["display"]["spectrum"] | true;
     
     // Alarms
     alarms.clear();
@@ -394,6 +543,7 @@ bool ConfigManager::parseConfig(JsonDocument& doc) {
         alarm.station_id = alarmObj["station_id"];
         alarm.volume = alarmObj["volume"];
         alarm.fade_in = alarmObj["fade_in"];
+        alarm.fade_curve = alarmObj["fade_curve"] | "linear";
         alarm.duration = alarmObj["duration"];
         
         alarms.push_back(alarm);
@@ -408,6 +558,15 @@ bool ConfigManager::parseConfig(JsonDocument& doc) {
         station.name = stationObj["name"].as<String>();
         station.url = stationObj["url"].as<String>();
         station.genre = stationObj["genre"].as<String>();
+        station.codec = stationObj["codec"] | "";
+        station.gain_db = stationObj["gain_db"] | 0.0f;
+        for (JsonObject variantObj : stationObj["variants"].as<JsonArray>()) {
+            StreamVariantConfig variant;
+            variant.url = variantObj["url"].as<String>();
+            variant.bitrate = variantObj["bitrate"] | 0;
+            variant.codec = variantObj["codec"] | "";
+            station.variants.push_back(variant);
+        }
         
         radioStations.push_back(station);
     }
@@ -424,6 +583,59 @@ bool ConfigManager::parseConfig(JsonDocument& doc) {
     systemConfig.hostname = doc["system"]["hostname"].as<String>();
     systemConfig.ota_password = doc["system"]["ota_password"].as<String>();
     
+    // Audio
+    audioConfig.buffer_min_kb = doc["audio"]["buffer_min_kb"] | 16;
+    audioConfig.buffer_max_kb = doc["audio"]["buffer_max_kb"] | 128;
+    audioConfig.prebuffer_percent = doc["audio"]["prebuffer_percent"] | 50;
+    audioConfig.stall_timeout_ms = doc["audio"]["stall_timeout_ms"] | 1500;
+    audioConfig.warm_start_s = doc["audio"]["warm_start_s"] | 30;
+    audioConfig.crossfade_ms = doc["audio"]["crossfade_ms"] | 150;
+    audioConfig.psram_budget_kb = doc["audio"]["psram_budget_kb"] | 384;
+    audioConfig.resolve_ttl_h = doc["audio"]["resolve_ttl_h"] | 24;
+    audioConfig.mp3_decoder = doc["audio"]["mp3_decoder"] | "";
+    audioConfig.normalize_loudness = doc["audio"]["normalize_loudness"] | true;
+    audioConfig.loudness_target_lufs = doc["audio"]["loudness_target_lufs"] | -18;
+    audioConfig.timeshift_kb = doc["audio"]["timeshift_kb"] | 4096;
+    audioConfig.adaptive_bitrate = doc["audio"]["adaptive_bitrate"] | true;
+    audioConfig.duck_db = doc["audio"]["duck_db"] | -12;
+    audioConfig.hourly_chime = doc["audio"]["hourly_chime"] | "";
+    audioConfig.record_buffer_kb = doc["audio"]["record_buffer_kb"] | 512;
+    audioConfig.tls_trust_store = doc["audio"]["tls_trust_store"] | "/certs";
+    audioConfig.tls_verify = doc["audio"]["tls_verify"] | true;
+    
+    // Equalizer, older configs without presets get the built-in ones
+    equalizerConfig.presets.clear();
+    JsonArray presetsArray = doc["equalizer"]["presets"];
+    if (presetsArray.isNull()) {
+        equalizerConfig.presets = defaultEqualizerPresets();
+    } else {
+        for (JsonObject presetObj : presetsArray) {
+            EqPresetConfig preset;
+            preset.name = presetObj["name"].as<String>();
+            for (JsonObject bandObj : presetObj["bands"].as<JsonArray>()) {
+                EqBandConfig band;
+                band.type = bandObj["type"] | "peaking";
+                band.freq = bandObj["freq"] | 1000.0f;
+                band.gain_db = bandObj["gain_db"] | 0.0f;
+                band.q = bandObj["q"] | 0.707f;
+                preset.bands.push_back(band);
+            }
+            equalizerConfig.presets.push_back(preset);
+        }
+    }
+    equalizerConfig.preset = doc["equalizer"]["preset"] | "flat";
+    
+    // Podcasts
+    podcastConfig.feeds.clear();
+    for (JsonObject feedObj : doc["podcasts"]["feeds"].as<JsonArray>()) {
+        PodcastFeedConfig feed;
+        feed.name = feedObj["name"] | "";
+        feed.url = feedObj["url"] | "";
+        podcastConfig.feeds.push_back(feed);
+    }
+    podcastConfig.quota_mb = doc["podcasts"]["quota_mb"] | 512;
+    podcastConfig.fetch_hour = doc["podcasts"]["fetch_hour"] | 3;
+    
     // Fallback audio
     fallbackAudio = doc["fallback_audio"].as<String>();
     
@@ -444,6 +656,7 @@ void ConfigManager::setDefaultConfig() {
     displayConfig.timeout = 30;
     displayConfig.auto_brightness = true;
     displayConfig.theme = "dark";
+    displayConfig.spectrum = true;
     
     // Default alarm (7:00 AM on weekdays)
     AlarmConfig defaultAlarm;
@@ -458,6 +671,7 @@ void ConfigManager::setDefaultConfig() {
     defaultAlarm.station_id = 0;
     defaultAlarm.volume = 70;
     defaultAlarm.fade_in = 30;
+    defaultAlarm.fade_curve = "perceptual";
     defaultAlarm.duration = 60;
     
     alarms.clear();
@@ -469,6 +683,7 @@ void ConfigManager::setDefaultConfig() {
     defaultStation.name = "Example Radio";
     defaultStation.url = "http://example.com/stream.mp3";
     defaultStation.genre = "Various";
+    defaultStation.gain_db = 0.0f;
     
     radioStations.clear();
     radioStations.push_back(defaultStation);
@@ -485,6 +700,86 @@ void ConfigManager::setDefaultConfig() {
     systemConfig.hostname = "radiowecker";
     systemConfig.ota_password = "changeme";
     
+    // Audio
+    audioConfig.buffer_min_kb = 16;
+    audioConfig.buffer_max_kb = 128;
+    audioConfig.prebuffer_percent = 50;
+    audioConfig.stall_timeout_ms = 1500;
+    audioConfig.warm_start_s = 30;
+    audioConfig.crossfade_ms = 150;
+    audioConfig.psram_budget_kb = 384;
+    audioConfig.resolve_ttl_h = 24;
+    audioConfig.mp3_decoder = "";
+    audioConfig.normalize_loudness = true;
+    audioConfig.loudness_target_lufs = -18;
+    audioConfig.timeshift_kb = 4096;
+    audioConfig.adaptive_bitrate = true;
+    audioConfig.duck_db = -12;
+    audioConfig.hourly_chime = "";
+    audioConfig.record_buffer_kb = 512;
+    audioConfig.tls_trust_store = "/certs";
+    audioConfig.tls_verify = true;
+    
+    // Equalizer presets
+    equalizerConfig.preset = "flat";
+    equalizerConfig.presets = defaultEqualizerPresets();
+    
+    // Podcasts
+    podcastConfig.feeds.clear();
+    podcastConfig.quota_mb = 512;
+    podcastConfig.fetch_hour = 3;
+    
     // Fallback audio
     fallbackAudio = "/alarm.mp3";
 }
+
+bool ConfigManager::setStationGain(const String& url, float gainDb) {
+    // Tenths of a dB are plenty and keep the file readable
+    gainDb = roundf(gainDb * 10.0f) / 10.0f;
+    bool changed = false;
+    for (auto& station : radioStations) {
+        if (station.url == url && fabsf(station.gain_db - gainDb) >= 0.5f) {
+            station.gain_db = gainDb;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+float ConfigManager::getStationGain(const String& url) const {
+    for (const auto& station : radioStations) {
+        if (station.url == url) {
+            return station.gain_db;
+        }
+    }
+    return 0.0f;
+}
+
+const RadioStation* ConfigManager::findStation(const String& url) const {
+    for (const auto& station : radioStations) {
+        if (station.url == url) {
+            return &station;
+        }
+    }
+    return nullptr;
+}
+
+const EqPresetConfig* ConfigManager::findEqualizerPreset(const String& name) const {
+    for (const auto& preset : equalizerConfig.presets) {
+        if (preset.name == name) {
+            return &preset;
+        }
+    }
+    return nullptr;
+}
+
+bool ConfigManager::setStationCodec(const String& url, const String& codec) {
+    bool changed = false;
+    for (auto& station : radioStations) {
+        if (station.url == url && station.codec != codec) {
+            station.codec = codec;
+            changed = true;
+        }
+    }
+    return changed;
+}
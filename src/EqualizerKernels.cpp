@@ -0,0 +1,139 @@
+#include "EqualizerKernels.h"
+#include <math.h>
+
+// Coefficient and state formats
+static const int COEFF_SHIFT = 28;
+static const int STATE_SHIFT = 8;  // Q15 PCM to Q23 state
+
+static int32_t toQ28(float value) {
+    float scaled = value * (float)(1 << COEFF_SHIFT);
+    if (scaled > 2147483647.0f) {
+        return INT32_MAX;
+    }
+    if (scaled < -2147483648.0f) {
+        return INT32_MIN;
+    }
+    return (int32_t)lrintf(scaled);
+}
+
+static inline int16_t saturate(int32_t state) {
+    // Round Q23 back to Q15
+    int32_t value = (state + (1 << (STATE_SHIFT - 1))) >> STATE_SHIFT;
+    if (value > 32767) {
+        return 32767;
+    }
+    if (value < -32768) {
+        return -32768;
+    }
+    return (int16_t)value;
+}
+
+static inline int32_t biquad(const EqCoeffs& c, EqState& s, int32_t x) {
+    int64_t acc = (int64_t)c.b0 * x + (int64_t)c.b1 * s.x1 + (int64_t)c.b2 * s.x2 -
+                  (int64_t)c.a1 * s.y1 - (int64_t)c.a2 * s.y2;
+    int32_t y = (int32_t)(acc >> COEFF_SHIFT);
+    s.x2 = s.x1;
+    s.x1 = x;
+    s.y2 = s.y1;
+    s.y1 = y;
+    return y;
+}
+
+void eqDesign(const EqBand& band, uint32_t sampleRate, float gain, EqCoeffs& coeffs) {
+    float freq = band.freq;
+    if (freq >= sampleRate * 0.45f) {
+        freq = sampleRate * 0.45f;
+    }
+    float q = band.q > 0.05f ? band.q : 0.05f;
+    float A = powf(10.0f, band.gainDb / 40.0f);
+    float w0 = 2.0f * (float)M_PI * freq / (float)sampleRate;
+    float cosw = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float b0, b1, b2, a0, a1, a2;
+
+    switch (band.type) {
+        case EqFilterType::LowShelf: {
+            float beta = 2.0f * sqrtf(A) * alpha;
+            b0 = A * ((A + 1) - (A - 1) * cosw + beta);
+            b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+            b2 = A * ((A + 1) - (A - 1) * cosw - beta);
+            a0 = (A + 1) + (A - 1) * cosw + beta;
+            a1 = -2 * ((A - 1) + (A + 1) * cosw);
+            a2 = (A + 1) + (A - 1) * cosw - beta;
+            break;
+        }
+        case EqFilterType::HighShelf: {
+            float beta = 2.0f * sqrtf(A) * alpha;
+            b0 = A * ((A + 1) + (A - 1) * cosw + beta);
+            b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+            b2 = A * ((A + 1) + (A - 1) * cosw - beta);
+            a0 = (A + 1) - (A - 1) * cosw + beta;
+            a1 = 2 * ((A - 1) - (A + 1) * cosw);
+            a2 = (A + 1) - (A - 1) * cosw - beta;
+            break;
+        }
+        case EqFilterType::Peaking:
+        default:
+            b0 = 1 + alpha * A;
+            b1 = -2 * cosw;
+            b2 = 1 - alpha * A;
+            a0 = 1 + alpha / A;
+            a1 = -2 * cosw;
+            a2 = 1 - alpha / A;
+            break;
+    }
+
+    coeffs.b0 = toQ28(gain * b0 / a0);
+    coeffs.b1 = toQ28(gain * b1 / a0);
+    coeffs.b2 = toQ28(gain * b2 / a0);
+    coeffs.a1 = toQ28(a1 / a0);
+    coeffs.a2 = toQ28(a2 / a0);
+}
+
+void eqProcessReference(const EqCoeffs* coeffs, EqState* state, size_t bands,
+                        int16_t* pcm, size_t frames) {
+    for (size_t i = 0; i < frames * 2; i++) {
+        int32_t value = (int32_t)pcm[i] << STATE_SHIFT;
+        size_t channel = i & 1;
+        for (size_t band = 0; band < bands; band++) {
+            value = biquad(coeffs[band], state[band * 2 + channel], value);
+        }
+        pcm[i] = saturate(value);
+    }
+}
+
+void eqProcessBlock(const EqCoeffs* coeffs, EqState* state, size_t bands,
+                    int16_t* pcm, size_t frames, int32_t* work) {
+    for (size_t i = 0; i < frames * 2; i++) {
+        work[i] = (int32_t)pcm[i] << STATE_SHIFT;
+    }
+
+    for (size_t band = 0; band < bands; band++) {
+        // Hoist the band into locals so the inner loop runs from registers
+        const int64_t b0 = coeffs[band].b0, b1 = coeffs[band].b1, b2 = coeffs[band].b2;
+        const int64_t a1 = coeffs[band].a1, a2 = coeffs[band].a2;
+        EqState& left = state[band * 2];
+        EqState& right = state[band * 2 + 1];
+        int32_t lx1 = left.x1, lx2 = left.x2, ly1 = left.y1, ly2 = left.y2;
+        int32_t rx1 = right.x1, rx2 = right.x2, ry1 = right.y1, ry2 = right.y2;
+
+        int32_t* p = work;
+        for (size_t n = 0; n < frames; n++, p += 2) {
+            int32_t lx = p[0];
+            int32_t rx = p[1];
+            int32_t ly = (int32_t)((b0 * lx + b1 * lx1 + b2 * lx2 - a1 * ly1 - a2 * ly2) >> COEFF_SHIFT);
+            int32_t ry = (int32_t)((b0 * rx + b1 * rx1 + b2 * rx2 - a1 * ry1 - a2 * ry2) >> COEFF_SHIFT);
+            lx2 = lx1; lx1 = lx; ly2 = ly1; ly1 = ly;
+            rx2 = rx1; rx1 = rx; ry2 = ry1; ry1 = ry;
+            p[0] = ly;
+            p[1] = ry;
+        }
+
+        left.x1 = lx1; left.x2 = lx2; left.y1 = ly1; left.y2 = ly2;
+        right.x1 = rx1; right.x2 = rx2; right.y1 = ry1; right.y2 = ry2;
+    }
+
+    for (size_t i = 0; i < frames * 2; i++) {
+        pcm[i] = saturate(work[i]);
+    }
+}
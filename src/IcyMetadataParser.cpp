@@ -0,0 +1,121 @@
+#include "IcyMetadataParser.h"
+
+static const char TITLE_KEY[] = "StreamTitle='";
+static const size_t TITLE_KEY_LENGTH = sizeof(TITLE_KEY) - 1;
+
+// Copy at most size-1 characters and terminate, trimming surrounding blanks
+static void copyTrimmed(char* dest, size_t size, const char* begin, const char* end) {
+    while (begin < end && *begin == ' ') {
+        begin++;
+    }
+    while (end > begin && end[-1] == ' ') {
+        end--;
+    }
+    size_t len = min((size_t)(end - begin), size - 1);
+    memcpy(dest, begin, len);
+    dest[len] = '\0';
+}
+
+void NowPlaying::fromStreamTitle(const char* streamTitle) {
+    if (!streamTitle) {
+        streamTitle = "";
+    }
+    const char* end = streamTitle + strlen(streamTitle);
+    const char* separator = strstr(streamTitle, " - ");
+    if (separator) {
+        copyTrimmed(artist, sizeof(artist), streamTitle, separator);
+        copyTrimmed(title, sizeof(title), separator + 3, end);
+    } else {
+        artist[0] = '\0';
+        copyTrimmed(title, sizeof(title), streamTitle, end);
+    }
+}
+
+void IcyMetadataParser::reset() {
+    // An empty title in the back slot, then swapped to the front
+    slots[1 - (generation.load() & 1)][0] = '\0';
+    generation++;
+    slots[1 - (generation.load() & 1)][0] = '\0';
+    beginBlock();
+}
+
+void IcyMetadataParser::copyTitle(char* dest, size_t size) const {
+    if (size == 0) {
+        return;
+    }
+    while (true) {
+        uint32_t before = generation.load(std::memory_order_acquire);
+        strlcpy(dest, slots[before & 1], size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // After a swap the writer may already be filling the slot just read
+        if (generation.load(std::memory_order_relaxed) == before) {
+            return;
+        }
+    }
+}
+
+void IcyMetadataParser::beginBlock() {
+    keyMatched = 0;
+    inValue = false;
+    quotePending = false;
+    valueComplete = false;
+    valueLength = 0;
+}
+
+void IcyMetadataParser::append(char c) {
+    char* back = slots[1 - (generation.load() & 1)];
+    if (valueLength < TITLE_SIZE - 1) {
+        back[valueLength++] = c;
+    }
+}
+
+void IcyMetadataParser::feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !valueComplete; i++) {
+        char c = (char)data[i];
+
+        if (!inValue) {
+            // Match the key, restarting on a mismatch
+            if (c == TITLE_KEY[keyMatched]) {
+                keyMatched++;
+            } else {
+                keyMatched = (c == TITLE_KEY[0]) ? 1 : 0;
+            }
+            if (keyMatched == TITLE_KEY_LENGTH) {
+                inValue = true;
+                valueLength = 0;
+            }
+            continue;
+        }
+
+        // The value ends at "';", a lone quote is part of the title
+        if (quotePending) {
+            quotePending = false;
+            if (c == ';') {
+                valueComplete = true;
+                break;
+            }
+            append('\'');
+        }
+        if (c == '\'') {
+            quotePending = true;
+        } else if (c != '\0') {
+            append(c);
+        }
+    }
+}
+
+bool IcyMetadataParser::endBlock() {
+    if (!inValue) {
+        return false;  // Block without a title (padding or other keys)
+    }
+
+    // A block that ended inside the value still carries a usable title
+    uint8_t front = generation.load() & 1;
+    slots[1 - front][valueLength] = '\0';
+    bool changed = strcmp(slots[1 - front], slots[front]) != 0;
+    if (changed) {
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    beginBlock();
+    return changed;
+}
@@ -0,0 +1,384 @@
+#include "Mp3Indexer.h"
+#include <vector>
+#include "AudioCodec.h"
+
+// Initialize static member
+Mp3Indexer* Mp3Indexer::instance = nullptr;
+
+// Indexer task: idle priority on the UI core, playback always goes first
+static const uint32_t INDEXER_TASK_STACK = 6144;
+static const UBaseType_t INDEXER_TASK_PRIORITY = 1;
+static const BaseType_t INDEXER_TASK_CORE = 0;
+
+// Read size while indexing, and the pause after every read that leaves the
+// card to a file that is playing
+static const size_t INDEX_READ_BLOCK = 16 * 1024;
+static const uint32_t INDEX_YIELD_MS = 5;
+
+// Paths waiting to be indexed ahead of the walk
+static const UBaseType_t REQUEST_QUEUE_LENGTH = 4;
+
+// Directory levels below the root that are walked
+static const uint8_t MAX_WALK_DEPTH = 3;
+
+// Bytes searched for the first frame by estimate()
+static const size_t ESTIMATE_PROBE_BYTES = 2048;
+
+static const char SIDECAR_MAGIC[4] = {'M', 'P', 'I', 'X'};
+static const uint16_t SIDECAR_VERSION = 1;
+
+namespace {
+
+/**
+ * @brief Sequential window over a file, refilled in large blocks
+ * A frame header or a whole ID3 tag can be skipped by moving on; the window
+ * only reads what it has not seen yet.
+ */
+class FileWindow {
+public:
+    FileWindow(File& file, uint8_t* buffer, size_t capacity)
+        : file(file), buffer(buffer), capacity(capacity) {}
+
+    // Make [pos, pos + len) available, false past the end of the file
+    bool ensure(uint32_t pos, size_t len) {
+        if (pos >= start && pos + len <= start + fill) {
+            return true;
+        }
+        if (fill == 0 || pos < start || pos > start + fill) {
+            if (!file.seek(pos)) {
+                return false;
+            }
+            start = pos;
+            fill = 0;
+        } else {
+            size_t keep = start + fill - pos;
+            memmove(buffer, buffer + (pos - start), keep);
+            start = pos;
+            fill = keep;
+        }
+        while (fill < len) {
+            size_t got = file.read(buffer + fill, capacity - fill);
+            if (got == 0) {
+                return false;
+            }
+            fill += got;
+            vTaskDelay(pdMS_TO_TICKS(INDEX_YIELD_MS));
+        }
+        return true;
+    }
+
+    const uint8_t* at(uint32_t pos) const { return buffer + (pos - start); }
+
+private:
+    File& file;
+    uint8_t* buffer;
+    size_t capacity;
+    uint32_t start = 0;
+    size_t fill = 0;
+};
+
+}  // namespace
+
+void Mp3Indexer::begin(const char* root) {
+    if (taskHandle) {
+        return;
+    }
+    strlcpy(rootPath, root ? root : "/", sizeof(rootPath));
+
+    requests = xQueueCreate(REQUEST_QUEUE_LENGTH, MAX_PATH);
+    if (!requests) {
+        Serial.println("[ERROR] Failed to create MP3 indexer queue");
+        return;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        indexerTask,            // Task function
+        "Mp3Indexer",           // Task name for debugging
+        INDEXER_TASK_STACK,     // Stack size
+        this,                   // Task parameters
+        INDEXER_TASK_PRIORITY,  // Task priority
+        &taskHandle,            // Task handle
+        INDEXER_TASK_CORE       // Core to run the task on
+    );
+    if (created != pdPASS) {
+        Serial.println("[ERROR] Failed to create MP3 indexer task");
+        taskHandle = nullptr;
+    }
+}
+
+void Mp3Indexer::request(const char* path) {
+    if (!requests || !path || strlen(path) >= MAX_PATH) {
+        return;
+    }
+    char item[MAX_PATH];
+    strlcpy(item, path, sizeof(item));
+    // A full queue is fine, the walk gets to the file anyway
+    xQueueSend(requests, item, 0);
+}
+
+void Mp3Indexer::indexerTask(void* parameter) {
+    Mp3Indexer* self = static_cast<Mp3Indexer*>(parameter);
+
+    uint32_t start = millis();
+    self->walk(self->rootPath, 0);
+    Serial.printf("[AUDIO] MP3 index walk done in %lu s, %u files indexed\n",
+                  (millis() - start) / 1000, self->indexedCount);
+
+    // Files that show up later are indexed when they are first played
+    char path[MAX_PATH];
+    while (true) {
+        if (xQueueReceive(self->requests, path, portMAX_DELAY) == pdTRUE) {
+            File mp3 = SD.open(path, FILE_READ);
+            bool current = mp3 && self->isCurrent(path, mp3);
+            mp3.close();
+            if (!current) {
+                self->indexFile(path);
+            }
+        }
+    }
+}
+
+void Mp3Indexer::serveRequests() {
+    char path[MAX_PATH];
+    while (xQueueReceive(requests, path, 0) == pdTRUE) {
+        File mp3 = SD.open(path, FILE_READ);
+        bool current = mp3 && isCurrent(path, mp3);
+        mp3.close();
+        if (!current) {
+            indexFile(path);
+        }
+    }
+}
+
+void Mp3Indexer::walk(const char* dir, uint8_t depth) {
+    // Collect the entries first, so no directory stays open while indexing
+    // and the walk never holds more than one directory handle
+    std::vector<String> files;
+    std::vector<String> dirs;
+    File root = SD.open(dir);
+    if (!root || !root.isDirectory()) {
+        return;
+    }
+    for (File entry = root.openNextFile(); entry; entry = root.openNextFile()) {
+        const char* name = entry.name();
+        if (name[0] != '.' && strcmp(name, "System Volume Information") != 0) {
+            if (entry.isDirectory()) {
+                dirs.push_back(entry.path());
+            } else if (isMp3(name)) {
+                files.push_back(entry.path());
+            }
+        }
+        entry.close();
+    }
+    root.close();
+
+    for (const String& path : files) {
+        serveRequests();
+        File mp3 = SD.open(path.c_str(), FILE_READ);
+        bool current = mp3 && isCurrent(path.c_str(), mp3);
+        mp3.close();
+        if (!current) {
+            indexFile(path.c_str());
+        }
+    }
+
+    if (depth < MAX_WALK_DEPTH) {
+        for (const String& path : dirs) {
+            walk(path.c_str(), depth + 1);
+        }
+    }
+}
+
+bool Mp3Indexer::isCurrent(const char* path, File& mp3) {
+    File sidecar = SD.open(sidecarPath(path).c_str(), FILE_READ);
+    if (!sidecar) {
+        return false;
+    }
+    SidecarHeader header;
+    bool ok = sidecar.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              memcmp(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) == 0 &&
+              header.version == SIDECAR_VERSION &&
+              header.fileSize == mp3.size() &&
+              header.fileMtime == (uint32_t)mp3.getLastWrite() &&
+              sidecar.size() == sizeof(header) + header.entryCount * sizeof(uint32_t);
+    sidecar.close();
+    return ok;
+}
+
+bool Mp3Indexer::indexFile(const char* path) {
+    File mp3 = SD.open(path, FILE_READ);
+    if (!mp3) {
+        return false;
+    }
+    uint8_t* buffer = (uint8_t*)ps_malloc(INDEX_READ_BLOCK);
+    if (!buffer) {
+        Serial.println("[ERROR] No PSRAM for the MP3 indexer");
+        mp3.close();
+        return false;
+    }
+
+    uint32_t started = millis();
+    FileWindow window(mp3, buffer, INDEX_READ_BLOCK);
+    std::vector<uint32_t> entries;
+    uint64_t durationUs = 0;
+    uint32_t pos = audioStart(mp3);
+    bool inSync = false;
+
+    AudioCodec::FrameHeader header;
+    while (window.ensure(pos, AudioCodec::FRAME_HEADER_BYTES)) {
+        if (!AudioCodec::parseFrameHeader(window.at(pos), header)) {
+            inSync = false;
+            pos++;
+            continue;
+        }
+        if (!inSync) {
+            // A sync pattern inside frame data is common: confirm a fresh
+            // sync with the header of the following frame (or the file end)
+            AudioCodec::FrameHeader next;
+            if (window.ensure(pos + header.length, AudioCodec::FRAME_HEADER_BYTES) &&
+                !AudioCodec::parseFrameHeader(window.at(pos + header.length), next)) {
+                pos++;
+                continue;
+            }
+            inSync = true;
+        }
+
+        // Every interval that ends up before this frame starts maps to it
+        while ((uint64_t)entries.size() * INDEX_INTERVAL_MS * 1000 <= durationUs) {
+            entries.push_back(pos);
+        }
+        durationUs += (uint64_t)header.samples * 1000000 / header.sampleRate;
+        pos += header.length;
+    }
+
+    SidecarHeader sidecarHeader;
+    memcpy(sidecarHeader.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+    sidecarHeader.version = SIDECAR_VERSION;
+    sidecarHeader.intervalMs = INDEX_INTERVAL_MS;
+    sidecarHeader.fileSize = mp3.size();
+    sidecarHeader.fileMtime = (uint32_t)mp3.getLastWrite();
+    sidecarHeader.durationMs = (uint32_t)(durationUs / 1000);
+    sidecarHeader.entryCount = entries.size();
+    mp3.close();
+    free(buffer);
+
+    if (entries.empty()) {
+        Serial.printf("[AUDIO] No MP3 frames in %s, not indexed\n", path);
+        return false;
+    }
+
+    // A short write leaves a sidecar whose size does not match its header,
+    // isCurrent() rejects it
+    String indexPath = sidecarPath(path);
+    if (SD.exists(indexPath.c_str())) {
+        SD.remove(indexPath.c_str());
+    }
+    File sidecar = SD.open(indexPath.c_str(), FILE_WRITE);
+    if (!sidecar) {
+        Serial.printf("[ERROR] Failed to create %s\n", indexPath.c_str());
+        return false;
+    }
+    size_t entryBytes = entries.size() * sizeof(uint32_t);
+    bool written = sidecar.write((const uint8_t*)&sidecarHeader, sizeof(sidecarHeader)) == sizeof(sidecarHeader) &&
+                   sidecar.write((const uint8_t*)entries.data(), entryBytes) == entryBytes;
+    sidecar.close();
+    if (!written) {
+        Serial.printf("[ERROR] Failed to write %s\n", indexPath.c_str());
+        SD.remove(indexPath.c_str());
+        return false;
+    }
+
+    indexedCount++;
+    Serial.printf("[AUDIO] Indexed %s: %u s, %u entries in %lu ms\n", path,
+                  sidecarHeader.durationMs / 1000, sidecarHeader.entryCount, millis() - started);
+    return true;
+}
+
+bool Mp3Indexer::lookup(const char* path, uint32_t positionMs, uint32_t& offset, uint32_t& startMs) {
+    File mp3 = SD.open(path, FILE_READ);
+    if (!mp3) {
+        return false;
+    }
+    uint32_t fileSize = mp3.size();
+    uint32_t fileMtime = (uint32_t)mp3.getLastWrite();
+    mp3.close();
+
+    File sidecar = SD.open(sidecarPath(path).c_str(), FILE_READ);
+    SidecarHeader header;
+    bool current = sidecar &&
+                   sidecar.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                   memcmp(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) == 0 &&
+                   header.version == SIDECAR_VERSION &&
+                   header.fileSize == fileSize && header.fileMtime == fileMtime &&
+                   header.entryCount > 0 && header.intervalMs > 0 &&
+                   sidecar.size() == sizeof(header) + header.entryCount * sizeof(uint32_t);
+    if (!current) {
+        if (sidecar) {
+            sidecar.close();
+        }
+        request(path);
+        return false;
+    }
+
+    uint32_t entry = min(positionMs / header.intervalMs, header.entryCount - 1);
+    bool found = sidecar.seek(sizeof(header) + entry * sizeof(uint32_t)) &&
+                 sidecar.read((uint8_t*)&offset, sizeof(offset)) == sizeof(offset);
+    sidecar.close();
+    startMs = entry * header.intervalMs;
+    return found && offset < fileSize;
+}
+
+bool Mp3Indexer::estimate(const char* path, uint32_t positionMs, uint32_t& offset) {
+    File mp3 = SD.open(path, FILE_READ);
+    if (!mp3) {
+        return false;
+    }
+    uint8_t probe[ESTIMATE_PROBE_BYTES];
+    uint32_t start = audioStart(mp3);
+    size_t len = mp3.seek(start) ? mp3.read(probe, sizeof(probe)) : 0;
+    uint32_t fileSize = mp3.size();
+    mp3.close();
+
+    // First frame whose successor follows where its header says
+    AudioCodec::FrameHeader header;
+    AudioCodec::FrameHeader next;
+    for (size_t i = 0; i + AudioCodec::FRAME_HEADER_BYTES <= len; i++) {
+        if (!AudioCodec::parseFrameHeader(probe + i, header)) {
+            continue;
+        }
+        size_t following = i + header.length;
+        if (following + AudioCodec::FRAME_HEADER_BYTES <= len &&
+            !AudioCodec::parseFrameHeader(probe + following, next)) {
+            continue;
+        }
+        uint64_t bytesPerSecond = (uint64_t)header.length * header.sampleRate / header.samples;
+        uint64_t target = start + i + bytesPerSecond * positionMs / 1000;
+        if (target >= fileSize) {
+            return false;
+        }
+        offset = (uint32_t)target;
+        return true;
+    }
+    return false;
+}
+
+String Mp3Indexer::sidecarPath(const char* path) {
+    return String(path) + ".idx";
+}
+
+bool Mp3Indexer::isMp3(const char* name) {
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".mp3") == 0;
+}
+
+uint32_t Mp3Indexer::audioStart(File& file) {
+    // Skip an ID3v2 tag (syncsafe size, plus a footer if flagged)
+    uint8_t tag[10];
+    if (!file.seek(0) || file.read(tag, sizeof(tag)) != sizeof(tag) ||
+        tag[0] != 'I' || tag[1] != 'D' || tag[2] != '3') {
+        return 0;
+    }
+    uint32_t size = ((uint32_t)(tag[6] & 0x7F) << 21) | ((uint32_t)(tag[7] & 0x7F) << 14) |
+                    ((uint32_t)(tag[8] & 0x7F) << 7) | (tag[9] & 0x7F);
+    return 10 + size + ((tag[5] & 0x10) ? 10 : 0);
+}
@@ -0,0 +1,1023 @@
+#include "MusicLibrary.h"
+#include <algorithm>
+#include "AudioCodec.h"
+
+// Initialize static member
+MusicLibrary* MusicLibrary::instance = nullptr;
+
+// Scanner task: idle priority on the UI core, playback always goes first
+static const uint32_t SCANNER_TASK_STACK = 8192;
+static const UBaseType_t SCANNER_TASK_PRIORITY = 1;
+static const BaseType_t SCANNER_TASK_CORE = 0;
+
+// Pause after reading the tags of a file, leaves the card to a file that is playing
+static const uint32_t SCAN_YIELD_MS = 5;
+
+// Directory levels below the root that are walked (root/Artist/Album/CD)
+static const uint8_t MAX_WALK_DEPTH = 4;
+
+// Library files, and directories that hold no music of the collection
+static const char* LIBRARY_DIR = "/library";
+static const char* INDEX_PATH = "/library/tracks.idx";
+static const char* CACHE_PATH = "/library/scan.dat";
+static const char* SKIPPED_DIRS[] = {"/library", "/podcasts", "/System Volume Information"};
+
+static const char INDEX_MAGIC[4] = {'M', 'L', 'I', 'X'};
+static const uint16_t INDEX_VERSION = 1;
+static const char CACHE_MAGIC[4] = {'M', 'L', 'S', 'C'};
+static const uint16_t CACHE_VERSION = 1;
+
+// Longest tag value kept, in bytes of UTF-8
+static const size_t MAX_TAG = 64;
+
+// Bytes read at the start of the audio to find the first frame
+static const size_t FRAME_PROBE_BYTES = 2048;
+
+// Longest path of a track, like the file path of an alarm
+static const size_t MAX_TRACK_PATH = 128;
+
+static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+namespace {
+
+/**
+ * @brief Growable array of plain records in PSRAM
+ * The scan holds the whole collection, which does not fit in internal RAM
+ * for large cards.
+ */
+template <typename T>
+class PsramVector {
+public:
+    PsramVector() = default;
+    PsramVector(const PsramVector&) = delete;
+    PsramVector& operator=(const PsramVector&) = delete;
+    ~PsramVector() { heap_caps_free(items); }
+
+    bool reserve(size_t n) {
+        if (n <= capacity) {
+            return true;
+        }
+        T* grown = (T*)heap_caps_realloc(items, n * sizeof(T), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!grown) {
+            return false;
+        }
+        items = grown;
+        capacity = n;
+        return true;
+    }
+
+    bool resize(size_t n) {
+        if (!reserve(n)) {
+            return false;
+        }
+        count = n;
+        return true;
+    }
+
+    bool append(const T* data, size_t n) {
+        if (count + n > capacity && !reserve(max(count + n, capacity * 2 + 256))) {
+            return false;
+        }
+        memcpy(items + count, data, n * sizeof(T));
+        count += n;
+        return true;
+    }
+
+    bool push(const T& item) { return append(&item, 1); }
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+    T* data() { return items; }
+    const T* data() const { return items; }
+    size_t size() const { return count; }
+
+private:
+    T* items = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+};
+
+// String pool: NUL-terminated strings addressed by offset
+class StringPool {
+public:
+    // Offset of the copy, NO_PARENT if out of memory
+    uint32_t add(const char* text) {
+        uint32_t offset = chars.size();
+        return chars.append(text, strlen(text) + 1) ? offset : NO_PARENT;
+    }
+
+    const char* at(uint32_t offset) const { return chars.data() + offset; }
+    size_t size() const { return chars.size(); }
+    const char* data() const { return chars.data(); }
+    bool load(File& file, size_t bytes) {
+        return chars.resize(bytes) && (bytes == 0 || file.read((uint8_t*)chars.data(), bytes) == bytes);
+    }
+
+private:
+    PsramVector<char> chars;
+};
+
+// Index layout: header, tracks, artists, string pool; all little endian
+struct IndexHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t trackCount;
+    uint32_t artistCount;
+    uint32_t stringBytes;
+} __attribute__((packed));
+
+struct TrackRecord {
+    uint32_t artist;  // String pool offsets
+    uint32_t album;
+    uint32_t title;
+    uint32_t path;
+    uint32_t durationMs;
+    uint16_t trackNo;
+    uint16_t reserved;
+} __attribute__((packed));
+
+struct ArtistRecord {
+    uint32_t name;
+    uint32_t firstTrack;
+    uint32_t trackCount;
+} __attribute__((packed));
+
+// Scan cache layout: header, directories in walk order, files, string pool
+struct CacheHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t dirCount;
+    uint32_t entryCount;
+    uint32_t stringBytes;
+} __attribute__((packed));
+
+struct CacheDir {
+    uint32_t path;
+    uint32_t mtime;
+    uint32_t parent;      // Index of the parent directory, NO_PARENT for the root
+    uint32_t firstEntry;
+    uint32_t entryCount;
+} __attribute__((packed));
+
+struct CacheEntry {
+    uint32_t name;        // File name within its directory
+    uint32_t artist;
+    uint32_t album;
+    uint32_t title;
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t durationMs;
+    uint16_t trackNo;
+    uint16_t reserved;
+} __attribute__((packed));
+
+struct Tags {
+    String artist;
+    String album;
+    String title;
+    uint16_t trackNo = 0;
+    uint32_t durationMs = 0;
+};
+
+// Append a code point as UTF-8
+void appendUtf8(String& out, uint32_t cp) {
+    char buf[5] = {};
+    if (cp < 0x80) {
+        buf[0] = (char)cp;
+    } else if (cp < 0x800) {
+        buf[0] = (char)(0xC0 | (cp >> 6));
+        buf[1] = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        buf[0] = (char)(0xE0 | (cp >> 12));
+        buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        buf[2] = (char)(0x80 | (cp & 0x3F));
+    } else {
+        buf[0] = (char)(0xF0 | (cp >> 18));
+        buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        buf[3] = (char)(0x80 | (cp & 0x3F));
+    }
+    out += buf;
+}
+
+// Text of an ID3 text frame (encoding byte first) as trimmed UTF-8
+String decodeText(const uint8_t* data, size_t len) {
+    String out;
+    if (len == 0) {
+        return out;
+    }
+    uint8_t encoding = data[0];
+    data++;
+    len--;
+
+    if (encoding == 1 || encoding == 2) {
+        // UTF-16, with a byte order mark (1) or big endian (2)
+        bool bigEndian = encoding == 2;
+        size_t i = 0;
+        if (encoding == 1 && len >= 2) {
+            bigEndian = data[0] == 0xFE && data[1] == 0xFF;
+            i = 2;
+        }
+        for (; i + 1 < len && out.length() < MAX_TAG - 4; i += 2) {
+            uint32_t unit = bigEndian ? (data[i] << 8) | data[i + 1] : (data[i + 1] << 8) | data[i];
+            if (unit == 0) {
+                break;
+            }
+            if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < len) {
+                uint32_t low = bigEndian ? (data[i + 2] << 8) | data[i + 3] : (data[i + 3] << 8) | data[i + 2];
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+            appendUtf8(out, unit);
+        }
+    } else {
+        // ISO-8859-1 (0) or UTF-8 (3)
+        for (size_t i = 0; i < len && data[i] && out.length() < MAX_TAG - 4; i++) {
+            if (encoding == 0) {
+                appendUtf8(out, data[i]);
+            } else {
+                out += (char)data[i];
+            }
+        }
+    }
+    out.trim();
+    return out;
+}
+
+uint32_t readBe32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+uint32_t syncsafe(const uint8_t* p) {
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) |
+           ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+/**
+ * @brief Read the ID3v2 frames the library needs, skipping the rest
+ * Pictures and other large frames are seeked over, never read.
+ * @return Offset of the audio after the tag, 0 without a tag
+ */
+uint32_t readId3v2(File& file, Tags& tags) {
+    uint8_t header[10];
+    if (!file.seek(0) || file.read(header, sizeof(header)) != sizeof(header) ||
+        header[0] != 'I' || header[1] != 'D' || header[2] != '3') {
+        return 0;
+    }
+    uint8_t version = header[3];
+    uint32_t tagSize = syncsafe(header + 6);
+    uint32_t audioStart = 10 + tagSize + ((header[5] & 0x10) ? 10 : 0);
+    if (version < 2 || version > 4) {
+        return audioStart;
+    }
+
+    uint32_t pos = 10;
+    uint32_t end = 10 + tagSize;
+    if (header[5] & 0x40) {
+        // Extended header: v2.4 counts itself, v2.3 does not
+        uint8_t ext[4];
+        if (!file.seek(pos) || file.read(ext, 4) != 4) {
+            return audioStart;
+        }
+        pos += version == 4 ? syncsafe(ext) : readBe32(ext) + 4;
+    }
+
+    const size_t idLen = version == 2 ? 3 : 4;
+    const size_t frameHeaderLen = version == 2 ? 6 : 10;
+    String albumArtist;
+    while (pos + frameHeaderLen <= end) {
+        uint8_t frame[10];
+        if (!file.seek(pos) || file.read(frame, frameHeaderLen) != frameHeaderLen || frame[0] == 0) {
+            break;  // Padding
+        }
+        uint32_t size;
+        if (version == 2) {
+            size = ((uint32_t)frame[3] << 16) | ((uint32_t)frame[4] << 8) | frame[5];
+        } else if (version == 3) {
+            size = readBe32(frame + 4);
+        } else {
+            size = syncsafe(frame + 4);
+        }
+        pos += frameHeaderLen;
+        if (size == 0 || pos + size > end) {
+            break;
+        }
+
+        char id[5] = {};
+        memcpy(id, frame, idLen);
+        String* target = nullptr;
+        bool number = false;
+        if (!strcmp(id, "TIT2") || !strcmp(id, "TT2")) {
+            target = &tags.title;
+        } else if (!strcmp(id, "TPE1") || !strcmp(id, "TP1")) {
+            target = &tags.artist;
+        } else if (!strcmp(id, "TPE2") || !strcmp(id, "TP2")) {
+            target = &albumArtist;
+        } else if (!strcmp(id, "TALB") || !strcmp(id, "TAL")) {
+            target = &tags.album;
+        } else if (!strcmp(id, "TRCK") || !strcmp(id, "TRK") || !strcmp(id, "TLEN") || !strcmp(id, "TLE")) {
+            number = true;
+        }
+
+        if (target || number) {
+            uint8_t text[2 * MAX_TAG + 2];
+            size_t len = min((size_t)size, sizeof(text));
+            if (file.read(text, len) != len) {
+                break;
+            }
+            String value = decodeText(text, len);
+            if (target) {
+                *target = value;
+            } else if (id[1] == 'R') {
+                tags.trackNo = value.toInt();  // "3" or "3/12"
+            } else {
+                tags.durationMs = value.toInt();
+            }
+        }
+        pos += size;
+    }
+
+    if (tags.artist.length() == 0) {
+        tags.artist = albumArtist;
+    }
+    return audioStart;
+}
+
+// ID3v1 trailer fills what the v2 tag left empty; returns its size
+uint32_t readId3v1(File& file, uint32_t fileSize, Tags& tags) {
+    uint8_t tag[128];
+    if (fileSize < sizeof(tag) || !file.seek(fileSize - sizeof(tag)) ||
+        file.read(tag, sizeof(tag)) != sizeof(tag) || memcmp(tag, "TAG", 3) != 0) {
+        return 0;
+    }
+    struct Field {
+        String* target;
+        size_t offset;
+    } fields[] = {{&tags.title, 3}, {&tags.artist, 33}, {&tags.album, 63}};
+    for (const Field& field : fields) {
+        if (field.target->length() > 0) {
+            continue;
+        }
+        uint8_t text[31] = {0};  // Encoding byte 0: ISO-8859-1
+        memcpy(text + 1, tag + field.offset, 30);
+        *field.target = decodeText(text, sizeof(text));
+    }
+    // ID3v1.1: track number in the last comment byte
+    if (tags.trackNo == 0 && tag[125] == 0 && tag[126] != 0) {
+        tags.trackNo = tag[126];
+    }
+    return sizeof(tag);
+}
+
+/**
+ * @brief Duration from the first MPEG frame
+ * Exact with a Xing/Info or VBRI header (VBR files), from the bitrate of
+ * the first frame otherwise.
+ */
+uint32_t readDuration(File& file, uint32_t audioStart, uint32_t audioEnd) {
+    uint8_t probe[FRAME_PROBE_BYTES];
+    size_t len = file.seek(audioStart) ? file.read(probe, sizeof(probe)) : 0;
+
+    AudioCodec::FrameHeader header;
+    AudioCodec::FrameHeader next;
+    for (size_t i = 0; i + AudioCodec::FRAME_HEADER_BYTES <= len; i++) {
+        if (!AudioCodec::parseFrameHeader(probe + i, header) || header.sampleRate == 0) {
+            continue;
+        }
+        size_t following = i + header.length;
+        if (following + AudioCodec::FRAME_HEADER_BYTES <= len &&
+            !AudioCodec::parseFrameHeader(probe + following, next)) {
+            continue;
+        }
+
+        // Xing/Info sits after the side information, VBRI 32 bytes in
+        size_t frameEnd = min(following, len);
+        for (size_t j = i + 4; j + 16 <= frameEnd && j < i + 64; j++) {
+            const uint8_t* p = probe + j;
+            uint32_t frames = 0;
+            if ((!memcmp(p, "Xing", 4) || !memcmp(p, "Info", 4)) && (readBe32(p + 4) & 1)) {
+                frames = readBe32(p + 8);
+            } else if (!memcmp(p, "VBRI", 4) && j + 18 <= frameEnd) {
+                frames = readBe32(p + 14);
+            }
+            if (frames > 0) {
+                return (uint32_t)((uint64_t)frames * header.samples * 1000 / header.sampleRate);
+            }
+        }
+
+        uint32_t audioBytes = audioEnd > audioStart + i ? audioEnd - audioStart - i : 0;
+        return (uint32_t)((uint64_t)audioBytes * header.samples * 1000 / ((uint64_t)header.length * header.sampleRate));
+    }
+    return 0;
+}
+
+bool readTags(const char* path, const char* name, Tags& tags) {
+    File file = SD.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    uint32_t size = file.size();
+    uint32_t audioStart = readId3v2(file, tags);
+    uint32_t trailer = readId3v1(file, size, tags);
+    if (tags.durationMs == 0) {
+        tags.durationMs = readDuration(file, audioStart, size - trailer);
+    }
+    file.close();
+
+    if (tags.title.length() == 0) {
+        tags.title = name;
+        int dot = tags.title.lastIndexOf('.');
+        if (dot > 0) {
+            tags.title.remove(dot);
+        }
+    }
+    if (tags.artist.length() == 0) {
+        tags.artist = "Unknown artist";
+    }
+    return true;
+}
+
+bool isMp3(const char* name) {
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".mp3") == 0;
+}
+
+bool isSkipped(const char* path) {
+    for (const char* skipped : SKIPPED_DIRS) {
+        if (strcasecmp(path, skipped) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief One scan: the cache of the last scan in, new cache and index out
+ */
+class LibraryScan {
+public:
+    explicit LibraryScan(bool full) : full(full) {}
+
+    uint32_t scanned = 0;
+    uint32_t reused = 0;
+    bool failed = false;  // Out of memory, the old index stays
+
+    void loadCache() {
+        File file = SD.open(CACHE_PATH, FILE_READ);
+        if (!file) {
+            return;
+        }
+        CacheHeader header;
+        bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                  header.version == CACHE_VERSION &&
+                  file.size() == sizeof(header) + header.dirCount * sizeof(CacheDir) +
+                                 header.entryCount * sizeof(CacheEntry) + header.stringBytes &&
+                  oldDirs.resize(header.dirCount) && oldEntries.resize(header.entryCount) &&
+                  file.read((uint8_t*)oldDirs.data(), header.dirCount * sizeof(CacheDir)) ==
+                      header.dirCount * sizeof(CacheDir) &&
+                  file.read((uint8_t*)oldEntries.data(), header.entryCount * sizeof(CacheEntry)) ==
+                      header.entryCount * sizeof(CacheEntry) &&
+                  oldStrings.load(file, header.stringBytes);
+        file.close();
+        if (!ok) {
+            Serial.println("[LIBRARY] Scan cache unusable, reading all tags");
+            oldDirs.resize(0);
+            oldEntries.resize(0);
+        }
+    }
+
+    void walk(const char* path, uint32_t parent, uint8_t depth) {
+        if (failed || isSkipped(path)) {
+            return;
+        }
+        File dir = SD.open(path);
+        if (!dir || !dir.isDirectory()) {
+            return;
+        }
+        uint32_t mtime = (uint32_t)dir.getLastWrite();
+        int32_t old = findOldDir(path);
+
+        CacheDir record;
+        record.path = strings.add(path);
+        record.mtime = mtime;
+        record.parent = parent;
+        record.firstEntry = entries.size();
+        record.entryCount = 0;
+        uint32_t index = dirs.size();
+        if (record.path == NO_PARENT || !dirs.push(record)) {
+            dir.close();
+            failed = true;
+            return;
+        }
+
+        if (old >= 0 && !full && oldDirs[old].mtime == mtime) {
+            // Nothing was added, removed or renamed here: no listing, no tags
+            dir.close();
+            const CacheDir& cached = oldDirs[old];
+            for (uint32_t i = 0; i < cached.entryCount && !failed; i++) {
+                copyOldEntry(oldEntries[cached.firstEntry + i]);
+                reused++;
+            }
+            dirs[index].entryCount = entries.size() - dirs[index].firstEntry;
+            if (depth < MAX_WALK_DEPTH) {
+                for (size_t i = 0; i < oldDirs.size() && !failed; i++) {
+                    if (oldDirs[i].parent == (uint32_t)old) {
+                        // Copy the path, the recursion grows the pool
+                        String child = oldStrings.at(oldDirs[i].path);
+                        walk(child.c_str(), index, depth + 1);
+                    }
+                }
+            }
+            return;
+        }
+
+        // Collect the entries first, so no directory stays open while reading tags
+        std::vector<String> subdirs;
+        struct FileInfo {
+            String name;
+            uint32_t size;
+            uint32_t mtime;
+        };
+        std::vector<FileInfo> files;
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+            const char* name = entry.name();
+            if (name[0] != '.') {
+                if (entry.isDirectory()) {
+                    subdirs.push_back(entry.path());
+                } else if (isMp3(name)) {
+                    files.push_back({name, (uint32_t)entry.size(), (uint32_t)entry.getLastWrite()});
+                }
+            }
+            entry.close();
+        }
+        dir.close();
+
+        for (const FileInfo& info : files) {
+            if (failed) {
+                return;
+            }
+            const CacheEntry* cached = old >= 0 ? findOldEntry(oldDirs[old], info.name.c_str()) : nullptr;
+            if (cached && cached->size == info.size && cached->mtime == info.mtime) {
+                copyOldEntry(*cached);
+                reused++;
+                continue;
+            }
+
+            String filePath = String(path) + (path[strlen(path) - 1] == '/' ? "" : "/") + info.name;
+            if (filePath.length() >= MAX_TRACK_PATH) {
+                continue;
+            }
+            Tags tags;
+            if (!readTags(filePath.c_str(), info.name.c_str(), tags)) {
+                continue;
+            }
+            CacheEntry entry = {};
+            entry.name = strings.add(info.name.c_str());
+            entry.artist = strings.add(tags.artist.c_str());
+            entry.album = strings.add(tags.album.c_str());
+            entry.title = strings.add(tags.title.c_str());
+            entry.size = info.size;
+            entry.mtime = info.mtime;
+            entry.durationMs = tags.durationMs;
+            entry.trackNo = tags.trackNo;
+            addEntry(entry);
+            scanned++;
+            vTaskDelay(pdMS_TO_TICKS(SCAN_YIELD_MS));
+        }
+        dirs[index].entryCount = entries.size() - dirs[index].firstEntry;
+
+        if (depth < MAX_WALK_DEPTH) {
+            for (const String& subdir : subdirs) {
+                walk(subdir.c_str(), index, depth + 1);
+            }
+        }
+    }
+
+    // Write the cache to a temporary file and replace the old one
+    bool writeCache() {
+        String temp = String(CACHE_PATH) + ".tmp";
+        File file = SD.open(temp.c_str(), FILE_WRITE);
+        if (!file) {
+            return false;
+        }
+        CacheHeader header;
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.reserved = 0;
+        header.dirCount = dirs.size();
+        header.entryCount = entries.size();
+        header.stringBytes = strings.size();
+        bool ok = writeAll(file, &header, sizeof(header)) &&
+                  writeAll(file, dirs.data(), dirs.size() * sizeof(CacheDir)) &&
+                  writeAll(file, entries.data(), entries.size() * sizeof(CacheEntry)) &&
+                  writeAll(file, strings.data(), strings.size());
+        file.close();
+        return ok && replace(temp.c_str(), CACHE_PATH);
+    }
+
+    /**
+     * @brief Sort the tracks and write the index to a temporary file
+     * @param indexPath Receives the path of the new index
+     */
+    bool writeIndex(String& indexPath, uint32_t& trackCount, uint32_t& artistCount) {
+        // Directory of each entry, for the full path
+        PsramVector<uint32_t> entryDir;
+        PsramVector<uint32_t> order;
+        if (!entryDir.resize(entries.size()) || !order.resize(entries.size())) {
+            return false;
+        }
+        for (size_t d = 0; d < dirs.size(); d++) {
+            for (uint32_t i = 0; i < dirs[d].entryCount; i++) {
+                entryDir[dirs[d].firstEntry + i] = d;
+            }
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.data(), order.data() + order.size(), [this](uint32_t a, uint32_t b) {
+            const CacheEntry& x = entries[a];
+            const CacheEntry& y = entries[b];
+            int c = strcasecmp(strings.at(x.artist), strings.at(y.artist));
+            if (c == 0) {
+                c = strcasecmp(strings.at(x.album), strings.at(y.album));
+            }
+            if (c == 0 && x.trackNo != y.trackNo) {
+                return x.trackNo < y.trackNo;
+            }
+            if (c == 0) {
+                c = strcasecmp(strings.at(x.title), strings.at(y.title));
+            }
+            return c < 0;
+        });
+
+        // Consecutive tracks share the artist and album strings
+        StringPool pool;
+        PsramVector<TrackRecord> tracks;
+        PsramVector<ArtistRecord> artists;
+        const char* lastArtist = nullptr;
+        const char* lastAlbum = nullptr;
+        TrackRecord track = {};
+        for (size_t i = 0; i < order.size(); i++) {
+            const CacheEntry& entry = entries[order[i]];
+            const char* artist = strings.at(entry.artist);
+            const char* album = strings.at(entry.album);
+            const char* dirPath = strings.at(dirs[entryDir[order[i]]].path);
+            String path = String(dirPath) + (dirPath[strlen(dirPath) - 1] == '/' ? "" : "/") +
+                          strings.at(entry.name);
+
+            if (!lastArtist || strcasecmp(artist, lastArtist) != 0) {
+                track.artist = pool.add(artist);
+                ArtistRecord record = {track.artist, (uint32_t)i, 0};
+                if (!artists.push(record)) {
+                    return false;
+                }
+                lastAlbum = nullptr;
+            }
+            if (!lastAlbum || strcmp(album, lastAlbum) != 0) {
+                track.album = pool.add(album);
+            }
+            lastArtist = artist;
+            lastAlbum = album;
+            track.title = pool.add(strings.at(entry.title));
+            track.path = pool.add(path.c_str());
+            track.durationMs = entry.durationMs;
+            track.trackNo = entry.trackNo;
+            if (track.artist == NO_PARENT || track.album == NO_PARENT || track.title == NO_PARENT ||
+                track.path == NO_PARENT || !tracks.push(track)) {
+                return false;
+            }
+            artists[artists.size() - 1].trackCount++;
+        }
+
+        indexPath = String(INDEX_PATH) + ".tmp";
+        File file = SD.open(indexPath.c_str(), FILE_WRITE);
+        if (!file) {
+            return false;
+        }
+        IndexHeader header;
+        memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = INDEX_VERSION;
+        header.reserved = 0;
+        header.trackCount = tracks.size();
+        header.artistCount = artists.size();
+        header.stringBytes = pool.size();
+        bool ok = writeAll(file, &header, sizeof(header)) &&
+                  writeAll(file, tracks.data(), tracks.size() * sizeof(TrackRecord)) &&
+                  writeAll(file, artists.data(), artists.size() * sizeof(ArtistRecord)) &&
+                  writeAll(file, pool.data(), pool.size());
+        file.close();
+        trackCount = tracks.size();
+        artistCount = artists.size();
+        return ok;
+    }
+
+    static bool replace(const char* temp, const char* path) {
+        if (SD.exists(path)) {
+            SD.remove(path);
+        }
+        return SD.rename(temp, path);
+    }
+
+private:
+    bool full;
+
+    PsramVector<CacheDir> oldDirs;
+    PsramVector<CacheEntry> oldEntries;
+    StringPool oldStrings;
+
+    PsramVector<CacheDir> dirs;
+    PsramVector<CacheEntry> entries;
+    StringPool strings;
+
+    static bool writeAll(File& file, const void* data, size_t len) {
+        return len == 0 || file.write((const uint8_t*)data, len) == len;
+    }
+
+    int32_t findOldDir(const char* path) const {
+        for (size_t i = 0; i < oldDirs.size(); i++) {
+            if (strcmp(oldStrings.at(oldDirs[i].path), path) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    const CacheEntry* findOldEntry(const CacheDir& dir, const char* name) const {
+        for (uint32_t i = 0; i < dir.entryCount; i++) {
+            const CacheEntry& entry = oldEntries[dir.firstEntry + i];
+            if (strcmp(oldStrings.at(entry.name), name) == 0) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    void copyOldEntry(const CacheEntry& cached) {
+        CacheEntry entry = cached;
+        entry.name = strings.add(oldStrings.at(cached.name));
+        entry.artist = strings.add(oldStrings.at(cached.artist));
+        entry.album = strings.add(oldStrings.at(cached.album));
+        entry.title = strings.add(oldStrings.at(cached.title));
+        addEntry(entry);
+    }
+
+    void addEntry(const CacheEntry& entry) {
+        if (entry.name == NO_PARENT || entry.artist == NO_PARENT || entry.album == NO_PARENT ||
+            entry.title == NO_PARENT || !entries.push(entry)) {
+            failed = true;
+        }
+    }
+};
+
+// Open the index and check its header; the caller holds the library mutex
+bool openIndex(File& file, IndexHeader& header) {
+    file = SD.open(INDEX_PATH, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+              header.version == INDEX_VERSION &&
+              file.size() == sizeof(header) + header.trackCount * sizeof(TrackRecord) +
+                             header.artistCount * sizeof(ArtistRecord) + header.stringBytes;
+    if (!ok) {
+        file.close();
+    }
+    return ok;
+}
+
+String readString(File& file, const IndexHeader& header, uint32_t offset) {
+    uint32_t start = sizeof(header) + header.trackCount * sizeof(TrackRecord) +
+                     header.artistCount * sizeof(ArtistRecord);
+    if (offset >= header.stringBytes || !file.seek(start + offset)) {
+        return String();
+    }
+    // No string in the pool is longer than a track path
+    char text[MAX_TRACK_PATH + 1];
+    size_t len = file.read((uint8_t*)text, min((size_t)MAX_TRACK_PATH, (size_t)(header.stringBytes - offset)));
+    text[len] = '\0';
+    return String(text);
+}
+
+}  // namespace
+
+void MusicLibrary::begin(const char* root) {
+    if (taskHandle) {
+        return;
+    }
+    strlcpy(rootPath, root ? root : "/", sizeof(rootPath));
+
+    mutex = xSemaphoreCreateMutex();
+    if (!mutex) {
+        Serial.println("[ERROR] Failed to create music library mutex");
+        return;
+    }
+
+    // Counts of the index from the last boot until the first scan is done
+    File index;
+    IndexHeader header;
+    if (openIndex(index, header)) {
+        status.tracks = header.trackCount;
+        status.artists = header.artistCount;
+        index.close();
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        scannerTask,            // Task function
+        "MusicLibrary",         // Task name for debugging
+        SCANNER_TASK_STACK,     // Stack size
+        this,                   // Task parameters
+        SCANNER_TASK_PRIORITY,  // Task priority
+        &taskHandle,            // Task handle
+        SCANNER_TASK_CORE       // Core to run the task on
+    );
+    if (created != pdPASS) {
+        Serial.println("[ERROR] Failed to create music library task");
+        taskHandle = nullptr;
+    }
+}
+
+void MusicLibrary::rescan(bool full) {
+    if (!taskHandle) {
+        return;
+    }
+    if (full) {
+        fullRescan = true;
+    }
+    xTaskNotifyGive(taskHandle);
+}
+
+void MusicLibrary::scannerTask(void* parameter) {
+    MusicLibrary* self = static_cast<MusicLibrary*>(parameter);
+
+    while (true) {
+        self->scan(self->fullRescan.exchange(false));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void MusicLibrary::scan(bool full) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.scanning = true;
+    xSemaphoreGive(mutex);
+
+    uint32_t started = millis();
+    if (!SD.exists(LIBRARY_DIR)) {
+        SD.mkdir(LIBRARY_DIR);
+    }
+
+    LibraryScan run(full);
+    run.loadCache();
+    run.walk(rootPath, NO_PARENT, 0);
+
+    String indexPath;
+    uint32_t tracks = 0;
+    uint32_t artists = 0;
+    bool ok = !run.failed && run.writeIndex(indexPath, tracks, artists);
+    if (ok) {
+        // Queries hold the mutex while the index is open
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        ok = LibraryScan::replace(indexPath.c_str(), INDEX_PATH);
+        xSemaphoreGive(mutex);
+    }
+    if (ok && !run.writeCache()) {
+        Serial.println("[ERROR] Failed to write the library scan cache");
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.scanning = false;
+    status.scanned = run.scanned;
+    status.reused = run.reused;
+    status.lastScanMs = millis() - started;
+    if (ok) {
+        status.tracks = tracks;
+        status.artists = artists;
+    }
+    xSemaphoreGive(mutex);
+
+    if (ok) {
+        Serial.printf("[LIBRARY] %u tracks by %u artists in %lu ms (%u tags read, %u from cache)\n",
+                      tracks, artists, millis() - started, run.scanned, run.reused);
+    } else {
+        Serial.println("[ERROR] Music library scan failed, keeping the previous index");
+    }
+}
+
+size_t MusicLibrary::getTracks(uint32_t first, size_t count, std::vector<Track>& tracks) {
+    if (!mutex) {
+        return 0;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    File file;
+    IndexHeader header;
+    size_t added = 0;
+    if (openIndex(file, header)) {
+        size_t available = first < header.trackCount ? header.trackCount - first : 0;
+        std::vector<TrackRecord> records(min(count, available));
+        size_t bytes = records.size() * sizeof(TrackRecord);
+        if (!records.empty() && file.seek(sizeof(header) + first * sizeof(TrackRecord)) &&
+            file.read((uint8_t*)records.data(), bytes) == bytes) {
+            // A page mostly shares artist and album, read those once
+            uint32_t artistOffset = NO_PARENT;
+            uint32_t albumOffset = NO_PARENT;
+            String artist;
+            String album;
+            for (const TrackRecord& record : records) {
+                if (record.artist != artistOffset) {
+                    artistOffset = record.artist;
+                    artist = readString(file, header, record.artist);
+                }
+                if (record.album != albumOffset) {
+                    albumOffset = record.album;
+                    album = readString(file, header, record.album);
+                }
+                Track track;
+                track.artist = artist;
+                track.album = album;
+                track.title = readString(file, header, record.title);
+                track.path = readString(file, header, record.path);
+                track.durationMs = record.durationMs;
+                track.trackNo = record.trackNo;
+                tracks.push_back(track);
+                added++;
+            }
+        }
+        file.close();
+    }
+    xSemaphoreGive(mutex);
+    return added;
+}
+
+size_t MusicLibrary::getArtists(uint32_t first, size_t count, std::vector<Artist>& artists) {
+    if (!mutex) {
+        return 0;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    File file;
+    IndexHeader header;
+    size_t added = 0;
+    if (openIndex(file, header)) {
+        size_t available = first < header.artistCount ? header.artistCount - first : 0;
+        std::vector<ArtistRecord> records(min(count, available));
+        size_t bytes = records.size() * sizeof(ArtistRecord);
+        uint32_t start = sizeof(header) + header.trackCount * sizeof(TrackRecord) + first * sizeof(ArtistRecord);
+        if (!records.empty() && file.seek(start) && file.read((uint8_t*)records.data(), bytes) == bytes) {
+            for (const ArtistRecord& record : records) {
+                Artist artist;
+                artist.name = readString(file, header, record.name);
+                artist.firstTrack = record.firstTrack;
+                artist.trackCount = record.trackCount;
+                artists.push_back(artist);
+                added++;
+            }
+        }
+        file.close();
+    }
+    xSemaphoreGive(mutex);
+    return added;
+}
+
+uint32_t MusicLibrary::findArtist(const char* prefix) {
+    if (!mutex) {
+        return 0;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    File file;
+    IndexHeader header;
+    uint32_t low = 0;
+    uint32_t high = 0;
+    if (openIndex(file, header)) {
+        // Lower bound over the sorted artist records, one record and name per step
+        high = header.artistCount;
+        uint32_t start = sizeof(header) + header.trackCount * sizeof(TrackRecord);
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            ArtistRecord record;
+            if (!file.seek(start + mid * sizeof(ArtistRecord)) ||
+                file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+                break;
+            }
+            if (strcasecmp(readString(file, header, record.name).c_str(), prefix) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        file.close();
+    }
+    xSemaphoreGive(mutex);
+    return low;
+}
+
+MusicLibrary::Status MusicLibrary::getStatus() {
+    if (!mutex) {
+        return status;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Status copy = status;
+    xSemaphoreGive(mutex);
+    return copy;
+}
@@ -0,0 +1,272 @@
+#include "OggDemuxer.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+// Header fields
+static const size_t CRC_OFFSET = 22;
+static const size_t SEGMENT_COUNT_OFFSET = 26;
+static const uint8_t FLAG_CONTINUED = 0x01;
+static const uint8_t FLAG_FIRST_PAGE = 0x02;
+
+// CRC-32 of Ogg: polynomial 0x04C11DB7, not reflected, zero initial value
+static uint32_t crcTable[256];
+static bool crcTableReady = false;
+
+static void buildCrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t r = i << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            r = (r & 0x80000000) ? (r << 1) ^ 0x04C11DB7 : r << 1;
+        }
+        crcTable[i] = r;
+    }
+    crcTableReady = true;
+}
+
+static uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void* allocBuffer(size_t len) {
+#ifdef ESP_PLATFORM
+    void* buffer = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return buffer ? buffer : heap_caps_malloc(len, MALLOC_CAP_8BIT);
+#else
+    return malloc(len);
+#endif
+}
+
+static void freeBuffer(void* buffer) {
+#ifdef ESP_PLATFORM
+    heap_caps_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+OggDemuxer::~OggDemuxer() {
+    release();
+}
+
+bool OggDemuxer::allocate() {
+    if (!crcTableReady) {
+        buildCrcTable();
+    }
+    if (!page) {
+        page = (uint8_t*)allocBuffer(MAX_PAGE);
+    }
+    if (!joined) {
+        joined = (uint8_t*)allocBuffer(MAX_PACKET);
+    }
+    if (!page || !joined) {
+        release();
+        return false;
+    }
+    reset();
+    return true;
+}
+
+void OggDemuxer::release() {
+    freeBuffer(page);
+    freeBuffer(joined);
+    page = nullptr;
+    joined = nullptr;
+    reset();
+}
+
+void OggDemuxer::reset() {
+    phase = Phase::Header;
+    have = 0;
+    pageLen = 0;
+    segment = 0;
+    bodyPos = 0;
+    joining = false;
+    joinOverflow = false;
+    joinedLen = 0;
+    locked = false;
+    streamStart = false;
+    pageStartsStream = false;
+    granule = -1;
+}
+
+bool OggDemuxer::fill(ReadFn read, void* context, size_t target) {
+    while (have < target) {
+        size_t got = read(context, page + have, target - have);
+        if (got == 0) {
+            return false;
+        }
+        have += got;
+    }
+    return true;
+}
+
+void OggDemuxer::resync(size_t from) {
+    // Keep everything from the next byte that could start a capture pattern
+    static const char CAPTURE[] = "OggS";
+    size_t start = from;
+    for (; start < have; start++) {
+        size_t match = 0;
+        while (match < 4 && start + match < have && page[start + match] == (uint8_t)CAPTURE[match]) {
+            match++;
+        }
+        if (match == 4 || start + match == have) {
+            break;
+        }
+    }
+    memmove(page, page + start, have - start);
+    have -= start;
+    skippedBytes += start;
+    phase = Phase::Header;
+
+    // Whatever was being joined lost its continuation
+    if (joining) {
+        joinOverflow = true;
+    }
+}
+
+bool OggDemuxer::checkPage() {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < pageLen; i++) {
+        uint8_t byte = (i >= CRC_OFFSET && i < CRC_OFFSET + 4) ? 0 : page[i];
+        crc = (crc << 8) ^ crcTable[((crc >> 24) ^ byte) & 0xFF];
+    }
+    return crc == readLe32(page + CRC_OFFSET);
+}
+
+OggDemuxer::Result OggDemuxer::next(ReadFn read, void* context, const uint8_t** packet, size_t* len) {
+    if (!page) {
+        return Result::NeedData;
+    }
+
+    while (true) {
+        switch (phase) {
+            case Phase::Header:
+                if (!fill(read, context, HEADER_BYTES)) {
+                    return Result::NeedData;
+                }
+                if (memcmp(page, "OggS", 4) != 0 || page[4] != 0) {
+                    resync(1);
+                    continue;
+                }
+                pageLen = HEADER_BYTES + page[SEGMENT_COUNT_OFFSET];
+                phase = Phase::Segments;
+                // Fall through
+
+            case Phase::Segments: {
+                if (!fill(read, context, pageLen)) {
+                    return Result::NeedData;
+                }
+                size_t segments = page[SEGMENT_COUNT_OFFSET];
+                size_t body = 0;
+                for (size_t i = 0; i < segments; i++) {
+                    body += page[HEADER_BYTES + i];
+                }
+                pageLen = HEADER_BYTES + segments + body;
+                phase = Phase::Body;
+            }
+                // Fall through
+
+            case Phase::Body: {
+                if (!fill(read, context, pageLen)) {
+                    return Result::NeedData;
+                }
+                if (!checkPage()) {
+                    badPages++;
+                    resync(1);
+                    continue;
+                }
+
+                uint32_t pageSerial = readLe32(page + 14);
+                bool firstPage = page[5] & FLAG_FIRST_PAGE;
+                if (!locked || (firstPage && pageSerial != serial)) {
+                    // First stream seen, or the next one of a chain
+                    locked = true;
+                    serial = pageSerial;
+                    joining = false;
+                }
+                if (pageSerial != serial) {
+                    // Another stream multiplexed into the same container
+                    have = 0;
+                    phase = Phase::Header;
+                    continue;
+                }
+
+                bool continued = page[5] & FLAG_CONTINUED;
+                if (continued && !joining) {
+                    // Tail of a packet whose start never arrived
+                    joining = true;
+                    joinOverflow = true;
+                    joinedLen = 0;
+                } else if (!continued && joining) {
+                    // The pages with the rest of the packet were lost
+                    joining = false;
+                }
+
+                pageStartsStream = firstPage;
+                granule = (int64_t)((uint64_t)readLe32(page + 6) | ((uint64_t)readLe32(page + 10) << 32));
+                segment = 0;
+                bodyPos = HEADER_BYTES + page[SEGMENT_COUNT_OFFSET];
+                phase = Phase::Packets;
+            }
+                // Fall through
+
+            case Phase::Packets: {
+                size_t segments = page[SEGMENT_COUNT_OFFSET];
+                while (segment < segments) {
+                    // A packet ends at the first lacing value below 255
+                    size_t start = bodyPos;
+                    size_t size = 0;
+                    bool complete = false;
+                    while (segment < segments) {
+                        uint8_t lacing = page[HEADER_BYTES + segment++];
+                        size += lacing;
+                        bodyPos += lacing;
+                        if (lacing < 255) {
+                            complete = true;
+                            break;
+                        }
+                    }
+
+                    if (!joining && complete) {
+                        // Whole packet in this page
+                        *packet = page + start;
+                        *len = size;
+                        streamStart = pageStartsStream;
+                        pageStartsStream = false;
+                        return Result::Packet;
+                    }
+
+                    if (!joining) {
+                        joining = true;
+                        joinOverflow = false;
+                        joinedLen = 0;
+                    }
+                    if (!joinOverflow) {
+                        if (joinedLen + size > MAX_PACKET) {
+                            joinOverflow = true;
+                        } else {
+                            memcpy(joined + joinedLen, page + start, size);
+                            joinedLen += size;
+                        }
+                    }
+                    if (complete) {
+                        joining = false;
+                        if (!joinOverflow) {
+                            *packet = joined;
+                            *len = joinedLen;
+                            streamStart = pageStartsStream;
+                            pageStartsStream = false;
+                            return Result::Packet;
+                        }
+                    }
+                }
+                have = 0;
+                phase = Phase::Header;
+                break;
+            }
+        }
+    }
+}
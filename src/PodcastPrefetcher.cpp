@@ -0,0 +1,828 @@
+#include "PodcastPrefetcher.h"
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include "TlsClient.h"
+#include <algorithm>
+#include "Mp3Indexer.h"
+
+// Initialize static member
+PodcastPrefetcher* PodcastPrefetcher::instance = nullptr;
+
+// Prefetch task: idle priority on the network core, playback always goes first
+static const uint32_t PREFETCH_TASK_STACK = 16384;  // mbedTLS handshake, HTTP clients and the RSS parser
+static const UBaseType_t PREFETCH_TASK_PRIORITY = 1;
+static const BaseType_t PREFETCH_TASK_CORE = 0;
+
+// Schedule: the nightly run may start within this many hours after the
+// fetch hour, a failed run is retried at this interval
+static const uint8_t FETCH_WINDOW_HOURS = 3;
+static const uint32_t FETCH_CHECK_INTERVAL = 60 * 1000;
+static const uint32_t FETCH_RETRY_INTERVAL = 15 * 60 * 1000;
+
+// HTTP
+static const uint32_t HTTP_TIMEOUT_MS = 10000;
+static const int MAX_REDIRECTS = 5;
+static const size_t MAX_FEED_BYTES = 1024 * 1024;   // Read no further looking for the first item
+static const uint32_t FEED_READ_TIMEOUT = 30000;
+static const uint32_t DOWNLOAD_STALL_TIMEOUT = 20000;
+
+// Download writes to SD in this size, with a pause after each one that
+// leaves the card to a file that is playing
+static const size_t DOWNLOAD_CHUNK = 8 * 1024;
+static const uint32_t DOWNLOAD_YIELD_MS = 2;
+
+static const char* PODCAST_ROOT = "/podcasts";
+static const char* EPISODE_FILE = "episode.json";
+
+namespace {
+
+/**
+ * @brief Streaming RSS parser, extracts the first item with an enclosure
+ * Fed one character at a time, so the feed never has to fit into memory.
+ * Knows just enough XML for feeds: tags with attributes, CDATA sections,
+ * comments and the common entities.
+ */
+class RssItemParser {
+public:
+    String title;
+    String url;
+    String type;
+    uint32_t length = 0;
+
+    bool isDone() const { return done; }
+
+    void feed(char c) {
+        switch (state) {
+            case State::Text:
+                if (c == '<') {
+                    state = State::Tag;
+                    tagLen = 0;
+                    tagOverflow = false;
+                } else if (inTitle) {
+                    appendText(c);
+                }
+                break;
+
+            case State::Tag:
+                if (c == '>') {
+                    state = State::Text;
+                    if (!tagOverflow) {
+                        tag[tagLen] = '\0';
+                        handleTag();
+                    }
+                    break;
+                }
+                if (tagLen + 1 < sizeof(tag)) {
+                    tag[tagLen++] = c;
+                } else {
+                    tagOverflow = true;  // Not a tag worth reading
+                }
+                if (tagLen == 8 && memcmp(tag, "![CDATA[", 8) == 0) {
+                    state = State::Cdata;
+                    brackets = 0;
+                } else if (tagLen == 3 && memcmp(tag, "!--", 3) == 0) {
+                    state = State::Comment;
+                    dashes = 0;
+                }
+                break;
+
+            case State::Cdata:
+                // Ends with "]]>"; brackets are held back until it is clear
+                // they are content
+                if (c == ']') {
+                    brackets++;
+                } else if (c == '>' && brackets >= 2) {
+                    for (; brackets > 2; brackets--) {
+                        appendRaw(']');
+                    }
+                    state = State::Text;
+                } else {
+                    for (; brackets > 0; brackets--) {
+                        appendRaw(']');
+                    }
+                    appendRaw(c);
+                }
+                break;
+
+            case State::Comment:
+                if (c == '>' && dashes >= 2) {
+                    state = State::Text;
+                }
+                dashes = (c == '-') ? dashes + 1 : 0;
+                break;
+        }
+    }
+
+    // Replace the XML entities feeds use in titles and URLs
+    static String decodeEntities(const String& text) {
+        if (text.indexOf('&') < 0) {
+            return text;
+        }
+        String out;
+        out.reserve(text.length());
+        for (size_t i = 0; i < text.length(); i++) {
+            int end = text[i] == '&' ? text.indexOf(';', i) : -1;
+            if (end < 0 || (size_t)end - i > 8) {
+                out += text[i];
+                continue;
+            }
+            String entity = text.substring(i + 1, end);
+            if (entity == "amp") {
+                out += '&';
+            } else if (entity == "lt") {
+                out += '<';
+            } else if (entity == "gt") {
+                out += '>';
+            } else if (entity == "quot") {
+                out += '"';
+            } else if (entity == "apos") {
+                out += '\'';
+            } else if (entity.startsWith("#")) {
+                long code = entity.startsWith("#x") ? strtol(entity.c_str() + 2, nullptr, 16)
+                                                    : strtol(entity.c_str() + 1, nullptr, 10);
+                // Titles are shown on a display with Latin-1 fonts at best
+                out += (code > 0 && code < 256) ? (char)code : '?';
+            } else {
+                out += text.substring(i, end + 1);
+            }
+            i = end;
+        }
+        return out;
+    }
+
+private:
+    enum class State { Text, Tag, Cdata, Comment };
+
+    static const size_t MAX_TITLE = 160;
+
+    State state = State::Text;
+    char tag[768];  // Enclosure tags carry long tracking URLs
+    size_t tagLen = 0;
+    bool tagOverflow = false;
+    uint8_t brackets = 0;
+    uint8_t dashes = 0;
+    bool inItem = false;
+    bool inTitle = false;
+    bool done = false;
+    String text;
+
+    void appendText(char c) {
+        if (text.length() < MAX_TITLE) {
+            text += c;
+        }
+    }
+
+    void appendRaw(char c) {
+        if (inTitle) {
+            appendText(c);
+        }
+    }
+
+    bool tagIs(const char* name) const {
+        size_t len = strlen(name);
+        return strncmp(tag, name, len) == 0 &&
+               (tag[len] == '\0' || tag[len] == ' ' || tag[len] == '/' || tag[len] == '\t' ||
+                tag[len] == '\r' || tag[len] == '\n');
+    }
+
+    // Value of an attribute of the current tag, empty if it has none
+    String attribute(const char* name) const {
+        size_t len = strlen(name);
+        for (const char* p = strstr(tag, name); p; p = strstr(p + 1, name)) {
+            bool start = p > tag && isspace((unsigned char)p[-1]);
+            const char* q = p + len;
+            while (isspace((unsigned char)*q)) {
+                q++;
+            }
+            if (!start || *q != '=') {
+                continue;
+            }
+            q++;
+            while (isspace((unsigned char)*q)) {
+                q++;
+            }
+            char quote = *q;
+            if (quote != '"' && quote != '\'') {
+                continue;
+            }
+            const char* end = strchr(q + 1, quote);
+            if (!end) {
+                return "";
+            }
+            String value;
+            value.concat(q + 1, end - q - 1);
+            return decodeEntities(value);
+        }
+        return "";
+    }
+
+    void handleTag() {
+        if (done) {
+            return;
+        }
+        if (tagIs("item")) {
+            inItem = true;
+            title = "";
+            url = "";
+        } else if (tagIs("/item")) {
+            // An item without audio (a text post) does not count
+            done = url.length() > 0;
+            inItem = false;
+        } else if (inItem && tagIs("title")) {
+            inTitle = tag[tagLen - 1] != '/';
+            text = "";
+        } else if (inItem && tagIs("/title")) {
+            inTitle = false;
+            title = decodeEntities(text);
+            title.trim();
+        } else if (inItem && url.isEmpty() && tagIs("enclosure")) {
+            url = attribute("url");
+            type = attribute("type");
+            length = strtoul(attribute("length").c_str(), nullptr, 10);
+        }
+    }
+};
+
+/**
+ * @brief HTTP GET that follows redirects by hand
+ * Podcast hosts redirect through tracking prefixes and CDNs, often between
+ * http and https; every hop gets a client of the right kind.
+ */
+class HttpGet {
+public:
+    HTTPClient http;
+
+    ~HttpGet() { http.end(); }
+
+    int get(const String& start, const String& range = "") {
+        static const char* headerKeys[] = {"Location", "Content-Range"};
+        String url = start;
+        for (int hop = 0; hop < MAX_REDIRECTS; hop++) {
+            http.end();
+            http.setReuse(false);
+            http.setTimeout(HTTP_TIMEOUT_MS);
+            http.setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+            http.setUserAgent("Radiowecker/1.0");
+            http.useHTTP10(true);  // No chunked encoding, the body is read raw
+            http.collectHeaders(headerKeys, 2);
+
+            bool opened;
+            if (url.startsWith("https://")) {
+                // Checked against the SD trust store; CDN hops that repeat
+                // resume their TLS session
+                opened = http.begin(secure, url);
+            } else {
+                opened = http.begin(plain, url);
+            }
+            if (!opened) {
+                Serial.printf("[ERROR] Invalid podcast URL: %s\n", url.c_str());
+                return -1;
+            }
+            if (range.length() > 0) {
+                http.addHeader("Range", range);
+            }
+
+            int code = http.GET();
+            if (code != HTTP_CODE_MOVED_PERMANENTLY && code != HTTP_CODE_FOUND &&
+                code != HTTP_CODE_SEE_OTHER && code != HTTP_CODE_TEMPORARY_REDIRECT &&
+                code != HTTP_CODE_PERMANENT_REDIRECT) {
+                return code;
+            }
+            String location = http.header("Location");
+            if (location.isEmpty()) {
+                return code;
+            }
+            if (location.startsWith("/")) {
+                // Relative to the host of the request
+                int hostEnd = url.indexOf('/', url.indexOf("//") + 2);
+                location = (hostEnd < 0 ? url : url.substring(0, hostEnd)) + location;
+            }
+            url = location;
+        }
+        Serial.printf("[ERROR] Too many redirects fetching %s\n", start.c_str());
+        return -1;
+    }
+
+private:
+    WiFiClient plain;
+    TlsClient secure;
+};
+
+// Episode files on SD, for pruning
+struct StoredFile {
+    String path;
+    uint32_t size;
+    time_t modified;
+};
+
+bool isAudioEnclosure(const String& url, const String& type) {
+    // The SD player decodes MP3 only
+    if (type.length() > 0) {
+        return type == "audio/mpeg" || type == "audio/mp3";
+    }
+    String path = url.substring(0, url.indexOf('?') < 0 ? url.length() : url.indexOf('?'));
+    path.toLowerCase();
+    return path.endsWith(".mp3");
+}
+
+}  // namespace
+
+void PodcastPrefetcher::setFeeds(const std::vector<String>& urls) {
+    feeds.clear();
+    for (const String& url : urls) {
+        Feed feed;
+        feed.url = url;
+        feed.dir = String(PODCAST_ROOT) + "/" + hashName(url);
+        feed.episode.bytes = 0;
+        feeds.push_back(feed);
+    }
+}
+
+void PodcastPrefetcher::begin() {
+    if (taskHandle) {
+        return;
+    }
+    mutex = xSemaphoreCreateMutex();
+    if (!mutex) {
+        Serial.println("[ERROR] Failed to create podcast mutex");
+        return;
+    }
+
+    // Episodes downloaded before the reboot are playable right away
+    if (!SD.exists(PODCAST_ROOT)) {
+        SD.mkdir(PODCAST_ROOT);
+    }
+    for (Feed& feed : feeds) {
+        loadEpisode(feed);
+    }
+    status.feed = -1;
+    status.total = -1;
+    status.quotaBytes = quotaBytes;
+
+    if (feeds.empty()) {
+        return;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        prefetchTask,            // Task function
+        "Podcasts",              // Task name for debugging
+        PREFETCH_TASK_STACK,     // Stack size
+        this,                    // Task parameters
+        PREFETCH_TASK_PRIORITY,  // Task priority
+        &taskHandle,             // Task handle
+        PREFETCH_TASK_CORE       // Core to run the task on
+    );
+    if (created != pdPASS) {
+        Serial.println("[ERROR] Failed to create podcast task");
+        taskHandle = nullptr;
+    }
+}
+
+void PodcastPrefetcher::fetchNow() {
+    if (taskHandle) {
+        xTaskNotifyGive(taskHandle);
+    }
+}
+
+bool PodcastPrefetcher::getEpisode(size_t feed, Episode& episode) {
+    if (!mutex || feed >= feeds.size()) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    episode = feeds[feed].episode;
+    xSemaphoreGive(mutex);
+    return episode.path.length() > 0;
+}
+
+PodcastPrefetcher::Status PodcastPrefetcher::getStatus() {
+    if (!mutex) {
+        Status idle = {};
+        idle.feed = -1;
+        idle.total = -1;
+        idle.quotaBytes = quotaBytes;
+        return idle;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Status copy = status;
+    xSemaphoreGive(mutex);
+    return copy;
+}
+
+void PodcastPrefetcher::prefetchTask(void* parameter) {
+    PodcastPrefetcher* self = static_cast<PodcastPrefetcher*>(parameter);
+    uint32_t lastAttempt = 0;
+    bool attempted = false;
+
+    while (true) {
+        // Woken early by fetchNow()
+        bool requested = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FETCH_CHECK_INTERVAL)) > 0;
+        bool retryDue = !attempted || millis() - lastAttempt >= FETCH_RETRY_INTERVAL;
+        if (!requested && !(retryDue && self->isFetchDue())) {
+            continue;
+        }
+        if (WiFi.status() != WL_CONNECTED || self->isBusy()) {
+            continue;
+        }
+
+        attempted = true;
+        lastAttempt = millis();
+        self->fetchAll();
+    }
+}
+
+bool PodcastPrefetcher::isFetchDue() {
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 0)) {
+        return false;  // No clock, no night
+    }
+    uint8_t hoursIn = (timeinfo.tm_hour + 24 - fetchHour) % 24;
+    return hoursIn < FETCH_WINDOW_HOURS && timeinfo.tm_yday != lastFetchDay;
+}
+
+bool PodcastPrefetcher::fetchAll() {
+    Serial.printf("[PODCAST] Fetching %u feeds\n", (unsigned)feeds.size());
+    uint32_t start = millis();
+    bool complete = true;
+    for (size_t i = 0; i < feeds.size(); i++) {
+        if (isBusy()) {
+            Serial.println("[PODCAST] Playback started, downloads wait");
+            complete = false;
+            break;
+        }
+        if (!fetchFeed(i)) {
+            complete = false;
+        }
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.fetching = false;
+    status.feed = -1;
+    if (complete) {
+        status.lastFetch = time(nullptr);
+    }
+    xSemaphoreGive(mutex);
+
+    if (complete) {
+        struct tm timeinfo;
+        if (getLocalTime(&timeinfo, 0)) {
+            lastFetchDay = timeinfo.tm_yday;
+        }
+    }
+    Serial.printf("[PODCAST] Fetch %s in %lu s\n", complete ? "complete" : "incomplete",
+                  (millis() - start) / 1000);
+    return complete;
+}
+
+bool PodcastPrefetcher::fetchFeed(size_t index) {
+    Feed& feed = feeds[index];
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.fetching = true;
+    status.feed = index;
+    status.downloaded = 0;
+    status.total = -1;
+    xSemaphoreGive(mutex);
+
+    Enclosure enclosure;
+    if (!readNewestItem(feed.url, enclosure)) {
+        return false;
+    }
+    if (!isAudioEnclosure(enclosure.url, enclosure.type)) {
+        Serial.printf("[PODCAST] Newest episode of %s is not MP3 (%s), skipped\n",
+                      feed.url.c_str(), enclosure.type.c_str());
+        return true;
+    }
+
+    // Episodes are named after their enclosure URL, a new one gets a new file
+    String path = feed.dir + "/" + hashName(enclosure.url) + ".mp3";
+    if (path == feed.episode.path && SD.exists(path.c_str())) {
+        return true;
+    }
+    if (!SD.exists(feed.dir.c_str())) {
+        SD.mkdir(feed.dir.c_str());
+    }
+
+    // A resumed part file already counts as used, only the rest needs room
+    String partPath = path + ".part";
+    File part = SD.open(partPath.c_str(), FILE_READ);
+    uint32_t partBytes = part ? part.size() : 0;
+    part.close();
+    prune(partPath, enclosure.length > partBytes ? enclosure.length - partBytes : 0);
+    Serial.printf("[PODCAST] Downloading \"%s\" (%u bytes)\n", enclosure.title.c_str(), enclosure.length);
+    if (!download(enclosure.url, partPath)) {
+        return false;  // The part file is continued next time
+    }
+
+    SD.remove(path.c_str());
+    if (!SD.rename(partPath.c_str(), path.c_str())) {
+        Serial.printf("[ERROR] Failed to rename %s\n", partPath.c_str());
+        return false;
+    }
+
+    File file = SD.open(path.c_str(), FILE_READ);
+    uint32_t bytes = file ? file.size() : 0;
+    file.close();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    feed.episode.title = enclosure.title;
+    feed.episode.path = path;
+    feed.episode.bytes = bytes;
+    xSemaphoreGive(mutex);
+    saveEpisode(feed);
+
+    // Index it now so a half-heard episode resumes without a scan
+    Mp3Indexer::getInstance().request(path.c_str());
+
+    // The previous episode may go now if space is short
+    prune("", 0);
+    return true;
+}
+
+bool PodcastPrefetcher::readNewestItem(const String& url, Enclosure& enclosure) {
+    HttpGet request;
+    int code = request.get(url);
+    if (code != HTTP_CODE_OK) {
+        Serial.printf("[ERROR] Podcast feed request failed, HTTP code: %d (%s)\n", code, url.c_str());
+        return false;
+    }
+
+    // Only read up to the end of the first item, the rest of a feed can
+    // run to megabytes of show notes
+    RssItemParser parser;
+    WiFiClient* stream = request.http.getStreamPtr();
+    int size = request.http.getSize();
+    uint8_t buffer[256];
+    size_t total = 0;
+    uint32_t start = millis();
+    while (stream && !parser.isDone() && total < MAX_FEED_BYTES &&
+           (size < 0 || (int)total < size) && millis() - start < FEED_READ_TIMEOUT) {
+        int available = stream->available();
+        if (available <= 0) {
+            if (!stream->connected()) {
+                break;
+            }
+            delay(5);
+            continue;
+        }
+        int len = stream->read(buffer, min((size_t)available, sizeof(buffer)));
+        for (int i = 0; i < len && !parser.isDone(); i++) {
+            parser.feed((char)buffer[i]);
+        }
+        total += max(len, 0);
+    }
+
+    if (!parser.isDone()) {
+        Serial.printf("[ERROR] No episode found in the first %u bytes of %s\n", (unsigned)total, url.c_str());
+        return false;
+    }
+    enclosure.url = parser.url;
+    enclosure.title = parser.title;
+    enclosure.type = parser.type;
+    enclosure.length = parser.length;
+    return true;
+}
+
+bool PodcastPrefetcher::download(const String& url, const String& partPath) {
+    // Continue a part file left by a dropped connection or a reboot
+    File part = SD.open(partPath.c_str(), FILE_APPEND);
+    if (!part) {
+        Serial.printf("[ERROR] Failed to open %s\n", partPath.c_str());
+        return false;
+    }
+    uint32_t offset = part.size();
+
+    HttpGet request;
+    int code = request.get(url, offset > 0 ? "bytes=" + String(offset) + "-" : "");
+    int32_t total = -1;
+    if (code == HTTP_CODE_PARTIAL_CONTENT) {
+        // Content-Range: bytes <first>-<last>/<size>
+        String range = request.http.header("Content-Range");
+        uint32_t first = strtoul(range.c_str() + range.indexOf(' ') + 1, nullptr, 10);
+        int slash = range.indexOf('/');
+        if (range.indexOf(' ') < 0 || first != offset) {
+            Serial.println("[ERROR] Server resumed at the wrong position, starting over");
+            part.close();
+            SD.remove(partPath.c_str());
+            return false;
+        }
+        if (slash >= 0 && range[slash + 1] != '*') {
+            total = strtoul(range.c_str() + slash + 1, nullptr, 10);
+        }
+        Serial.printf("[PODCAST] Resuming at byte %u\n", offset);
+    } else if (code == HTTP_CODE_OK) {
+        if (offset > 0) {
+            // The server ignored the range, start the file over
+            Serial.println("[PODCAST] Server does not resume, starting over");
+            part.close();
+            SD.remove(partPath.c_str());
+            part = SD.open(partPath.c_str(), FILE_WRITE);
+            if (!part) {
+                return false;
+            }
+            offset = 0;
+        }
+        total = request.http.getSize();
+    } else if (code == HTTP_CODE_RANGE_NOT_SATISFIABLE && offset > 0) {
+        // Everything was downloaded before the connection dropped
+        part.close();
+        return true;
+    } else {
+        Serial.printf("[ERROR] Episode download failed, HTTP code: %d\n", code);
+        part.close();
+        return false;
+    }
+
+    uint8_t* buffer = (uint8_t*)malloc(DOWNLOAD_CHUNK);
+    if (!buffer) {
+        part.close();
+        return false;
+    }
+
+    WiFiClient* stream = request.http.getStreamPtr();
+    uint32_t received = offset;
+    uint32_t lastData = millis();
+    bool complete = false;
+    while (stream) {
+        if (total >= 0 && received >= (uint32_t)total) {
+            complete = true;
+            break;
+        }
+        if (isBusy()) {
+            Serial.printf("[PODCAST] Download paused at byte %u for playback\n", received);
+            break;
+        }
+        int available = stream->available();
+        if (available <= 0) {
+            if (!stream->connected()) {
+                // Without a length the end of the connection is the end of the file
+                complete = total < 0;
+                break;
+            }
+            if (millis() - lastData >= DOWNLOAD_STALL_TIMEOUT) {
+                Serial.printf("[ERROR] Episode download stalled at byte %u\n", received);
+                break;
+            }
+            delay(10);
+            continue;
+        }
+        int len = stream->read(buffer, min((size_t)available, DOWNLOAD_CHUNK));
+        if (len <= 0) {
+            continue;
+        }
+        if (part.write(buffer, len) != (size_t)len) {
+            Serial.println("[ERROR] SD write failed, card full?");
+            break;
+        }
+        received += len;
+        lastData = millis();
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        status.downloaded = received;
+        status.total = total;
+        xSemaphoreGive(mutex);
+        delay(DOWNLOAD_YIELD_MS);
+    }
+
+    free(buffer);
+    part.close();
+    return complete;
+}
+
+void PodcastPrefetcher::prune(const String& downloading, uint32_t room) {
+    // Everything below the root counts; the newest episode of every feed
+    // and the download in progress are kept
+    std::vector<String> keep;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const Feed& feed : feeds) {
+        if (feed.episode.path.length() > 0) {
+            keep.push_back(feed.episode.path);
+        }
+    }
+    xSemaphoreGive(mutex);
+    if (downloading.length() > 0) {
+        keep.push_back(downloading);
+    }
+
+    std::vector<StoredFile> candidates;
+    uint64_t used = 0;
+    File root = SD.open(PODCAST_ROOT);
+    if (!root || !root.isDirectory()) {
+        return;
+    }
+    std::vector<String> dirs;
+    for (File entry = root.openNextFile(); entry; entry = root.openNextFile()) {
+        if (entry.isDirectory()) {
+            dirs.push_back(entry.path());
+        }
+        entry.close();
+    }
+    root.close();
+
+    for (const String& dirPath : dirs) {
+        bool known = std::any_of(feeds.begin(), feeds.end(),
+                                 [&](const Feed& feed) { return feed.dir == dirPath; });
+        File dir = SD.open(dirPath.c_str());
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+            String path = entry.path();
+            uint32_t size = entry.size();
+            time_t modified = entry.getLastWrite();
+            entry.close();
+
+            // Episode files of feeds that were removed from the list go first
+            if (!known) {
+                SD.remove(path.c_str());
+                continue;
+            }
+            used += size;
+            // Frame index sidecars go along with their episode
+            if (path.endsWith(EPISODE_FILE) || path.endsWith(".idx")) {
+                continue;
+            }
+            if (std::find(keep.begin(), keep.end(), path) == keep.end()) {
+                candidates.push_back({path, size, modified});
+            }
+        }
+        dir.close();
+        if (!known) {
+            SD.rmdir(dirPath.c_str());
+        }
+    }
+
+    // Oldest first until the next download fits
+    std::sort(candidates.begin(), candidates.end(),
+              [](const StoredFile& a, const StoredFile& b) { return a.modified < b.modified; });
+    for (const StoredFile& file : candidates) {
+        if (used + room <= quotaBytes) {
+            break;
+        }
+        Serial.printf("[PODCAST] Pruning %s\n", file.path.c_str());
+        SD.remove(file.path.c_str());
+        used -= file.size;
+        String sidecar = file.path + ".idx";
+        File index = SD.open(sidecar.c_str(), FILE_READ);
+        if (index) {
+            used -= min((uint64_t)index.size(), used);
+            index.close();
+            SD.remove(sidecar.c_str());
+        }
+    }
+    if (used + room > quotaBytes) {
+        Serial.println("[PODCAST] Quota too small for the newest episodes, keeping them anyway");
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.usedBytes = used;
+    status.quotaBytes = quotaBytes;
+    xSemaphoreGive(mutex);
+}
+
+void PodcastPrefetcher::loadEpisode(Feed& feed) {
+    String path = feed.dir + "/" + EPISODE_FILE;
+    File file = SD.open(path.c_str(), FILE_READ);
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(512);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        Serial.printf("[ERROR] Failed to parse %s: %s\n", path.c_str(), error.c_str());
+        return;
+    }
+
+    String episodePath = doc["path"] | "";
+    if (episodePath.isEmpty() || !SD.exists(episodePath.c_str())) {
+        return;
+    }
+    feed.episode.title = doc["title"] | "";
+    feed.episode.path = episodePath;
+    feed.episode.bytes = doc["bytes"] | 0;
+}
+
+void PodcastPrefetcher::saveEpisode(const Feed& feed) {
+    DynamicJsonDocument doc(512);
+    doc["title"] = feed.episode.title;
+    doc["path"] = feed.episode.path;
+    doc["bytes"] = feed.episode.bytes;
+
+    String path = feed.dir + "/" + EPISODE_FILE;
+    File file = SD.open(path.c_str(), FILE_WRITE);
+    if (!file) {
+        Serial.printf("[ERROR] Failed to write %s\n", path.c_str());
+        return;
+    }
+    serializeJson(doc, file);
+    file.close();
+}
+
+String PodcastPrefetcher::hashName(const String& text) {
+    // FNV-1a, short stable names that are valid on FAT
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < text.length(); i++) {
+        hash ^= (uint8_t)text[i];
+        hash *= 16777619u;
+    }
+    char name[9];
+    snprintf(name, sizeof(name), "%08x", hash);
+    return name;
+}
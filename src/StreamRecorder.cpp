@@ -0,0 +1,501 @@
+#include "StreamRecorder.h"
+#include <ArduinoJson.h>
+#include "AudioCodec.h"
+#include "AudioManager.h"
+#include "StreamResolver.h"
+
+// Initialize static member
+StreamRecorder* StreamRecorder::instance = nullptr;
+
+// Recorder task reads the stream when it has its own connection, next to
+// the player's network task; the writer runs below both
+static const uint32_t RECORDER_TASK_STACK = 16384;  // Resolving and TLS handshakes run on it
+static const UBaseType_t RECORDER_TASK_PRIORITY = 2;
+static const BaseType_t RECORDER_TASK_CORE = 0;
+static const uint32_t WRITER_TASK_STACK = 4096;
+static const UBaseType_t WRITER_TASK_PRIORITY = 1;
+static const BaseType_t WRITER_TASK_CORE = 0;
+
+// SD writes: whole clusters of a 32 GB SDHC card (FAT32, 32 KB clusters),
+// whole multiples of the clusters of smaller cards. Every write starts on
+// a cluster boundary of the file, so FAT allocates once per write and the
+// card never has to merge a partially written block.
+static const size_t CLUSTER_BYTES = 32 * 1024;
+
+// Directory entry and FAT are brought up to date this often, a power cut
+// loses no more than the ring and this much
+static const uint32_t SYNC_BYTES = 1024 * 1024;
+
+// Writer checks the ring at least this often
+static const uint32_t WRITER_POLL_MS = 50;
+
+// Own connection: retry interval after a failed connect or a dropped stream
+static const uint32_t RECONNECT_DELAY_MS = 2000;
+
+static const char* RECORDINGS_DIR = "/recordings";
+static const char* SCHEDULES_PATH = "/recordings.json";
+
+void StreamRecorder::begin() {
+    if (recorderTaskHandle) {
+        return;
+    }
+    mutex = xSemaphoreCreateMutex();
+    if (!mutex) {
+        Serial.println("[ERROR] Failed to create recorder mutex");
+        return;
+    }
+    loadSchedules();
+
+    // The ring is a few clusters at least, or the writer could never drain it in whole clusters
+    bufferBytes = max(bufferBytes, 4 * CLUSTER_BYTES);
+
+    BaseType_t recorderCreated = xTaskCreatePinnedToCore(
+        recorderTask,            // Task function
+        "Recorder",              // Task name for debugging
+        RECORDER_TASK_STACK,     // Stack size
+        this,                    // Task parameters
+        RECORDER_TASK_PRIORITY,  // Task priority
+        &recorderTaskHandle,     // Task handle
+        RECORDER_TASK_CORE       // Core to run the task on
+    );
+    BaseType_t writerCreated = xTaskCreatePinnedToCore(
+        writerTask,            // Task function
+        "RecorderWrite",       // Task name for debugging
+        WRITER_TASK_STACK,     // Stack size
+        this,                  // Task parameters
+        WRITER_TASK_PRIORITY,  // Task priority
+        &writerTaskHandle,     // Task handle
+        WRITER_TASK_CORE       // Core to run the task on
+    );
+    if (recorderCreated != pdPASS || writerCreated != pdPASS) {
+        Serial.println("[ERROR] Failed to create recorder tasks");
+    }
+}
+
+bool StreamRecorder::start(const char* url, uint16_t minutes) {
+    if (!mutex || !url || url[0] == '\0' || minutes == 0) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool busy = status.recording || requestPending;
+    if (!busy) {
+        strlcpy(request.url, url, sizeof(request.url));
+        request.minutes = minutes;
+        request.scheduleId = 0;
+        requestPending = true;
+    }
+    xSemaphoreGive(mutex);
+    if (!busy) {
+        xTaskNotifyGive(recorderTaskHandle);
+    }
+    return !busy;
+}
+
+void StreamRecorder::stop() {
+    stopRequested = true;
+}
+
+StreamRecorder::Status StreamRecorder::getStatus() {
+    if (!mutex) {
+        return status;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Status copy = status;
+    xSemaphoreGive(mutex);
+    copy.bytes = bytesWritten;
+    copy.maxWriteMs = maxWriteMs;
+    copy.bufferPercent = copy.recording ? ring.fillPercent() : 0;
+    return copy;
+}
+
+bool StreamRecorder::addSchedule(const Schedule& schedule) {
+    if (!mutex) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = schedules.size() < MAX_SCHEDULES && schedule.minutes > 0;
+    for (const auto& s : schedules) {
+        if (s.when.id == schedule.when.id) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        schedules.push_back(schedule);
+        saveSchedules();
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+bool StreamRecorder::updateSchedule(const Schedule& schedule) {
+    if (!mutex) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool found = false;
+    for (auto& s : schedules) {
+        if (s.when.id == schedule.when.id) {
+            s = schedule;
+            found = true;
+            saveSchedules();
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+    return found;
+}
+
+bool StreamRecorder::removeSchedule(uint8_t id) {
+    if (!mutex) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool found = false;
+    for (auto it = schedules.begin(); it != schedules.end(); ++it) {
+        if (it->when.id == id) {
+            schedules.erase(it);
+            found = true;
+            saveSchedules();
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+    return found;
+}
+
+std::vector<StreamRecorder::Schedule> StreamRecorder::getSchedules() {
+    std::vector<Schedule> copy;
+    if (!mutex) {
+        return copy;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    copy = schedules;
+    xSemaphoreGive(mutex);
+    return copy;
+}
+
+void StreamRecorder::recorderTask(void* parameter) {
+    StreamRecorder* self = static_cast<StreamRecorder*>(parameter);
+
+    while (true) {
+        self->checkSchedules();
+
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+        Request job = self->request;
+        bool pending = self->requestPending;
+        self->requestPending = false;
+        xSemaphoreGive(self->mutex);
+
+        if (pending) {
+            self->record(job);
+        }
+
+        // Woken early by start()
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    }
+}
+
+void StreamRecorder::checkSchedules() {
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 0)) {
+        return;
+    }
+    // Once per minute, like the alarms
+    int minuteOfDay = timeinfo.tm_hour * 60 + timeinfo.tm_min;
+    if (minuteOfDay == lastScheduleMinute) {
+        return;
+    }
+    lastScheduleMinute = minuteOfDay;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const auto& schedule : schedules) {
+        if (!schedule.when.shouldTrigger(timeinfo)) {
+            continue;
+        }
+        String url;
+        if (status.recording || requestPending) {
+            Serial.printf("[RECORD] Schedule %d skipped, another recording is running\n", schedule.when.id);
+        } else if (!stationLookup || !stationLookup(schedule.when.sourceData.stationIndex, url)) {
+            Serial.printf("[RECORD] Schedule %d has no station\n", schedule.when.id);
+        } else {
+            strlcpy(request.url, url.c_str(), sizeof(request.url));
+            request.minutes = schedule.minutes;
+            request.scheduleId = schedule.when.id;
+            requestPending = true;
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+bool StreamRecorder::openOwnConnection(const char* url) {
+    String streamUrl;
+    if (!StreamResolver::getInstance().resolve(url, streamUrl)) {
+        streamUrl = url;
+    }
+    return reader.open(streamUrl.c_str());
+}
+
+void StreamRecorder::record(const Request& job) {
+    if (!ring.allocate(bufferBytes)) {
+        return;
+    }
+    if (!SD.exists(RECORDINGS_DIR)) {
+        SD.mkdir(RECORDINGS_DIR);
+    }
+
+    // File name from the start time, the writer adds the extension of the codec
+    struct tm timeinfo;
+    char stamp[20] = "recording";
+    if (getLocalTime(&timeinfo, 0)) {
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M", &timeinfo);
+    }
+    snprintf(filePath, sizeof(filePath), "%s/%s", RECORDINGS_DIR, stamp);
+
+    AudioManager& audio = AudioManager::getInstance();
+    bool shared = audio.tapStream(job.url, &ring);
+    uint32_t nextConnectMs = millis();
+    uint32_t dropped = 0;       // Lost by taps that have ended
+    uint32_t tapDropped = 0;    // Lost by the current tap
+    stopRequested = false;
+    bytesWritten = 0;
+    maxWriteMs = 0;
+    finishing = false;
+    writing = true;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.recording = true;
+    status.shared = shared;
+    status.scheduleId = job.scheduleId;
+    status.path = "";
+    status.dropped = 0;
+    status.remainingS = (uint32_t)job.minutes * 60;
+    xSemaphoreGive(mutex);
+    xTaskNotifyGive(writerTaskHandle);
+    Serial.printf("[RECORD] Recording %s for %u min%s\n", job.url, job.minutes,
+                  shared ? ", sharing the player's connection" : "");
+
+    uint32_t startMs = millis();
+    uint32_t lengthMs = (uint32_t)job.minutes * 60 * 1000;
+    uint32_t lastStatusMs = 0;
+    while (millis() - startMs < lengthMs && !stopRequested) {
+        uint32_t now = millis();
+        int moved = 0;
+
+        if (shared) {
+            // The player tuned elsewhere or dropped the connection: go on alone
+            if (!audio.isTapped(&ring, tapDropped)) {
+                audio.untapStream(&ring);
+                shared = false;
+                dropped += tapDropped;
+                tapDropped = 0;
+                nextConnectMs = now;
+                Serial.println("[RECORD] Player left the station, recording on its own connection");
+            }
+        } else if (reader.isOpen()) {
+            // Never more than the ring holds: a slow card holds up this socket, not the player's
+            moved = reader.pump(ring, ring.capacity());
+            if (moved < 0) {
+                Serial.println("[RECORD] Stream connection lost");
+                reader.close();
+                nextConnectMs = now + RECONNECT_DELAY_MS;
+            }
+        } else if ((int32_t)(now - nextConnectMs) >= 0) {
+            shared = audio.tapStream(job.url, &ring);
+            if (!shared && !openOwnConnection(job.url)) {
+                Serial.printf("[RECORD] Could not connect to %s\n", job.url);
+                nextConnectMs = millis() + RECONNECT_DELAY_MS;
+            }
+        }
+
+        if (now - lastStatusMs >= 1000) {
+            lastStatusMs = now;
+            checkSchedules();
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            status.shared = shared;
+            status.dropped = dropped + tapDropped;
+            status.remainingS = (lengthMs - min(lengthMs, now - startMs)) / 1000;
+            xSemaphoreGive(mutex);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(moved > 0 ? 1 : 5));
+    }
+
+    if (shared) {
+        audio.isTapped(&ring, tapDropped);
+        audio.untapStream(&ring);
+        dropped += tapDropped;
+    }
+    reader.close();
+
+    // Let the writer put the rest of the ring on the card and close the file
+    finishing = true;
+    xTaskNotifyGive(writerTaskHandle);
+    while (writing) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    ring.release();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    status.recording = false;
+    status.shared = false;
+    status.dropped = dropped;
+    status.remainingS = 0;
+    String path = status.path;
+    xSemaphoreGive(mutex);
+    Serial.printf("[RECORD] Saved %s: %u bytes, %u dropped, slowest write %u ms\n", path.c_str(),
+                  (unsigned)bytesWritten, (unsigned)dropped, (unsigned)maxWriteMs);
+}
+
+void StreamRecorder::writerTask(void* parameter) {
+    StreamRecorder* self = static_cast<StreamRecorder*>(parameter);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WRITER_POLL_MS));
+        if (!self->writing) {
+            continue;
+        }
+
+        File file;
+        bool failed = false;
+        uint32_t syncedBytes = 0;
+        while (true) {
+            // Read before draining, everything produced before the flag gets written
+            bool final = self->finishing;
+            size_t pending = self->ring.available();
+
+            if (!file && !failed && (pending >= CLUSTER_BYTES || (final && pending > 0))) {
+                // The first bytes tell the codec, and with it the extension
+                uint8_t probe[1024];
+                size_t len = self->ring.peek(probe, sizeof(probe));
+                const char* ext = AudioCodec::name(AudioCodec::fromFrameSync(probe, len));
+                String path = String(self->filePath) + "." + (ext[0] ? ext : "raw");
+                file = SD.open(path.c_str(), FILE_WRITE);
+                if (!file) {
+                    Serial.printf("[ERROR] Failed to create recording %s\n", path.c_str());
+                    failed = true;
+                }
+                xSemaphoreTake(self->mutex, portMAX_DELAY);
+                self->status.path = file ? path : String();
+                xSemaphoreGive(self->mutex);
+            }
+
+            if (failed) {
+                // Nowhere to write, keep the ring from filling up
+                self->ring.discard(pending);
+            } else if (file) {
+                self->drain(file, final);
+                if (self->bytesWritten - syncedBytes >= SYNC_BYTES) {
+                    file.flush();
+                    syncedBytes = self->bytesWritten;
+                }
+            }
+
+            if (final) {
+                break;
+            }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WRITER_POLL_MS));
+        }
+
+        if (file) {
+            file.close();
+        }
+        self->writing = false;
+    }
+}
+
+void StreamRecorder::drain(File& file, bool final) {
+    // Whole clusters while recording, the rest once the producer is done
+    while (ring.available() >= CLUSTER_BYTES || (final && ring.available() > 0)) {
+        const uint8_t* region = nullptr;
+        size_t len = ring.readRegion(&region);
+
+        // Writes start at cluster boundaries of the ring, which is a power of
+        // two of at least four clusters, so a whole cluster is contiguous
+        if (!final) {
+            len = min(len, CLUSTER_BYTES);
+        }
+
+        uint32_t started = millis();
+        size_t written = file.write(region, len);
+        uint32_t elapsed = millis() - started;
+        if (elapsed > maxWriteMs) {
+            maxWriteMs = elapsed;
+        }
+        ring.discard(len);
+        bytesWritten += written;
+        if (written != len) {
+            Serial.println("[ERROR] Recording write failed, card full?");
+            ring.discard(ring.available());
+            return;
+        }
+    }
+}
+
+void StreamRecorder::loadSchedules() {
+    File file = SD.open(SCHEDULES_PATH, FILE_READ);
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(4096);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        Serial.printf("[ERROR] Failed to parse %s: %s\n", SCHEDULES_PATH, error.c_str());
+        return;
+    }
+
+    schedules.clear();
+    for (JsonObject obj : doc["recordings"].as<JsonArray>()) {
+        if (schedules.size() >= MAX_SCHEDULES) {
+            break;
+        }
+        Schedule schedule = {};
+        schedule.when.id = obj["id"];
+        schedule.when.hour = obj["hour"];
+        schedule.when.minute = obj["minute"];
+        schedule.when.enabled = obj["enabled"];
+        JsonArray daysArray = obj["repeat"];
+        for (int i = 0; i < 7; i++) {
+            schedule.when.repeat[i] = daysArray[i];
+        }
+        schedule.when.source = 0;  // Radio
+        schedule.when.sourceData.stationIndex = obj["stationIndex"];
+        schedule.minutes = obj["minutes"] | 60;
+        schedules.push_back(schedule);
+    }
+    Serial.printf("[RECORD] Loaded %u recording schedules\n", (unsigned)schedules.size());
+}
+
+void StreamRecorder::saveSchedules() {
+    // Caller holds the mutex
+    DynamicJsonDocument doc(4096);
+    JsonArray array = doc.createNestedArray("recordings");
+    for (const auto& schedule : schedules) {
+        JsonObject obj = array.createNestedObject();
+        obj["id"] = schedule.when.id;
+        obj["hour"] = schedule.when.hour;
+        obj["minute"] = schedule.when.minute;
+        obj["enabled"] = schedule.when.enabled;
+        JsonArray daysArray = obj.createNestedArray("repeat");
+        for (int i = 0; i < 7; i++) {
+            daysArray.add(schedule.when.repeat[i]);
+        }
+        obj["stationIndex"] = schedule.when.sourceData.stationIndex;
+        obj["minutes"] = schedule.minutes;
+    }
+
+    String temp = String(SCHEDULES_PATH) + ".tmp";
+    File file = SD.open(temp.c_str(), FILE_WRITE);
+    if (!file) {
+        Serial.println("[ERROR] Failed to write recording schedules");
+        return;
+    }
+    bool ok = serializeJson(doc, file) > 0;
+    file.close();
+    if (ok) {
+        if (SD.exists(SCHEDULES_PATH)) {
+            SD.remove(SCHEDULES_PATH);
+        }
+        SD.rename(temp.c_str(), SCHEDULES_PATH);
+    }
+}
@@ -0,0 +1,370 @@
+#include "StreamResolver.h"
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include "TlsClient.h"
+#include <ArduinoJson.h>
+#include <SD.h>
+
+// Initialize static member
+StreamResolver* StreamResolver::instance = nullptr;
+
+static const char* CACHE_FILE = "/stream_cache.json";
+
+// Redirects and playlist hops followed before giving up
+static const int MAX_HOPS = 5;
+
+// Playlists are small; anything bigger is not a playlist we can use
+static const size_t MAX_PLAYLIST_BYTES = 4096;
+static const uint32_t PLAYLIST_READ_TIMEOUT = 3000;
+
+// Cached stations, the oldest entry goes when the cache is full. Longer
+// URLs (tokenised redirects) are resolved every time instead of cached, so
+// the document below always holds the whole cache.
+static const size_t MAX_ENTRIES = 32;
+static const size_t MAX_CACHED_URL = 512;
+static const size_t CACHE_DOC_BYTES = JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(MAX_ENTRIES) +
+                                      MAX_ENTRIES * (JSON_OBJECT_SIZE(3) + 2 * (MAX_CACHED_URL + 1)) + 512;
+
+// Epoch seconds before which the clock has not been set by NTP
+static const uint32_t CLOCK_VALID_AFTER = 1600000000;
+
+void StreamResolver::begin() {
+    if (!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    loadCache();
+}
+
+bool StreamResolver::resolve(const char* url, String& resolved) {
+    if (!url || !mutex) {
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t now = time(nullptr);
+    for (const Entry& entry : entries) {
+        if (entry.url == url && isFresh(entry, now)) {
+            resolved = entry.resolved;
+            xSemaphoreGive(mutex);
+            return true;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    // Off the lock: a slow host must not hold up the other callers
+    uint32_t start = millis();
+    if (!resolveNetwork(url, resolved)) {
+        return false;
+    }
+    if (resolved != url) {
+        Serial.printf("[AUDIO] Resolved %s -> %s in %lu ms\n", url, resolved.c_str(), millis() - start);
+    }
+
+    if (strlen(url) > MAX_CACHED_URL || resolved.length() > MAX_CACHED_URL) {
+        Serial.printf("[AUDIO] Stream URL of %s too long to cache\n", url);
+        return true;
+    }
+
+    // Replace the station's entry, or make room for it
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto found = entries.end();
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->url == url) {
+            found = it;
+        }
+        if (it->resolvedAt < oldest->resolvedAt) {
+            oldest = it;
+        }
+    }
+    if (found == entries.end()) {
+        if (entries.size() >= MAX_ENTRIES) {
+            entries.erase(oldest);
+        }
+        entries.push_back(Entry());
+        found = entries.end() - 1;
+    }
+    found->url = url;
+    found->resolved = resolved;
+    found->resolvedAt = now >= CLOCK_VALID_AFTER ? now : 0;
+
+    saveCache();
+    xSemaphoreGive(mutex);
+    return true;
+}
+
+void StreamResolver::reportFailure(const char* url) {
+    if (!url || !mutex) {
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->url == url) {
+            Serial.printf("[AUDIO] Cached stream URL of %s failed, resolving again next time\n", url);
+            entries.erase(it);
+            saveCache();
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+bool StreamResolver::isFresh(const Entry& entry, uint32_t now) const {
+    if (ttlSeconds == 0) {
+        return false;
+    }
+    // Without a clock on either side the age is unknown; trust the entry
+    // until it fails
+    if (now < CLOCK_VALID_AFTER || entry.resolvedAt == 0) {
+        return true;
+    }
+    return now - entry.resolvedAt < ttlSeconds;
+}
+
+bool StreamResolver::resolveNetwork(const String& url, String& resolved) {
+    String current = url;
+
+    for (int hop = 0; hop < MAX_HOPS; hop++) {
+        // The session of an HTTPS hop is cached, the reader resumes it
+        WiFiClient plain;
+        TlsClient secure;
+        WiFiClient& client = current.startsWith("https://") ? secure : plain;
+        HTTPClient http;
+        http.setReuse(false);
+        http.setTimeout(5000);
+        http.setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+        http.setUserAgent("Radiowecker/1.0");
+
+        static const char* headerKeys[] = {"Content-Type", "Location"};
+        http.collectHeaders(headerKeys, 2);
+
+        if (!http.begin(client, current)) {
+            Serial.printf("[ERROR] Invalid stream URL: %s\n", current.c_str());
+            return false;
+        }
+
+        int httpCode = http.GET();
+        if (httpCode == HTTP_CODE_MOVED_PERMANENTLY || httpCode == HTTP_CODE_FOUND ||
+            httpCode == HTTP_CODE_SEE_OTHER || httpCode == HTTP_CODE_TEMPORARY_REDIRECT ||
+            httpCode == HTTP_CODE_PERMANENT_REDIRECT) {
+            String location = http.header("Location");
+            http.end();
+            if (location.isEmpty()) {
+                Serial.printf("[ERROR] Redirect without a location from %s\n", current.c_str());
+                return false;
+            }
+            current = absoluteUrl(current, location);
+            continue;
+        }
+
+        if (httpCode != HTTP_CODE_OK) {
+            Serial.printf("[ERROR] Stream request failed, HTTP code: %d\n", httpCode);
+            http.end();
+            return false;
+        }
+
+        String contentType = http.header("Content-Type");
+        contentType.toLowerCase();
+        if (!isPlaylist(contentType, current)) {
+            // Audio: this is the stream, the reader connects to it again
+            http.end();
+            resolved = current;
+            return true;
+        }
+
+        // Read the playlist, bounded in size and time
+        String body;
+        WiFiClient* stream = http.getStreamPtr();
+        uint32_t start = millis();
+        int size = http.getSize();
+        while (stream && body.length() < MAX_PLAYLIST_BYTES &&
+               (size < 0 || (int)body.length() < size) &&
+               millis() - start < PLAYLIST_READ_TIMEOUT) {
+            int c = stream->read();
+            if (c < 0) {
+                if (!stream->connected()) {
+                    break;
+                }
+                delay(2);
+                continue;
+            }
+            body += (char)c;
+        }
+        http.end();
+
+        String next;
+        if (!parsePlaylist(body, current, next)) {
+            return false;
+        }
+        current = next;
+    }
+
+    Serial.printf("[ERROR] Too many redirects resolving %s\n", url.c_str());
+    return false;
+}
+
+bool StreamResolver::parsePlaylist(const String& body, const String& baseUrl, String& next) {
+    // HLS lists segments (a master playlist lists segment playlists), the
+    // decoders only play continuous streams
+    if (body.indexOf("#EXT-X-") >= 0) {
+        Serial.printf("[ERROR] HLS not supported: %s\n", baseUrl.c_str());
+        return false;
+    }
+
+    int pos = 0;
+    while (pos < (int)body.length()) {
+        int end = body.indexOf('\n', pos);
+        if (end < 0) {
+            end = body.length();
+        }
+        String line = body.substring(pos, end);
+        line.trim();
+        pos = end + 1;
+
+        // PLS: File1=http://...
+        if (line.startsWith("File")) {
+            int eq = line.indexOf('=');
+            if (eq > 0) {
+                next = absoluteUrl(baseUrl, line.substring(eq + 1));
+                return true;
+            }
+            continue;
+        }
+
+        if (line.isEmpty() || line.startsWith("#") || line.startsWith("[")) {
+            continue;
+        }
+
+        // Other PLS keys (Title1=, Length1=, NumberOfEntries=)
+        if (!line.startsWith("http") && line.indexOf('=') > 0) {
+            continue;
+        }
+
+        // M3U: the first URI line
+        next = absoluteUrl(baseUrl, line);
+        return true;
+    }
+
+    Serial.printf("[ERROR] No stream found in playlist %s\n", baseUrl.c_str());
+    return false;
+}
+
+bool StreamResolver::isPlaylist(const String& contentType, const String& url) {
+    if (contentType.indexOf("mpegurl") >= 0 || contentType.indexOf("scpls") >= 0 ||
+        contentType.indexOf("x-pls") >= 0) {
+        return true;
+    }
+
+    // Servers often send playlists as text or binary; go by the extension then
+    if (!contentType.isEmpty() && !contentType.startsWith("text/") &&
+        !contentType.startsWith("application/octet-stream")) {
+        return false;
+    }
+    String path = url;
+    int query = path.indexOf('?');
+    if (query >= 0) {
+        path = path.substring(0, query);
+    }
+    path.toLowerCase();
+    return path.endsWith(".m3u") || path.endsWith(".m3u8") || path.endsWith(".pls");
+}
+
+String StreamResolver::absoluteUrl(const String& base, const String& ref) {
+    if (ref.startsWith("http://") || ref.startsWith("https://")) {
+        return ref;
+    }
+
+    int schemeEnd = base.indexOf("://");
+    int hostEnd = schemeEnd >= 0 ? base.indexOf('/', schemeEnd + 3) : -1;
+    String origin = hostEnd >= 0 ? base.substring(0, hostEnd) : base;
+    if (ref.startsWith("/")) {
+        return origin + ref;
+    }
+
+    // Relative to the directory of the base URL
+    String path = base;
+    int query = path.indexOf('?');
+    if (query >= 0) {
+        path = path.substring(0, query);
+    }
+    int slash = path.lastIndexOf('/');
+    if (slash < hostEnd || hostEnd < 0) {
+        return origin + "/" + ref;
+    }
+    return path.substring(0, slash + 1) + ref;
+}
+
+void StreamResolver::loadCache() {
+    if (!SD.exists(CACHE_FILE)) {
+        return;
+    }
+
+    File file = SD.open(CACHE_FILE, FILE_READ);
+    if (!file) {
+        Serial.println("Failed to open stream cache for reading");
+        return;
+    }
+
+    DynamicJsonDocument doc(CACHE_DOC_BYTES);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+
+    if (error) {
+        Serial.printf("Failed to parse stream cache: %s\n", error.c_str());
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    entries.clear();
+    for (JsonObject obj : doc["stations"].as<JsonArray>()) {
+        if (entries.size() >= MAX_ENTRIES) {
+            break;
+        }
+        Entry entry;
+        entry.url = obj["url"].as<String>();
+        entry.resolved = obj["resolved"].as<String>();
+        entry.resolvedAt = obj["resolved_at"] | 0;
+        if (!entry.url.isEmpty() && !entry.resolved.isEmpty()) {
+            entries.push_back(entry);
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    Serial.printf("Loaded %d cached stream URLs\n", entries.size());
+}
+
+void StreamResolver::saveCache() {
+    // Caller holds mutex
+    DynamicJsonDocument doc(CACHE_DOC_BYTES);
+    JsonArray stations = doc.createNestedArray("stations");
+    for (const Entry& entry : entries) {
+        JsonObject obj = stations.createNestedObject();
+        obj["url"] = entry.url;
+        obj["resolved"] = entry.resolved;
+        obj["resolved_at"] = entry.resolvedAt;
+    }
+    if (doc.overflowed()) {
+        Serial.println("[ERROR] Stream cache does not fit its document, not saved");
+        return;
+    }
+
+    // Write beside the old cache, a failed write leaves it intact
+    String temp = String(CACHE_FILE) + ".tmp";
+    File file = SD.open(temp.c_str(), FILE_WRITE);
+    if (!file) {
+        Serial.println("Failed to create stream cache");
+        return;
+    }
+    bool ok = serializeJson(doc, file) > 0;
+    file.close();
+    if (!ok) {
+        Serial.println("Failed to write stream cache");
+        SD.remove(temp.c_str());
+        return;
+    }
+    if (SD.exists(CACHE_FILE)) {
+        SD.remove(CACHE_FILE);
+    }
+    SD.rename(temp.c_str(), CACHE_FILE);
+}
@@ -0,0 +1,249 @@
+#include "TlsClient.h"
+#include "TlsManager.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl_internal.h"
+#include <new>
+
+struct TlsClient::Context {
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+};
+
+TlsClient::~TlsClient() {
+    stop();
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port, DEFAULT_TIMEOUT_MS);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, DEFAULT_TIMEOUT_MS);
+}
+
+int TlsClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    stop();
+    if (!host || !tcp.connect(host, port, timeout)) {
+        return 0;
+    }
+    // Handshake messages are small and go back and forth
+    tcp.setNoDelay(true);
+
+    tls = new (std::nothrow) Context;
+    if (!tls) {
+        Serial.println("[ERROR] Out of memory for a TLS connection");
+        tcp.stop();
+        return 0;
+    }
+    mbedtls_ssl_init(&tls->ssl);
+    mbedtls_ssl_config_init(&tls->conf);
+    mbedtls_ctr_drbg_init(&tls->drbg);
+    mbedtls_entropy_init(&tls->entropy);
+
+    if (!handshake(host, port, timeout)) {
+        TlsManager::getInstance().recordFailure();
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+bool TlsClient::handshake(const char* host, uint16_t port, int32_t timeout) {
+    TlsManager& manager = TlsManager::getInstance();
+
+    static const char PERSONALIZATION[] = "radiowecker-tls";
+    int ret = mbedtls_ctr_drbg_seed(&tls->drbg, mbedtls_entropy_func, &tls->entropy,
+                                    (const unsigned char*)PERSONALIZATION, sizeof(PERSONALIZATION) - 1);
+    if (ret == 0) {
+        ret = mbedtls_ssl_config_defaults(&tls->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret != 0) {
+        Serial.printf("[ERROR] TLS setup failed (-0x%04x)\n", (unsigned)-ret);
+        return false;
+    }
+    if (!manager.configure(&tls->conf)) {
+        Serial.printf("[ERROR] Failed to set up the certificate checks for %s\n", host);
+        return false;
+    }
+    mbedtls_ssl_conf_rng(&tls->conf, mbedtls_ctr_drbg_random, &tls->drbg);
+    mbedtls_ssl_conf_session_tickets(&tls->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+    ret = mbedtls_ssl_setup(&tls->ssl, &tls->conf);
+    if (ret == 0) {
+        ret = mbedtls_ssl_set_hostname(&tls->ssl, host);  // SNI and the name check
+    }
+    if (ret != 0) {
+        Serial.printf("[ERROR] TLS setup failed (-0x%04x)\n", (unsigned)-ret);
+        return false;
+    }
+    mbedtls_ssl_set_bio(&tls->ssl, &tcp, sendCallback, recvCallback, nullptr);
+
+    // Stepped instead of mbedtls_ssl_handshake() to see whether the server
+    // took the offered session, which only the handshake state tells
+    bool offered = manager.restoreSession(host, port, &tls->ssl);
+    resumed = false;
+    uint32_t start = millis();
+    while (tls->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        ret = mbedtls_ssl_handshake_step(&tls->ssl);
+        if (tls->ssl.handshake && tls->ssl.handshake->resume) {
+            resumed = true;
+        }
+        if (ret == 0) {
+            continue;
+        }
+        if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+            millis() - start >= (uint32_t)timeout) {
+            break;
+        }
+        delay(1);
+    }
+
+    if (tls->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        if (ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
+            Serial.printf("[ERROR] TLS: certificate of %s not trusted (flags 0x%x)\n",
+                          host, (unsigned)mbedtls_ssl_get_verify_result(&tls->ssl));
+        } else {
+            Serial.printf("[ERROR] TLS handshake with %s failed (-0x%04x)\n", host, (unsigned)-ret);
+        }
+        if (offered) {
+            manager.forgetSession(host, port);
+        }
+        return false;
+    }
+
+    uint32_t elapsed = millis() - start;
+    manager.recordHandshake(resumed, elapsed);
+    manager.saveSession(host, port, &tls->ssl);  // A resumption may come with a new ticket
+    Serial.printf("[TLS] %s: %s in %lu ms\n", host, resumed ? "session resumed" : "full handshake",
+                  (unsigned long)elapsed);
+    return true;
+}
+
+int TlsClient::pull() {
+    if (!tls) {
+        return 0;
+    }
+    size_t ready = mbedtls_ssl_get_bytes_avail(&tls->ssl);
+    if (ready == 0 && !closed) {
+        // A zero-length read decrypts the next record if it has arrived
+        int ret = mbedtls_ssl_read(&tls->ssl, nullptr, 0);
+        if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            closed = true;  // close_notify, end of the connection or a fatal alert
+        }
+        ready = mbedtls_ssl_get_bytes_avail(&tls->ssl);
+    }
+    return (int)ready;
+}
+
+int TlsClient::available() {
+    return (peeked >= 0 ? 1 : 0) + pull();
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+    if (!tls || size == 0) {
+        return -1;
+    }
+    int count = 0;
+    if (peeked >= 0) {
+        buf[count++] = (uint8_t)peeked;
+        peeked = -1;
+    }
+    // Only decrypted bytes are read, so this never waits for the network
+    if ((size_t)count < size && pull() > 0) {
+        int ret = mbedtls_ssl_read(&tls->ssl, buf + count, size - count);
+        if (ret > 0) {
+            count += ret;
+        }
+    }
+    return count > 0 ? count : -1;
+}
+
+int TlsClient::read() {
+    uint8_t byte;
+    return read(&byte, 1) == 1 ? byte : -1;
+}
+
+int TlsClient::peek() {
+    if (peeked < 0) {
+        uint8_t byte;
+        if (read(&byte, 1) == 1) {
+            peeked = byte;
+        }
+    }
+    return peeked;
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+    if (!tls) {
+        return 0;
+    }
+    size_t sent = 0;
+    uint32_t start = millis();
+    while (sent < size) {
+        int ret = mbedtls_ssl_write(&tls->ssl, buf + sent, size - sent);
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+        if ((ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) ||
+            millis() - start >= (uint32_t)DEFAULT_TIMEOUT_MS) {
+            break;
+        }
+        delay(1);
+    }
+    return sent;
+}
+
+uint8_t TlsClient::connected() {
+    if (!tls) {
+        return 0;
+    }
+    // Decrypted data outlives the socket until it has been read
+    return available() > 0 || (!closed && tcp.connected());
+}
+
+void TlsClient::stop() {
+    if (tls) {
+        if (!closed && tcp.connected()) {
+            mbedtls_ssl_close_notify(&tls->ssl);  // Best effort
+        }
+        mbedtls_ssl_free(&tls->ssl);
+        mbedtls_ssl_config_free(&tls->conf);
+        mbedtls_ctr_drbg_free(&tls->drbg);
+        mbedtls_entropy_free(&tls->entropy);
+        delete tls;
+        tls = nullptr;
+    }
+    tcp.stop();
+    peeked = -1;
+    closed = false;
+}
+
+int TlsClient::sendCallback(void* context, const unsigned char* buf, size_t len) {
+    WiFiClient* tcp = static_cast<WiFiClient*>(context);
+    if (!tcp->connected()) {
+        return MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    size_t sent = tcp->write(buf, len);
+    return sent > 0 ? (int)sent : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int TlsClient::recvCallback(void* context, unsigned char* buf, size_t len) {
+    WiFiClient* tcp = static_cast<WiFiClient*>(context);
+    int pending = tcp->available();
+    if (pending <= 0) {
+        // Nothing yet, or end of stream once the socket is gone
+        return tcp->connected() ? MBEDTLS_ERR_SSL_WANT_READ : 0;
+    }
+    int got = tcp->read(buf, min(len, (size_t)pending));
+    return got > 0 ? got : MBEDTLS_ERR_SSL_WANT_READ;
+}
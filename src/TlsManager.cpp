@@ -0,0 +1,257 @@
+#include "TlsManager.h"
+#include <SD.h>
+#include <vector>
+#if TLS_HAVE_CRT_BUNDLE
+#include <esp_crt_bundle.h>
+#endif
+
+// Initialize static member
+TlsManager* TlsManager::instance = nullptr;
+
+// A CA bundle (cacert.pem) is about 220 KB; bigger files are not certificates
+static const size_t MAX_CERT_FILE = 512 * 1024;
+
+// Servers issue tickets for hours, older sessions are not offered any more
+static const uint32_t SESSION_MAX_AGE_MS = 4UL * 60 * 60 * 1000;
+
+void TlsManager::begin(const char* dir, bool verify) {
+    if (!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (!storeReady) {
+        mbedtls_x509_crt_init(&trustStore);
+        storeReady = true;
+    }
+    this->verify = verify;
+
+    File root = SD.open(dir);
+    if (!root || !root.isDirectory()) {
+        Serial.printf("[TLS] No trust store at %s\n", dir);
+    } else {
+        // Collect the names first, so the directory is not open while parsing
+        std::vector<String> paths;
+        for (File entry = root.openNextFile(); entry; entry = root.openNextFile()) {
+            String name = entry.name();
+            name.toLowerCase();
+            if (!entry.isDirectory() &&
+                (name.endsWith(".pem") || name.endsWith(".crt") || name.endsWith(".cer"))) {
+                paths.push_back(entry.path());
+            }
+            entry.close();
+        }
+        root.close();
+        for (const String& path : paths) {
+            loadFile(path.c_str());
+        }
+    }
+
+    certificates = 0;
+    for (const mbedtls_x509_crt* cert = &trustStore; cert && cert->raw.len > 0; cert = cert->next) {
+        certificates++;
+    }
+    Serial.printf("[TLS] Trust store: %u certificates\n", certificates);
+    if (!verify) {
+        Serial.println("[TLS] Server certificates are not checked");
+    } else if (certificates == 0 && TLS_HAVE_CRT_BUNDLE) {
+        Serial.println("[TLS] Empty trust store, using the built-in CA bundle");
+    } else if (certificates == 0) {
+        Serial.println("[TLS] Empty trust store and no built-in CA bundle, server certificates are not checked");
+    }
+}
+
+void TlsManager::loadFile(const char* path) {
+    File file = SD.open(path, FILE_READ);
+    size_t len = file ? file.size() : 0;
+    if (len == 0 || len > MAX_CERT_FILE) {
+        Serial.printf("[TLS] Skipping %s (%u bytes)\n", path, (unsigned)len);
+        file.close();
+        return;
+    }
+
+    // PEM is parsed as a string, the terminator counts towards its length
+    uint8_t* data = (uint8_t*)ps_malloc(len + 1);
+    if (!data) {
+        Serial.printf("[ERROR] No PSRAM to load %s\n", path);
+        file.close();
+        return;
+    }
+    bool loaded = file.read(data, len) == len;
+    file.close();
+    data[len] = 0;
+    if (!loaded) {
+        Serial.printf("[ERROR] Failed to read %s\n", path);
+        free(data);
+        return;
+    }
+
+    bool pem = strstr((const char*)data, "-----BEGIN ") != nullptr;
+    int result = mbedtls_x509_crt_parse(&trustStore, data, pem ? len + 1 : len);
+    free(data);
+    if (result < 0) {
+        Serial.printf("[ERROR] No certificate in %s (-0x%04x)\n", path, (unsigned)-result);
+    } else if (result > 0) {
+        Serial.printf("[TLS] %s: %d certificates could not be parsed\n", path, result);
+    }
+}
+
+bool TlsManager::configure(mbedtls_ssl_config* conf) {
+    if (!verify || (certificates == 0 && !TLS_HAVE_CRT_BUNDLE)) {
+        mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_NONE);
+        return true;
+    }
+    mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    if (certificates > 0) {
+        mbedtls_ssl_conf_ca_chain(conf, &trustStore, nullptr);
+        return true;
+    }
+#if TLS_HAVE_CRT_BUNDLE
+    return esp_crt_bundle_attach(conf) == ESP_OK;
+#else
+    return false;
+#endif
+}
+
+TlsManager::Session* TlsManager::findSession(const char* host, uint16_t port) {
+    // Caller holds mutex
+    for (Session& session : sessions) {
+        if (session.data && session.port == port && strcmp(session.host, host) == 0) {
+            return &session;
+        }
+    }
+    return nullptr;
+}
+
+bool TlsManager::restoreSession(const char* host, uint16_t port, mbedtls_ssl_context* ssl) {
+    if (!mutex) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool offered = false;
+    Session* cached = findSession(host, port);
+    if (cached && millis() - cached->savedMs >= SESSION_MAX_AGE_MS) {
+        free(cached->data);
+        *cached = Session();
+        cached = nullptr;
+    }
+    if (cached) {
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        if (mbedtls_ssl_session_load(&session, cached->data, cached->len) == 0 &&
+            mbedtls_ssl_set_session(ssl, &session) == 0) {
+            cached->usedMs = millis();
+            offered = true;
+        }
+        mbedtls_ssl_session_free(&session);
+    }
+    xSemaphoreGive(mutex);
+    return offered;
+}
+
+void TlsManager::saveSession(const char* host, uint16_t port, const mbedtls_ssl_context* ssl) {
+    if (!mutex || strlen(host) >= sizeof(Session::host)) {
+        return;
+    }
+
+    // Serialize outside the lock, the first call only asks for the size
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    uint8_t* data = nullptr;
+    size_t len = 0;
+    if (mbedtls_ssl_get_session(ssl, &session) == 0) {
+        mbedtls_ssl_session_save(&session, nullptr, 0, &len);
+        data = len > 0 ? (uint8_t*)ps_malloc(len) : nullptr;
+        if (data && mbedtls_ssl_session_save(&session, data, len, &len) != 0) {
+            free(data);
+            data = nullptr;
+        }
+    }
+    mbedtls_ssl_session_free(&session);
+    if (!data) {
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Session* slot = findSession(host, port);
+    for (size_t i = 0; !slot && i < MAX_SESSIONS; i++) {
+        if (!sessions[i].data) {
+            slot = &sessions[i];
+        }
+    }
+    if (!slot) {
+        // Cache full: the server used longest ago goes
+        slot = &sessions[0];
+        for (Session& candidate : sessions) {
+            if ((int32_t)(candidate.usedMs - slot->usedMs) < 0) {
+                slot = &candidate;
+            }
+        }
+    }
+    free(slot->data);
+    strlcpy(slot->host, host, sizeof(slot->host));
+    slot->port = port;
+    slot->data = data;
+    slot->len = len;
+    slot->savedMs = millis();
+    slot->usedMs = slot->savedMs;
+    xSemaphoreGive(mutex);
+}
+
+void TlsManager::forgetSession(const char* host, uint16_t port) {
+    if (!mutex) {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Session* cached = findSession(host, port);
+    if (cached) {
+        free(cached->data);
+        *cached = Session();
+    }
+    xSemaphoreGive(mutex);
+}
+
+void TlsManager::recordHandshake(bool resumed, uint32_t ms) {
+    if (!mutex) {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (resumed) {
+        resumedHandshakes++;
+        resumedMs += ms;
+    } else {
+        fullHandshakes++;
+        fullMs += ms;
+    }
+    xSemaphoreGive(mutex);
+}
+
+void TlsManager::recordFailure() {
+    if (!mutex) {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    failures++;
+    xSemaphoreGive(mutex);
+}
+
+TlsManager::Status TlsManager::getStatus() {
+    Status status = {};
+    status.verify = verify;
+    status.certificates = certificates;
+    status.builtinBundle = verify && certificates == 0 && TLS_HAVE_CRT_BUNDLE;
+    if (!mutex) {
+        return status;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const Session& session : sessions) {
+        if (session.data) {
+            status.sessions++;
+        }
+    }
+    status.fullHandshakes = fullHandshakes;
+    status.resumedHandshakes = resumedHandshakes;
+    status.fullAvgMs = fullHandshakes ? (uint32_t)(fullMs / fullHandshakes) : 0;
+    status.resumedAvgMs = resumedHandshakes ? (uint32_t)(resumedMs / resumedHandshakes) : 0;
+    status.failures = failures;
+    xSemaphoreGive(mutex);
+    return status;
+}
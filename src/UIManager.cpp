@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include <lvgl.h>
+#include <esp_heap_caps.h>
 #include "UIManager.h"
 #include "DisplayManager.h"
 #include "AudioManager.h"
@@ -21,6 +22,13 @@ LV_FONT_DECLARE(lv_font_montserrat_40x);
 // Include weather icons
 LV_IMG_DECLARE(icon_02d);
 
+// Spectrum visualizer layout and timing
+static const lv_coord_t SPECTRUM_BAR_WIDTH = 20;
+static const lv_coord_t SPECTRUM_BAR_GAP = 4;
+static const lv_coord_t SPECTRUM_HEIGHT = 96;
+static const uint32_t SPECTRUM_FRAME_MS = 40;     // 25 frames per second
+static const uint32_t SPECTRUM_RESUME_MS = 2000;  // Buffer healthy this long before it resumes
+
 // Define the static instance pointer
 UIManager* UIManager::instance = nullptr;
 
@@ -324,6 +332,31 @@ void UIManager::updateWifiSsid(const char* ssid) {
     }
 }
 
+void UIManager::updateNowPlaying(const char* artist, const char* title) {
+    bool hasTitle = title && title[0] != '\0';
+    bool hasArtist = artist && artist[0] != '\0';
+    
+    if (nowPlayingLabel) {
+        if (hasTitle) {
+            char buf[176];
+            if (hasArtist) {
+                snprintf(buf, sizeof(buf), LV_SYMBOL_AUDIO " %s - %s", artist, title);
+            } else {
+                snprintf(buf, sizeof(buf), LV_SYMBOL_AUDIO " %s", title);
+            }
+            lv_label_set_text(nowPlayingLabel, buf);
+            lv_obj_clear_flag(nowPlayingLabel, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(nowPlayingLabel, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+    
+    if (radioArtistLabel && radioTitleLabel) {
+        lv_label_set_text(radioArtistLabel, hasArtist ? artist : "");
+        lv_label_set_text(radioTitleLabel, hasTitle ? title : "");
+    }
+}
+
 void UIManager::updateIpAddress(const char* ipAddress) {
     if (ipLabel) {
         char buf[64];
@@ -686,6 +719,24 @@ void UIManager::createRadioScreen() {
     lv_obj_clear_flag(radioScreen, LV_OBJ_FLAG_SCROLLABLE);
     lv_obj_set_style_bg_color(radioScreen, lv_color_black(), LV_PART_MAIN);
     
+    // Now playing: artist above title
+    radioArtistLabel = lv_label_create(radioScreen);
+    lv_obj_add_style(radioArtistLabel, &infoStyle, 0);
+    lv_obj_set_style_text_font(radioArtistLabel, &lv_font_montserrat_24, 0);
+    lv_obj_set_width(radioArtistLabel, 700);
+    lv_obj_set_style_text_align(radioArtistLabel, LV_TEXT_ALIGN_CENTER, 0);
+    lv_label_set_long_mode(radioArtistLabel, LV_LABEL_LONG_SCROLL_CIRCULAR);
+    lv_label_set_text(radioArtistLabel, "");
+    lv_obj_align(radioArtistLabel, LV_ALIGN_CENTER, 0, -40);
+    
+    radioTitleLabel = lv_label_create(radioScreen);
+    lv_obj_add_style(radioTitleLabel, &infoStyle, 0);
+    lv_obj_set_width(radioTitleLabel, 700);
+    lv_obj_set_style_text_align(radioTitleLabel, LV_TEXT_ALIGN_CENTER, 0);
+    lv_label_set_long_mode(radioTitleLabel, LV_LABEL_LONG_SCROLL_CIRCULAR);
+    lv_label_set_text(radioTitleLabel, "");
+    lv_obj_align(radioTitleLabel, LV_ALIGN_CENTER, 0, 0);
+    
     // Volume slider
     lv_obj_t* volumeSlider = lv_slider_create(radioScreen);
     lv_obj_set_size(volumeSlider, 200, 20);
@@ -694,6 +745,209 @@ void UIManager::createRadioScreen() {
     lv_slider_set_value(volumeSlider, 70, LV_ANIM_OFF);
     // Use a static member function as callback instead of a capturing lambda
     lv_obj_add_event_cb(volumeSlider, radio_volume_changed_cb, LV_EVENT_VALUE_CHANGED, this);
+    
+    // Timeshift controls: rewind, pause/play, back to live
+    lv_obj_t* btnBack = lv_btn_create(radioScreen);
+    lv_obj_add_style(btnBack, &buttonStyle, 0);
+    lv_obj_add_style(btnBack, &buttonPressedStyle, LV_STATE_PRESSED);
+    lv_obj_set_size(btnBack, 90, 50);
+    lv_obj_align(btnBack, LV_ALIGN_BOTTOM_MID, -110, -60);
+    lv_obj_t* backLabel = lv_label_create(btnBack);
+    lv_label_set_text(backLabel, "-30s");
+    lv_obj_center(backLabel);
+    lv_obj_add_event_cb(btnBack, timeshift_back_cb, LV_EVENT_CLICKED, this);
+    
+    lv_obj_t* btnPause = lv_btn_create(radioScreen);
+    lv_obj_add_style(btnPause, &buttonStyle, 0);
+    lv_obj_add_style(btnPause, &buttonPressedStyle, LV_STATE_PRESSED);
+    lv_obj_set_size(btnPause, 90, 50);
+    lv_obj_align(btnPause, LV_ALIGN_BOTTOM_MID, 0, -60);
+    timeshiftPauseLabel = lv_label_create(btnPause);
+    lv_label_set_text(timeshiftPauseLabel, LV_SYMBOL_PAUSE);
+    lv_obj_center(timeshiftPauseLabel);
+    lv_obj_add_event_cb(btnPause, timeshift_pause_cb, LV_EVENT_CLICKED, this);
+    
+    lv_obj_t* btnLive = lv_btn_create(radioScreen);
+    lv_obj_add_style(btnLive, &buttonStyle, 0);
+    lv_obj_add_style(btnLive, &buttonPressedStyle, LV_STATE_PRESSED);
+    lv_obj_set_size(btnLive, 90, 50);
+    lv_obj_align(btnLive, LV_ALIGN_BOTTOM_MID, 110, -60);
+    lv_obj_t* liveLabel = lv_label_create(btnLive);
+    lv_label_set_text(liveLabel, "Live");
+    lv_obj_center(liveLabel);
+    lv_obj_add_event_cb(btnLive, timeshift_live_cb, LV_EVENT_CLICKED, this);
+    
+    timeshiftDelayLabel = lv_label_create(radioScreen);
+    lv_obj_add_style(timeshiftDelayLabel, &infoStyle, 0);
+    lv_label_set_text(timeshiftDelayLabel, "LIVE");
+    lv_obj_align(timeshiftDelayLabel, LV_ALIGN_BOTTOM_MID, 0, -120);
+    
+    // Position behind live moves on its own while paused
+    timeshiftTimer = lv_timer_create(timeshift_timer_cb, 500, this);
+    
+    // Spectrum visualizer above the now playing labels
+    const lv_coord_t spectrumWidth = SPECTRUM_BARS * (SPECTRUM_BAR_WIDTH + SPECTRUM_BAR_GAP) - SPECTRUM_BAR_GAP;
+    if (!spectrumBuffer) {
+        spectrumBuffer = static_cast<lv_color_t*>(heap_caps_malloc(
+            LV_CANVAS_BUF_SIZE_TRUE_COLOR(spectrumWidth, SPECTRUM_HEIGHT), MALLOC_CAP_SPIRAM));
+    }
+    if (!spectrumBuffer) {
+        Serial.println("[ERROR] No PSRAM for the spectrum canvas");
+        return;
+    }
+    spectrumCanvas = lv_canvas_create(radioScreen);
+    lv_canvas_set_buffer(spectrumCanvas, spectrumBuffer, spectrumWidth, SPECTRUM_HEIGHT, LV_IMG_CF_TRUE_COLOR);
+    lv_canvas_fill_bg(spectrumCanvas, lv_color_black(), LV_OPA_COVER);
+    lv_obj_align(spectrumCanvas, LV_ALIGN_TOP_MID, 0, 40);
+    memset(spectrumDrawn, 0, sizeof(spectrumDrawn));
+    if (!spectrumEnabled) {
+        lv_obj_add_flag(spectrumCanvas, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (!spectrumTimer) {
+        spectrumTimer = lv_timer_create(spectrum_timer_cb, SPECTRUM_FRAME_MS, this);
+    }
+}
+
+void UIManager::setSpectrumEnabled(bool enabled) {
+    spectrumEnabled = enabled;
+    if (spectrumCanvas) {
+        if (enabled) {
+            lv_obj_clear_flag(spectrumCanvas, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(spectrumCanvas, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+}
+
+void UIManager::spectrum_timer_cb(lv_timer_t* timer) {
+    UIManager* ui = static_cast<UIManager*>(timer->user_data);
+    if (!ui || !ui->spectrumCanvas) return;
+    
+    static const uint8_t silence[SPECTRUM_BARS] = {};
+    AudioManager& audio = AudioManager::getInstance();
+    
+    // Stop the tap whenever nobody looks at the bars
+    if (!ui->spectrumEnabled || ui->currentScreen != ui->radioScreen || !audio.isPlaying()) {
+        if (audio.isSpectrumEnabled()) {
+            audio.setSpectrumEnabled(false);
+            ui->drawSpectrum(silence);
+        }
+        return;
+    }
+    
+    // Give the CPU back to the decoder while the stream runs short
+    uint32_t now = millis();
+    if (audio.isBufferLow()) {
+        ui->spectrumHealthySince = 0;
+        if (!ui->spectrumSuspended) {
+            Serial.println("[AUDIO] Stream buffer low, spectrum paused");
+            ui->spectrumSuspended = true;
+            audio.setSpectrumEnabled(false);
+            ui->drawSpectrum(silence);
+        }
+        return;
+    }
+    if (ui->spectrumSuspended) {
+        if (ui->spectrumHealthySince == 0) {
+            ui->spectrumHealthySince = now | 1;
+        }
+        if (now - ui->spectrumHealthySince < SPECTRUM_RESUME_MS) {
+            return;
+        }
+        ui->spectrumSuspended = false;
+    }
+    
+    if (!audio.isSpectrumEnabled()) {
+        audio.setSpectrumEnabled(true);
+    }
+    uint8_t bars[SPECTRUM_BARS];
+    if (audio.getSpectrum(bars, SPECTRUM_BARS)) {
+        ui->drawSpectrum(bars);
+    }
+}
+
+// Paint only the rows a bar grew or shrank by and invalidate just that
+// strip, so a frame redraws a few small rectangles instead of the canvas
+void UIManager::drawSpectrum(const uint8_t* bars) {
+    const lv_coord_t width = SPECTRUM_BARS * (SPECTRUM_BAR_WIDTH + SPECTRUM_BAR_GAP) - SPECTRUM_BAR_GAP;
+    const lv_color_t barColor = lv_palette_main(LV_PALETTE_CYAN);
+    const lv_color_t bgColor = lv_color_black();
+    
+    lv_area_t canvasArea;
+    lv_obj_get_coords(spectrumCanvas, &canvasArea);
+    
+    for (size_t b = 0; b < SPECTRUM_BARS; b++) {
+        lv_coord_t height = (bars[b] * SPECTRUM_HEIGHT + 127) / 255;
+        lv_coord_t drawn = spectrumDrawn[b];
+        if (height == drawn) {
+            continue;
+        }
+        
+        lv_coord_t top = SPECTRUM_HEIGHT - max(height, drawn);
+        lv_coord_t bottom = SPECTRUM_HEIGHT - min(height, drawn);
+        lv_color_t color = height > drawn ? barColor : bgColor;
+        lv_coord_t x = b * (SPECTRUM_BAR_WIDTH + SPECTRUM_BAR_GAP);
+        for (lv_coord_t y = top; y < bottom; y++) {
+            lv_color_t* row = spectrumBuffer + y * width + x;
+            for (lv_coord_t i = 0; i < SPECTRUM_BAR_WIDTH; i++) {
+                row[i] = color;
+            }
+        }
+        spectrumDrawn[b] = height;
+        
+        lv_area_t area;
+        area.x1 = canvasArea.x1 + x;
+        area.x2 = area.x1 + SPECTRUM_BAR_WIDTH - 1;
+        area.y1 = canvasArea.y1 + top;
+        area.y2 = canvasArea.y1 + bottom - 1;
+        lv_obj_invalidate_area(spectrumCanvas, &area);
+    }
+}
+
+// Rewind 30 s further behind the current position
+void UIManager::timeshift_back_cb(lv_event_t* e) {
+    UIManager* ui = static_cast<UIManager*>(lv_event_get_user_data(e));
+    if (!ui) return;
+    
+    AudioManager& audio = AudioManager::getInstance();
+    audio.seekBehindLive(audio.getTimeshiftStatus().delayMs + 30000);
+    timeshift_timer_cb(ui->timeshiftTimer);
+}
+
+void UIManager::timeshift_pause_cb(lv_event_t* e) {
+    UIManager* ui = static_cast<UIManager*>(lv_event_get_user_data(e));
+    if (!ui) return;
+    
+    AudioManager& audio = AudioManager::getInstance();
+    if (audio.isPaused()) {
+        audio.resume();
+    } else {
+        audio.pause();
+    }
+    timeshift_timer_cb(ui->timeshiftTimer);
+}
+
+void UIManager::timeshift_live_cb(lv_event_t* e) {
+    UIManager* ui = static_cast<UIManager*>(lv_event_get_user_data(e));
+    if (!ui) return;
+    
+    AudioManager::getInstance().goLive();
+    timeshift_timer_cb(ui->timeshiftTimer);
+}
+
+void UIManager::timeshift_timer_cb(lv_timer_t* timer) {
+    UIManager* ui = static_cast<UIManager*>(timer->user_data);
+    if (!ui || ui->currentScreen != ui->radioScreen) return;
+    
+    AudioManager::TimeshiftStatus status = AudioManager::getInstance().getTimeshiftStatus();
+    lv_label_set_text(ui->timeshiftPauseLabel, status.paused ? LV_SYMBOL_PLAY : LV_SYMBOL_PAUSE);
+    
+    uint32_t seconds = status.delayMs / 1000;
+    if (seconds == 0 && !status.paused) {
+        lv_label_set_text(ui->timeshiftDelayLabel, "LIVE");
+    } else {
+        lv_label_set_text_fmt(ui->timeshiftDelayLabel, "-%u:%02u", (unsigned)(seconds / 60), (unsigned)(seconds % 60));
+    }
 }
 
 // Static callback implementation
@@ -786,6 +1040,101 @@ void UIManager::createSettingsScreen() {
     
     // Use a static member function as callback instead of a capturing lambda
     lv_obj_add_event_cb(btnWeather, weather_btn_clicked_cb, LV_EVENT_CLICKED, this);
+    
+    // Audio diagnostics button
+    lv_obj_t* btnDiagnostics = lv_btn_create(btnContainer);
+    lv_obj_add_style(btnDiagnostics, &buttonStyle, 0);
+    lv_obj_add_style(btnDiagnostics, &buttonPressedStyle, LV_STATE_PRESSED);
+    lv_obj_set_size(btnDiagnostics, lv_pct(100), 60);
+    lv_obj_align(btnDiagnostics, LV_ALIGN_TOP_MID, 0, 240);
+    
+    lv_obj_t* diagnosticsBtnLabel = lv_label_create(btnDiagnostics);
+    lv_label_set_text(diagnosticsBtnLabel, "Audio Diagnostics");
+    lv_obj_center(diagnosticsBtnLabel);
+    
+    lv_obj_add_event_cb(btnDiagnostics, diagnostics_btn_clicked_cb, LV_EVENT_CLICKED, this);
+}
+
+void UIManager::createDiagnosticsScreen() {
+    diagnosticsScreen = lv_obj_create(NULL);
+    lv_obj_clear_flag(diagnosticsScreen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_bg_color(diagnosticsScreen, lv_color_black(), LV_PART_MAIN);
+    
+    // Transparent area at the top goes back to the home screen, like in settings
+    lv_obj_t* backArea = lv_obj_create(diagnosticsScreen);
+    lv_obj_set_size(backArea, 800, 50);
+    lv_obj_align(backArea, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_set_style_bg_opa(backArea, LV_OPA_0, LV_PART_MAIN);
+    lv_obj_set_style_border_width(backArea, 0, LV_PART_MAIN);
+    lv_obj_add_event_cb(backArea, back_area_clicked_cb, LV_EVENT_CLICKED, this);
+    
+    lv_obj_t* title = lv_label_create(diagnosticsScreen);
+    lv_obj_add_style(title, &infoStyle, 0);
+    lv_label_set_text(title, "Audio Diagnostics");
+    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 20);
+    lv_obj_clear_flag(title, LV_OBJ_FLAG_CLICKABLE);
+    
+    // Share of the time the jitter buffer spent in each tenth of its target depth
+    diagnosticsChart = lv_chart_create(diagnosticsScreen);
+    lv_obj_set_size(diagnosticsChart, 340, 260);
+    lv_obj_align(diagnosticsChart, LV_ALIGN_LEFT_MID, 30, 30);
+    lv_chart_set_type(diagnosticsChart, LV_CHART_TYPE_BAR);
+    lv_chart_set_point_count(diagnosticsChart, AudioTelemetry::FILL_BUCKETS);
+    lv_chart_set_range(diagnosticsChart, LV_CHART_AXIS_PRIMARY_Y, 0, 100);
+    lv_chart_set_div_line_count(diagnosticsChart, 5, 0);
+    diagnosticsSeries = lv_chart_add_series(diagnosticsChart, lv_palette_main(LV_PALETTE_CYAN), LV_CHART_AXIS_PRIMARY_Y);
+    
+    lv_obj_t* chartLabel = lv_label_create(diagnosticsScreen);
+    lv_obj_add_style(chartLabel, &statusStyle, 0);
+    lv_label_set_text(chartLabel, "Buffer fill: empty ... target");
+    lv_obj_align_to(chartLabel, diagnosticsChart, LV_ALIGN_OUT_BOTTOM_MID, 0, 8);
+    
+    diagnosticsLabel = lv_label_create(diagnosticsScreen);
+    lv_obj_add_style(diagnosticsLabel, &infoStyle, 0);
+    lv_obj_set_width(diagnosticsLabel, 380);
+    lv_label_set_text(diagnosticsLabel, "");
+    lv_obj_align(diagnosticsLabel, LV_ALIGN_RIGHT_MID, -20, 30);
+    
+    diagnosticsTimer = lv_timer_create(diagnostics_timer_cb, 1000, this);
+}
+
+void UIManager::showDiagnosticsScreen() {
+    if (!diagnosticsScreen) {
+        createDiagnosticsScreen();
+    }
+    showScreen(diagnosticsScreen);
+    diagnostics_timer_cb(diagnosticsTimer);
+}
+
+void UIManager::diagnostics_timer_cb(lv_timer_t* timer) {
+    UIManager* ui = static_cast<UIManager*>(timer->user_data);
+    if (!ui || ui->currentScreen != ui->diagnosticsScreen) return;
+    
+    AudioManager& audio = AudioManager::getInstance();
+    AudioManager::PumpStats pump = audio.getPumpStats();
+    AudioManager::StallStats stalls = audio.getStallStats();
+    AudioTelemetry::Snapshot telemetry = audio.getTelemetry();
+    
+    for (size_t i = 0; i < AudioTelemetry::FILL_BUCKETS; i++) {
+        lv_coord_t percent = telemetry.fillSamples > 0 ? (telemetry.fill[i] * 100) / telemetry.fillSamples : 0;
+        lv_chart_set_value_by_id(ui->diagnosticsChart, ui->diagnosticsSeries, i, percent);
+    }
+    lv_chart_refresh(ui->diagnosticsChart);
+    
+    lv_label_set_text_fmt(ui->diagnosticsLabel,
+                          "Underruns: %u (%u ms)\n"
+                          "Buffer: %u / %u KB\n"
+                          "Pipeline p50/95/99: %u/%u/%u us\n"
+                          "Network: %u KB/s, jitter %u ms\n"
+                          "Reconnects: %u, stalls: %u\n"
+                          "Telemetry: %u.%02u%% CPU",
+                          (unsigned)pump.underruns, (unsigned)pump.underrunMs,
+                          (unsigned)(pump.bufferFill / 1024), (unsigned)(pump.targetDepth / 1024),
+                          (unsigned)telemetry.pipelineP50Us, (unsigned)telemetry.pipelineP95Us,
+                          (unsigned)telemetry.pipelineP99Us,
+                          (unsigned)(pump.throughput / 1024), (unsigned)pump.jitterMs,
+                          (unsigned)stalls.reconnects, (unsigned)stalls.stalls,
+                          (unsigned)(telemetry.overheadPpm / 10000), (unsigned)((telemetry.overheadPpm / 100) % 100));
 }
 
 void UIManager::back_area_clicked_cb(lv_event_t* e) {
@@ -821,6 +1170,14 @@ void UIManager::weather_btn_clicked_cb(lv_event_t* e) {
     }
 }
 
+void UIManager::diagnostics_btn_clicked_cb(lv_event_t* e) {
+    Serial.println("Diagnostics button clicked");
+    UIManager* self = static_cast<UIManager*>(lv_event_get_user_data(e));
+    if (self) {
+        self->showDiagnosticsScreen();
+    }
+}
+
 void UIManager::back_btn_clicked_cb(lv_event_t* e) {
     Serial.println("Back button clicked");
     UIManager* self = static_cast<UIManager*>(lv_event_get_user_data(e));
@@ -1138,6 +1495,15 @@ void UIManager::createHomeScreen() {
     lv_label_set_text(nextAlarmLabel, "No Alarms");
     lv_obj_align(nextAlarmLabel, LV_ALIGN_BOTTOM_MID, 0, -10);
     
+    // Now playing line above the sensor panel, hidden while no title is known
+    nowPlayingLabel = lv_label_create(homeScreen);
+    lv_obj_add_style(nowPlayingLabel, &infoStyle, 0);
+    lv_obj_set_width(nowPlayingLabel, 560);
+    lv_label_set_long_mode(nowPlayingLabel, LV_LABEL_LONG_SCROLL_CIRCULAR);
+    lv_label_set_text(nowPlayingLabel, "");
+    lv_obj_align(nowPlayingLabel, LV_ALIGN_BOTTOM_LEFT, 10, -95);
+    lv_obj_add_flag(nowPlayingLabel, LV_OBJ_FLAG_HIDDEN);
+    
     // Create sensor panel with better spacing - moved to bottom-left, 70% width
     lv_obj_t* sensorPanel = lv_obj_create(homeScreen);
     lv_obj_set_size(sensorPanel, 560, 70);  // 70% of 800px width = 560px
@@ -44,6 +44,11 @@
 #include "UIManager.h"
 #include "ConfigManager.h"
 #include "AudioManager.h"
+#include "Mp3Indexer.h"
+#include "MusicLibrary.h"
+#include "PodcastPrefetcher.h"
+#include "StreamRecorder.h"
+#include "TlsManager.h"
 #include "AlarmManager.h"
 #include "Globals.h" // For I2C management functions
 
@@ -138,6 +143,11 @@ void update_weather_task(void *parameter);
 #include "UIManager.h"
 #include "ConfigManager.h"
 #include "AudioManager.h"
+#include "Mp3Indexer.h"
+#include "MusicLibrary.h"
+#include "PodcastPrefetcher.h"
+#include "StreamRecorder.h"
+#include "TlsManager.h"
 #include "AlarmManager.h"
 #include "WeatherService.h"
 
@@ -233,29 +243,96 @@ void update_display_task(void *parameter);
 void update_sensors_task(void *parameter);
 void check_alarms_task(void *parameter);
 
+// Look up the radio station of an alarm
+static bool getAlarmStation(const Alarm& alarm, RadioStation& station) {
+    std::vector<RadioStation> stations = ConfigManager::getInstance().getRadioStations();
+    if (alarm.source != 0 || alarm.sourceData.stationIndex >= stations.size()) {
+        return false;
+    }
+    station = stations[alarm.sourceData.stationIndex];
+    return true;
+}
+
+// Alarm pre-flight callback, runs a few seconds before the alarm triggers
+void onAlarmPreflight(const Alarm& alarm) {
+    AudioManager& audio = AudioManager::getInstance();
+    
+    // Make sure the fallback can cover for the station (or a broken file)
+    audio.checkFallbackReadable();
+    
+    // Don't cut off whatever the user is listening to
+    if (audio.isPlaying()) {
+        return;
+    }
+    
+    // Connect and fill the jitter buffer while muted
+    RadioStation station;
+    if (getAlarmStation(alarm, station)) {
+        audio.prepareStream(station.url.c_str(), AudioCodec::fromName(station.codec.c_str()));
+    }
+}
+
+// Rise time of a tone alarm without a fade-in of its own
+static const uint32_t TONE_ALARM_RAMP_MS = 60000;
+
+// Last resort of an alarm: the SD fallback track, then the built-in tone
+static void playAlarmFallback(const Alarm& alarm) {
+    AudioManager& audio = AudioManager::getInstance();
+    if (!audio.playFile(ConfigManager::getInstance().getFallbackAudio().c_str())) {
+        audio.playTone(0, alarm.fadeIn * 1000);
+    }
+}
+
 // Alarm triggered callback
 void onAlarmTriggered(const Alarm& alarm) {
     // Get singleton instances
     UIManager& ui = UIManager::getInstance();
     AudioManager& audio = AudioManager::getInstance();
     
-    // Show alarm screen
-    ui.showAlarmScreen();
+    // Start audio first, the screen can follow a few frames later
+    audio.markTrigger();
+    
+    // Ramp up from silence to the alarm volume inside the output path
+    audio.setVolume(alarm.volume);
+    audio.setFadeIn(alarm.fadeIn * 1000, static_cast<AudioOutputFade::Curve>(alarm.fadeCurve));
     
     // If it's a radio alarm, start playing the radio
     if (alarm.source == 0) { // Radio
-        // Use playStream instead as there's no direct playRadio method
-        // Get the URL for the station index
-        String stationUrl = "http://example.com/radio.mp3"; // You should get this from a station list
-        audio.playStream(stationUrl.c_str());
+        // A station prepared during the pre-flight starts from its buffer;
+        // a known codec skips probing the stream
+        RadioStation station;
+        bool started = false;
+        if (getAlarmStation(alarm, station)) {
+            started = audio.commitPreparedStream(station.url.c_str()) ||
+                      audio.playStream(station.url.c_str(), AudioCodec::fromName(station.codec.c_str()));
+        }
+        if (!started) {
+            // Station unreachable: an alarm must never stay silent
+            playAlarmFallback(alarm);
+        }
     } 
     // If it's an MP3 alarm, play the specified file
     else if (alarm.source == 1) { // MP3
-        audio.playFile(alarm.sourceData.filepath);
+        if (!audio.playFile(alarm.sourceData.filepath)) {
+            playAlarmFallback(alarm);
+        }
+    }
+    // Podcast alarm: the episode downloaded overnight plays from SD
+    else if (alarm.source == 2) { // Podcast
+        PodcastPrefetcher::Episode episode;
+        if (!PodcastPrefetcher::getInstance().getEpisode(alarm.sourceData.feedIndex, episode) ||
+            !audio.playFile(episode.path.c_str())) {
+            playAlarmFallback(alarm);
+        }
+    }
+    // Tone alarm: synthesized, rises slowly unless the alarm has its own fade
+    else if (alarm.source == 3) { // Tone
+        audio.playTone(alarm.sourceData.tonePattern,
+                       alarm.fadeIn > 0 ? alarm.fadeIn * 1000 : TONE_ALARM_RAMP_MS);
     }
     
-    // Set volume using the AudioManager singleton instance
-    audio.setVolume(alarm.volume);
+    // Show alarm screen
+    ui.showAlarmScreen();
 }
 
 void setup() {
@@ -327,6 +404,7 @@ void setup() {
         }
     }
     Serial.println("[DEBUG] UIManager initialized successfully");
+    ui.setSpectrumEnabled(config.getDisplayConfig().spectrum);
     
     // Initialize WiFi
     Serial.println("[DEBUG] Starting WiFi initialization...");
@@ -353,6 +431,14 @@ void setup() {
     audio_init();
     Serial.println("[DEBUG] Audio initialization completed");
     
+    // Initialize alarms
+    Serial.println("[DEBUG] Starting alarm initialization...");
+    alarm.setAlarmTriggerCallback(onAlarmTriggered);
+    alarm.setAlarmPreflightCallback(onAlarmPreflight);
+    alarm.setPreflightLead(config.getAudioConfig().warm_start_s);
+    alarm.begin();
+    Serial.println("[DEBUG] Alarm initialization completed");
+    
     // Initialize web server
     Serial.println("[DEBUG] Starting web server initialization...");
     web_server_init();
@@ -385,7 +471,8 @@ void setup() {
     BaseType_t alarmsTaskCreated = xTaskCreate(
         check_alarms_task,     // Function
         "AlarmTask",          // Name
-        4096,                 // Stack size
+        16384,                // Stack size - the alarm callbacks resolve and connect
+                              // streams, an https station adds the TLS handshake
         NULL,                 // Parameters
         1,                    // Priority
         &alarmTaskHandle      // Task handle - use the correct variable name
@@ -442,6 +529,10 @@ void loop() {
     // Get UIManager instance
     UIManager& ui = UIManager::getInstance();
     
+    // Serve the web interface and the API; without this no request is answered
+    server.handleClient();
+    ElegantOTA.loop();
+    
     // Update UI is handled separately via tasks so no need to call update() here
     
     // Update time string once per second
@@ -460,12 +551,41 @@ void loop() {
             Serial.printf("[MEM] Free heap: %d bytes\n", ESP.getFreeHeap());
         }
         
+        // Cache detected stream codecs in the station list so the next tune skips probing
+        String codecUrl;
+        StreamCodec codec;
+        if (AudioManager::getInstance().takeDetectedCodec(codecUrl, codec) &&
+            ConfigManager::getInstance().setStationCodec(codecUrl, AudioCodec::name(codec))) {
+            ConfigManager::getInstance().saveConfig();
+        }
+        
+        // Keep learned loudness gains so the next tune starts at the right level
+        String gainUrl;
+        float gainDb;
+        if (AudioManager::getInstance().takeLearnedGain(gainUrl, gainDb) &&
+            ConfigManager::getInstance().setStationGain(gainUrl, gainDb)) {
+            ConfigManager::getInstance().saveConfig();
+        }
+        
+        // Step the bitrate of the station on air with the network
+        AudioManager::getInstance().adaptBitrate();
+        
         // Get current time
         struct tm timeinfo;
         char timeStr[9];  // HH:MM:SS + null terminator
         char dateStr[32];
         
         if (getLocalTime(&timeinfo)) {
+            // Hourly chime over the station on air, never into a silent room
+            static int lastChimeHour = -1;
+            if (timeinfo.tm_min == 0 && timeinfo.tm_hour != lastChimeHour) {
+                lastChimeHour = timeinfo.tm_hour;
+                String chime = ConfigManager::getInstance().getAudioConfig().hourly_chime;
+                if (chime.length() > 0 && AudioManager::getInstance().isPlaying()) {
+                    AudioManager::getInstance().playClip(chime.c_str());
+                }
+            }
+            
             // Format time as HH:MM:SS
             strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
             // Create German weekday array
@@ -684,10 +804,165 @@ void sensors_init() {
                  sht31_success ? "AVAILABLE" : "UNAVAILABLE");
 }
 
+/**
+ * @brief Load an equalizer preset from the config into the output chain
+ * @param name Preset name
+ * @return false if there is no such preset
+ */
+bool apply_equalizer_preset(const String& name) {
+    const EqPresetConfig* preset = ConfigManager::getInstance().findEqualizerPreset(name);
+    if (!preset) {
+        return false;
+    }
+
+    EqBand bands[EQ_MAX_BANDS];
+    size_t count = 0;
+    for (const auto& band : preset->bands) {
+        if (count == EQ_MAX_BANDS) {
+            Serial.printf("[AUDIO] Preset %s has more than %u bands, ignoring the rest\n",
+                          name.c_str(), (unsigned)EQ_MAX_BANDS);
+            break;
+        }
+        bands[count].type = band.type == "lowshelf" ? EqFilterType::LowShelf :
+                            band.type == "highshelf" ? EqFilterType::HighShelf :
+                            EqFilterType::Peaking;
+        bands[count].freq = band.freq;
+        bands[count].gainDb = constrain(band.gain_db, -15.0f, 15.0f);
+        bands[count].q = band.q;
+        count++;
+    }
+    AudioManager::getInstance().setEqualizer(bands, count);
+    return true;
+}
+
 void audio_init() {
+    // Apply stream buffer settings before the audio tasks allocate the ring
+    AudioConfig audioConfig = ConfigManager::getInstance().getAudioConfig();
+    AudioManager::getInstance().setBufferLimits(audioConfig.buffer_min_kb * 1024,
+                                                audioConfig.buffer_max_kb * 1024);
+    AudioManager::getInstance().setPreBufferPercent(audioConfig.prebuffer_percent);
+
+    // A stalled stream is covered by the fallback track from SD
+    AudioManager::getInstance().setStallTimeout(audioConfig.stall_timeout_ms);
+    AudioManager::getInstance().setFallbackFile(ConfigManager::getInstance().getFallbackAudio().c_str());
+
+    // Station switches overlap the old and new stream within the PSRAM budget
+    AudioManager::getInstance().setCrossfade(audioConfig.crossfade_ms);
+    AudioManager::getInstance().setPsramBudget(audioConfig.psram_budget_kb * 1024);
+
+    // Stations are levelled to a common loudness, starting from the gain
+    // remembered for each of them
+    AudioManager::getInstance().setLoudnessNormalization(audioConfig.normalize_loudness,
+                                                         audioConfig.loudness_target_lufs);
+    AudioManager::getInstance().setStationGainLookup([](const char* url) {
+        return ConfigManager::getInstance().getStationGain(url);
+    });
+
+    // Stations listed at several bitrates follow the network
+    AudioManager::getInstance().setAdaptiveBitrate(audioConfig.adaptive_bitrate);
+    AudioManager::getInstance().setStreamVariantLookup([](const char* url, AudioManager::StreamVariant* variants,
+                                                          size_t max) {
+        const RadioStation* station = ConfigManager::getInstance().findStation(url);
+        size_t count = 0;
+        if (!station) {
+            return count;
+        }
+        for (const auto& variant : station->variants) {
+            if (count == max) {
+                break;
+            }
+            strlcpy(variants[count].url, variant.url.c_str(), sizeof(variants[count].url));
+            variants[count].kbps = variant.bitrate;
+            variants[count].codec = AudioCodec::fromName(variant.codec.c_str());
+            count++;
+        }
+        return count;
+    });
+
+    // MP3 decoder implementation, empty config keeps the build default
+    AudioManager::getInstance().setMp3Decoder(AudioDecoder::fromName(audioConfig.mp3_decoder.c_str()));
+
+    // Live radio can be paused and rewound within this much compressed history
+    AudioManager::getInstance().setTimeshift((size_t)audioConfig.timeshift_kb * 1024);
+#ifdef AUDIO_BENCHMARK
+    // Reference files in /bench on SD, decoded before playback starts
+    AudioDecoder::benchmark("/bench");
+#endif
+    
     // Initialize the audio manager
     AudioManager::getInstance().begin();
     AudioManager::getInstance().setVolume(50);
+
+    // Chimes mix over the station, which steps back while they play
+    AudioManager::getInstance().setDuckLevel(audioConfig.duck_db);
+    if (ConfigManager::getInstance().isSDCardPresent() && audioConfig.hourly_chime.length() > 0) {
+        AudioManager::getInstance().loadClip(audioConfig.hourly_chime.c_str());
+    }
+
+    // Equalizer preset from the config, unknown names play flat
+    String preset = ConfigManager::getInstance().getEqualizerConfig().preset;
+    if (!apply_equalizer_preset(preset)) {
+        Serial.printf("[AUDIO] Unknown equalizer preset %s, playing flat\n", preset.c_str());
+    }
+#ifdef AUDIO_BENCHMARK
+    // Worst case of the cascade: every band in use, octave spaced
+    EqBand benchBands[EQ_MAX_BANDS];
+    for (size_t i = 0; i < EQ_MAX_BANDS; i++) {
+        benchBands[i] = {EqFilterType::Peaking, 31.25f * (1 << i), 3.0f, 1.0f};
+    }
+    AudioOutputEqualizer::benchmark(benchBands, EQ_MAX_BANDS);
+#endif
+
+    // CA certificates for HTTPS stations and podcasts, before the first connection
+    TlsManager::getInstance().begin(audioConfig.tls_trust_store.c_str(), audioConfig.tls_verify);
+
+    // Playlist and redirect targets of the stations, cached on SD
+    StreamResolver::getInstance().setTtl(audioConfig.resolve_ttl_h * 3600UL);
+    StreamResolver::getInstance().begin();
+
+    // Frame index sidecars next to the MP3 files, built in the background
+    if (ConfigManager::getInstance().isSDCardPresent()) {
+        Mp3Indexer::getInstance().begin("/");
+    }
+
+    // Tags of the MP3 collection, indexed for browsing
+    if (ConfigManager::getInstance().isSDCardPresent()) {
+        MusicLibrary::getInstance().begin("/");
+    }
+
+    // Newest podcast episodes, downloaded overnight for podcast alarms
+    if (ConfigManager::getInstance().isSDCardPresent()) {
+        PodcastConfig podcasts = ConfigManager::getInstance().getPodcastConfig();
+        std::vector<String> feeds;
+        for (const auto& feed : podcasts.feeds) {
+            feeds.push_back(feed.url);
+        }
+        PodcastPrefetcher& prefetcher = PodcastPrefetcher::getInstance();
+        prefetcher.setFeeds(feeds);
+        prefetcher.setQuota((uint64_t)podcasts.quota_mb * 1024 * 1024);
+        prefetcher.setFetchHour(podcasts.fetch_hour);
+        prefetcher.setBusyCheck([]() {
+            // No downloads competing with playback, a recording or an alarm about to start
+            return AudioManager::getInstance().isPlaying() || AlarmManager::getInstance().isPreflightActive() ||
+                   StreamRecorder::getInstance().getStatus().recording;
+        });
+        prefetcher.begin();
+    }
+
+    // Scheduled recordings of radio shows to SD
+    if (ConfigManager::getInstance().isSDCardPresent()) {
+        StreamRecorder& recorder = StreamRecorder::getInstance();
+        recorder.setBufferSize((size_t)audioConfig.record_buffer_kb * 1024);
+        recorder.setStationLookup([](uint8_t index, String& url) {
+            std::vector<RadioStation> stations = ConfigManager::getInstance().getRadioStations();
+            if (index >= stations.size()) {
+                return false;
+            }
+            url = stations[index].url;
+            return true;
+        });
+        recorder.begin();
+    }
     Serial.println("Audio initialized");
 }
 
@@ -711,6 +986,592 @@ void web_server_init() {
     server.serveStatic("/js", SPIFFS, "/www/js");
     server.serveStatic("/img", SPIFFS, "/www/img");
     
+    // Alarm settings API
+    server.on("/api/alarms", HTTP_GET, []() {
+        DynamicJsonDocument doc(2048);
+        JsonArray alarmsArray = doc.to<JsonArray>();
+        for (const Alarm& alarm : AlarmManager::getInstance().getAlarms()) {
+            JsonObject alarmObj = alarmsArray.createNestedObject();
+            alarmObj["id"] = alarm.id;
+            alarmObj["hour"] = alarm.hour;
+            alarmObj["minute"] = alarm.minute;
+            alarmObj["enabled"] = alarm.enabled;
+            alarmObj["volume"] = alarm.volume;
+            alarmObj["source"] = alarm.source;
+            if (alarm.source == 3) {
+                alarmObj["pattern"] = AudioGeneratorTone::patternName(alarm.sourceData.tonePattern);
+            }
+            alarmObj["fade_in"] = alarm.fadeIn;
+            alarmObj["fade_curve"] = AudioOutputFade::curveName(
+                static_cast<AudioOutputFade::Curve>(alarm.fadeCurve));
+        }
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Alarm start latency: trigger to first decoded sample at the output
+    server.on("/api/alarms/latency", HTTP_GET, []() {
+        AudioManager& audio = AudioManager::getInstance();
+        DynamicJsonDocument doc(128);
+        doc["trigger_to_first_sample_ms"] = audio.getTriggerLatency();
+        doc["warm_start"] = audio.wasWarmStart();
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Switch to a station from the station list: station (index)
+    server.on("/api/radio/play", HTTP_POST, []() {
+        std::vector<RadioStation> stations = ConfigManager::getInstance().getRadioStations();
+        int index = server.hasArg("station") ? server.arg("station").toInt() : -1;
+        if (index < 0 || index >= (int)stations.size()) {
+            server.send(400, "application/json", "{\"error\":\"invalid station\"}");
+            return;
+        }
+        const RadioStation& station = stations[index];
+        if (!AudioManager::getInstance().playStream(station.url.c_str(),
+                                                    AudioCodec::fromName(station.codec.c_str()))) {
+            server.send(502, "application/json", "{\"error\":\"station not reachable\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Pause the station on air, the timeshift history keeps recording
+    server.on("/api/radio/pause", HTTP_POST, []() {
+        if (!AudioManager::getInstance().pause()) {
+            server.send(409, "application/json", "{\"error\":\"no stream to pause\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    server.on("/api/radio/resume", HTTP_POST, []() {
+        if (!AudioManager::getInstance().resume()) {
+            server.send(409, "application/json", "{\"error\":\"not paused\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Rewind the station on air: behind_ms (time behind live, 0 for live)
+    server.on("/api/radio/seek", HTTP_POST, []() {
+        if (!server.hasArg("behind_ms") || server.arg("behind_ms").toInt() < 0) {
+            server.send(400, "application/json", "{\"error\":\"invalid behind_ms\"}");
+            return;
+        }
+        if (!AudioManager::getInstance().seekBehindLive(server.arg("behind_ms").toInt())) {
+            server.send(409, "application/json", "{\"error\":\"nothing recorded to seek in\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Timeshift position and the history available to rewind into
+    server.on("/api/radio/timeshift", HTTP_GET, []() {
+        AudioManager::TimeshiftStatus status = AudioManager::getInstance().getTimeshiftStatus();
+        DynamicJsonDocument doc(128);
+        doc["enabled"] = status.enabled;
+        doc["paused"] = status.paused;
+        doc["delay_ms"] = status.delayMs;
+        doc["window_ms"] = status.windowMs;
+        doc["capacity"] = status.capacity;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Station switch latency and stream pipeline memory
+    server.on("/api/audio/switch", HTTP_GET, []() {
+        AudioManager::SwitchStats stats = AudioManager::getInstance().getSwitchStats();
+        DynamicJsonDocument doc(256);
+        doc["switches"] = stats.switches;
+        doc["gapless"] = stats.gapless;
+        doc["last_switch_ms"] = stats.lastSwitchMs;
+        doc["max_switch_ms"] = stats.maxSwitchMs;
+        doc["pending"] = stats.pending;
+        doc["psram_bytes"] = stats.psramBytes;
+        doc["psram_budget"] = stats.psramBudget;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Bitrate variant of the station on air
+    server.on("/api/audio/bitrate", HTTP_GET, []() {
+        AudioManager::BitrateStats stats = AudioManager::getInstance().getBitrateStats();
+        DynamicJsonDocument doc(192);
+        doc["enabled"] = stats.enabled;
+        doc["kbps"] = stats.kbps;
+        doc["variant"] = stats.variant;
+        doc["variant_count"] = stats.variantCount;
+        doc["pending"] = stats.pending;
+        doc["switches"] = stats.switches;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Stream pipeline telemetry: underruns, buffer fill histogram, pipeline
+    // time per frame, network rate, reconnects and the cost of measuring
+    server.on("/api/audio/stats", HTTP_GET, []() {
+        AudioManager& audio = AudioManager::getInstance();
+        AudioManager::PumpStats pump = audio.getPumpStats();
+        AudioManager::StallStats stalls = audio.getStallStats();
+        AudioTelemetry::Snapshot telemetry = audio.getTelemetry();
+        DynamicJsonDocument doc(768);
+        doc["underruns"] = pump.underruns;
+        doc["underrun_ms"] = pump.underrunMs;
+        doc["buffer_fill"] = pump.bufferFill;
+        doc["target_depth"] = pump.targetDepth;
+        JsonArray fill = doc.createNestedArray("fill_histogram");
+        for (uint32_t count : telemetry.fill) {
+            fill.add(count);
+        }
+        JsonObject pipeline = doc.createNestedObject("pipeline_us");
+        pipeline["frames"] = telemetry.pipelineFrames;
+        pipeline["p50"] = telemetry.pipelineP50Us;
+        pipeline["p95"] = telemetry.pipelineP95Us;
+        pipeline["p99"] = telemetry.pipelineP99Us;
+        pipeline["max"] = telemetry.pipelineMaxUs;
+        doc["network_bps"] = pump.throughput;
+        doc["jitter_ms"] = pump.jitterMs;
+        doc["bytes_received"] = pump.bytesReceived;
+        doc["reconnects"] = stalls.reconnects;
+        doc["stalls"] = stalls.stalls;
+        doc["overhead_percent"] = telemetry.overheadPpm / 10000.0f;
+        doc["max_overhead_percent"] = telemetry.maxOverheadPpm / 10000.0f;
+        doc["since_ms"] = telemetry.sinceMs;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Play a clip over the audio playing now: path (MP3 or WAV on SD), gain_db (optional)
+    server.on("/api/audio/clip", HTTP_POST, []() {
+        if (!server.hasArg("path") || server.arg("path").length() == 0) {
+            server.send(400, "application/json", "{\"error\":\"missing path\"}");
+            return;
+        }
+        float gainDb = server.hasArg("gain_db") ? server.arg("gain_db").toFloat() : 0.0f;
+        if (!AudioManager::getInstance().playClip(server.arg("path").c_str(), gainDb)) {
+            server.send(409, "application/json", "{\"error\":\"clip not playable\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Equalizer presets and the active one
+    server.on("/api/equalizer", HTTP_GET, []() {
+        EqualizerConfig eq = ConfigManager::getInstance().getEqualizerConfig();
+        DynamicJsonDocument doc(512);
+        doc["preset"] = eq.preset;
+        JsonArray presets = doc.createNestedArray("presets");
+        for (const auto& preset : eq.presets) {
+            presets.add(preset.name);
+        }
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Select an equalizer preset: preset (name)
+    server.on("/api/equalizer", HTTP_POST, []() {
+        String name = server.arg("preset");
+        if (!apply_equalizer_preset(name)) {
+            server.send(404, "application/json", "{\"error\":\"unknown preset\"}");
+            return;
+        }
+        EqualizerConfig eq = ConfigManager::getInstance().getEqualizerConfig();
+        eq.preset = name;
+        ConfigManager::getInstance().setEqualizerConfig(eq);
+        ConfigManager::getInstance().saveConfig();
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Loudness of the stream on air and the normalization gain on top of the volume
+    server.on("/api/audio/loudness", HTTP_GET, []() {
+        AudioManager& audio = AudioManager::getInstance();
+        AudioConfig audioConfig = ConfigManager::getInstance().getAudioConfig();
+        DynamicJsonDocument doc(128);
+        float lufs = audio.getShortTermLoudness();
+        if (isnan(lufs)) {
+            doc["short_term_lufs"] = nullptr;  // Still settling
+        } else {
+            doc["short_term_lufs"] = lufs;
+        }
+        doc["gain_db"] = audio.getLoudnessGain();
+        doc["target_lufs"] = audioConfig.loudness_target_lufs;
+        doc["enabled"] = audioConfig.normalize_loudness;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // MP3 decoder implementation
+    server.on("/api/audio/decoder", HTTP_GET, []() {
+        DynamicJsonDocument doc(64);
+        doc["mp3"] = AudioDecoder::name(AudioManager::getInstance().getMp3Decoder());
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Select the MP3 decoder: mp3 ("libmad"/"helix"), used from the next start
+    server.on("/api/audio/decoder", HTTP_POST, []() {
+        String mp3 = server.arg("mp3");
+        if (mp3 != "libmad" && mp3 != "helix") {
+            server.send(400, "application/json", "{\"error\":\"invalid decoder\"}");
+            return;
+        }
+        AudioManager::getInstance().setMp3Decoder(AudioDecoder::fromName(mp3.c_str()));
+        AudioConfig audioConfig = ConfigManager::getInstance().getAudioConfig();
+        audioConfig.mp3_decoder = mp3;
+        ConfigManager::getInstance().setAudioConfig(audioConfig);
+        ConfigManager::getInstance().saveConfig();
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Play a file from SD: path, optional start_ms to resume inside it
+    server.on("/api/audio/file", HTTP_POST, []() {
+        String path = server.arg("path");
+        long startMs = server.hasArg("start_ms") ? server.arg("start_ms").toInt() : 0;
+        if (path.isEmpty() || !path.startsWith("/") || startMs < 0) {
+            server.send(400, "application/json", "{\"error\":\"invalid path or start_ms\"}");
+            return;
+        }
+        if (!AudioManager::getInstance().playFile(path.c_str(), (uint32_t)startMs)) {
+            server.send(404, "application/json", "{\"error\":\"file not playable\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Local file playing (or last played) and the position to resume it at
+    server.on("/api/audio/file", HTTP_GET, []() {
+        String path;
+        uint32_t positionMs = AudioManager::getInstance().getFilePosition(path);
+        DynamicJsonDocument doc(256);
+        doc["path"] = path;
+        doc["position_ms"] = positionMs;
+        doc["indexed"] = Mp3Indexer::getInstance().getIndexedCount();
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // SD throughput and block read latency of local playback
+    server.on("/api/audio/sd", HTTP_GET, []() {
+        AudioFileSourceSDBlock::ReadStats stats = AudioManager::getInstance().getSdReadStats();
+        DynamicJsonDocument doc(256);
+        doc["blocks"] = stats.blocks;
+        doc["bytes_per_second"] = stats.bytesPerSecond;
+        doc["p50_us"] = stats.p50Us;
+        doc["p95_us"] = stats.p95Us;
+        doc["p99_us"] = stats.p99Us;
+        doc["max_us"] = stats.maxUs;
+        doc["underruns"] = stats.underruns;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Set the fade-in of an alarm: id, fade_in (seconds), fade_curve ("linear"/"perceptual")
+    server.on("/api/alarms/fade", HTTP_POST, []() {
+        if (!server.hasArg("id")) {
+            server.send(400, "application/json", "{\"error\":\"missing id\"}");
+            return;
+        }
+        
+        AlarmManager& alarms = AlarmManager::getInstance();
+        const Alarm* existing = alarms.getAlarm(server.arg("id").toInt());
+        if (!existing) {
+            server.send(404, "application/json", "{\"error\":\"unknown alarm\"}");
+            return;
+        }
+        
+        Alarm alarm = *existing;
+        if (server.hasArg("fade_in")) {
+            alarm.fadeIn = constrain(server.arg("fade_in").toInt(), 0, 255);
+        }
+        if (server.hasArg("fade_curve")) {
+            alarm.fadeCurve = static_cast<uint8_t>(
+                AudioOutputFade::curveFromName(server.arg("fade_curve").c_str()));
+        }
+        alarms.updateAlarm(alarm);
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Set the sound of an alarm: id, source ("radio", "file", "podcast" or
+    // "tone"), station (index), path, feed (index) or pattern (name or index)
+    server.on("/api/alarms/source", HTTP_POST, []() {
+        AlarmManager& alarms = AlarmManager::getInstance();
+        const Alarm* existing = server.hasArg("id") ? alarms.getAlarm(server.arg("id").toInt()) : nullptr;
+        if (!existing) {
+            server.send(404, "application/json", "{\"error\":\"unknown alarm\"}");
+            return;
+        }
+        
+        Alarm alarm = *existing;
+        String source = server.arg("source");
+        int feed = server.hasArg("feed") ? server.arg("feed").toInt() : -1;
+        int pattern = -1;
+        if (server.hasArg("pattern")) {
+            String name = server.arg("pattern");
+            pattern = isDigit(name.charAt(0)) ? name.toInt() : AudioGeneratorTone::fromName(name.c_str());
+        }
+        if (source == "radio" && server.hasArg("station")) {
+            alarm.source = 0;
+            alarm.sourceData.stationIndex = server.arg("station").toInt();
+        } else if (source == "file" && server.hasArg("path")) {
+            alarm.source = 1;
+            strlcpy(alarm.sourceData.filepath, server.arg("path").c_str(), sizeof(alarm.sourceData.filepath));
+        } else if (source == "podcast" && feed >= 0 &&
+                   feed < (int)ConfigManager::getInstance().getPodcastConfig().feeds.size()) {
+            alarm.source = 2;
+            alarm.sourceData.feedIndex = feed;
+        } else if (source == "tone" && pattern >= 0 && pattern < AudioGeneratorTone::patternCount()) {
+            alarm.source = 3;
+            alarm.sourceData.tonePattern = pattern;
+        } else {
+            server.send(400, "application/json", "{\"error\":\"invalid source\"}");
+            return;
+        }
+        alarms.updateAlarm(alarm);
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Podcast feeds, their downloaded episodes and the download in progress
+    server.on("/api/podcasts", HTTP_GET, []() {
+        PodcastPrefetcher& prefetcher = PodcastPrefetcher::getInstance();
+        PodcastConfig podcasts = ConfigManager::getInstance().getPodcastConfig();
+        PodcastPrefetcher::Status status = prefetcher.getStatus();
+        DynamicJsonDocument doc(2048);
+        JsonArray feedsArray = doc.createNestedArray("feeds");
+        for (size_t i = 0; i < podcasts.feeds.size(); i++) {
+            JsonObject feedObj = feedsArray.createNestedObject();
+            feedObj["name"] = podcasts.feeds[i].name;
+            PodcastPrefetcher::Episode episode;
+            if (prefetcher.getEpisode(i, episode)) {
+                feedObj["episode"] = episode.title;
+                feedObj["path"] = episode.path;
+                feedObj["bytes"] = episode.bytes;
+            }
+        }
+        doc["fetching"] = status.fetching;
+        doc["feed"] = status.feed;
+        doc["downloaded"] = status.downloaded;
+        doc["total"] = status.total;
+        doc["used_bytes"] = status.usedBytes;
+        doc["quota_bytes"] = status.quotaBytes;
+        doc["last_fetch"] = status.lastFetch;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Download the newest episodes now instead of overnight
+    server.on("/api/podcasts/fetch", HTTP_POST, []() {
+        if (PodcastPrefetcher::getInstance().getFeedCount() == 0) {
+            server.send(409, "application/json", "{\"error\":\"no podcast feeds\"}");
+            return;
+        }
+        PodcastPrefetcher::getInstance().fetchNow();
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // A page of the music library in artist, album, track order: offset, count
+    server.on("/api/library/tracks", HTTP_GET, []() {
+        MusicLibrary& library = MusicLibrary::getInstance();
+        uint32_t offset = server.hasArg("offset") ? max(0L, server.arg("offset").toInt()) : 0;
+        size_t count = server.hasArg("count") ? constrain(server.arg("count").toInt(), 1, 50) : 20;
+        std::vector<MusicLibrary::Track> tracks;
+        library.getTracks(offset, count, tracks);
+        MusicLibrary::Status status = library.getStatus();
+        DynamicJsonDocument doc(1024 + tracks.size() * 512);
+        doc["total"] = status.tracks;
+        doc["offset"] = offset;
+        doc["scanning"] = status.scanning;
+        JsonArray tracksArray = doc.createNestedArray("tracks");
+        for (const auto& track : tracks) {
+            JsonObject trackObj = tracksArray.createNestedObject();
+            trackObj["artist"] = track.artist;
+            trackObj["album"] = track.album;
+            trackObj["title"] = track.title;
+            trackObj["path"] = track.path;
+            trackObj["duration_ms"] = track.durationMs;
+            trackObj["track"] = track.trackNo;
+        }
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // A page of artists: offset, count, or prefix to start at the first artist at or after it
+    server.on("/api/library/artists", HTTP_GET, []() {
+        MusicLibrary& library = MusicLibrary::getInstance();
+        uint32_t offset = server.hasArg("offset") ? max(0L, server.arg("offset").toInt()) : 0;
+        if (server.hasArg("prefix")) {
+            offset = library.findArtist(server.arg("prefix").c_str());
+        }
+        size_t count = server.hasArg("count") ? constrain(server.arg("count").toInt(), 1, 50) : 20;
+        std::vector<MusicLibrary::Artist> artists;
+        library.getArtists(offset, count, artists);
+        MusicLibrary::Status status = library.getStatus();
+        DynamicJsonDocument doc(512 + artists.size() * 192);
+        doc["total"] = status.artists;
+        doc["offset"] = offset;
+        JsonArray artistsArray = doc.createNestedArray("artists");
+        for (const auto& artist : artists) {
+            JsonObject artistObj = artistsArray.createNestedObject();
+            artistObj["name"] = artist.name;
+            artistObj["first_track"] = artist.firstTrack;
+            artistObj["tracks"] = artist.trackCount;
+        }
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Scanner state and the size of the library
+    server.on("/api/library/status", HTTP_GET, []() {
+        MusicLibrary::Status status = MusicLibrary::getInstance().getStatus();
+        DynamicJsonDocument doc(256);
+        doc["scanning"] = status.scanning;
+        doc["tracks"] = status.tracks;
+        doc["artists"] = status.artists;
+        doc["scanned"] = status.scanned;
+        doc["reused"] = status.reused;
+        doc["last_scan_ms"] = status.lastScanMs;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Trust store and TLS session resumption statistics
+    server.on("/api/tls", HTTP_GET, []() {
+        TlsManager::Status status = TlsManager::getInstance().getStatus();
+        DynamicJsonDocument doc(256);
+        doc["verify"] = status.verify;
+        doc["certificates"] = status.certificates;
+        doc["builtin_bundle"] = status.builtinBundle;
+        doc["sessions"] = status.sessions;
+        doc["full_handshakes"] = status.fullHandshakes;
+        doc["full_avg_ms"] = status.fullAvgMs;
+        doc["resumed_handshakes"] = status.resumedHandshakes;
+        doc["resumed_avg_ms"] = status.resumedAvgMs;
+        doc["failures"] = status.failures;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Rescan the card after copying music: full=1 also rereads unchanged directories
+    server.on("/api/library/scan", HTTP_POST, []() {
+        if (!ConfigManager::getInstance().isSDCardPresent()) {
+            server.send(409, "application/json", "{\"error\":\"no SD card\"}");
+            return;
+        }
+        MusicLibrary::getInstance().rescan(server.arg("full") == "1");
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Recording schedules and the recording in progress
+    server.on("/api/recordings", HTTP_GET, []() {
+        StreamRecorder& recorder = StreamRecorder::getInstance();
+        StreamRecorder::Status status = recorder.getStatus();
+        DynamicJsonDocument doc(2048);
+        JsonArray schedulesArray = doc.createNestedArray("schedules");
+        for (const auto& schedule : recorder.getSchedules()) {
+            JsonObject scheduleObj = schedulesArray.createNestedObject();
+            scheduleObj["id"] = schedule.when.id;
+            scheduleObj["hour"] = schedule.when.hour;
+            scheduleObj["minute"] = schedule.when.minute;
+            scheduleObj["enabled"] = schedule.when.enabled;
+            JsonArray daysArray = scheduleObj.createNestedArray("repeat");
+            for (int i = 0; i < 7; i++) {
+                daysArray.add(schedule.when.repeat[i]);
+            }
+            scheduleObj["station"] = schedule.when.sourceData.stationIndex;
+            scheduleObj["minutes"] = schedule.minutes;
+        }
+        doc["recording"] = status.recording;
+        doc["shared"] = status.shared;
+        doc["schedule"] = status.scheduleId;
+        doc["path"] = status.path;
+        doc["bytes"] = status.bytes;
+        doc["dropped"] = status.dropped;
+        doc["remaining_s"] = status.remainingS;
+        doc["buffer_percent"] = status.bufferPercent;
+        doc["max_write_ms"] = status.maxWriteMs;
+        String response;
+        serializeJson(doc, response);
+        server.send(200, "application/json", response);
+    });
+    
+    // Add or change a recording schedule: id, hour, minute, days ("0111110", Sunday first),
+    // station (index), minutes, enabled (optional)
+    server.on("/api/recordings", HTTP_POST, []() {
+        String days = server.arg("days");
+        long hour = server.arg("hour").toInt();
+        long minute = server.arg("minute").toInt();
+        long minutes = server.arg("minutes").toInt();
+        if (!server.hasArg("id") || !server.hasArg("station") || days.length() != 7 ||
+            hour < 0 || hour > 23 || minute < 0 || minute > 59 || minutes <= 0 || minutes > 24 * 60) {
+            server.send(400, "application/json", "{\"error\":\"invalid schedule\"}");
+            return;
+        }
+        StreamRecorder::Schedule schedule = {};
+        schedule.when.id = server.arg("id").toInt();
+        schedule.when.hour = hour;
+        schedule.when.minute = minute;
+        schedule.when.enabled = !server.hasArg("enabled") || server.arg("enabled") != "0";
+        for (int i = 0; i < 7; i++) {
+            schedule.when.repeat[i] = days[i] == '1';
+        }
+        schedule.when.source = 0;  // Radio
+        schedule.when.sourceData.stationIndex = server.arg("station").toInt();
+        schedule.minutes = minutes;
+        StreamRecorder& recorder = StreamRecorder::getInstance();
+        if (!recorder.updateSchedule(schedule) && !recorder.addSchedule(schedule)) {
+            server.send(409, "application/json", "{\"error\":\"too many schedules\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Remove a recording schedule: id
+    server.on("/api/recordings/remove", HTTP_POST, []() {
+        if (!server.hasArg("id") || !StreamRecorder::getInstance().removeSchedule(server.arg("id").toInt())) {
+            server.send(404, "application/json", "{\"error\":\"unknown schedule\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // Record a station now: station (index), minutes
+    server.on("/api/recordings/start", HTTP_POST, []() {
+        std::vector<RadioStation> stations = ConfigManager::getInstance().getRadioStations();
+        long station = server.hasArg("station") ? server.arg("station").toInt() : -1;
+        long minutes = server.arg("minutes").toInt();
+        if (station < 0 || station >= (long)stations.size() || minutes <= 0 || minutes > 24 * 60) {
+            server.send(400, "application/json", "{\"error\":\"invalid station or minutes\"}");
+            return;
+        }
+        if (!StreamRecorder::getInstance().start(stations[station].url.c_str(), minutes)) {
+            server.send(409, "application/json", "{\"error\":\"recording in progress\"}");
+            return;
+        }
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
+    // End the recording in progress
+    server.on("/api/recordings/stop", HTTP_POST, []() {
+        StreamRecorder::getInstance().stop();
+        server.send(200, "application/json", "{\"status\":\"ok\"}");
+    });
+    
     // Handle 404
     server.onNotFound([]() {
         server.send(404, "text/plain", "Not found");
@@ -847,6 +1708,12 @@ void update_display_task(void *parameter) {
             lastWifiStatusUpdate = currentTime;
         }
         
+        // Show stream title changes posted by the audio network task
+        NowPlaying nowPlaying;
+        if (AudioManager::getInstance().receiveNowPlaying(nowPlaying)) {
+            ui.updateNowPlaying(nowPlaying.artist, nowPlaying.title);
+        }
+        
         // Small delay to allow other tasks to run
         vTaskDelay(pdMS_TO_TICKS(1)); // 1ms delay for high refresh rate
     }
@@ -927,12 +1794,15 @@ void update_sensors_task(void *parameter) {
 }
 
 void check_alarms_task(void *parameter) {
+    AlarmManager& alarms = AlarmManager::getInstance();
+    
     while (1) {
-        // Check if any alarms need to be triggered
-        AlarmManager::getInstance().checkAlarms();
+        // Check if any alarms need to be triggered (and snooze timeouts)
+        alarms.update();
         
-        // Sleep for 1 second
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        // Wake just after each second of the clock turns over, so an alarm
+        // fires within a few ms of its minute instead of up to a second late
+        vTaskDelay(pdMS_TO_TICKS(alarms.msToNextSecond()));
     }
 }
 